@@ -3,10 +3,304 @@
 #ifndef __LINUX_MFD_MICROCHIP_DPLL_H
 #define __LINUX_MFD_MICROCHIP_DPLL_H
 
+#include <linux/atomic.h>
+#include <linux/ktime.h>
+#include <linux/minmax.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/wait.h>
+
+/* Bus users are split in two classes. Latency critical transfers are the ones
+ * a PTP servo waits on (TOD, DCO, TIE, phase step). Everything else is
+ * background and gives way to them: each background transfer is a chunk, and
+ * a pending critical transfer is served at the next chunk boundary.
+ */
+/* A critical transfer within this window means a servo operation, usually a
+ * burst of several transfers, is still in progress
+ */
+#define MICROCHIP_DPLL_BUS_CRITICAL_BURST_NS	(1 * NSEC_PER_MSEC)
+
+/* Page of the chip not known, the next access selects it */
+#define MICROCHIP_DPLL_PAGE_INVALID		0xffff
+
+/* A failed transfer is retried at most this many times, and all transfers of
+ * a device share a budget of retries per period, so that a dead bus costs a
+ * bounded time per access instead of retries on every byte
+ */
+#define MICROCHIP_DPLL_XFER_RETRIES		2
+#define MICROCHIP_DPLL_RETRY_BUDGET		16
+#define MICROCHIP_DPLL_RETRY_PERIOD_NS		(1 * NSEC_PER_SEC)
+
+enum microchip_dpll_bus_class {
+	MICROCHIP_DPLL_BUS_CRITICAL,
+	MICROCHIP_DPLL_BUS_BACKGROUND,
+	MICROCHIP_DPLL_BUS_CLASS_MAX,
+};
+
+enum microchip_dpll_bus_type {
+	MICROCHIP_DPLL_BUS_I2C,
+	MICROCHIP_DPLL_BUS_SPI,
+};
+
+/* Per class bus lock acquisitions, one per zl3073x_read()/zl3073x_write().
+ * regmap moves one byte per transaction, so an access of n bytes is n
+ * transactions on the wire, see microchip_dpll_bus_xfers().
+ */
+struct microchip_dpll_bus_stats {
+	u64 transfers;
+	u64 wait_total_ns;
+	u64 wait_max_ns;
+	/* Times a background transfer stepped aside for a critical one */
+	u64 yields;
+};
+
+/* Transfer errors of the transport, for all classes */
+struct microchip_dpll_bus_errors {
+	u64 errors;
+	u64 retries;
+	/* Errors not retried because the budget was spent */
+	u64 budget_exhausted;
+	/* Accesses that failed after all retries */
+	u64 failures;
+};
+
+struct microchip_dpll_rec;
+
 struct microchip_dpll_ddata {
 	struct device *dev;
 	struct regmap *regmap;
 	struct mutex lock;
 	u16 page;
+
+	/* Transport and its clock (0 if unknown), for timing estimates */
+	enum microchip_dpll_bus_type bus_type;
+	u32 bus_hz;
+
+	/* Transaction recorder of the transport, see mfd/microchip-dpll-rec.h */
+	struct microchip_dpll_rec *rec;
+
+	/* Bus arbitration */
+	atomic_t critical_pending;
+	u64 critical_last_ns;
+	wait_queue_head_t critical_wq;
+	spinlock_t stats_lock;
+	struct microchip_dpll_bus_stats stats[MICROCHIP_DPLL_BUS_CLASS_MAX];
+
+	/* Error recovery of the transport, under lock */
+	unsigned int retry_budget;
+	u64 retry_period_start;
+	/* Protected by stats_lock */
+	struct microchip_dpll_bus_errors errors;
+	/* Page register writes and all transactions on the wire, page selects
+	 * included. Never reset so that users can take deltas. Protected by
+	 * stats_lock.
+	 */
+	u64 page_selects;
+	u64 xfers;
 };
+
+static inline void microchip_dpll_bus_init(struct microchip_dpll_ddata *ddata)
+{
+	mutex_init(&ddata->lock);
+	ddata->page = MICROCHIP_DPLL_PAGE_INVALID;
+	ddata->retry_budget = MICROCHIP_DPLL_RETRY_BUDGET;
+	atomic_set(&ddata->critical_pending, 0);
+	init_waitqueue_head(&ddata->critical_wq);
+	spin_lock_init(&ddata->stats_lock);
+}
+
+static inline void microchip_dpll_bus_lock(struct microchip_dpll_ddata *ddata,
+					   enum microchip_dpll_bus_class class)
+{
+	struct microchip_dpll_bus_stats *stats = &ddata->stats[class];
+	u64 start = ktime_get_ns();
+	u64 yields = 0;
+	u64 wait;
+
+	if (class == MICROCHIP_DPLL_BUS_CRITICAL) {
+		atomic_inc(&ddata->critical_pending);
+		mutex_lock(&ddata->lock);
+		atomic_dec(&ddata->critical_pending);
+	} else {
+		for (;;) {
+			wait_event(ddata->critical_wq,
+				   !atomic_read(&ddata->critical_pending));
+			mutex_lock(&ddata->lock);
+			if (!atomic_read(&ddata->critical_pending))
+				break;
+
+			/* A critical transfer queued up while we were waiting */
+			mutex_unlock(&ddata->lock);
+			yields++;
+		}
+	}
+
+	wait = ktime_get_ns() - start;
+
+	spin_lock(&ddata->stats_lock);
+	stats->transfers++;
+	stats->wait_total_ns += wait;
+	stats->wait_max_ns = max(stats->wait_max_ns, wait);
+	stats->yields += yields;
+	spin_unlock(&ddata->stats_lock);
+}
+
+static inline void microchip_dpll_bus_unlock(struct microchip_dpll_ddata *ddata,
+					     enum microchip_dpll_bus_class class)
+{
+	if (class == MICROCHIP_DPLL_BUS_CRITICAL)
+		WRITE_ONCE(ddata->critical_last_ns, ktime_get_ns());
+
+	mutex_unlock(&ddata->lock);
+
+	if (class == MICROCHIP_DPLL_BUS_CRITICAL &&
+	    !atomic_read(&ddata->critical_pending))
+		wake_up_all(&ddata->critical_wq);
+}
+
+/* Bus clock cycles of a write of @len bytes to one register, and the cycle
+ * that ends its last data bit. I2C: start, address, register, the data and a
+ * stop. SPI: a command byte and the data.
+ */
+static inline void microchip_dpll_bus_write_cycles(struct microchip_dpll_ddata *ddata,
+						   u16 len, u32 *total, u32 *last_data)
+{
+	if (ddata->bus_type == MICROCHIP_DPLL_BUS_I2C) {
+		*total = 9 * (2 + len) + 2;
+		*last_data = 1 + 9 * (1 + len) + 8;
+	} else {
+		*total = 8 * (1 + len);
+		*last_data = *total;
+	}
+}
+
+/* Page the chip is on as the transport last set it, or
+ * MICROCHIP_DPLL_PAGE_INVALID. Read without the bus lock, so only a hint for
+ * ordering accesses.
+ */
+static inline u16 microchip_dpll_bus_page(struct microchip_dpll_ddata *ddata)
+{
+	return READ_ONCE(ddata->page);
+}
+
+/* Called by the transports before every write of the page register */
+static inline void microchip_dpll_bus_page_select(struct microchip_dpll_ddata *ddata)
+{
+	spin_lock(&ddata->stats_lock);
+	ddata->page_selects++;
+	spin_unlock(&ddata->stats_lock);
+}
+
+static inline u64 microchip_dpll_bus_page_selects(struct microchip_dpll_ddata *ddata)
+{
+	u64 n;
+
+	spin_lock(&ddata->stats_lock);
+	n = ddata->page_selects;
+	spin_unlock(&ddata->stats_lock);
+
+	return n;
+}
+
+/* Called by the transports for every transaction on the wire */
+static inline void microchip_dpll_bus_xfer(struct microchip_dpll_ddata *ddata)
+{
+	spin_lock(&ddata->stats_lock);
+	ddata->xfers++;
+	spin_unlock(&ddata->stats_lock);
+}
+
+static inline u64 microchip_dpll_bus_xfers(struct microchip_dpll_ddata *ddata)
+{
+	u64 n;
+
+	spin_lock(&ddata->stats_lock);
+	n = ddata->xfers;
+	spin_unlock(&ddata->stats_lock);
+
+	return n;
+}
+
+/* Called by the transports after a failed page select or read of an access.
+ * The page register may or may not have taken the write, so the next attempt
+ * selects the page again. Returns whether the access is to be retried.
+ */
+static inline bool microchip_dpll_bus_xfer_failed(struct microchip_dpll_ddata *ddata,
+						  unsigned int attempt)
+{
+	u64 now = ktime_get_ns();
+	bool retry = false;
+
+	ddata->page = MICROCHIP_DPLL_PAGE_INVALID;
+
+	if (now - ddata->retry_period_start >= MICROCHIP_DPLL_RETRY_PERIOD_NS) {
+		ddata->retry_period_start = now;
+		ddata->retry_budget = MICROCHIP_DPLL_RETRY_BUDGET;
+	}
+
+	if (attempt < MICROCHIP_DPLL_XFER_RETRIES && ddata->retry_budget) {
+		ddata->retry_budget--;
+		retry = true;
+	}
+
+	spin_lock(&ddata->stats_lock);
+	ddata->errors.errors++;
+	if (retry)
+		ddata->errors.retries++;
+	else if (attempt < MICROCHIP_DPLL_XFER_RETRIES)
+		ddata->errors.budget_exhausted++;
+	if (!retry)
+		ddata->errors.failures++;
+	spin_unlock(&ddata->stats_lock);
+
+	return retry;
+}
+
+/* Called by the transports after a failed data write. The chip may have taken
+ * the write despite the error, and writing a command register twice runs the
+ * command twice, so data writes are never retried. The page is selected again
+ * by the next access.
+ */
+static inline void microchip_dpll_bus_write_failed(struct microchip_dpll_ddata *ddata)
+{
+	microchip_dpll_bus_xfer_failed(ddata, MICROCHIP_DPLL_XFER_RETRIES);
+}
+
+/* Lets a long background job decide to step aside between its chunks */
+static inline bool microchip_dpll_bus_critical_busy(struct microchip_dpll_ddata *ddata)
+{
+	if (atomic_read(&ddata->critical_pending))
+		return true;
+
+	return ktime_get_ns() - READ_ONCE(ddata->critical_last_ns) <
+	       MICROCHIP_DPLL_BUS_CRITICAL_BURST_NS;
+}
+
+static inline void
+microchip_dpll_bus_stats_get(struct microchip_dpll_ddata *ddata,
+			     struct microchip_dpll_bus_stats *stats)
+{
+	spin_lock(&ddata->stats_lock);
+	memcpy(stats, ddata->stats, sizeof(ddata->stats));
+	spin_unlock(&ddata->stats_lock);
+}
+
+static inline void
+microchip_dpll_bus_errors_get(struct microchip_dpll_ddata *ddata,
+			      struct microchip_dpll_bus_errors *errors)
+{
+	spin_lock(&ddata->stats_lock);
+	*errors = ddata->errors;
+	spin_unlock(&ddata->stats_lock);
+}
+
+static inline void
+microchip_dpll_bus_stats_reset(struct microchip_dpll_ddata *ddata)
+{
+	spin_lock(&ddata->stats_lock);
+	memset(ddata->stats, 0, sizeof(ddata->stats));
+	memset(&ddata->errors, 0, sizeof(ddata->errors));
+	spin_unlock(&ddata->stats_lock);
+}
 #endif /*  __LINUX_MFD_MICROCHIP_DPLL_H */
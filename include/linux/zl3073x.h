@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+#ifndef __LINUX_ZL3073X_H
+#define __LINUX_ZL3073X_H
+
+#include <linux/dpll.h>
+#include <linux/notifier.h>
+#include <linux/types.h>
+
+/* In-kernel consumer API of ptp_zl3073x, for drivers on the same board (e.g.
+ * a NIC that advertises SyncE quality) that must react to lock and holdover
+ * changes without going through userspace.
+ *
+ * A DPLL channel is identified by the clock ID of its device, as reported by
+ * the DPLL netlink API or set with the "clock-id" firmware property, and by
+ * its index on that device.
+ */
+
+#define ZL3073X_REF_NONE	(-1)
+
+struct zl3073x_dpll_status {
+	enum dpll_lock_status	lock_status;
+	/* Reference the DPLL is locked or locking to, or ZL3073X_REF_NONE */
+	int			selected_ref;
+	/* Of the selected reference, in the units of the DPLL netlink
+	 * phase-offset and fractional-frequency-offset attributes. Zero when
+	 * there is no selected reference.
+	 */
+	s64			phase_offset;
+	s64			ffo;
+	/* CLOCK_MONOTONIC time the status was sampled at */
+	u64			timestamp_ns;
+};
+
+/* Bits of the notifier action */
+#define ZL3073X_DPLL_EVENT_LOCK_STATUS	BIT(0)
+#define ZL3073X_DPLL_EVENT_REF_CHANGE	BIT(1)
+
+/* Data passed to the notifier. The status is only valid during the call. */
+struct zl3073x_dpll_event {
+	struct device		*dev;
+	u64			clock_id;
+	int			dpll_index;
+	enum dpll_lock_status	prev_lock_status;
+	const struct zl3073x_dpll_status *status;
+};
+
+/* The chain is atomic: callbacks run in the context of the driver monitor
+ * under rcu_read_lock() and must not sleep. The action is a mask of
+ * ZL3073X_DPLL_EVENT_* bits.
+ */
+int zl3073x_dpll_register_notifier(struct notifier_block *nb);
+int zl3073x_dpll_unregister_notifier(struct notifier_block *nb);
+
+/* Copies the last status published by the monitor. Safe in any context,
+ * including hard IRQ. Returns -ENODEV for an unknown clock ID or index and
+ * -ENODATA before the first monitor sweep.
+ */
+int zl3073x_dpll_status_get(u64 clock_id, int dpll_index,
+			    struct zl3073x_dpll_status *status);
+
+#endif /* __LINUX_ZL3073X_H */
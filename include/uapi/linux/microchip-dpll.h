@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+
+#ifndef _UAPI_LINUX_MICROCHIP_DPLL_H
+#define _UAPI_LINUX_MICROCHIP_DPLL_H
+
+#include <linux/types.h>
+
+/* Bus transaction recorder dump, as read from
+ * /sys/kernel/debug/microchip-dpll-{i2c,spi}/<device>/recorder.bin: one header
+ * followed by header.count entries, oldest first. All fields are in host byte
+ * order.
+ *
+ * Every entry is one transfer on the wire. The register address of an access
+ * is page * 128 + offset; a write to offset MICROCHIP_DPLL_REC_PAGE_REG
+ * selects the page of the following accesses.
+ */
+#define MICROCHIP_DPLL_REC_MAGIC	0x4352444d	/* "MDRC" */
+#define MICROCHIP_DPLL_REC_VERSION	1
+
+#define MICROCHIP_DPLL_REC_PAGE_REG	0x7f
+#define MICROCHIP_DPLL_REC_DATA_MAX	8
+/* Entry page while the transport does not know the current page */
+#define MICROCHIP_DPLL_REC_PAGE_UNKNOWN	0xff
+
+enum microchip_dpll_rec_bus {
+	MICROCHIP_DPLL_REC_BUS_I2C,
+	MICROCHIP_DPLL_REC_BUS_SPI,
+};
+
+struct microchip_dpll_rec_header {
+	__u32	magic;
+	__u16	version;
+	__u16	entry_size;
+	__u32	count;
+	__u32	bus;		/* enum microchip_dpll_rec_bus */
+	__u32	bus_hz;		/* 0 when unknown */
+	__u32	reserved;
+	/* Entries overwritten because the ring was full */
+	__u64	dropped;
+} __attribute__((packed));
+
+/* flags */
+#define MICROCHIP_DPLL_REC_WRITE	(1 << 0)
+#define MICROCHIP_DPLL_REC_ERROR	(1 << 1)
+
+struct microchip_dpll_rec_entry {
+	/* CLOCK_MONOTONIC start of the transfer */
+	__u64	timestamp_ns;
+	__u32	latency_ns;
+	__u8	flags;
+	/* Current page before the transfer */
+	__u8	page;
+	__u8	offset;
+	/* Bytes transferred; only the first MICROCHIP_DPLL_REC_DATA_MAX are kept */
+	__u8	len;
+	__u8	data[MICROCHIP_DPLL_REC_DATA_MAX];
+} __attribute__((packed));
+
+#endif /* _UAPI_LINUX_MICROCHIP_DPLL_H */
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+
+#ifndef _UAPI_LINUX_ZL3073X_H
+#define _UAPI_LINUX_ZL3073X_H
+
+#include <linux/types.h>
+
+/* Layout of the "status_record" binary sysfs attribute of a ptp_zl3073x
+ * device. The monitor rewrites the whole record at the end of every sweep; a
+ * read of the whole record at offset 0 returns one coherent sweep. Readers
+ * must check version and size, and only look at the first num_dplls DPLLs
+ * and num_refs references.
+ */
+#define ZL3073X_STATUS_VERSION		1
+
+#define ZL3073X_STATUS_MAX_DPLLS	5
+#define ZL3073X_STATUS_MAX_REFS		10
+
+#define ZL3073X_STATUS_REF_NONE		0xff
+
+/* flags */
+#define ZL3073X_STATUS_F_TOD_VALID	(1 << 0)
+#define ZL3073X_STATUS_F_DCO_VALID	(1 << 1)
+
+struct zl3073x_status_ref {
+	/* In the units of the DPLL netlink phase-offset and
+	 * fractional-frequency-offset attributes
+	 */
+	__s64	phase_offset;
+	__s64	ffo;
+	__u8	priority;
+	__u8	state;			/* enum dpll_pin_state */
+	__u8	reserved[6];
+} __attribute__((packed));
+
+struct zl3073x_status_dpll {
+	__u8	lock_status;		/* enum dpll_lock_status */
+	__u8	mode;			/* DPLL_MODE_REFSEL mode field */
+	__u8	selected_ref;		/* or ZL3073X_STATUS_REF_NONE */
+	__u8	reserved[5];
+	struct zl3073x_status_ref ref[ZL3073X_STATUS_MAX_REFS];
+} __attribute__((packed));
+
+struct zl3073x_status_record {
+	__u32	version;
+	__u32	size;
+	/* Incremented on every publication */
+	__u64	generation;
+	/* CLOCK_MONOTONIC end of the sweep */
+	__u64	timestamp_ns;
+	__u16	chip_id;
+	__u8	num_dplls;
+	__u8	num_refs;
+	__u8	ptp_dpll;
+	__u8	reserved0;
+	__u16	flags;
+
+	/* DPLL_REF_MON_STATUS per reference, 0 means qualified */
+	__u8	ref_status[ZL3073X_STATUS_MAX_REFS];
+	__u8	reserved1[6];
+
+	/* Last TOD read of the PTP DPLL and the CLOCK_REALTIME time of the
+	 * read command, both in nanoseconds
+	 */
+	__s64	tod_ns;
+	__s64	tod_sys_ns;
+
+	/* Last DCO frequency offset word of the PTP DPLL, sign extended */
+	__s64	dco_word;
+
+	struct zl3073x_status_dpll dpll[ZL3073X_STATUS_MAX_DPLLS];
+} __attribute__((packed));
+
+#endif /* _UAPI_LINUX_ZL3073X_H */
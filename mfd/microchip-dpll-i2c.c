@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0+
 
+#include <linux/debugfs.h>
 #include <linux/i2c.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
@@ -11,6 +12,8 @@
 #include <linux/of_platform.h>
 #include <linux/mfd/microchip-dpll.h>
 
+#include "microchip-dpll-rec.h"
+
 #define MICROCHIP_DPLL_PAGE_ADDR		0x007F
 #define MICROCHIP_DPLL_HIGHER_ADDR_MASK		0xFF80
 #define MICROCHIP_DPLL_LOWER_ADDR_MASK		0x007F
@@ -27,8 +30,11 @@ static const struct of_device_id microchip_dpll_i2c_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, microchip_dpll_i2c_of_match);
 
-static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
-				      u8 reg, u8 *buf, u16 bytes)
+/* Parent of the per-device recorder directories */
+static struct dentry *microchip_dpll_i2c_debugfs;
+
+static int __microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
+					u8 reg, u8 *buf, u16 bytes)
 {
 	struct i2c_client *client = to_i2c_client(dpll->dev);
 	struct i2c_msg msg[2];
@@ -58,8 +64,8 @@ static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
 	return 0;
 }
 
-static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
-				       u8 reg, u8 *buf, u16 bytes)
+static int __microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
+					 u8 reg, u8 *buf, u16 bytes)
 {
 	struct i2c_client *client = to_i2c_client(dpll->dev);
 	u8 msg[256];
@@ -79,6 +85,32 @@ static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
 	return 0;
 }
 
+static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
+				      u8 reg, u8 *buf, u16 bytes)
+{
+	u64 start = microchip_dpll_rec_begin(dpll);
+	int ret;
+
+	microchip_dpll_bus_xfer(dpll);
+	ret = __microchip_dpll_read_device(dpll, reg, buf, bytes);
+	microchip_dpll_rec_log(dpll, start, false, reg, buf, bytes, ret);
+
+	return ret;
+}
+
+static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
+				       u8 reg, u8 *buf, u16 bytes)
+{
+	u64 start = microchip_dpll_rec_begin(dpll);
+	int ret;
+
+	microchip_dpll_bus_xfer(dpll);
+	ret = __microchip_dpll_write_device(dpll, reg, buf, bytes);
+	microchip_dpll_rec_log(dpll, start, true, reg, buf, bytes, ret);
+
+	return ret;
+}
+
 static int microchip_dpll_write_page_register(struct microchip_dpll_ddata *dpll,
 					      u16 reg)
 {
@@ -97,9 +129,10 @@ static int microchip_dpll_write_page_register(struct microchip_dpll_ddata *dpll,
 	if (dpll->page == page)
 		return 0;
 
+	microchip_dpll_bus_page_select(dpll);
 	err = microchip_dpll_write_device(dpll, page_reg, &buf, bytes);
 	if (err)
-		dev_err(dpll->dev, "Failed to set page offset 0x%x\n", page);
+		dev_err_ratelimited(dpll->dev, "Failed to set page offset 0x%x\n", page);
 	else
 		/* Remember the last page */
 		dpll->page = page;
@@ -111,16 +144,18 @@ static int microchip_dpll_reg_read(void *context, unsigned int reg, unsigned int
 {
 	struct microchip_dpll_ddata *dpll = i2c_get_clientdata((struct i2c_client *)context);
 	u8 addr = (u8)(reg & MICROCHIP_DPLL_LOWER_ADDR_MASK);
+	unsigned int attempt = 0;
 	int err;
 
-	err = microchip_dpll_write_page_register(dpll, reg);
-	if (err)
-		return err;
+	do {
+		err = microchip_dpll_write_page_register(dpll, reg);
+		if (!err)
+			err = microchip_dpll_read_device(dpll, addr, (u8 *)val, 1);
+	} while (err && microchip_dpll_bus_xfer_failed(dpll, attempt++));
 
-	err = microchip_dpll_read_device(dpll, addr, (u8 *)val, 1);
 	if (err)
-		dev_err(dpll->dev,
-			"Failed to read offset address 0x%x\n", addr);
+		dev_err_ratelimited(dpll->dev,
+				    "Failed to read offset address 0x%x\n", addr);
 
 	return err;
 }
@@ -129,17 +164,23 @@ static int microchip_dpll_reg_write(void *context, unsigned int reg, unsigned in
 {
 	struct microchip_dpll_ddata *dpll = i2c_get_clientdata((struct i2c_client *)context);
 	u8 addr = (u8)(reg & MICROCHIP_DPLL_LOWER_ADDR_MASK);
+	unsigned int attempt = 0;
 	u8 data = (u8)val;
 	int err;
 
-	err = microchip_dpll_write_page_register(dpll, reg);
-	if (err)
-		return err;
+	do {
+		err = microchip_dpll_write_page_register(dpll, reg);
+	} while (err && microchip_dpll_bus_xfer_failed(dpll, attempt++));
+
+	if (!err) {
+		err = microchip_dpll_write_device(dpll, addr, &data, 1);
+		if (err)
+			microchip_dpll_bus_write_failed(dpll);
+	}
 
-	err = microchip_dpll_write_device(dpll, addr, &data, 1);
 	if (err)
-		dev_err(dpll->dev,
-			"Failed to write offset address 0x%x\n", addr);
+		dev_err_ratelimited(dpll->dev,
+				    "Failed to write offset address 0x%x\n", addr);
 
 	return err;
 }
@@ -156,6 +197,7 @@ static const struct regmap_config microchip_dpll_regmap_config = {
 static int microchip_dpll_i2c_probe(struct i2c_client *client)
 {
 	struct microchip_dpll_ddata *dpll;
+	struct i2c_timings timings;
 	int ret;
 
 	dpll = devm_kzalloc(&client->dev, sizeof(*dpll), GFP_KERNEL);
@@ -172,13 +214,30 @@ static int microchip_dpll_i2c_probe(struct i2c_client *client)
 		dev_err(dpll->dev, "Failed to allocate register map: %d\n", ret);
 		return ret;
 	}
-	mutex_init(&dpll->lock);
+	microchip_dpll_bus_init(dpll);
 
-	return of_platform_default_populate(dpll->dev->of_node, NULL, dpll->dev);
+	/* The bus clock of the adapter, 100 kHz if the firmware has none */
+	i2c_parse_fw_timings(&client->adapter->dev, &timings, true);
+	dpll->bus_type = MICROCHIP_DPLL_BUS_I2C;
+	dpll->bus_hz = timings.bus_freq_hz;
+
+	ret = microchip_dpll_rec_init(dpll, microchip_dpll_i2c_debugfs,
+				      MICROCHIP_DPLL_REC_BUS_I2C, dpll->bus_hz);
+	if (ret)
+		return ret;
+
+	ret = of_platform_default_populate(dpll->dev->of_node, NULL, dpll->dev);
+	if (ret)
+		microchip_dpll_rec_exit(dpll);
+
+	return ret;
 }
 
 static void microchip_dpll_i2c_remove(struct i2c_client *client)
 {
+	struct microchip_dpll_ddata *dpll = i2c_get_clientdata(client);
+
+	microchip_dpll_rec_exit(dpll);
 }
 
 static struct i2c_driver microchip_dpll_i2c_driver = {
@@ -193,13 +252,22 @@ static struct i2c_driver microchip_dpll_i2c_driver = {
 
 static int __init microchip_dpll_i2c_init(void)
 {
-	return i2c_add_driver(&microchip_dpll_i2c_driver);
+	int ret;
+
+	microchip_dpll_i2c_debugfs = debugfs_create_dir("microchip-dpll-i2c", NULL);
+
+	ret = i2c_add_driver(&microchip_dpll_i2c_driver);
+	if (ret)
+		debugfs_remove_recursive(microchip_dpll_i2c_debugfs);
+
+	return ret;
 }
 subsys_initcall(microchip_dpll_i2c_init);
 
 static void __exit microchip_dpll_i2c_exit(void)
 {
 	i2c_del_driver(&microchip_dpll_i2c_driver);
+	debugfs_remove_recursive(microchip_dpll_i2c_debugfs);
 }
 module_exit(microchip_dpll_i2c_exit);
 
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* Bus transaction recorder of the I2C and SPI transports, see
+ * microchip-dpll-rec.h
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+#include "microchip-dpll-rec.h"
+
+struct microchip_dpll_rec_snapshot {
+	size_t			len;
+	u8			data[];
+};
+
+void microchip_dpll_rec_log(struct microchip_dpll_ddata *ddata, u64 start, bool write,
+			    u8 reg, const u8 *buf, u16 bytes, int err)
+{
+	struct microchip_dpll_rec *rec = ddata->rec;
+	struct microchip_dpll_rec_entry *e;
+	unsigned long flags;
+	u64 latency;
+
+	if (!start)
+		return;
+
+	latency = ktime_get_ns() - start;
+
+	spin_lock_irqsave(&rec->lock, flags);
+	if (!rec->enabled)
+		goto out;
+
+	e = &rec->ring[rec->head];
+	e->timestamp_ns = start;
+	e->latency_ns = min_t(u64, latency, U32_MAX);
+	e->flags = (write ? MICROCHIP_DPLL_REC_WRITE : 0) |
+		   (err ? MICROCHIP_DPLL_REC_ERROR : 0);
+	e->page = ddata->page == MICROCHIP_DPLL_PAGE_INVALID ?
+		  MICROCHIP_DPLL_REC_PAGE_UNKNOWN : ddata->page >> 7;
+	e->offset = reg;
+	e->len = min_t(u16, bytes, U8_MAX);
+	memset(e->data, 0, sizeof(e->data));
+	if (!err || write)
+		memcpy(e->data, buf, min_t(u16, bytes, sizeof(e->data)));
+
+	rec->head = (rec->head + 1) % rec->size;
+	if (rec->count < rec->size)
+		rec->count++;
+	else
+		rec->dropped++;
+out:
+	spin_unlock_irqrestore(&rec->lock, flags);
+}
+EXPORT_SYMBOL_GPL(microchip_dpll_rec_log);
+
+static int microchip_dpll_rec_start(struct microchip_dpll_rec *rec, u32 entries)
+{
+	struct microchip_dpll_rec_entry *ring, *old = NULL;
+	unsigned long flags;
+
+	if (!entries || entries > MICROCHIP_DPLL_REC_MAX_ENTRIES)
+		return -EINVAL;
+
+	if (rec->enabled)
+		return -EBUSY;
+
+	if (entries != rec->size) {
+		ring = kvcalloc(entries, sizeof(*ring), GFP_KERNEL);
+		if (!ring)
+			return -ENOMEM;
+	} else {
+		ring = rec->ring;
+	}
+
+	spin_lock_irqsave(&rec->lock, flags);
+	if (ring != rec->ring)
+		old = rec->ring;
+	rec->ring = ring;
+	rec->size = entries;
+	rec->head = 0;
+	rec->count = 0;
+	rec->dropped = 0;
+	WRITE_ONCE(rec->enabled, true);
+	spin_unlock_irqrestore(&rec->lock, flags);
+
+	kvfree(old);
+
+	return 0;
+}
+
+static void microchip_dpll_rec_stop(struct microchip_dpll_rec *rec)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rec->lock, flags);
+	WRITE_ONCE(rec->enabled, false);
+	spin_unlock_irqrestore(&rec->lock, flags);
+}
+
+static void microchip_dpll_rec_clear(struct microchip_dpll_rec *rec)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&rec->lock, flags);
+	rec->head = 0;
+	rec->count = 0;
+	rec->dropped = 0;
+	spin_unlock_irqrestore(&rec->lock, flags);
+}
+
+static int microchip_dpll_rec_ctl_show(struct seq_file *s, void *unused)
+{
+	struct microchip_dpll_rec *rec = s->private;
+	unsigned long flags;
+	u32 count, size;
+	u64 dropped;
+	bool enabled;
+
+	spin_lock_irqsave(&rec->lock, flags);
+	enabled = rec->enabled;
+	count = rec->count;
+	size = rec->size;
+	dropped = rec->dropped;
+	spin_unlock_irqrestore(&rec->lock, flags);
+
+	seq_printf(s, "state: %s\n", enabled ? "recording" : "stopped");
+	seq_printf(s, "entries: %u/%u\n", count, size);
+	seq_printf(s, "dropped: %llu\n", dropped);
+
+	return 0;
+}
+
+static int microchip_dpll_rec_ctl_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, microchip_dpll_rec_ctl_show, inode->i_private);
+}
+
+/* Accepted input:
+ *	"start [<entries>]"	clear and record into a ring of <entries>
+ *	"stop"			stop recording, keep the log for dumping
+ *	"clear"			drop the log
+ */
+static ssize_t microchip_dpll_rec_ctl_write(struct file *file,
+					    const char __user *ubuf,
+					    size_t count, loff_t *ppos)
+{
+	struct microchip_dpll_rec *rec = file_inode(file)->i_private;
+	u32 entries = MICROCHIP_DPLL_REC_DEFAULT_ENTRIES;
+	char buf[32];
+	char *arg;
+	int ret = 0;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	arg = strim(buf);
+
+	mutex_lock(&rec->ctl_lock);
+
+	if (!strncmp(arg, "start", 5)) {
+		arg = skip_spaces(arg + 5);
+		if (*arg)
+			ret = kstrtou32(arg, 0, &entries);
+		if (!ret)
+			ret = microchip_dpll_rec_start(rec, entries);
+	} else if (!strcmp(arg, "stop")) {
+		microchip_dpll_rec_stop(rec);
+	} else if (!strcmp(arg, "clear")) {
+		microchip_dpll_rec_clear(rec);
+	} else {
+		ret = -EINVAL;
+	}
+
+	mutex_unlock(&rec->ctl_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations microchip_dpll_rec_ctl_fops = {
+	.owner = THIS_MODULE,
+	.open = microchip_dpll_rec_ctl_open,
+	.read = seq_read,
+	.write = microchip_dpll_rec_ctl_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* The dump is taken at open, so a reader sees one consistent log even while
+ * recording goes on
+ */
+static int microchip_dpll_rec_bin_open(struct inode *inode, struct file *file)
+{
+	struct microchip_dpll_rec *rec = inode->i_private;
+	struct microchip_dpll_rec_snapshot *snap;
+	struct microchip_dpll_rec_header *hdr;
+	struct microchip_dpll_rec_entry *out;
+	unsigned long flags;
+	u32 first;
+
+	mutex_lock(&rec->ctl_lock);
+
+	snap = kvzalloc(struct_size(snap, data, sizeof(*hdr) +
+				    (size_t)rec->size * sizeof(*out)), GFP_KERNEL);
+	if (!snap) {
+		mutex_unlock(&rec->ctl_lock);
+		return -ENOMEM;
+	}
+
+	hdr = (struct microchip_dpll_rec_header *)snap->data;
+	out = (struct microchip_dpll_rec_entry *)(hdr + 1);
+
+	spin_lock_irqsave(&rec->lock, flags);
+	first = rec->size ? (rec->head + rec->size - rec->count) % rec->size : 0;
+	for (u32 i = 0; i < rec->count; i++)
+		out[i] = rec->ring[(first + i) % rec->size];
+	hdr->count = rec->count;
+	hdr->dropped = rec->dropped;
+	spin_unlock_irqrestore(&rec->lock, flags);
+
+	mutex_unlock(&rec->ctl_lock);
+
+	hdr->magic = MICROCHIP_DPLL_REC_MAGIC;
+	hdr->version = MICROCHIP_DPLL_REC_VERSION;
+	hdr->entry_size = sizeof(*out);
+	hdr->bus = rec->bus;
+	hdr->bus_hz = rec->bus_hz;
+	snap->len = sizeof(*hdr) + (size_t)hdr->count * sizeof(*out);
+
+	file->private_data = snap;
+
+	return 0;
+}
+
+static ssize_t microchip_dpll_rec_bin_read(struct file *file, char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	struct microchip_dpll_rec_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, snap->data, snap->len);
+}
+
+static int microchip_dpll_rec_bin_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+
+	return 0;
+}
+
+static const struct file_operations microchip_dpll_rec_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = microchip_dpll_rec_bin_open,
+	.read = microchip_dpll_rec_bin_read,
+	.llseek = default_llseek,
+	.release = microchip_dpll_rec_bin_release,
+};
+
+int microchip_dpll_rec_init(struct microchip_dpll_ddata *ddata, struct dentry *root,
+			   enum microchip_dpll_rec_bus bus, u32 bus_hz)
+{
+	struct microchip_dpll_rec *rec;
+
+	rec = devm_kzalloc(ddata->dev, sizeof(*rec), GFP_KERNEL);
+	if (!rec)
+		return -ENOMEM;
+
+	mutex_init(&rec->ctl_lock);
+	spin_lock_init(&rec->lock);
+	rec->bus = bus;
+	rec->bus_hz = bus_hz;
+	ddata->rec = rec;
+
+	rec->debugfs = debugfs_create_dir(dev_name(ddata->dev), root);
+	debugfs_create_file("recorder", 0600, rec->debugfs, rec,
+			    &microchip_dpll_rec_ctl_fops);
+	debugfs_create_file("recorder.bin", 0400, rec->debugfs, rec,
+			    &microchip_dpll_rec_bin_fops);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(microchip_dpll_rec_init);
+
+void microchip_dpll_rec_exit(struct microchip_dpll_ddata *ddata)
+{
+	struct microchip_dpll_rec *rec = ddata->rec;
+
+	debugfs_remove_recursive(rec->debugfs);
+	microchip_dpll_rec_stop(rec);
+	kvfree(rec->ring);
+	rec->ring = NULL;
+}
+EXPORT_SYMBOL_GPL(microchip_dpll_rec_exit);
+
+MODULE_DESCRIPTION("Microchip DPLL bus transaction recorder");
+MODULE_LICENSE("GPL");
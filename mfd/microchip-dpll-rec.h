@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+
+/* Bus transaction recorder shared by the I2C and SPI transports, built as
+ * the microchip-dpll-rec module.
+ *
+ * When started, every transfer on the wire (page selection included) is
+ * logged into a ring buffer. The control file is
+ * <debugfs>/microchip-dpll-{i2c,spi}/<device>/recorder and the dump, in the
+ * format of uapi/linux/microchip-dpll.h, is recorder.bin next to it.
+ */
+
+#ifndef __MICROCHIP_DPLL_REC_H
+#define __MICROCHIP_DPLL_REC_H
+
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/mfd/microchip-dpll.h>
+#include <uapi/linux/microchip-dpll.h>
+
+#define MICROCHIP_DPLL_REC_DEFAULT_ENTRIES	65536
+#define MICROCHIP_DPLL_REC_MAX_ENTRIES		(1 << 20)
+
+struct dentry;
+
+struct microchip_dpll_rec {
+	/* Serializes start/stop/clear and dump snapshots */
+	struct mutex		ctl_lock;
+	/* Protects the ring, taken for every logged transfer */
+	spinlock_t		lock;
+	bool			enabled;
+	struct microchip_dpll_rec_entry *ring;
+	u32			size;
+	u32			head;
+	u32			count;
+	u64			dropped;
+
+	enum microchip_dpll_rec_bus bus;
+	u32			bus_hz;
+	struct dentry		*debugfs;
+};
+
+/* Returns the start time of the transfer, or 0 when not recording */
+static inline u64 microchip_dpll_rec_begin(struct microchip_dpll_ddata *ddata)
+{
+	return READ_ONCE(ddata->rec->enabled) ? ktime_get_ns() : 0;
+}
+
+/* Log a transfer that began at @start, as returned by microchip_dpll_rec_begin() */
+void microchip_dpll_rec_log(struct microchip_dpll_ddata *ddata, u64 start, bool write,
+			    u8 reg, const u8 *buf, u16 bytes, int err);
+
+/* Recorder of @ddata, with its files in a directory named after the device
+ * under @root
+ */
+int microchip_dpll_rec_init(struct microchip_dpll_ddata *ddata, struct dentry *root,
+			    enum microchip_dpll_rec_bus bus, u32 bus_hz);
+void microchip_dpll_rec_exit(struct microchip_dpll_ddata *ddata);
+
+#endif /* __MICROCHIP_DPLL_REC_H */
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0+
 
+#include <linux/debugfs.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/mfd/core.h>
@@ -11,6 +12,8 @@
 #include <linux/of_platform.h>
 #include <linux/mfd/microchip-dpll.h>
 
+#include "microchip-dpll-rec.h"
+
 #define MICROCHIP_DPLL_PAGE_ADDR		0x007F
 #define MICROCHIP_DPLL_HIGHER_ADDR_MASK		0xFF80
 #define MICROCHIP_DPLL_LOWER_ADDR_MASK		0x007F
@@ -27,8 +30,11 @@ static const struct of_device_id microchip_dpll_spi_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, microchip_dpll_spi_of_match);
 
-static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
-				      u8 reg, u8 *buf, u16 bytes)
+/* Parent of the per-device recorder directories */
+static struct dentry *microchip_dpll_spi_debugfs;
+
+static int __microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
+					u8 reg, u8 *buf, u16 bytes)
 {
 	struct spi_device *client = to_spi_device(dpll->dev);
 	struct spi_transfer xfer = {0};
@@ -54,8 +60,8 @@ static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
 	return ret;
 }
 
-static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
-				       u8 reg, u8 *buf, u16 bytes)
+static int __microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
+					 u8 reg, u8 *buf, u16 bytes)
 {
 	struct spi_device *client = to_spi_device(dpll->dev);
 	struct spi_transfer xfer = {0};
@@ -75,6 +81,32 @@ static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
 	return spi_sync(client, &msg);
 }
 
+static int microchip_dpll_read_device(struct microchip_dpll_ddata *dpll,
+				      u8 reg, u8 *buf, u16 bytes)
+{
+	u64 start = microchip_dpll_rec_begin(dpll);
+	int ret;
+
+	microchip_dpll_bus_xfer(dpll);
+	ret = __microchip_dpll_read_device(dpll, reg, buf, bytes);
+	microchip_dpll_rec_log(dpll, start, false, reg, buf, bytes, ret);
+
+	return ret;
+}
+
+static int microchip_dpll_write_device(struct microchip_dpll_ddata *dpll,
+				       u8 reg, u8 *buf, u16 bytes)
+{
+	u64 start = microchip_dpll_rec_begin(dpll);
+	int ret;
+
+	microchip_dpll_bus_xfer(dpll);
+	ret = __microchip_dpll_write_device(dpll, reg, buf, bytes);
+	microchip_dpll_rec_log(dpll, start, true, reg, buf, bytes, ret);
+
+	return ret;
+}
+
 static int microchip_dpll_write_page_register(struct microchip_dpll_ddata *dpll,
 					      u16 reg)
 {
@@ -93,9 +125,10 @@ static int microchip_dpll_write_page_register(struct microchip_dpll_ddata *dpll,
 	if (dpll->page == page)
 		return 0;
 
+	microchip_dpll_bus_page_select(dpll);
 	err = microchip_dpll_write_device(dpll, page_reg, &buf, bytes);
 	if (err)
-		dev_err(dpll->dev, "Failed to set page offset 0x%x\n", page);
+		dev_err_ratelimited(dpll->dev, "Failed to set page offset 0x%x\n", page);
 	else
 		/* Remember the last page */
 		dpll->page = page;
@@ -107,16 +140,18 @@ static int microchip_dpll_reg_read(void *context, unsigned int reg, unsigned int
 {
 	struct microchip_dpll_ddata *dpll = spi_get_drvdata((struct spi_device *)context);
 	u8 addr = (u8)(reg & MICROCHIP_DPLL_LOWER_ADDR_MASK);
+	unsigned int attempt = 0;
 	int err;
 
-	err = microchip_dpll_write_page_register(dpll, reg);
-	if (err)
-		return err;
+	do {
+		err = microchip_dpll_write_page_register(dpll, reg);
+		if (!err)
+			err = microchip_dpll_read_device(dpll, addr, (u8 *)val, 1);
+	} while (err && microchip_dpll_bus_xfer_failed(dpll, attempt++));
 
-	err = microchip_dpll_read_device(dpll, addr, (u8 *)val, 1);
 	if (err)
-		dev_err(dpll->dev,
-			"Failed to read offset address 0x%x\n", addr);
+		dev_err_ratelimited(dpll->dev,
+				    "Failed to read offset address 0x%x\n", addr);
 
 	return err;
 }
@@ -125,17 +160,23 @@ static int microchip_dpll_reg_write(void *context, unsigned int reg, unsigned in
 {
 	struct microchip_dpll_ddata *dpll = spi_get_drvdata((struct spi_device *)context);
 	u8 addr = (u8)(reg & MICROCHIP_DPLL_LOWER_ADDR_MASK);
+	unsigned int attempt = 0;
 	u8 data = (u8)val;
 	int err;
 
-	err = microchip_dpll_write_page_register(dpll, reg);
-	if (err)
-		return err;
+	do {
+		err = microchip_dpll_write_page_register(dpll, reg);
+	} while (err && microchip_dpll_bus_xfer_failed(dpll, attempt++));
+
+	if (!err) {
+		err = microchip_dpll_write_device(dpll, addr, &data, 1);
+		if (err)
+			microchip_dpll_bus_write_failed(dpll);
+	}
 
-	err = microchip_dpll_write_device(dpll, addr, &data, 1);
 	if (err)
-		dev_err(dpll->dev,
-			"Failed to write offset address 0x%x\n", addr);
+		dev_err_ratelimited(dpll->dev,
+				    "Failed to write offset address 0x%x\n", addr);
 
 	return err;
 }
@@ -168,13 +209,28 @@ static int microchip_dpll_spi_probe(struct spi_device *client)
 		dev_err(dpll->dev, "Failed to allocate register map: %d\n", ret);
 		return ret;
 	}
-	mutex_init(&dpll->lock);
+	microchip_dpll_bus_init(dpll);
 
-	return of_platform_default_populate(dpll->dev->of_node, NULL, dpll->dev);
+	dpll->bus_type = MICROCHIP_DPLL_BUS_SPI;
+	dpll->bus_hz = client->max_speed_hz;
+
+	ret = microchip_dpll_rec_init(dpll, microchip_dpll_spi_debugfs,
+				      MICROCHIP_DPLL_REC_BUS_SPI, dpll->bus_hz);
+	if (ret)
+		return ret;
+
+	ret = of_platform_default_populate(dpll->dev->of_node, NULL, dpll->dev);
+	if (ret)
+		microchip_dpll_rec_exit(dpll);
+
+	return ret;
 }
 
 static void microchip_dpll_spi_remove(struct spi_device *client)
 {
+	struct microchip_dpll_ddata *dpll = spi_get_drvdata(client);
+
+	microchip_dpll_rec_exit(dpll);
 }
 
 static struct spi_driver microchip_dpll_spi_driver = {
@@ -189,13 +245,22 @@ static struct spi_driver microchip_dpll_spi_driver = {
 
 static int __init microchip_dpll_spi_init(void)
 {
-	return spi_register_driver(&microchip_dpll_spi_driver);
+	int ret;
+
+	microchip_dpll_spi_debugfs = debugfs_create_dir("microchip-dpll-spi", NULL);
+
+	ret = spi_register_driver(&microchip_dpll_spi_driver);
+	if (ret)
+		debugfs_remove_recursive(microchip_dpll_spi_debugfs);
+
+	return ret;
 }
 subsys_initcall(microchip_dpll_spi_init);
 
 static void __exit microchip_dpll_spi_exit(void)
 {
 	spi_unregister_driver(&microchip_dpll_spi_driver);
+	debugfs_remove_recursive(microchip_dpll_spi_debugfs);
 }
 module_exit(microchip_dpll_spi_exit);
 
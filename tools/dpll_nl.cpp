@@ -0,0 +1,347 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include "dpll_nl.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace dpll {
+
+namespace {
+
+constexpr size_t RX_BUF_SIZE = 64 * 1024;
+
+void put_attr(std::vector<uint8_t> &buf, uint16_t type, const void *data,
+	      size_t len)
+{
+	struct nlattr nla;
+	size_t off = buf.size();
+
+	nla.nla_len = NLA_HDRLEN + len;
+	nla.nla_type = type;
+	buf.resize(off + NLA_ALIGN(nla.nla_len));
+	memcpy(&buf[off], &nla, sizeof(nla));
+	memcpy(&buf[off + NLA_HDRLEN], data, len);
+}
+
+} // namespace
+
+uint32_t attr::u32() const
+{
+	uint32_t v = 0;
+
+	memcpy(&v, data.data(), std::min(data.size(), sizeof(v)));
+	return v;
+}
+
+uint64_t attr::u64() const
+{
+	uint64_t v = 0;
+
+	if (data.size() == sizeof(uint32_t))
+		return u32();
+	memcpy(&v, data.data(), std::min(data.size(), sizeof(v)));
+	return v;
+}
+
+int64_t attr::s64() const
+{
+	if (data.size() == sizeof(int32_t))
+		return static_cast<int32_t>(u32());
+	return static_cast<int64_t>(u64());
+}
+
+std::string attr::str() const
+{
+	std::string s(data.begin(), data.end());
+
+	while (!s.empty() && s.back() == '\0')
+		s.pop_back();
+	return s;
+}
+
+std::vector<attr> attr::nested() const
+{
+	std::vector<attr> out;
+	size_t off = 0;
+
+	while (off + NLA_HDRLEN <= data.size()) {
+		struct nlattr nla;
+
+		memcpy(&nla, &data[off], sizeof(nla));
+		if (nla.nla_len < NLA_HDRLEN || off + nla.nla_len > data.size())
+			break;
+		out.push_back({ static_cast<uint16_t>(nla.nla_type & NLA_TYPE_MASK),
+				std::vector<uint8_t>(data.begin() + off + NLA_HDRLEN,
+						     data.begin() + off + nla.nla_len) });
+		off += NLA_ALIGN(nla.nla_len);
+	}
+
+	return out;
+}
+
+const attr *msg::find(uint16_t type) const
+{
+	for (const auto &a : attrs)
+		if (a.type == type)
+			return &a;
+	return nullptr;
+}
+
+std::vector<const attr *> msg::find_all(uint16_t type) const
+{
+	std::vector<const attr *> out;
+
+	for (const auto &a : attrs)
+		if (a.type == type)
+			out.push_back(&a);
+	return out;
+}
+
+req_attr req_attr::u32(uint16_t type, uint32_t val)
+{
+	req_attr a{ type, std::vector<uint8_t>(sizeof(val)) };
+
+	memcpy(a.data.data(), &val, sizeof(val));
+	return a;
+}
+
+req_attr req_attr::u64(uint16_t type, uint64_t val)
+{
+	req_attr a{ type, std::vector<uint8_t>(sizeof(val)) };
+
+	memcpy(a.data.data(), &val, sizeof(val));
+	return a;
+}
+
+req_attr req_attr::str(uint16_t type, const std::string &val)
+{
+	req_attr a{ type, std::vector<uint8_t>(val.begin(), val.end()) };
+
+	a.data.push_back('\0');
+	return a;
+}
+
+req_attr req_attr::nested(uint16_t type, const std::vector<req_attr> &attrs)
+{
+	req_attr a{ static_cast<uint16_t>(type | NLA_F_NESTED), {} };
+
+	for (const auto &n : attrs)
+		put_attr(a.data, n.type, n.data.data(), n.data.size());
+	return a;
+}
+
+socket::socket() : rxbuf_(RX_BUF_SIZE)
+{
+	struct sockaddr_nl addr = {};
+
+	fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+	if (fd_ < 0)
+		throw std::system_error(errno, std::generic_category(), "socket");
+
+	addr.nl_family = AF_NETLINK;
+	if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr))) {
+		int err = errno;
+
+		close(fd_);
+		throw std::system_error(err, std::generic_category(), "bind");
+	}
+}
+
+socket::~socket()
+{
+	if (fd_ >= 0)
+		close(fd_);
+}
+
+std::vector<attr> socket::parse_attrs(const uint8_t *p, size_t len)
+{
+	attr whole{ 0, std::vector<uint8_t>(p, p + len) };
+
+	return whole.nested();
+}
+
+void socket::send(uint16_t type, uint16_t flags, uint8_t cmd, uint8_t version,
+		  const std::vector<req_attr> &attrs)
+{
+	std::vector<uint8_t> buf(NLMSG_HDRLEN + GENL_HDRLEN);
+	struct sockaddr_nl dst = {};
+	struct nlmsghdr nlh = {};
+	struct genlmsghdr genl = {};
+
+	for (const auto &a : attrs)
+		put_attr(buf, a.type, a.data.data(), a.data.size());
+
+	nlh.nlmsg_len = buf.size();
+	nlh.nlmsg_type = type;
+	nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+	nlh.nlmsg_seq = seq_++;
+	genl.cmd = cmd;
+	genl.version = version;
+	memcpy(&buf[0], &nlh, sizeof(nlh));
+	memcpy(&buf[NLMSG_HDRLEN], &genl, sizeof(genl));
+
+	dst.nl_family = AF_NETLINK;
+	if (sendto(fd_, buf.data(), buf.size(), 0,
+		   reinterpret_cast<struct sockaddr *>(&dst), sizeof(dst)) < 0)
+		throw std::system_error(errno, std::generic_category(), "sendto");
+}
+
+void socket::resolve()
+{
+	std::vector<req_attr> attrs = { req_attr::str(CTRL_ATTR_FAMILY_NAME, FAMILY_NAME) };
+	std::vector<msg> replies = request(GENL_ID_CTRL, 1, CTRL_CMD_GETFAMILY,
+					   attrs, false);
+
+	for (const auto &m : replies) {
+		const attr *id = m.find(CTRL_ATTR_FAMILY_ID);
+		const attr *grps = m.find(CTRL_ATTR_MCAST_GROUPS);
+
+		if (id)
+			family_ = id->u32() & 0xffff;
+		if (!grps)
+			continue;
+
+		for (const auto &grp : grps->nested()) {
+			std::string name;
+			uint32_t gid = 0;
+
+			for (const auto &ga : grp.nested()) {
+				if (ga.type == CTRL_ATTR_MCAST_GRP_NAME)
+					name = ga.str();
+				else if (ga.type == CTRL_ATTR_MCAST_GRP_ID)
+					gid = ga.u32();
+			}
+			if (name == MCGRP_MONITOR)
+				monitor_grp_ = gid;
+		}
+	}
+
+	if (!family_)
+		throw std::runtime_error("dpll generic netlink family not found");
+}
+
+void socket::join_monitor()
+{
+	if (!monitor_grp_)
+		throw std::runtime_error("dpll monitor multicast group not found");
+
+	if (setsockopt(fd_, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &monitor_grp_,
+		       sizeof(monitor_grp_)))
+		throw std::system_error(errno, std::generic_category(),
+					"NETLINK_ADD_MEMBERSHIP");
+}
+
+std::vector<msg> socket::transact(uint8_t cmd, const std::vector<req_attr> &attrs,
+				  bool dump)
+{
+	return request(family_, FAMILY_VERSION, cmd, attrs, dump);
+}
+
+std::vector<msg> socket::request(uint16_t family, uint8_t version, uint8_t cmd,
+				 const std::vector<req_attr> &attrs, bool dump)
+{
+	uint32_t seq = seq_;
+	std::vector<msg> out;
+
+	send(family, dump ? NLM_F_DUMP : 0, cmd, version, attrs);
+
+	for (;;) {
+		ssize_t len = recv(fd_, rxbuf_.data(), rxbuf_.size(), 0);
+		struct nlmsghdr *nlh;
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category(), "recv");
+		}
+
+		for (nlh = reinterpret_cast<struct nlmsghdr *>(rxbuf_.data());
+		     NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			const uint8_t *payload;
+
+			if (nlh->nlmsg_seq != seq)
+				continue;
+
+			if (nlh->nlmsg_type == NLMSG_DONE)
+				return out;
+
+			if (nlh->nlmsg_type == NLMSG_ERROR) {
+				auto *err = static_cast<struct nlmsgerr *>(NLMSG_DATA(nlh));
+
+				if (err->error)
+					throw std::system_error(-err->error,
+								std::generic_category(),
+								"dpll request");
+				// Plain ACK terminates a non-dump request.
+				if (!dump)
+					return out;
+				continue;
+			}
+
+			payload = static_cast<const uint8_t *>(NLMSG_DATA(nlh));
+			msg m;
+
+			m.cmd = reinterpret_cast<const struct genlmsghdr *>(payload)->cmd;
+			m.attrs = parse_attrs(payload + GENL_HDRLEN,
+					      nlh->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN);
+			out.push_back(std::move(m));
+		}
+	}
+}
+
+bool socket::recv_ntf(msg &out, int timeout_ms)
+{
+	auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(timeout_ms);
+	struct pollfd pfd = { fd_, POLLIN, 0 };
+
+	for (;;) {
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - std::chrono::steady_clock::now()).count();
+		struct nlmsghdr *nlh;
+		const uint8_t *payload;
+		ssize_t len;
+		int ret;
+
+		ret = poll(&pfd, 1, left > 0 ? left : 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			throw std::system_error(errno, std::generic_category(), "poll");
+		if (ret == 0)
+			return false;
+
+		len = recv(fd_, rxbuf_.data(), rxbuf_.size(), 0);
+		if (len < 0)
+			throw std::system_error(errno, std::generic_category(), "recv");
+
+		nlh = reinterpret_cast<struct nlmsghdr *>(rxbuf_.data());
+		if (!NLMSG_OK(nlh, len) || nlh->nlmsg_type != family_)
+			continue;
+
+		payload = static_cast<const uint8_t *>(NLMSG_DATA(nlh));
+		out.cmd = reinterpret_cast<const struct genlmsghdr *>(payload)->cmd;
+		out.attrs = parse_attrs(payload + GENL_HDRLEN,
+					nlh->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN);
+		return true;
+	}
+}
+
+void socket::drain()
+{
+	while (recv(fd_, rxbuf_.data(), rxbuf_.size(), MSG_DONTWAIT) > 0)
+		;
+}
+
+} // namespace dpll
@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Minimal generic netlink client for the kernel DPLL family.
+//
+// The DPLL uapi header is not shipped by every distribution, so the command
+// and attribute numbers used by the tools are mirrored here from
+// include/uapi/linux/dpll.h (family version 1).
+
+#ifndef ZL3073X_TOOLS_DPLL_NL_H
+#define ZL3073X_TOOLS_DPLL_NL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dpll {
+
+constexpr const char *FAMILY_NAME = "dpll";
+constexpr const char *MCGRP_MONITOR = "monitor";
+constexpr uint8_t FAMILY_VERSION = 1;
+
+enum cmd : uint8_t {
+	CMD_DEVICE_ID_GET = 1,
+	CMD_DEVICE_GET,
+	CMD_DEVICE_SET,
+	CMD_DEVICE_CREATE_NTF,
+	CMD_DEVICE_DELETE_NTF,
+	CMD_DEVICE_CHANGE_NTF,
+	CMD_PIN_ID_GET,
+	CMD_PIN_GET,
+	CMD_PIN_SET,
+	CMD_PIN_CREATE_NTF,
+	CMD_PIN_DELETE_NTF,
+	CMD_PIN_CHANGE_NTF,
+};
+
+enum device_attr : uint16_t {
+	A_ID = 1,
+	A_MODULE_NAME,
+	A_PAD,
+	A_CLOCK_ID,
+	A_MODE,
+	A_MODE_SUPPORTED,
+	A_LOCK_STATUS,
+	A_TEMP,
+	A_TYPE,
+	A_LOCK_STATUS_ERROR,
+};
+
+enum pin_attr : uint16_t {
+	A_PIN_ID = 1,
+	A_PIN_PARENT_ID,
+	A_PIN_MODULE_NAME,
+	A_PIN_PAD,
+	A_PIN_CLOCK_ID,
+	A_PIN_BOARD_LABEL,
+	A_PIN_PANEL_LABEL,
+	A_PIN_PACKAGE_LABEL,
+	A_PIN_TYPE,
+	A_PIN_DIRECTION,
+	A_PIN_FREQUENCY,
+	A_PIN_FREQUENCY_SUPPORTED,
+	A_PIN_FREQUENCY_MIN,
+	A_PIN_FREQUENCY_MAX,
+	A_PIN_PRIO,
+	A_PIN_STATE,
+	A_PIN_CAPABILITIES,
+	A_PIN_PARENT_DEVICE,
+	A_PIN_PARENT_PIN,
+	A_PIN_PHASE_ADJUST_MIN,
+	A_PIN_PHASE_ADJUST_MAX,
+	A_PIN_PHASE_ADJUST,
+	A_PIN_PHASE_OFFSET,
+	A_PIN_FRACTIONAL_FREQUENCY_OFFSET,
+	A_PIN_ESYNC_FREQUENCY,
+	A_PIN_ESYNC_FREQUENCY_SUPPORTED,
+	A_PIN_ESYNC_PULSE,
+};
+
+enum pin_state : uint32_t {
+	PIN_STATE_CONNECTED = 1,
+	PIN_STATE_DISCONNECTED,
+	PIN_STATE_SELECTABLE,
+};
+
+struct attr {
+	uint16_t type;
+	std::vector<uint8_t> data;
+
+	uint32_t u32() const;
+	uint64_t u64() const;
+	int64_t s64() const;
+	std::string str() const;
+	std::vector<attr> nested() const;
+};
+
+struct msg {
+	uint8_t cmd = 0;
+	std::vector<attr> attrs;
+
+	const attr *find(uint16_t type) const;
+	std::vector<const attr *> find_all(uint16_t type) const;
+};
+
+// Request attribute: a u32, u64, string or nested payload.
+struct req_attr {
+	uint16_t type;
+	std::vector<uint8_t> data;
+
+	static req_attr u32(uint16_t type, uint32_t val);
+	static req_attr u64(uint16_t type, uint64_t val);
+	static req_attr str(uint16_t type, const std::string &val);
+	static req_attr nested(uint16_t type, const std::vector<req_attr> &attrs);
+};
+
+// One netlink socket bound to the DPLL family. Use one instance for
+// requests and a separate one for multicast notifications so that a
+// notification never interleaves with a reply being parsed.
+class socket {
+public:
+	socket();
+	~socket();
+
+	socket(const socket &) = delete;
+	socket &operator=(const socket &) = delete;
+
+	// Resolve the family id and the monitor multicast group via nlctrl.
+	void resolve();
+	void join_monitor();
+
+	// Send a request and collect every reply message. Throws on a
+	// netlink error reply.
+	std::vector<msg> transact(uint8_t cmd, const std::vector<req_attr> &attrs,
+				  bool dump);
+
+	// Wait up to timeout_ms for one multicast notification. Returns
+	// false on timeout.
+	bool recv_ntf(msg &out, int timeout_ms);
+
+	// Discard any queued notifications.
+	void drain();
+
+	int fd() const { return fd_; }
+
+private:
+	int fd_ = -1;
+	uint16_t family_ = 0;
+	uint32_t monitor_grp_ = 0;
+	uint32_t seq_ = 1;
+	std::vector<uint8_t> rxbuf_;
+
+	std::vector<msg> request(uint16_t family, uint8_t version, uint8_t cmd,
+				 const std::vector<req_attr> &attrs, bool dump);
+	void send(uint16_t type, uint16_t flags, uint8_t cmd, uint8_t version,
+		  const std::vector<req_attr> &attrs);
+	static std::vector<attr> parse_attrs(const uint8_t *p, size_t len);
+};
+
+} // namespace dpll
+
+#endif // ZL3073X_TOOLS_DPLL_NL_H
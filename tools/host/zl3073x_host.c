@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/* Register model behind the host regmap of zl3073x_host.h.
+ *
+ * The model is a flat register file of ZL3073X_HOST_NUM_REGS bytes, plus one
+ * bank per channel for each of the reference, DPLL, synth and output
+ * mailboxes. A read command written to the semaphore register of a mailbox
+ * copies the bank of the channel selected in the mask register into the
+ * mailbox registers, a write command copies them back into the banks of all
+ * selected channels. The semaphore bits then clear after a configurable number
+ * of polls. Like the transports, the model selects the page of every byte it
+ * moves and counts the page selects this takes.
+ *
+ * This translation unit also instantiates zl3073x_core.h, so the core is
+ * compile checked with the host warnings whenever the library is built.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zl3073x_host_dev.h"
+
+#define ZL3073X_HOST_PAGE_SIZE		0x80
+#define ZL3073X_HOST_MB_CHANNELS	16
+/* Mailbox registers run from after the semaphore (offset 4 of the page) to
+ * before the page register
+ */
+#define ZL3073X_HOST_MB_SIZE		(ZL3073X_HOST_PAGE_SIZE - 1 - 5)
+
+struct zl3073x_host_mb {
+	const struct zl3073x_mb	*mb;
+	u8			bank[ZL3073X_HOST_MB_CHANNELS][ZL3073X_HOST_MB_SIZE];
+	unsigned int		busy;
+};
+
+struct regmap {
+	pthread_mutex_t		lock;
+	u8			regs[ZL3073X_HOST_NUM_REGS];
+	struct zl3073x_host_mb	mbs[4];
+	unsigned int		busy_polls;
+	u64			transfers;
+	u16			page;
+	u64			page_selects;
+	zl3073x_host_trace_t	trace;
+	void			*trace_priv;
+	unsigned int		read_error_reg;
+	int			read_error;
+};
+
+static unsigned int zl3073x_host_mb_start(const struct zl3073x_mb *mb)
+{
+	return mb->sem_reg + 1;
+}
+
+static struct zl3073x_host_mb *zl3073x_host_mb_find(struct regmap *map, unsigned int reg)
+{
+	for (int i = 0; i < ARRAY_SIZE(map->mbs); i++)
+		if (map->mbs[i].mb->mask_reg == reg || map->mbs[i].mb->sem_reg == reg)
+			return &map->mbs[i];
+
+	return NULL;
+}
+
+static u16 zl3073x_host_mb_mask(struct regmap *map, const struct zl3073x_mb *mb)
+{
+	return zl3073x_get_be(&map->regs[mb->mask_reg], 2);
+}
+
+static void zl3073x_host_mb_exec(struct regmap *map, struct zl3073x_host_mb *hmb, u8 cmd)
+{
+	u8 *window = &map->regs[zl3073x_host_mb_start(hmb->mb)];
+	u16 mask = zl3073x_host_mb_mask(map, hmb->mb);
+	int ch;
+
+	/* The command bits are the same for all mailboxes. A read latches the
+	 * lowest selected channel.
+	 */
+	if (cmd & DPLL_REF_MB_SEM_RD) {
+		for (ch = 0; ch < ZL3073X_HOST_MB_CHANNELS; ch++)
+			if (mask & BIT(ch))
+				break;
+		if (ch < ZL3073X_HOST_MB_CHANNELS)
+			memcpy(window, hmb->bank[ch], ZL3073X_HOST_MB_SIZE);
+	}
+
+	if (cmd & DPLL_REF_MB_SEM_WR)
+		for (ch = 0; ch < ZL3073X_HOST_MB_CHANNELS; ch++)
+			if (mask & BIT(ch))
+				memcpy(hmb->bank[ch], window, ZL3073X_HOST_MB_SIZE);
+
+	hmb->busy = map->busy_polls;
+	if (!hmb->busy)
+		map->regs[hmb->mb->sem_reg] = 0;
+}
+
+struct regmap *zl3073x_host_regmap_new(u16 chip_id)
+{
+	struct regmap *map;
+
+	map = calloc(1, sizeof(*map));
+	if (!map)
+		return NULL;
+
+	pthread_mutex_init(&map->lock, NULL);
+	map->mbs[0].mb = &zl3073x_ref_mb;
+	map->mbs[1].mb = &zl3073x_dpll_mb;
+	map->mbs[2].mb = &zl3073x_synth_mb;
+	map->mbs[3].mb = &zl3073x_output_mb;
+
+	map->page = ZL3073X_PAGE_NONE;
+	map->regs[DPLL_CHIP_ID_REG] = chip_id >> 8;
+	map->regs[DPLL_CHIP_ID_REG + 1] = chip_id & 0xff;
+
+	return map;
+}
+
+void zl3073x_host_regmap_free(struct regmap *map)
+{
+	if (!map)
+		return;
+
+	pthread_mutex_destroy(&map->lock);
+	free(map);
+}
+
+void zl3073x_host_regmap_set_busy_polls(struct regmap *map, unsigned int polls)
+{
+	pthread_mutex_lock(&map->lock);
+	map->busy_polls = polls;
+	pthread_mutex_unlock(&map->lock);
+}
+
+void zl3073x_host_regmap_set_trace(struct regmap *map, zl3073x_host_trace_t fn, void *priv)
+{
+	pthread_mutex_lock(&map->lock);
+	map->trace = fn;
+	map->trace_priv = priv;
+	pthread_mutex_unlock(&map->lock);
+}
+
+void zl3073x_host_regmap_set_read_error(struct regmap *map, unsigned int reg, int err)
+{
+	pthread_mutex_lock(&map->lock);
+	map->read_error_reg = reg;
+	map->read_error = err;
+	pthread_mutex_unlock(&map->lock);
+}
+
+static int zl3073x_host_check(unsigned int reg, size_t count)
+{
+	if (!count || reg + count > ZL3073X_HOST_NUM_REGS)
+		return -EINVAL;
+
+	return 0;
+}
+
+void zl3073x_host_regmap_poke(struct regmap *map, unsigned int reg, const u8 *buf,
+			      size_t count)
+{
+	if (zl3073x_host_check(reg, count))
+		return;
+
+	pthread_mutex_lock(&map->lock);
+	memcpy(&map->regs[reg], buf, count);
+	pthread_mutex_unlock(&map->lock);
+}
+
+void zl3073x_host_regmap_peek(struct regmap *map, unsigned int reg, u8 *buf, size_t count)
+{
+	if (zl3073x_host_check(reg, count))
+		return;
+
+	pthread_mutex_lock(&map->lock);
+	memcpy(buf, &map->regs[reg], count);
+	pthread_mutex_unlock(&map->lock);
+}
+
+static u8 *zl3073x_host_bank(struct regmap *map, unsigned int mask_reg, unsigned int ch,
+			     unsigned int reg, size_t count)
+{
+	struct zl3073x_host_mb *hmb = zl3073x_host_mb_find(map, mask_reg);
+	unsigned int start;
+
+	if (!hmb || ch >= ZL3073X_HOST_MB_CHANNELS)
+		return NULL;
+
+	start = zl3073x_host_mb_start(hmb->mb);
+	if (reg < start || reg + count > start + ZL3073X_HOST_MB_SIZE)
+		return NULL;
+
+	return &hmb->bank[ch][reg - start];
+}
+
+void zl3073x_host_regmap_poke_bank(struct regmap *map, unsigned int mask_reg,
+				   unsigned int ch, unsigned int reg, const u8 *buf,
+				   size_t count)
+{
+	u8 *bank;
+
+	pthread_mutex_lock(&map->lock);
+	bank = zl3073x_host_bank(map, mask_reg, ch, reg, count);
+	if (bank)
+		memcpy(bank, buf, count);
+	pthread_mutex_unlock(&map->lock);
+}
+
+void zl3073x_host_regmap_peek_bank(struct regmap *map, unsigned int mask_reg,
+				   unsigned int ch, unsigned int reg, u8 *buf, size_t count)
+{
+	u8 *bank;
+
+	pthread_mutex_lock(&map->lock);
+	bank = zl3073x_host_bank(map, mask_reg, ch, reg, count);
+	if (bank)
+		memcpy(buf, bank, count);
+	pthread_mutex_unlock(&map->lock);
+}
+
+u64 zl3073x_host_regmap_transfers(struct regmap *map)
+{
+	u64 transfers;
+
+	pthread_mutex_lock(&map->lock);
+	transfers = map->transfers;
+	pthread_mutex_unlock(&map->lock);
+
+	return transfers;
+}
+
+u16 zl3073x_host_regmap_page(struct regmap *map)
+{
+	u16 page;
+
+	pthread_mutex_lock(&map->lock);
+	page = map->page;
+	pthread_mutex_unlock(&map->lock);
+
+	return page;
+}
+
+u64 zl3073x_host_regmap_page_selects(struct regmap *map)
+{
+	u64 page_selects;
+
+	pthread_mutex_lock(&map->lock);
+	page_selects = map->page_selects;
+	pthread_mutex_unlock(&map->lock);
+
+	return page_selects;
+}
+
+/* Account one transfer of the core, under the model lock */
+static void zl3073x_host_transfer(struct regmap *map, bool write, unsigned int reg,
+				  size_t count)
+{
+	map->transfers++;
+
+	for (size_t i = 0; i < count; i++) {
+		if (ZL3073X_PAGE_OF(reg + i) == map->page)
+			continue;
+		map->page = ZL3073X_PAGE_OF(reg + i);
+		map->page_selects++;
+	}
+
+	if (map->trace)
+		map->trace(map->trace_priv, write, reg, count);
+}
+
+int regmap_bulk_read(struct regmap *map, unsigned int reg, void *val, size_t count)
+{
+	struct zl3073x_host_mb *hmb;
+	int ret;
+
+	ret = zl3073x_host_check(reg, count);
+	if (ret)
+		return ret;
+
+	pthread_mutex_lock(&map->lock);
+	zl3073x_host_transfer(map, false, reg, count);
+	if (map->read_error && map->read_error_reg >= reg &&
+	    map->read_error_reg < reg + count) {
+		ret = map->read_error;
+		pthread_mutex_unlock(&map->lock);
+		return ret;
+	}
+	memcpy(val, &map->regs[reg], count);
+
+	/* A pending command completes after busy_polls semaphore reads */
+	hmb = zl3073x_host_mb_find(map, reg);
+	if (hmb && reg == hmb->mb->sem_reg && hmb->busy && !--hmb->busy)
+		map->regs[reg] = 0;
+	pthread_mutex_unlock(&map->lock);
+
+	return 0;
+}
+
+int regmap_bulk_write(struct regmap *map, unsigned int reg, const void *val, size_t count)
+{
+	struct zl3073x_host_mb *hmb;
+	int ret;
+
+	ret = zl3073x_host_check(reg, count);
+	if (ret)
+		return ret;
+
+	pthread_mutex_lock(&map->lock);
+	zl3073x_host_transfer(map, true, reg, count);
+	memcpy(&map->regs[reg], val, count);
+
+	hmb = zl3073x_host_mb_find(map, reg);
+	if (hmb && reg == hmb->mb->sem_reg)
+		zl3073x_host_mb_exec(map, hmb, map->regs[reg]);
+	pthread_mutex_unlock(&map->lock);
+
+	return 0;
+}
+
+int zl3073x_host_init(struct zl3073x *zl3073x, struct regmap *map)
+{
+	u8 buf[2];
+	int ret;
+
+	memset(zl3073x, 0, sizeof(*zl3073x));
+	zl3073x->regmap = map;
+	mutex_init(&zl3073x->bus_lock);
+
+	ret = zl3073x_read(zl3073x, DPLL_CHIP_ID_REG, buf, sizeof(buf));
+	if (ret) {
+		mutex_destroy(&zl3073x->bus_lock);
+		return ret;
+	}
+
+	zl3073x->chip_id = zl3073x_get_be(buf, sizeof(buf));
+	zl3073x->info = zl3073x_chip_info_lookup(zl3073x->chip_id);
+	if (!zl3073x->info)
+		zl3073x->info = &zl3073x_chip_info_default;
+
+	return 0;
+}
+
+void zl3073x_host_exit(struct zl3073x *zl3073x)
+{
+	mutex_destroy(&zl3073x->bus_lock);
+}
@@ -0,0 +1,220 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* Kernel shim for building zl3073x/zl3073x_core.h on a development host.
+ *
+ * Provides the kernel types and helpers the core uses, a pthread based mutex,
+ * read_poll_timeout_atomic() and a regmap backed by a register model of the
+ * chip (see zl3073x_host.c). The model keeps the register file, completes
+ * mailbox commands and keeps one bank of mailbox registers per channel, so
+ * the mailbox sequences of the core behave as they do on the chip.
+ *
+ * Host programs include zl3073x_host_dev.h, which pulls in the core on top of
+ * this file.
+ */
+
+#ifndef __ZL3073X_HOST_H
+#define __ZL3073X_HOST_H
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define BIT(nr)			(1UL << (nr))
+#define GENMASK(h, l)		(((~0UL) << (l)) & (~0UL >> (sizeof(long) * 8 - 1 - (h))))
+#define ARRAY_SIZE(arr)		((int)(sizeof(arr) / sizeof((arr)[0])))
+#define is_signed_type(type)	(((type)(-1)) < (type)1)
+
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_SEC		1000000000L
+#define PSEC_PER_SEC		1000000000000LL
+
+#define WARN_ON(cond)		(cond)
+#define BUILD_BUG_ON(cond)	_Static_assert(!(cond), #cond)
+
+static inline s64 sign_extend64(u64 value, int index)
+{
+	int shift = 63 - index;
+
+	return (s64)(value << shift) >> shift;
+}
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline s64 div64_s64(s64 dividend, s64 divisor)
+{
+	return dividend / divisor;
+}
+
+struct timespec64 {
+	s64	tv_sec;
+	long	tv_nsec;
+};
+
+static inline void set_normalized_timespec64(struct timespec64 *ts, s64 sec, s64 nsec)
+{
+	while (nsec >= NSEC_PER_SEC) {
+		nsec -= NSEC_PER_SEC;
+		++sec;
+	}
+	while (nsec < 0) {
+		nsec += NSEC_PER_SEC;
+		--sec;
+	}
+	ts->tv_sec = sec;
+	ts->tv_nsec = nsec;
+}
+
+/* Values of uapi/linux/dpll.h, which older host headers do not have */
+enum dpll_mode {
+	DPLL_MODE_MANUAL = 1,
+	DPLL_MODE_AUTOMATIC,
+};
+
+enum dpll_lock_status {
+	DPLL_LOCK_STATUS_UNLOCKED = 1,
+	DPLL_LOCK_STATUS_LOCKED,
+	DPLL_LOCK_STATUS_LOCKED_HO_ACQ,
+	DPLL_LOCK_STATUS_HOLDOVER,
+};
+
+enum dpll_pin_state {
+	DPLL_PIN_STATE_CONNECTED = 1,
+	DPLL_PIN_STATE_DISCONNECTED,
+	DPLL_PIN_STATE_SELECTABLE,
+};
+
+struct mutex {
+	pthread_mutex_t	m;
+};
+
+static inline void mutex_init(struct mutex *lock)
+{
+	pthread_mutex_init(&lock->m, NULL);
+}
+
+static inline void mutex_destroy(struct mutex *lock)
+{
+	pthread_mutex_destroy(&lock->m);
+}
+
+static inline void mutex_lock(struct mutex *lock)
+{
+	pthread_mutex_lock(&lock->m);
+}
+
+static inline void mutex_unlock(struct mutex *lock)
+{
+	pthread_mutex_unlock(&lock->m);
+}
+
+static inline u64 zl3073x_host_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline void udelay(unsigned long usecs)
+{
+	u64 end = zl3073x_host_now_ns() + usecs * NSEC_PER_USEC;
+
+	while (zl3073x_host_now_ns() < end)
+		;
+}
+
+/* Same contract as the kernel macro: 0 once @cond holds, -ETIMEDOUT if it
+ * still does not after @timeout_us, with @val holding the last read
+ */
+#define read_poll_timeout_atomic(op, val, cond, delay_us, timeout_us,		\
+				 delay_before_read, args...)			\
+({										\
+	u64 __timeout = zl3073x_host_now_ns() + (u64)(timeout_us) * NSEC_PER_USEC; \
+	if ((delay_before_read) && (delay_us))					\
+		udelay(delay_us);						\
+	for (;;) {								\
+		(val) = op(args);						\
+		if (cond)							\
+			break;							\
+		if ((timeout_us) && zl3073x_host_now_ns() > __timeout) {	\
+			(val) = op(args);					\
+			break;							\
+		}								\
+		if (delay_us)							\
+			udelay(delay_us);					\
+	}									\
+	(cond) ? 0 : -ETIMEDOUT;						\
+})
+
+#define readx_poll_timeout_atomic(op, addr, val, cond, delay_us, timeout_us)	\
+	read_poll_timeout_atomic(op, val, cond, delay_us, timeout_us, false, addr)
+
+/* Register model behind the host regmap, see zl3073x_host.c */
+#define ZL3073X_HOST_NUM_REGS	0x800
+
+struct regmap;
+
+/* A register model of a chip with the given ID, all other registers zero */
+struct regmap *zl3073x_host_regmap_new(u16 chip_id);
+void zl3073x_host_regmap_free(struct regmap *map);
+
+/* Number of semaphore reads that still see a mailbox command pending, 0 to
+ * complete commands as soon as they are written
+ */
+void zl3073x_host_regmap_set_busy_polls(struct regmap *map, unsigned int polls);
+
+/* Reads that include @reg fail with @err, as a bus error would; 0 to stop */
+void zl3073x_host_regmap_set_read_error(struct regmap *map, unsigned int reg, int err);
+
+/* Register file access of the test harness, bypassing the mailbox logic */
+void zl3073x_host_regmap_poke(struct regmap *map, unsigned int reg, const u8 *buf,
+			      size_t count);
+void zl3073x_host_regmap_peek(struct regmap *map, unsigned int reg, u8 *buf, size_t count);
+
+/* Mailbox bank of channel @ch, as the chip would latch it on a read command */
+void zl3073x_host_regmap_poke_bank(struct regmap *map, unsigned int mask_reg,
+				   unsigned int ch, unsigned int reg, const u8 *buf,
+				   size_t count);
+void zl3073x_host_regmap_peek_bank(struct regmap *map, unsigned int mask_reg,
+				   unsigned int ch, unsigned int reg, u8 *buf, size_t count);
+
+/* Bus transfers seen by the model, for profiling the core's access pattern */
+u64 zl3073x_host_regmap_transfers(struct regmap *map);
+
+/* Page of the last byte the model moved, and the page selects so far */
+u16 zl3073x_host_regmap_page(struct regmap *map);
+u64 zl3073x_host_regmap_page_selects(struct regmap *map);
+
+/* Called with the model locked for every transfer, so it must not call back
+ * into the model. NULL to stop tracing.
+ */
+typedef void (*zl3073x_host_trace_t)(void *priv, bool write, unsigned int reg, size_t count);
+void zl3073x_host_regmap_set_trace(struct regmap *map, zl3073x_host_trace_t fn, void *priv);
+
+int regmap_bulk_read(struct regmap *map, unsigned int reg, void *val, size_t count);
+int regmap_bulk_write(struct regmap *map, unsigned int reg, const void *val, size_t count);
+
+#endif /* __ZL3073X_HOST_H */
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* zl3073x/zl3073x_core.h on top of the host shim: the device the core
+ * operates on and the bus primitives it expects from its environment.
+ *
+ * Resource locks are not modelled; a host program that drives one device
+ * from several threads serializes the mailbox sequences itself.
+ */
+
+#ifndef __ZL3073X_HOST_DEV_H
+#define __ZL3073X_HOST_DEV_H
+
+#include "zl3073x_host.h"
+#include "zl3073x_core.h"
+
+struct zl3073x {
+	struct regmap		*regmap;
+	/* Stands in for the MFD bus lock */
+	struct mutex		bus_lock;
+	const struct zl3073x_chip_info *info;
+	u16			chip_id;
+};
+
+static inline int zl3073x_read(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
+{
+	int ret;
+
+	mutex_lock(&zl3073x->bus_lock);
+	ret = regmap_bulk_read(zl3073x->regmap, regaddr, buf, count);
+	mutex_unlock(&zl3073x->bus_lock);
+
+	return ret;
+}
+
+static inline int zl3073x_write(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
+{
+	int ret;
+
+	mutex_lock(&zl3073x->bus_lock);
+	ret = regmap_bulk_write(zl3073x->regmap, regaddr, zl3073x_swap(buf, count), count);
+	mutex_unlock(&zl3073x->bus_lock);
+
+	return ret;
+}
+
+static inline void zl3073x_res_assert_held(struct zl3073x *zl3073x, enum zl3073x_res res)
+{
+}
+
+/* The page the register model last selected */
+static inline u16 zl3073x_bus_page(struct zl3073x *zl3073x)
+{
+	return zl3073x_host_regmap_page(zl3073x->regmap);
+}
+
+/* Open a device on @map and detect the variant, see zl3073x_host.c */
+int zl3073x_host_init(struct zl3073x *zl3073x, struct regmap *map);
+void zl3073x_host_exit(struct zl3073x *zl3073x);
+
+#endif /* __ZL3073X_HOST_DEV_H */
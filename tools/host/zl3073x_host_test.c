@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/* Host tests of zl3073x/zl3073x_core.h against the register model of
+ * zl3073x_host.c: the grouping and page order of zl3073x_field_read_batch(),
+ * and the mailbox sequences. Run with make -C tools test; the exit status is
+ * the number of failed tests.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "zl3073x_host_dev.h"
+
+#define ZL3073X_TEST_CHIP_ID	0x0e95
+#define ZL3073X_TEST_MAX_XFERS	64
+
+struct zl3073x_test_xfer {
+	bool		write;
+	unsigned int	reg;
+	size_t		count;
+};
+
+struct zl3073x_test {
+	struct regmap		*map;
+	struct zl3073x		zl3073x;
+	struct zl3073x_test_xfer xfers[ZL3073X_TEST_MAX_XFERS];
+	int			num_xfers;
+	const char		*name;
+	int			failed;
+};
+
+#define TEST_CHECK(t, cond)							\
+do {										\
+	if (!(cond)) {								\
+		fprintf(stderr, "%s:%d: %s: %s\n", __FILE__, __LINE__,		\
+			(t)->name, #cond);					\
+		(t)->failed = 1;						\
+	}									\
+} while (0)
+
+static void zl3073x_test_trace(void *priv, bool write, unsigned int reg, size_t count)
+{
+	struct zl3073x_test *t = priv;
+
+	if (t->num_xfers < ZL3073X_TEST_MAX_XFERS)
+		t->xfers[t->num_xfers] = (struct zl3073x_test_xfer) {
+			.write = write,
+			.reg = reg,
+			.count = count,
+		};
+	t->num_xfers++;
+}
+
+static int zl3073x_test_begin(struct zl3073x_test *t, const char *name)
+{
+	memset(t, 0, sizeof(*t));
+	t->name = name;
+
+	t->map = zl3073x_host_regmap_new(ZL3073X_TEST_CHIP_ID);
+	if (!t->map || zl3073x_host_init(&t->zl3073x, t->map)) {
+		fprintf(stderr, "%s: cannot set up the register model\n", name);
+		zl3073x_host_regmap_free(t->map);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* Trace only the transfers of the code under test */
+static void zl3073x_test_trace_start(struct zl3073x_test *t)
+{
+	t->num_xfers = 0;
+	zl3073x_host_regmap_set_trace(t->map, zl3073x_test_trace, t);
+}
+
+static int zl3073x_test_end(struct zl3073x_test *t)
+{
+	zl3073x_host_exit(&t->zl3073x);
+	zl3073x_host_regmap_free(t->map);
+
+	printf("%s %s\n", t->failed ? "FAIL" : "ok  ", t->name);
+
+	return t->failed;
+}
+
+/* Whether the traced reads are exactly @regs and @counts, in this order */
+static bool zl3073x_test_reads(struct zl3073x_test *t, const unsigned int *regs,
+			       const size_t *counts, int num)
+{
+	if (t->num_xfers != num)
+		return false;
+
+	for (int i = 0; i < num; i++)
+		if (t->xfers[i].write || t->xfers[i].reg != regs[i] ||
+		    t->xfers[i].count != counts[i])
+			return false;
+
+	return true;
+}
+
+/* No traced transfer crosses a page or touches the page register */
+static bool zl3073x_test_in_page(struct zl3073x_test *t)
+{
+	for (int i = 0; i < t->num_xfers && i < ZL3073X_TEST_MAX_XFERS; i++) {
+		unsigned int first = t->xfers[i].reg;
+		unsigned int last = first + t->xfers[i].count - 1;
+
+		if (ZL3073X_PAGE_OF(first) != ZL3073X_PAGE_OF(last) || (last & 0x7f) == 0x7f)
+			return false;
+	}
+
+	return true;
+}
+
+/* Adjacent fields share a read, a hole starts a new one, and the requests may
+ * come in any order
+ */
+static int zl3073x_test_batch_grouping(void)
+{
+	static const unsigned int regs[] = {
+		DPLL_REF_MON_STATUS(0), DPLL_MON_STATUS(0), DPLL_REF_FREQ_ERR(0),
+	};
+	static const size_t counts[] = { 3, 1, 8 };
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_freq_err, 1),
+		ZL3073X_FIELD_REQ(ref_mon_status, 2),
+		ZL3073X_FIELD_REQ(dpll_mon_status, 0),
+		ZL3073X_FIELD_REQ(ref_mon_status, 0),
+		ZL3073X_FIELD_REQ(ref_freq_err, 0),
+		ZL3073X_FIELD_REQ(ref_mon_status, 1),
+	};
+	const u8 freq_err[] = { 0x00, 0x00, 0x01, 0x00, 0xff, 0xff, 0xff, 0xfe };
+	const u8 ref_status[] = { 0x11, 0x22, 0x33 };
+	const u8 dpll_status = 0x44;
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "batch_grouping"))
+		return 1;
+
+	zl3073x_host_regmap_poke(t.map, DPLL_REF_MON_STATUS(0), ref_status, sizeof(ref_status));
+	zl3073x_host_regmap_poke(t.map, DPLL_MON_STATUS(0), &dpll_status, 1);
+	zl3073x_host_regmap_poke(t.map, DPLL_REF_FREQ_ERR(0), freq_err, sizeof(freq_err));
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, req, ARRAY_SIZE(req)));
+	TEST_CHECK(&t, zl3073x_test_reads(&t, regs, counts, ARRAY_SIZE(regs)));
+
+	TEST_CHECK(&t, (s64)req[0].val == -2);
+	TEST_CHECK(&t, req[1].val == 0x33);
+	TEST_CHECK(&t, req[2].val == 0x44);
+	TEST_CHECK(&t, req[3].val == 0x11);
+	TEST_CHECK(&t, req[4].val == 0x100);
+	TEST_CHECK(&t, req[5].val == 0x22);
+
+	return zl3073x_test_end(&t);
+}
+
+/* A run of adjacent fields is split at ZL3073X_FIELD_BURST_MAX bytes, between
+ * two fields
+ */
+static int zl3073x_test_batch_burst_max(void)
+{
+	static const unsigned int regs[] = { DPLL_REF_PHASE_ERR(0), DPLL_REF_PHASE_ERR(5) };
+	static const size_t counts[] = { 30, 30 };
+	struct zl3073x_field_req req[10];
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "batch_burst_max"))
+		return 1;
+
+	for (int i = 0; i < ARRAY_SIZE(req); i++)
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(ref_phase_err, i);
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, req, ARRAY_SIZE(req)));
+	TEST_CHECK(&t, zl3073x_test_reads(&t, regs, counts, ARRAY_SIZE(regs)));
+
+	return zl3073x_test_end(&t);
+}
+
+/* The bursts on the page the bus is on go first, then the other pages in
+ * address order, so each page is selected at most once
+ */
+static int zl3073x_test_batch_page_rotation(void)
+{
+	static const unsigned int regs[] = {
+		DPLL_MODE_REFSEL(0), DPLL_DF_OFFSET(0), DPLL_REF_MON_STATUS(0),
+	};
+	static const size_t counts[] = { 1, 6, 1 };
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_mon_status, 0),
+		ZL3073X_FIELD_REQ(dpll_df_offset, 0),
+		ZL3073X_FIELD_REQ(dpll_mode_refsel, 0),
+	};
+	struct zl3073x_test t;
+	u64 page_selects;
+	u8 val;
+
+	if (zl3073x_test_begin(&t, "batch_page_rotation"))
+		return 1;
+
+	/* Leave the bus on the page of dpll_mode_refsel */
+	TEST_CHECK(&t, !zl3073x_read(&t.zl3073x, DPLL_MODE_REFSEL(1), &val, 1));
+	TEST_CHECK(&t, zl3073x_bus_page(&t.zl3073x) == ZL3073X_PAGE_OF(DPLL_MODE_REFSEL(0)));
+
+	page_selects = zl3073x_host_regmap_page_selects(t.map);
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, req, ARRAY_SIZE(req)));
+	TEST_CHECK(&t, zl3073x_test_reads(&t, regs, counts, ARRAY_SIZE(regs)));
+	TEST_CHECK(&t, zl3073x_host_regmap_page_selects(t.map) - page_selects == 2);
+
+	return zl3073x_test_end(&t);
+}
+
+/* Fields next to the page register of page 0x100 and at the start of page
+ * 0x180: the bursts stop short of the page register and never span pages
+ */
+static const struct zl3073x_field zl3073x_test_field_a = { .reg = 0x17a, .size = 2 };
+static const struct zl3073x_field zl3073x_test_field_b = { .reg = 0x17c, .size = 2 };
+static const struct zl3073x_field zl3073x_test_field_c = { .reg = 0x17e, .size = 1 };
+static const struct zl3073x_field zl3073x_test_field_d = { .reg = 0x180, .size = 2 };
+static const struct zl3073x_field zl3073x_test_field_e = { .reg = 0x182, .size = 1 };
+/* Adjacent fields, the second ending on the page register of page 0x180 */
+static const struct zl3073x_field zl3073x_test_field_f = { .reg = 0x1fc, .size = 2 };
+static const struct zl3073x_field zl3073x_test_field_g = { .reg = 0x1fe, .size = 2 };
+
+static int zl3073x_test_batch_page_register(void)
+{
+	static const unsigned int regs[] = { 0x17a, 0x180 };
+	static const size_t counts[] = { 5, 3 };
+	struct zl3073x_field_req req[] = {
+		{ .field = &zl3073x_test_field_e },
+		{ .field = &zl3073x_test_field_c },
+		{ .field = &zl3073x_test_field_a },
+		{ .field = &zl3073x_test_field_d },
+		{ .field = &zl3073x_test_field_b },
+	};
+	struct zl3073x_field_req end[] = {
+		{ .field = &zl3073x_test_field_c },
+		{ .field = &zl3073x_test_field_b },
+	};
+	struct zl3073x_field_req joint[] = {
+		{ .field = &zl3073x_test_field_g },
+		{ .field = &zl3073x_test_field_f },
+	};
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "batch_page_register"))
+		return 1;
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, req, ARRAY_SIZE(req)));
+	TEST_CHECK(&t, zl3073x_test_reads(&t, regs, counts, ARRAY_SIZE(regs)));
+	TEST_CHECK(&t, zl3073x_test_in_page(&t));
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, end, ARRAY_SIZE(end)));
+	TEST_CHECK(&t, t.num_xfers == 1 && t.xfers[0].reg == 0x17c && t.xfers[0].count == 3);
+
+	/* A field that ends on the page register does not join the burst */
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_field_read_batch(&t.zl3073x, joint, ARRAY_SIZE(joint)));
+	TEST_CHECK(&t, t.num_xfers == 2 && t.xfers[0].reg == 0x1fc && t.xfers[0].count == 2);
+
+	return zl3073x_test_end(&t);
+}
+
+/* Status fields change behind the driver and must not be cached */
+static int zl3073x_test_batch_cacheable(void)
+{
+	struct zl3073x_field_req cfg[] = {
+		ZL3073X_FIELD_REQ(output_ctrl, 0),
+		ZL3073X_FIELD_REQ(synth_ctrl, 1),
+	};
+	struct zl3073x_field_req status[] = {
+		ZL3073X_FIELD_REQ(synth_ctrl, 0),
+		ZL3073X_FIELD_REQ(ref_mon_status, 0),
+	};
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "batch_cacheable"))
+		return 1;
+
+	TEST_CHECK(&t, zl3073x_field_reqs_cacheable(cfg, ARRAY_SIZE(cfg)));
+	TEST_CHECK(&t, !zl3073x_field_reqs_cacheable(status, ARRAY_SIZE(status)));
+
+	return zl3073x_test_end(&t);
+}
+
+static int zl3073x_test_batch_too_many(void)
+{
+	struct zl3073x_field_req req[ZL3073X_FIELD_BATCH_MAX + 1];
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "batch_too_many"))
+		return 1;
+
+	for (int i = 0; i < ARRAY_SIZE(req); i++)
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(ref_mon_status, 0);
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, zl3073x_field_read_batch(&t.zl3073x, req, ARRAY_SIZE(req)) == -EINVAL);
+	TEST_CHECK(&t, t.num_xfers == 0);
+
+	return zl3073x_test_end(&t);
+}
+
+/* A read command latches the bank of the lowest selected channel, after the
+ * semaphore has been polled until the model clears it
+ */
+static int zl3073x_test_mb_read(void)
+{
+	const u8 base[] = { 0x61, 0xa8 };
+	const u8 other[] = { 0x12, 0x34 };
+	struct zl3073x_test t;
+	u16 val = 0;
+	u8 sem;
+
+	if (zl3073x_test_begin(&t, "mb_read"))
+		return 1;
+
+	zl3073x_host_regmap_poke_bank(t.map, DPLL_REF_MB_MASK, 3, DPLL_REF_FREQ_BASE_REG,
+				      base, sizeof(base));
+	zl3073x_host_regmap_poke_bank(t.map, DPLL_REF_MB_MASK, 5, DPLL_REF_FREQ_BASE_REG,
+				      other, sizeof(other));
+	zl3073x_host_regmap_set_busy_polls(t.map, 3);
+
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, !zl3073x_mb_read(&t.zl3073x, &zl3073x_ref_mb, BIT(3) | BIT(5),
+					DPLL_REF_MB_SEM_RD));
+	/* Mask, command, three polls that see it pending and one that does not */
+	TEST_CHECK(&t, t.num_xfers == 6);
+	zl3073x_host_regmap_peek(t.map, DPLL_REF_MB_SEM, &sem, 1);
+	TEST_CHECK(&t, !sem);
+
+	TEST_CHECK(&t, !zl3073x_field_read_ref_freq_base(&t.zl3073x, 0, &val));
+	TEST_CHECK(&t, val == 25000);
+
+	return zl3073x_test_end(&t);
+}
+
+/* A write command stores the mailbox registers into the banks of all selected
+ * channels and leaves the others alone
+ */
+static int zl3073x_test_mb_write(void)
+{
+	const u8 zero[2] = { 0 };
+	struct zl3073x_test t;
+	u8 bank[2];
+
+	if (zl3073x_test_begin(&t, "mb_write"))
+		return 1;
+
+	TEST_CHECK(&t, !zl3073x_mb_read(&t.zl3073x, &zl3073x_output_mb, BIT(1),
+					DPLL_OUTPUT_MB_SEM_RD));
+	TEST_CHECK(&t, !zl3073x_field_write_output_div(&t.zl3073x, 0, 0x01020304));
+	TEST_CHECK(&t, !zl3073x_mb_select(&t.zl3073x, &zl3073x_output_mb, BIT(1) | BIT(2)));
+	TEST_CHECK(&t, !zl3073x_mb_cmd(&t.zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR));
+
+	for (unsigned int ch = 0; ch < 4; ch++) {
+		u8 div[4];
+
+		zl3073x_host_regmap_peek_bank(t.map, DPLL_OUTPUT_MB_MASK, ch, DPLL_OUTPUT_DIV,
+					      div, sizeof(div));
+		if (ch == 1 || ch == 2)
+			TEST_CHECK(&t, zl3073x_get_be(div, sizeof(div)) == 0x01020304);
+		else
+			TEST_CHECK(&t, !zl3073x_get_be(div, sizeof(div)));
+	}
+
+	/* The other mailboxes are untouched */
+	zl3073x_host_regmap_peek_bank(t.map, DPLL_REF_MB_MASK, 1, DPLL_REF_FREQ_BASE_REG,
+				      bank, sizeof(bank));
+	TEST_CHECK(&t, !memcmp(bank, zero, sizeof(bank)));
+
+	return zl3073x_test_end(&t);
+}
+
+/* A command the chip never completes times out */
+static int zl3073x_test_mb_timeout(void)
+{
+	struct zl3073x_test t;
+
+	if (zl3073x_test_begin(&t, "mb_timeout"))
+		return 1;
+
+	zl3073x_host_regmap_set_busy_polls(t.map, UINT_MAX);
+	TEST_CHECK(&t, zl3073x_mb_read(&t.zl3073x, &zl3073x_dpll_mb, BIT(0),
+				       DPLL_DPLL_MB_SEM_RD) == -ETIMEDOUT);
+
+	return zl3073x_test_end(&t);
+}
+
+static int zl3073x_test_tod_sem(struct zl3073x *zl3073x)
+{
+	u8 ctrl;
+	int ret;
+
+	ret = zl3073x_read(zl3073x, DPLL_TOD_CTRL(0), &ctrl, sizeof(ctrl));
+	if (ret)
+		return ret;
+
+	return ctrl;
+}
+
+/* A failed semaphore read ends zl3073x_poll() at once with its error, even
+ * though the error value has the semaphore bit set
+ */
+static int zl3073x_test_poll_read_error(void)
+{
+	const u8 busy = DPLL_TOD_CTRL_SEM;
+	struct zl3073x_test t;
+	u64 start;
+	int ret;
+	int val;
+
+	if (zl3073x_test_begin(&t, "poll_read_error"))
+		return 1;
+
+	zl3073x_host_regmap_poke(t.map, DPLL_TOD_CTRL(0), &busy, 1);
+	zl3073x_host_regmap_set_read_error(t.map, DPLL_TOD_CTRL(0), -EIO);
+	TEST_CHECK(&t, (-EIO & DPLL_TOD_CTRL_SEM));
+
+	zl3073x_test_trace_start(&t);
+	start = zl3073x_host_now_ns();
+	ret = zl3073x_poll(zl3073x_test_tod_sem, &t.zl3073x, val, !(DPLL_TOD_CTRL_SEM & val));
+	TEST_CHECK(&t, ret == -EIO);
+	TEST_CHECK(&t, t.num_xfers == 1);
+	TEST_CHECK(&t, zl3073x_host_now_ns() - start < READ_TIMEOUT_US * NSEC_PER_USEC / 10);
+
+	/* The same for the mailbox semaphore */
+	zl3073x_host_regmap_set_read_error(t.map, DPLL_REF_MB_SEM, -EIO);
+	zl3073x_test_trace_start(&t);
+	TEST_CHECK(&t, zl3073x_mb_read(&t.zl3073x, &zl3073x_ref_mb, BIT(0),
+				       DPLL_REF_MB_SEM_RD) == -EIO);
+	/* Mask, command and the failed poll */
+	TEST_CHECK(&t, t.num_xfers == 3);
+
+	return zl3073x_test_end(&t);
+}
+
+int main(void)
+{
+	int failed = 0;
+
+	failed += zl3073x_test_batch_grouping();
+	failed += zl3073x_test_batch_burst_max();
+	failed += zl3073x_test_batch_page_rotation();
+	failed += zl3073x_test_batch_page_register();
+	failed += zl3073x_test_batch_cacheable();
+	failed += zl3073x_test_batch_too_many();
+	failed += zl3073x_test_mb_read();
+	failed += zl3073x_test_mb_write();
+	failed += zl3073x_test_mb_timeout();
+	failed += zl3073x_test_poll_read_error();
+
+	return failed;
+}
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Latency sample collection and percentile summary shared by the tools.
+
+#ifndef ZL3073X_TOOLS_STATS_H
+#define ZL3073X_TOOLS_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace zl3073x {
+
+using clock = std::chrono::steady_clock;
+
+inline int64_t elapsed_ns(clock::time_point from, clock::time_point to)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+class samples {
+public:
+	explicit samples(std::string name) : name_(std::move(name)) {}
+
+	void add(int64_t ns) { v_.push_back(ns); sorted_ = false; }
+	void add_failure() { failures_++; }
+	size_t count() const { return v_.size(); }
+	const std::string &name() const { return name_; }
+
+	// Percentile by nearest rank, p in [0, 100].
+	int64_t percentile(double p)
+	{
+		size_t idx;
+
+		if (v_.empty())
+			return 0;
+		sort();
+		idx = static_cast<size_t>(p / 100.0 * (v_.size() - 1) + 0.5);
+		return v_[std::min(idx, v_.size() - 1)];
+	}
+
+	double mean() const
+	{
+		double sum = 0;
+
+		for (int64_t x : v_)
+			sum += x;
+		return v_.empty() ? 0 : sum / v_.size();
+	}
+
+	static void print_header(FILE *f)
+	{
+		fprintf(f, "%-28s %8s %6s %10s %10s %10s %10s %10s\n",
+			"operation", "samples", "fail", "min_us", "median_us",
+			"p99_us", "max_us", "mean_us");
+	}
+
+	void print(FILE *f)
+	{
+		fprintf(f, "%-28s %8zu %6zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			name_.c_str(), v_.size(), failures_,
+			percentile(0) / 1e3, percentile(50) / 1e3,
+			percentile(99) / 1e3, percentile(100) / 1e3, mean() / 1e3);
+	}
+
+private:
+	std::string name_;
+	std::vector<int64_t> v_;
+	size_t failures_ = 0;
+	bool sorted_ = false;
+
+	void sort()
+	{
+		if (!sorted_)
+			std::sort(v_.begin(), v_.end());
+		sorted_ = true;
+	}
+};
+
+} // namespace zl3073x
+
+#endif // ZL3073X_TOOLS_STATS_H
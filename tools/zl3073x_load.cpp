@@ -0,0 +1,493 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// PHC and DPLL contention load generator for the zl3073x driver.
+//
+// Runs, each in its own thread and at its own rate, for a fixed duration:
+//  - a PHC reader (clock_gettime on the PTP clock)
+//  - a servo emulator: adjfine at every tick along a slow sine, plus an
+//    adjphase of alternating sign every few ticks
+//  - DPLL netlink pin dumps
+//  - a priority setter and a frequency setter, toggling one input pin
+//    between its original value and another one
+// and records the latency distribution of every operation class, together
+// with the number of periods each thread missed.
+//
+// With --baseline the PHC reader and the servo first run alone for the same
+// duration, so that the report shows how much the monitoring and management
+// traffic degrades the servo operations. The pin settings and the PHC
+// frequency are restored on exit.
+
+#include "dpll_nl.h"
+#include "stats.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/timex.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace zl3073x;
+
+#define FD_TO_CLOCKID(fd)	((~(clockid_t)(fd) << 3) | 3)
+
+namespace {
+
+struct options {
+	std::string module = "ptp_zl3073x";
+	std::string phc = "/dev/ptp0";
+	unsigned int duration_s = 10;
+	bool baseline = false;
+	unsigned int phc_hz = 100;
+	unsigned int servo_hz = 16;
+	unsigned int phase_every = 8;
+	unsigned int phase_ns = 100;
+	unsigned int servo_ppb = 1000;
+	unsigned int dump_hz = 10;
+	std::string prio_label;
+	unsigned int prio_hz = 1;
+	std::string freq_label;
+	uint64_t freq_alt = 0;
+	unsigned int freq_hz = 1;
+};
+
+// Operation class of one thread: its latencies and the periods it missed
+// because the previous operation overran
+struct load_class {
+	samples lat;
+	uint64_t ops = 0;
+	uint64_t missed = 0;
+
+	explicit load_class(const char *name) : lat(name) {}
+};
+
+struct input_pin {
+	uint32_t id = 0;
+	uint32_t parent = 0;
+	uint32_t prio = 0;
+	uint64_t frequency = 0;
+	bool found = false;
+};
+
+void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -m, --module NAME       driver module name (default ptp_zl3073x)\n"
+		"  -c, --phc DEV           PTP clock device (default /dev/ptp0)\n"
+		"  -d, --duration S        run time per phase (default 10)\n"
+		"  -B, --baseline          run PHC reader and servo alone first\n"
+		"  -r, --phc-hz HZ         PHC read rate, 0 disables (default 100)\n"
+		"  -s, --servo-hz HZ       adjfine rate, 0 disables (default 16)\n"
+		"  -a, --phase-every N     adjphase every N servo ticks, 0 disables (default 8)\n"
+		"  -A, --phase-ns NS       adjphase step (default 100)\n"
+		"  -F, --servo-ppb PPB     adjfine sine amplitude (default 1000)\n"
+		"  -D, --dump-hz HZ        pin dump rate, 0 disables (default 10)\n"
+		"  -p, --prio-pin LABEL    input pin whose priority to toggle\n"
+		"  -P, --prio-hz HZ        priority set rate (default 1)\n"
+		"  -f, --freq-pin LABEL    input pin whose frequency to toggle\n"
+		"  -q, --freq HZ           frequency to alternate with the current one\n"
+		"  -Q, --freq-hz HZ        frequency set rate (default 1)\n",
+		prog);
+}
+
+options parse_args(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{ "module", required_argument, nullptr, 'm' },
+		{ "phc", required_argument, nullptr, 'c' },
+		{ "duration", required_argument, nullptr, 'd' },
+		{ "baseline", no_argument, nullptr, 'B' },
+		{ "phc-hz", required_argument, nullptr, 'r' },
+		{ "servo-hz", required_argument, nullptr, 's' },
+		{ "phase-every", required_argument, nullptr, 'a' },
+		{ "phase-ns", required_argument, nullptr, 'A' },
+		{ "servo-ppb", required_argument, nullptr, 'F' },
+		{ "dump-hz", required_argument, nullptr, 'D' },
+		{ "prio-pin", required_argument, nullptr, 'p' },
+		{ "prio-hz", required_argument, nullptr, 'P' },
+		{ "freq-pin", required_argument, nullptr, 'f' },
+		{ "freq", required_argument, nullptr, 'q' },
+		{ "freq-hz", required_argument, nullptr, 'Q' },
+		{ "help", no_argument, nullptr, 'h' },
+		{}
+	};
+	options opt;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "m:c:d:Br:s:a:A:F:D:p:P:f:q:Q:h",
+				long_opts, nullptr)) != -1) {
+		switch (c) {
+		case 'm': opt.module = optarg; break;
+		case 'c': opt.phc = optarg; break;
+		case 'd': opt.duration_s = strtoul(optarg, nullptr, 0); break;
+		case 'B': opt.baseline = true; break;
+		case 'r': opt.phc_hz = strtoul(optarg, nullptr, 0); break;
+		case 's': opt.servo_hz = strtoul(optarg, nullptr, 0); break;
+		case 'a': opt.phase_every = strtoul(optarg, nullptr, 0); break;
+		case 'A': opt.phase_ns = strtoul(optarg, nullptr, 0); break;
+		case 'F': opt.servo_ppb = strtoul(optarg, nullptr, 0); break;
+		case 'D': opt.dump_hz = strtoul(optarg, nullptr, 0); break;
+		case 'p': opt.prio_label = optarg; break;
+		case 'P': opt.prio_hz = strtoul(optarg, nullptr, 0); break;
+		case 'f': opt.freq_label = optarg; break;
+		case 'q': opt.freq_alt = strtoull(optarg, nullptr, 0); break;
+		case 'Q': opt.freq_hz = strtoul(optarg, nullptr, 0); break;
+		default:
+			usage(argv[0]);
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
+	if (!opt.freq_label.empty() && !opt.freq_alt) {
+		fprintf(stderr, "--freq-pin needs --freq\n");
+		exit(1);
+	}
+
+	return opt;
+}
+
+// Calls fn at hz until stop is set. A call that overruns its period makes
+// the loop skip the periods it covered instead of bursting to catch up.
+void periodic(unsigned int hz, const std::atomic<bool> &stop, load_class &cls,
+	      const std::function<void()> &fn)
+{
+	auto period = std::chrono::nanoseconds(1000000000ull / hz);
+	auto next = clock::now();
+
+	while (!stop.load(std::memory_order_relaxed)) {
+		clock::time_point now;
+
+		fn();
+
+		next += period;
+		now = clock::now();
+		if (now > next) {
+			cls.missed += (now - next) / period + 1;
+			next = now;
+			continue;
+		}
+		std::this_thread::sleep_until(next);
+	}
+}
+
+template <typename F>
+void timed(load_class &cls, F fn)
+{
+	auto start = clock::now();
+
+	cls.ops++;
+	if (fn())
+		cls.lat.add(elapsed_ns(start, clock::now()));
+	else
+		cls.lat.add_failure();
+}
+
+template <typename F>
+void timed_nl(load_class &cls, F fn)
+{
+	timed(cls, [&] {
+		try {
+			fn();
+			return true;
+		} catch (const std::exception &) {
+			return false;
+		}
+	});
+}
+
+input_pin find_input_pin(dpll::socket &nl, const options &opt,
+			 const std::string &label)
+{
+	input_pin p;
+
+	for (const auto &m : nl.transact(dpll::CMD_PIN_GET, {}, true)) {
+		const dpll::attr *id = m.find(dpll::A_PIN_ID);
+		const dpll::attr *mod = m.find(dpll::A_PIN_MODULE_NAME);
+		const dpll::attr *lbl = m.find(dpll::A_PIN_BOARD_LABEL);
+		const dpll::attr *freq = m.find(dpll::A_PIN_FREQUENCY);
+
+		if (!id || !mod || mod->str() != opt.module || !lbl ||
+		    lbl->str() != label)
+			continue;
+
+		p.id = id->u32();
+		if (freq)
+			p.frequency = freq->u64();
+
+		// The priority of the pin on its first parent device
+		for (const dpll::attr *parent : m.find_all(dpll::A_PIN_PARENT_DEVICE)) {
+			bool have_prio = false;
+
+			for (const auto &a : parent->nested()) {
+				if (a.type == dpll::A_PIN_PARENT_ID)
+					p.parent = a.u32();
+				else if (a.type == dpll::A_PIN_PRIO) {
+					p.prio = a.u32();
+					have_prio = true;
+				}
+			}
+			if (have_prio) {
+				p.found = true;
+				break;
+			}
+		}
+	}
+
+	return p;
+}
+
+void set_prio(dpll::socket &nl, const input_pin &p, uint32_t prio)
+{
+	nl.transact(dpll::CMD_PIN_SET, {
+		dpll::req_attr::u32(dpll::A_PIN_ID, p.id),
+		dpll::req_attr::nested(dpll::A_PIN_PARENT_DEVICE, {
+			dpll::req_attr::u32(dpll::A_PIN_PARENT_ID, p.parent),
+			dpll::req_attr::u32(dpll::A_PIN_PRIO, prio),
+		}),
+	}, false);
+}
+
+void set_freq(dpll::socket &nl, const input_pin &p, uint64_t freq)
+{
+	nl.transact(dpll::CMD_PIN_SET, {
+		dpll::req_attr::u32(dpll::A_PIN_ID, p.id),
+		dpll::req_attr::u64(dpll::A_PIN_FREQUENCY, freq),
+	}, false);
+}
+
+bool phc_adjfine(clockid_t clk, double ppb)
+{
+	struct timex tx = {};
+
+	// scaled ppm: ppm with a 16 bit fractional part
+	tx.modes = ADJ_FREQUENCY;
+	tx.freq = static_cast<long>(ppb * 65.536);
+	return clock_adjtime(clk, &tx) >= 0;
+}
+
+bool phc_adjphase(clockid_t clk, long ns)
+{
+	struct timex tx = {};
+
+	tx.modes = ADJ_OFFSET | ADJ_NANO;
+	tx.offset = ns;
+	return clock_adjtime(clk, &tx) >= 0;
+}
+
+struct phase_result {
+	load_class phc_read{ "phc-read" };
+	load_class adjfine{ "adjfine" };
+	load_class adjphase{ "adjphase" };
+	load_class pin_dump{ "pin-dump" };
+	load_class prio_set{ "pin-set prio" };
+	load_class freq_set{ "pin-set frequency" };
+};
+
+void run_phase(const options &opt, clockid_t clk, const input_pin &prio_pin,
+	       const input_pin &freq_pin, bool full, phase_result &r)
+{
+	std::vector<std::thread> threads;
+	std::atomic<bool> stop{ false };
+
+	if (opt.phc_hz)
+		threads.emplace_back([&] {
+			periodic(opt.phc_hz, stop, r.phc_read, [&] {
+				timed(r.phc_read, [&] {
+					struct timespec ts;
+
+					return clock_gettime(clk, &ts) == 0;
+				});
+			});
+		});
+
+	if (opt.servo_hz)
+		threads.emplace_back([&] {
+			unsigned int tick = 0;
+			long sign = 1;
+
+			periodic(opt.servo_hz, stop, r.adjfine, [&] {
+				double t = static_cast<double>(tick) / opt.servo_hz;
+				double ppb = opt.servo_ppb * sin(2 * M_PI * t / 60);
+
+				timed(r.adjfine, [&] { return phc_adjfine(clk, ppb); });
+
+				if (opt.phase_every && !(++tick % opt.phase_every)) {
+					timed(r.adjphase, [&] {
+						return phc_adjphase(clk, sign * opt.phase_ns);
+					});
+					sign = -sign;
+				}
+			});
+		});
+
+	if (full && opt.dump_hz)
+		threads.emplace_back([&] {
+			dpll::socket nl;
+
+			nl.resolve();
+			periodic(opt.dump_hz, stop, r.pin_dump, [&] {
+				timed_nl(r.pin_dump, [&] {
+					nl.transact(dpll::CMD_PIN_GET, {}, true);
+				});
+			});
+		});
+
+	if (full && prio_pin.found && opt.prio_hz)
+		threads.emplace_back([&] {
+			dpll::socket nl;
+			bool alt = false;
+
+			nl.resolve();
+			periodic(opt.prio_hz, stop, r.prio_set, [&] {
+				alt = !alt;
+				timed_nl(r.prio_set, [&] {
+					set_prio(nl, prio_pin, alt ? prio_pin.prio ^ 1 :
+						 prio_pin.prio);
+				});
+			});
+		});
+
+	if (full && freq_pin.found && opt.freq_hz)
+		threads.emplace_back([&] {
+			dpll::socket nl;
+			bool alt = false;
+
+			nl.resolve();
+			periodic(opt.freq_hz, stop, r.freq_set, [&] {
+				alt = !alt;
+				timed_nl(r.freq_set, [&] {
+					set_freq(nl, freq_pin, alt ? opt.freq_alt :
+						 freq_pin.frequency);
+				});
+			});
+		});
+
+	std::this_thread::sleep_for(std::chrono::seconds(opt.duration_s));
+	stop = true;
+	for (auto &t : threads)
+		t.join();
+}
+
+void print_phase(const char *title, phase_result &r)
+{
+	load_class *all[] = { &r.phc_read, &r.adjfine, &r.adjphase, &r.pin_dump,
+			      &r.prio_set, &r.freq_set };
+
+	printf("%s\n", title);
+	samples::print_header(stdout);
+	for (load_class *cls : all)
+		if (cls->ops)
+			cls->lat.print(stdout);
+	for (load_class *cls : all)
+		if (cls->missed)
+			printf("%s: %" PRIu64 " periods missed\n",
+			       cls->lat.name().c_str(), cls->missed);
+	printf("\n");
+}
+
+// p99 of the loaded run relative to the baseline, for the servo classes
+void print_degradation(phase_result &base, phase_result &load)
+{
+	std::pair<load_class *, load_class *> servo[] = {
+		{ &base.phc_read, &load.phc_read },
+		{ &base.adjfine, &load.adjfine },
+		{ &base.adjphase, &load.adjphase },
+	};
+
+	printf("%-28s %12s %12s %8s\n", "servo operation", "base_p99_us",
+	       "load_p99_us", "ratio");
+	for (auto &s : servo) {
+		double b, l;
+
+		if (!s.first->lat.count() || !s.second->lat.count())
+			continue;
+		b = s.first->lat.percentile(99) / 1e3;
+		l = s.second->lat.percentile(99) / 1e3;
+		printf("%-28s %12.1f %12.1f %8.2f\n", s.first->lat.name().c_str(), b,
+		       l, b ? l / b : 0.0);
+	}
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options opt = parse_args(argc, argv);
+	input_pin prio_pin, freq_pin;
+	struct timex saved = {};
+	bool restore_freq;
+	clockid_t clk;
+	int fd;
+
+	fd = open(opt.phc.c_str(), O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "cannot open %s: %s\n", opt.phc.c_str(), strerror(errno));
+		return 1;
+	}
+	clk = FD_TO_CLOCKID(fd);
+	restore_freq = clock_adjtime(clk, &saved) >= 0;
+
+	try {
+		dpll::socket nl;
+		phase_result base, load;
+
+		nl.resolve();
+
+		if (!opt.prio_label.empty()) {
+			prio_pin = find_input_pin(nl, opt, opt.prio_label);
+			if (!prio_pin.found) {
+				fprintf(stderr, "no input pin labelled %s\n",
+					opt.prio_label.c_str());
+				return 1;
+			}
+		}
+		if (!opt.freq_label.empty()) {
+			freq_pin = find_input_pin(nl, opt, opt.freq_label);
+			if (!freq_pin.found) {
+				fprintf(stderr, "no pin labelled %s\n",
+					opt.freq_label.c_str());
+				return 1;
+			}
+		}
+
+		if (opt.baseline) {
+			run_phase(opt, clk, prio_pin, freq_pin, false, base);
+			print_phase("baseline: PHC reader and servo only", base);
+		}
+
+		run_phase(opt, clk, prio_pin, freq_pin, true, load);
+		print_phase("full load", load);
+
+		if (opt.baseline)
+			print_degradation(base, load);
+
+		if (prio_pin.found)
+			set_prio(nl, prio_pin, prio_pin.prio);
+		if (freq_pin.found)
+			set_freq(nl, freq_pin, freq_pin.frequency);
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	if (restore_freq) {
+		saved.modes = ADJ_FREQUENCY;
+		clock_adjtime(clk, &saved);
+	}
+	close(fd);
+
+	return 0;
+}
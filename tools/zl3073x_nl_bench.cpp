@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// DPLL netlink latency benchmark for the zl3073x driver.
+//
+// Measures, against the devices and pins registered by ptp_zl3073x:
+//  - device-get round trip per DPLL device
+//  - pin-get round trip per pin
+//  - full pin-dump round trip
+//  - reference-loss alarm propagation: time from forcing a reference
+//    monitor failure through debugfs (zl3073x/<dev>/ref_mon_status) to the
+//    arrival of the pin-change-ntf that reports the pin as disconnected,
+//    and the matching recovery time once the override is dropped.
+//
+// The alarm latency includes the driver monitor period, which is the
+// figure that users of the notification API actually experience.
+
+#include "dpll_nl.h"
+#include "stats.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace zl3073x;
+
+namespace {
+
+struct options {
+	std::string module = "ptp_zl3073x";
+	std::string inject_file;
+	std::string pin_label;
+	unsigned int ref = 0;
+	unsigned int status = 0x01;
+	unsigned int iterations = 1000;
+	unsigned int trials = 20;
+	unsigned int timeout_ms = 5000;
+	unsigned int settle_ms = 1500;
+};
+
+struct target {
+	std::vector<uint32_t> devices;
+	std::vector<uint32_t> pins;
+	uint32_t inject_pin = 0;
+	bool have_inject_pin = false;
+};
+
+void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -m, --module NAME       driver module name (default ptp_zl3073x)\n"
+		"  -n, --iterations N      get/dump iterations (default 1000)\n"
+		"  -i, --inject FILE       debugfs ref_mon_status file of the device\n"
+		"  -r, --ref N             reference to fail (default 0)\n"
+		"  -l, --label LABEL       board label of the pin for --ref\n"
+		"  -s, --status VAL        REF_MON_STATUS value to force (default 0x01)\n"
+		"  -t, --trials N          alarm injection trials (default 20)\n"
+		"  -T, --timeout MS        notification timeout (default 5000)\n"
+		"  -S, --settle MS         idle time between trials (default 1500)\n",
+		prog);
+}
+
+options parse_args(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{ "module", required_argument, nullptr, 'm' },
+		{ "iterations", required_argument, nullptr, 'n' },
+		{ "inject", required_argument, nullptr, 'i' },
+		{ "ref", required_argument, nullptr, 'r' },
+		{ "label", required_argument, nullptr, 'l' },
+		{ "status", required_argument, nullptr, 's' },
+		{ "trials", required_argument, nullptr, 't' },
+		{ "timeout", required_argument, nullptr, 'T' },
+		{ "settle", required_argument, nullptr, 'S' },
+		{ "help", no_argument, nullptr, 'h' },
+		{}
+	};
+	options opt;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "m:n:i:r:l:s:t:T:S:h", long_opts,
+				nullptr)) != -1) {
+		switch (c) {
+		case 'm': opt.module = optarg; break;
+		case 'n': opt.iterations = strtoul(optarg, nullptr, 0); break;
+		case 'i': opt.inject_file = optarg; break;
+		case 'r': opt.ref = strtoul(optarg, nullptr, 0); break;
+		case 'l': opt.pin_label = optarg; break;
+		case 's': opt.status = strtoul(optarg, nullptr, 0); break;
+		case 't': opt.trials = strtoul(optarg, nullptr, 0); break;
+		case 'T': opt.timeout_ms = strtoul(optarg, nullptr, 0); break;
+		case 'S': opt.settle_ms = strtoul(optarg, nullptr, 0); break;
+		default:
+			usage(argv[0]);
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
+	return opt;
+}
+
+target discover(dpll::socket &nl, const options &opt)
+{
+	target t;
+
+	for (const auto &m : nl.transact(dpll::CMD_DEVICE_GET, {}, true)) {
+		const dpll::attr *id = m.find(dpll::A_ID);
+		const dpll::attr *mod = m.find(dpll::A_MODULE_NAME);
+
+		if (id && mod && mod->str() == opt.module)
+			t.devices.push_back(id->u32());
+	}
+
+	for (const auto &m : nl.transact(dpll::CMD_PIN_GET, {}, true)) {
+		const dpll::attr *id = m.find(dpll::A_PIN_ID);
+		const dpll::attr *mod = m.find(dpll::A_PIN_MODULE_NAME);
+		const dpll::attr *label = m.find(dpll::A_PIN_BOARD_LABEL);
+
+		if (!id || !mod || mod->str() != opt.module)
+			continue;
+
+		t.pins.push_back(id->u32());
+		if (!opt.pin_label.empty() && label && label->str() == opt.pin_label) {
+			t.inject_pin = id->u32();
+			t.have_inject_pin = true;
+		}
+	}
+
+	return t;
+}
+
+void bench_device_get(dpll::socket &nl, const target &t, unsigned int n,
+		      samples &s)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		for (uint32_t id : t.devices) {
+			auto start = clock::now();
+
+			try {
+				nl.transact(dpll::CMD_DEVICE_GET,
+					    { dpll::req_attr::u32(dpll::A_ID, id) }, false);
+				s.add(elapsed_ns(start, clock::now()));
+			} catch (const std::exception &) {
+				s.add_failure();
+			}
+		}
+	}
+}
+
+void bench_pin_get(dpll::socket &nl, const target &t, unsigned int n,
+		   samples &s)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		for (uint32_t id : t.pins) {
+			auto start = clock::now();
+
+			try {
+				nl.transact(dpll::CMD_PIN_GET,
+					    { dpll::req_attr::u32(dpll::A_PIN_ID, id) }, false);
+				s.add(elapsed_ns(start, clock::now()));
+			} catch (const std::exception &) {
+				s.add_failure();
+			}
+		}
+	}
+}
+
+void bench_pin_dump(dpll::socket &nl, unsigned int n, samples &s)
+{
+	for (unsigned int i = 0; i < n; i++) {
+		auto start = clock::now();
+
+		try {
+			nl.transact(dpll::CMD_PIN_GET, {}, true);
+			s.add(elapsed_ns(start, clock::now()));
+		} catch (const std::exception &) {
+			s.add_failure();
+		}
+	}
+}
+
+bool inject(const std::string &file, const std::string &cmd)
+{
+	std::ofstream f(file);
+
+	f << cmd << std::flush;
+	return f.good();
+}
+
+// True when the notification concerns one of our objects and reflects the
+// wanted pin state (disconnected after the injection, anything else after
+// recovery).
+bool ntf_matches(const dpll::msg &m, const target &t, bool want_disconnected)
+{
+	std::set<uint32_t> devices(t.devices.begin(), t.devices.end());
+	const dpll::attr *id;
+
+	if (m.cmd == dpll::CMD_DEVICE_CHANGE_NTF) {
+		id = m.find(dpll::A_ID);
+		return !t.have_inject_pin && id && devices.count(id->u32());
+	}
+
+	if (m.cmd != dpll::CMD_PIN_CHANGE_NTF)
+		return false;
+
+	id = m.find(dpll::A_PIN_ID);
+	if (!id)
+		return false;
+
+	if (!t.have_inject_pin) {
+		for (uint32_t pin : t.pins)
+			if (pin == id->u32())
+				return true;
+		return false;
+	}
+
+	if (id->u32() != t.inject_pin)
+		return false;
+
+	for (const dpll::attr *parent : m.find_all(dpll::A_PIN_PARENT_DEVICE)) {
+		for (const auto &a : parent->nested()) {
+			bool disconnected;
+
+			if (a.type != dpll::A_PIN_STATE)
+				continue;
+
+			disconnected = a.u32() == dpll::PIN_STATE_DISCONNECTED;
+			if (disconnected == want_disconnected)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool wait_ntf(dpll::socket &mon, const target &t, bool want_disconnected,
+	      clock::time_point start, unsigned int timeout_ms, samples &s)
+{
+	auto deadline = start + std::chrono::milliseconds(timeout_ms);
+	dpll::msg m;
+
+	while (clock::now() < deadline) {
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - clock::now()).count();
+
+		if (!mon.recv_ntf(m, left))
+			break;
+		if (ntf_matches(m, t, want_disconnected)) {
+			s.add(elapsed_ns(start, clock::now()));
+			return true;
+		}
+	}
+
+	s.add_failure();
+	return false;
+}
+
+void bench_alarm(dpll::socket &mon, const target &t, const options &opt,
+		 samples &loss, samples &recovery)
+{
+	char fail_cmd[32];
+	char clear_cmd[32];
+
+	snprintf(fail_cmd, sizeof(fail_cmd), "%u 0x%02x", opt.ref, opt.status);
+	snprintf(clear_cmd, sizeof(clear_cmd), "%u hw", opt.ref);
+
+	for (unsigned int i = 0; i < opt.trials; i++) {
+		clock::time_point start;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(opt.settle_ms));
+		mon.drain();
+
+		start = clock::now();
+		if (!inject(opt.inject_file, fail_cmd)) {
+			fprintf(stderr, "cannot write %s: %s\n",
+				opt.inject_file.c_str(), strerror(errno));
+			return;
+		}
+		wait_ntf(mon, t, true, start, opt.timeout_ms, loss);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(opt.settle_ms));
+		mon.drain();
+
+		start = clock::now();
+		inject(opt.inject_file, clear_cmd);
+		wait_ntf(mon, t, false, start, opt.timeout_ms, recovery);
+	}
+
+	inject(opt.inject_file, "hw");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options opt = parse_args(argc, argv);
+
+	try {
+		dpll::socket nl;
+		samples dev_get("device-get");
+		samples pin_get("pin-get");
+		samples pin_dump("pin-dump");
+		samples loss("ref-loss -> ntf");
+		samples recovery("ref-recovery -> ntf");
+		target t;
+
+		nl.resolve();
+		t = discover(nl, opt);
+		if (t.devices.empty()) {
+			fprintf(stderr, "no dpll device registered by %s\n",
+				opt.module.c_str());
+			return 1;
+		}
+		if (!opt.pin_label.empty() && !t.have_inject_pin) {
+			fprintf(stderr, "no pin labelled %s\n", opt.pin_label.c_str());
+			return 1;
+		}
+
+		printf("%s: %zu devices, %zu pins\n", opt.module.c_str(),
+		       t.devices.size(), t.pins.size());
+
+		bench_device_get(nl, t, opt.iterations, dev_get);
+		bench_pin_get(nl, t, opt.iterations, pin_get);
+		bench_pin_dump(nl, opt.iterations, pin_dump);
+
+		if (!opt.inject_file.empty()) {
+			dpll::socket mon;
+
+			mon.resolve();
+			mon.join_monitor();
+			bench_alarm(mon, t, opt, loss, recovery);
+		}
+
+		samples::print_header(stdout);
+		dev_get.print(stdout);
+		pin_get.print(stdout);
+		pin_dump.print(stdout);
+		if (!opt.inject_file.empty()) {
+			loss.print(stdout);
+			recovery.print(stdout);
+		}
+	} catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
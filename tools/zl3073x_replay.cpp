@@ -0,0 +1,378 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Offline replay of a microchip-dpll bus recorder dump.
+//
+// The dump (debugfs microchip-dpll-{i2c,spi}/<device>/recorder.bin, layout in
+// uapi/linux/microchip-dpll.h) is fed to a register model that tracks the
+// selected page and the last known value of every register. The tool reports:
+//  - timing: transfer latency per direction, bus occupancy, and the share of
+//    it the wire itself needs at the given bus speed
+//  - hot registers, ranked by bus time
+//  - redundant accesses: page selects of the current page, writes of the
+//    value a register is known to hold, reads that return the value of the
+//    previous read with no write in between, and runs of single-byte
+//    transfers to consecutive registers that one burst could replace.
+//
+// Semaphore and command registers legitimately show up as repeated reads
+// (polling) and redundant writes (triggers); the report lists the registers so
+// that these can be told apart from real waste.
+
+#include "stats.h"
+
+#include <linux/microchip-dpll.h>
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+using namespace zl3073x;
+
+namespace {
+
+constexpr unsigned int page_size = 128;
+constexpr unsigned int num_regs = 0x800;
+
+struct options {
+	std::string file;
+	unsigned int top = 15;
+	uint32_t bus_hz = 0;
+	unsigned int run_gap_us = 50;
+};
+
+struct reg_stats {
+	uint64_t reads = 0;
+	uint64_t writes = 0;
+	uint64_t bytes = 0;
+	uint64_t time_ns = 0;
+	uint64_t redundant_writes = 0;
+	uint64_t repeated_reads = 0;
+};
+
+// What the host knows about a register from the trace so far
+struct reg_state {
+	bool known = false;
+	uint8_t value = 0;
+	bool read_valid = false;	// last access was a read, no write since
+	uint8_t last_read = 0;
+};
+
+class reg_model {
+public:
+	std::array<reg_stats, num_regs> stats{};
+	uint64_t page_selects = 0;
+	uint64_t redundant_page_selects = 0;
+	uint64_t unknown_page = 0;
+	uint64_t errors = 0;
+	uint64_t coalescable = 0;
+
+	void feed(const microchip_dpll_rec_entry &e, uint64_t run_gap_ns)
+	{
+		bool write = e.flags & MICROCHIP_DPLL_REC_WRITE;
+		unsigned int addr;
+
+		// The transport forgets the page after a failed transfer
+		if (e.flags & MICROCHIP_DPLL_REC_ERROR) {
+			errors++;
+			prev_valid_ = false;
+			page_known_ = false;
+			return;
+		}
+
+		// Each entry carries the page at the time of the transfer, so a
+		// trace started mid-stream still attributes its accesses
+		if (!page_known_ && e.page != MICROCHIP_DPLL_REC_PAGE_UNKNOWN &&
+		    e.page * page_size < num_regs) {
+			page_ = e.page;
+			page_known_ = true;
+		}
+
+		if (write && e.offset == MICROCHIP_DPLL_REC_PAGE_REG) {
+			page_selects++;
+			if (page_known_ && page_ == e.data[0])
+				redundant_page_selects++;
+			page_ = e.data[0];
+			page_known_ = true;
+			return;
+		}
+
+		if (!page_known_)
+			unknown_page++;
+
+		addr = page_ * page_size + e.offset;
+		if (addr >= num_regs)
+			return;
+
+		account(addr, e, write);
+		track_run(addr, e, write, run_gap_ns);
+	}
+
+private:
+	std::array<reg_state, num_regs> state_{};
+	uint8_t page_ = 0;
+	bool page_known_ = false;
+
+	bool prev_valid_ = false;
+	bool prev_write_ = false;
+	unsigned int prev_end_ = 0;
+	uint64_t prev_end_ns_ = 0;
+
+	void account(unsigned int addr, const microchip_dpll_rec_entry &e, bool write)
+	{
+		unsigned int n = std::min<unsigned int>(e.len, MICROCHIP_DPLL_REC_DATA_MAX);
+		reg_stats &s = stats[addr];
+
+		s.bytes += e.len;
+		s.time_ns += e.latency_ns;
+		if (write)
+			s.writes++;
+		else
+			s.reads++;
+
+		for (unsigned int i = 0; i < n && addr + i < num_regs; i++) {
+			reg_state &r = state_[addr + i];
+			uint8_t v = e.data[i];
+
+			if (write) {
+				if (r.known && r.value == v)
+					stats[addr + i].redundant_writes++;
+				r.read_valid = false;
+			} else {
+				if (r.read_valid && r.last_read == v)
+					stats[addr + i].repeated_reads++;
+				r.read_valid = true;
+				r.last_read = v;
+			}
+			r.known = true;
+			r.value = v;
+		}
+	}
+
+	// A transfer that continues the previous one (same direction, next
+	// address, shortly after) could have been part of the same burst
+	void track_run(unsigned int addr, const microchip_dpll_rec_entry &e, bool write,
+		       uint64_t run_gap_ns)
+	{
+		if (prev_valid_ && prev_write_ == write && addr == prev_end_ &&
+		    e.timestamp_ns - prev_end_ns_ <= run_gap_ns)
+			coalescable++;
+
+		prev_valid_ = true;
+		prev_write_ = write;
+		prev_end_ = addr + e.len;
+		prev_end_ns_ = e.timestamp_ns + e.latency_ns;
+	}
+};
+
+void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] FILE\n"
+		"  -n, --top N        hot registers to list (default 15)\n"
+		"  -b, --bus-hz HZ    bus clock, overrides the one in the dump\n"
+		"  -g, --gap US       max gap between transfers of one burst (default 50)\n",
+		prog);
+}
+
+options parse_args(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{ "top", required_argument, nullptr, 'n' },
+		{ "bus-hz", required_argument, nullptr, 'b' },
+		{ "gap", required_argument, nullptr, 'g' },
+		{ "help", no_argument, nullptr, 'h' },
+		{}
+	};
+	options opt;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "n:b:g:h", long_opts, nullptr)) != -1) {
+		switch (c) {
+		case 'n': opt.top = strtoul(optarg, nullptr, 0); break;
+		case 'b': opt.bus_hz = strtoul(optarg, nullptr, 0); break;
+		case 'g': opt.run_gap_us = strtoul(optarg, nullptr, 0); break;
+		default:
+			usage(argv[0]);
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		exit(1);
+	}
+	opt.file = argv[optind];
+
+	return opt;
+}
+
+bool load(const std::string &file, microchip_dpll_rec_header &hdr,
+	  std::vector<microchip_dpll_rec_entry> &entries)
+{
+	std::ifstream f(file, std::ios::binary);
+
+	if (!f.read(reinterpret_cast<char *>(&hdr), sizeof(hdr))) {
+		fprintf(stderr, "%s: short header\n", file.c_str());
+		return false;
+	}
+	if (hdr.magic != MICROCHIP_DPLL_REC_MAGIC ||
+	    hdr.version != MICROCHIP_DPLL_REC_VERSION ||
+	    hdr.entry_size != sizeof(microchip_dpll_rec_entry)) {
+		fprintf(stderr, "%s: not a version %d recorder dump\n", file.c_str(),
+			MICROCHIP_DPLL_REC_VERSION);
+		return false;
+	}
+
+	entries.resize(hdr.count);
+	if (!f.read(reinterpret_cast<char *>(entries.data()),
+		    entries.size() * sizeof(entries[0]))) {
+		fprintf(stderr, "%s: truncated, expected %u entries\n", file.c_str(),
+			hdr.count);
+		return false;
+	}
+
+	return true;
+}
+
+// Time the wire needs for one transfer, without any host or driver overhead
+uint64_t wire_ns(const microchip_dpll_rec_header &hdr, uint32_t bus_hz,
+		 const microchip_dpll_rec_entry &e)
+{
+	uint64_t bits;
+
+	if (!bus_hz)
+		return 0;
+
+	if (hdr.bus == MICROCHIP_DPLL_REC_BUS_I2C) {
+		// address + register, then a repeated start and the address
+		// again for reads; 9 bits per byte, plus start/stop
+		bits = (e.flags & MICROCHIP_DPLL_REC_WRITE) ?
+		       9 * (2 + e.len) + 2 : 9 * (3 + e.len) + 3;
+	} else {
+		bits = 8 * (1 + e.len);
+	}
+
+	return bits * 1000000000ull / bus_hz;
+}
+
+void report_timing(const microchip_dpll_rec_header &hdr, uint32_t bus_hz,
+		   const std::vector<microchip_dpll_rec_entry> &entries)
+{
+	samples rd("read"), wr("write"), page("page select");
+	uint64_t busy = 0, wire = 0, span;
+
+	for (const auto &e : entries) {
+		bool write = e.flags & MICROCHIP_DPLL_REC_WRITE;
+
+		if (write && e.offset == MICROCHIP_DPLL_REC_PAGE_REG)
+			page.add(e.latency_ns);
+		else if (write)
+			wr.add(e.latency_ns);
+		else
+			rd.add(e.latency_ns);
+
+		busy += e.latency_ns;
+		wire += wire_ns(hdr, bus_hz, e);
+	}
+
+	span = entries.back().timestamp_ns + entries.back().latency_ns -
+	       entries.front().timestamp_ns;
+
+	printf("%s bus, %u Hz, %zu transfers over %.3f ms, %" PRIu64 " dropped\n",
+	       hdr.bus == MICROCHIP_DPLL_REC_BUS_I2C ? "I2C" : "SPI", bus_hz,
+	       entries.size(), span / 1e6, static_cast<uint64_t>(hdr.dropped));
+	printf("bus occupied %.1f%% of the time", span ? 100.0 * busy / span : 0.0);
+	if (bus_hz)
+		printf(", wire time %.1f%% of that", busy ? 100.0 * wire / busy : 0.0);
+	printf("\n\n");
+
+	samples::print_header(stdout);
+	rd.print(stdout);
+	wr.print(stdout);
+	page.print(stdout);
+	printf("\n");
+}
+
+void report_hot(const reg_model &m, unsigned int top)
+{
+	std::vector<unsigned int> regs;
+
+	for (unsigned int i = 0; i < num_regs; i++)
+		if (m.stats[i].reads || m.stats[i].writes)
+			regs.push_back(i);
+
+	std::sort(regs.begin(), regs.end(), [&](unsigned int a, unsigned int b) {
+		return m.stats[a].time_ns > m.stats[b].time_ns;
+	});
+	if (regs.size() > top)
+		regs.resize(top);
+
+	printf("%-8s %10s %10s %10s %12s %10s %10s\n", "reg", "reads", "writes",
+	       "bytes", "time_us", "rep_reads", "red_wr");
+	for (unsigned int r : regs) {
+		const reg_stats &s = m.stats[r];
+
+		printf("0x%04x   %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %12.1f %10" PRIu64
+		       " %10" PRIu64 "\n", r, s.reads, s.writes, s.bytes, s.time_ns / 1e3,
+		       s.repeated_reads, s.redundant_writes);
+	}
+	printf("\n");
+}
+
+void report_redundant(const reg_model &m, size_t transfers)
+{
+	uint64_t rep = 0, red = 0;
+
+	for (const auto &s : m.stats) {
+		rep += s.repeated_reads;
+		red += s.redundant_writes;
+	}
+
+	printf("page selects:           %10" PRIu64 " (%" PRIu64 " of the current page)\n",
+	       m.page_selects, m.redundant_page_selects);
+	printf("repeated reads:         %10" PRIu64 "\n", rep);
+	printf("redundant writes:       %10" PRIu64 "\n", red);
+	printf("coalescable transfers:  %10" PRIu64 " (%.1f%% of all)\n", m.coalescable,
+	       transfers ? 100.0 * m.coalescable / transfers : 0.0);
+	if (m.unknown_page)
+		printf("unknown page:           %10" PRIu64 " (page assumed 0)\n",
+		       m.unknown_page);
+	if (m.errors)
+		printf("failed transfers:       %10" PRIu64 "\n", m.errors);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	options opt = parse_args(argc, argv);
+	std::vector<microchip_dpll_rec_entry> entries;
+	microchip_dpll_rec_header hdr;
+	uint32_t bus_hz;
+	reg_model model;
+
+	if (!load(opt.file, hdr, entries))
+		return 1;
+
+	if (entries.empty()) {
+		printf("empty trace\n");
+		return 0;
+	}
+
+	bus_hz = opt.bus_hz ? opt.bus_hz : hdr.bus_hz;
+
+	for (const auto &e : entries)
+		model.feed(e, opt.run_gap_us * 1000ull);
+
+	report_timing(hdr, bus_hz, entries);
+	report_hot(model, opt.top);
+	report_redundant(model, entries.size());
+
+	return 0;
+}
@@ -13,193 +13,51 @@
 #include <linux/mfd/microchip-dpll.h>
 #include <linux/regmap.h>
 #include <linux/dpll.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <linux/list.h>
+#include <linux/property.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/zl3073x.h>
+#include <linux/seqlock.h>
+#include <linux/sysfs.h>
+#include <linux/sort.h>
+#include <linux/mm.h>
+#include <uapi/linux/zl3073x.h>
 
 #include "ptp_private.h"
+#include "zl3073x_core.h"
 
-#define DPLL_CHIP_ID_REG				(0x01)
-
-#define DPLL_REF_MON_STATUS(index)			(0x102 + (index))
-#define DPLL_REF_MON_STATUS_QUALIFIED(val)	(!val)
-
-#define DPLL_MON_STATUS(index)					(0x110 + (index))
-#define DPLL_MON_STATUS_HO_READY_GET(val)		((val & GENMASK(2, 2)) >> 2)
-#define DPLL_LOCK_REFSEL_STATUS(index)			(0x130 + (index))
-#define DPLL_LOCK_REFSEL_LOCK_GET(val)			((val & GENMASK(6, 4)) >> 4)
-#define DPLL_LOCK_REFSEL_REF_GET(val)			((val & GENMASK(3, 0)))
-
-#define DPLL_REF_FREQ_ERR(ref)			(0x144 + (ref) * 0x4)
-
-#define DPLL_REF_PHASE_ERR_RQST			(0x20f)
-#define DPLL_REF_PHASE_ERR_RQST_MASK	GENMASK(0, 0)
-
-#define REF_FREQ_MEAS_CTRL				0x21C
-#define REF_FREQ_MEAS_CTRL_MASK			GENMASK(1, 0)
-
-#define REF_FREQ_MEAS_MASK_3_0			0x21D
-#define REF_FREQ_MEAS_MASK_4			0x21E
-
-#define DPLL_MEAS_REF_FREQ_CTRL			0x21F
-#define DPLL_MEAS_REF_FREQ_MASK_SHIFT	4
-
-#define DPLL_REF_PHASE_ERR(ref)			(0x220 + (ref) * 0x6)
-
-#define DPLL_MODE_REFSEL(index)				(0x284 + (index) * 0x4)
-#define DPLL_MODE_REFSEL_MODE_GET(val)		(val & GENMASK(2, 0))
-#define DPLL_MODE_REFSEL_REF_GET(val)		((val & GENMASK(7, 4)) >> 4)
-
-#define DPLL_TIE_CTRL				0x2b0
-#define DPLL_TIE_CTRL_MASK			GENMASK(2, 0)
-#define DPLL_TIE_CTRL_MASK_REG		0x2b1
-#define DPLL_TIE_CTRL_OPERATION		4
-#define DPLL_TIE_CTRL_SIZE			1
-
-#define DPLL_MEAS_CTRL				(0x2D0)
-#define DPLL_MEAS_CTRL_EN_MASK		GENMASK(0, 0)
-#define DPLL_MEAS_IDX_REG			(0x2D1)
-#define DPLL_MEAS_IDX_MASK			GENMASK(2, 0)
-
-#define DPLL_SYNTH_CTRL(index)				(0x480 + (index))
-#define DPLL_SYNTH_CTRL_DPLL_SEL_GET(val)	((val & GENMASK(6, 4)) >> 4)
-
-#define DPLL_TOD_CTRL(index)		(0x2b8 + (index))
-#define DPLL_TOD_CTRL_SEM			BIT(4)
-
-#define DPLL_DF_OFFSET(index)		(0x300 + (index) * 0x20)
-#define DPLL_TIE_DATA(index)		(0x30c + (index) * 0x20)
-#define DPLL_TOD_SEC(index)			(0x312 + (index) * 0x20)
-#define DPLL_TOD_SEC_SIZE			6
-#define DPLL_TOD_NSEC(index)		(0x318 + (index) * 0x20)
-#define DPLL_TOD_NSEC_SIZE			6
-
-#define DPLL_SYNTH_PHASE_SHIFT_CTRL		0x49e
-#define DPLL_SYNTH_PHASE_SHIFT_MASK		0x49f
-#define DPLL_SYNTH_PHASE_SHIFT_INTVL	0x4a0
-#define DPLL_SYNTH_PHASE_SHIFT_DATA		0x4a1
-
-#define DPLL_OUTPUT_CTRL(index)					(0x4a8 + (index))
-#define DPLL_OUTPUT_CTRL_SIZE					1
-#define DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(val)		((val & GENMASK(6, 4)) >> 4)
-#define DPLL_OUTPUT_CTRL_STOP					BIT(1)
-#define DPLL_OUTPUT_CTRL_STOP_HIGH				BIT(2)
-#define DPLL_OUTPUT_CTRL_STOP_HZ				BIT(3)
-
-#define DPLL_OUTPUT_PHASE_STEP_CTRL					0x4b8
-#define DPLL_OUTPUT_PHASE_STEP_CTRL_SIZE			1
-#define DPLL_OUTPUT_PHASE_STEP_CTRL_OP(cmd)			(cmd & GENMASK(1, 0))
-#define DPLL_OUTPUT_PAHSE_STEP_CTRL_OP_WRITE		3
-#define DPLL_OUTPUT_PHASE_STEP_CTRL_OP_MASK			GENMASK(1, 0)
-#define DPLL_OUTPUT_PHASE_STEP_CTRL_TOD_STEP		BIT(3)
-#define DPLL_OUTPUT_PHASE_STEP_CTRL_DPLL(index)		((index) << 4)
-#define DPLL_OUTPUT_PHASE_STEP_NUMBER				0x4b9
-#define DPLL_OUTPUT_PHASE_STEP_NUMBER_SIZE			1
-#define DPLL_OUTPUT_PHASE_STEP_MASK					0x4ba
-#define DPLL_OUTPUT_PHASE_STEP_MASK_SIZE			2
-#define DPLL_OUTPUT_PHASE_STEP_DATA					0x4bc
-#define DPLL_OUTPUT_PHASE_STEP_DATA_SIZE			4
-
-#define DPLL_REF_MB_MASK								0x502
-#define DPLL_REF_MB_MASK_SIZE							2
-#define DPLL_REF_MB_SEM									0x504
-#define DPLL_REF_MB_SEM_SIZE							1
-#define DPLL_REF_MB_SEM_RD								BIT(1)
-#define DPLL_REF_MB_SEM_WR								BIT(0)
-#define DPLL_REF_FREQ_BASE_REG							0x505
-#define DPLL_REF_FREQ_BASE_REG_SIZE						2
-#define DPLL_REF_FREQ_MULT_REG							0x507
-#define DPLL_REF_FREQ_MULT_REG_SIZE						2
-#define DPLL_REF_FREQ_RATIO_M_REG						0x509
-#define DPLL_REF_FREQ_RATIO_M_REG_SIZE					2
-#define DPLL_REF_FREQ_RATIO_N_REG						0x50B
-#define DPLL_REF_FREQ_RATIO_N_REG_SIZE					2
-#define DPLL_REF_PHASE_OFFSET_COMPENSATION_REG			0x528
-#define DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE		6
-
-#define DPLL_REF_SYNC_CTRL						0x52E
-#define DPLL_REF_SYNC_CTRL_MODE_GET(val)		(val & GENMASK(3, 0))
-#define DPLL_REF_ESYNC_DIV_REG					0x530
-#define DPLL_REF_ESYNC_DIV_SIZE					4
-
-#define DPLL_DPLL_MB_MASK			0x602
-#define DPLL_DPLL_MB_MASK_SIZE		2
-#define DPLL_DPLL_MB_SEM			0x604
-#define DPLL_DPLL_MB_SEM_SIZE		1
-#define DPLL_DPLL_MB_SEM_RD			BIT(1)
-#define DPLL_DPLL_MB_SEM_WR			BIT(0)
-
-#define DPLL_REF_PRIORITY(refId)				(0x652 + (refId/2))
-#define DPLL_REF_PRIORITY_GET_UPPER(data)		(((data) & GENMASK(7, 4)) >> 4)
-#define DPLL_REF_PRIORITY_GET_LOWER(data)		((data) & GENMASK(3, 0))
-
-#define DPLL_REF_PRIORITY_GET(data, refId) \
-	(((refId) % 2 == 0) ? DPLL_REF_PRIORITY_GET_LOWER(data) : \
-							DPLL_REF_PRIORITY_GET_UPPER(data))
-
-#define DPLL_REF_PRIORITY_SET_LOWER(data, value) \
-	(((data) & GENMASK(7, 4)) | ((value) & GENMASK(3, 0)))
-
-#define DPLL_REF_PRIORITY_SET_UPPER(data, value) \
-	(((data) & GENMASK(3, 0)) | (((value) & GENMASK(3, 0)) << 4))
-
-#define DPLL_REF_PRIORITY_SET(data, refId, value) \
-	(((refId) % 2 == 0) ? DPLL_REF_PRIORITY_SET_LOWER((data), (value)) : \
-							DPLL_REF_PRIORITY_SET_UPPER((data), (value)))
-
-#define DPLL_REF_PRIORITY_INVALID	0xf
-#define DPLL_REF_INVALID			0xff
-
-#define DPLL_SYNTH_MB_MASK			0x682
-#define DPLL_SYNTH_MB_MASK_SIZE		2
-#define DPLL_SYNTH_MB_SEM			0x684
-#define DPLL_SYNTH_MB_SEM_SIZE		1
-#define DPLL_SYNTH_MB_SEM_RD		BIT(1)
-#define DPLL_SYNTH_FREQ_BASE		0x686
-#define DPLL_SYNTH_FREQ_BASE_SIZE	2
-#define DPLL_SYNTH_FREQ_MULT		0x688
-#define DPLL_SYNTH_FREQ_MULT_SIZE	4
-#define DPLL_SYNTH_FREQ_M			0x68c
-#define DPLL_SYNTH_FREQ_M_SIZE		2
-#define DPLL_SYNTH_FREQ_N			0x68e
-#define DPLL_SYNTH_FREQ_N_SIZE		2
-
-#define DPLL_OUTPUT_MB_MASK								0x702
-#define DPLL_OUTPUT_MB_MASK_SIZE						2
-#define DPLL_OUTPUT_MB_SEM								0x704
-#define DPLL_OUTPUT_MB_SEM_SIZE							1
-#define DPLL_OUTPUT_MB_SEM_RD							BIT(1)
-#define DPLL_OUTPUT_MB_SEM_WR							BIT(0)
-#define DPLL_OUTPUT_MODE								0x705
-#define DPLL_OUTPUT_MODE_SIZE							1
-#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT(val)				((val) << 4)
-#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(val)			((val & GENMASK(7, 4)) >> 4)
-#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT_MASK				GENMASK(7, 4)
-#define DPLL_OUTPUT_MODE_CLOCK_TYPE_GET(val)			(val & GENMASK(2, 0))
-#define DPLL_OUTPUT_DIV									0x70c
-#define DPLL_OUTPUT_DIV_SIZE							4
-#define DPLL_OUTPUT_WIDTH								0x710
-#define DPLL_OUTPUT_WIDTH_SIZE							4
-#define DPLL_OUTPUT_ESYNC_DIV_REG						0x714
-#define DPLL_OUTPUT_ESYNC_DIV_SIZE						4
-#define DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG				0x718
-#define DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE				4
-#define DPLL_OUTPUTP_GREATER_THAN_OUTPUTN(outp, outn)	((outp) > (outn))
-#define DPLL_OUTPUT_PHASE_COMPENSATION_REG				0x720
-#define DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE			4
-#define DPLL_OUTPUT_GPO_EN								0x724
-#define DPLL_OUTPUT_GPO_EN_SIZE							1
-
-#define ZL3073X_1PPM_FORMAT		281474976
-
-#define ZL3073X_MAX_SYNTH				5
-#define ZL3073X_MAX_INPUT_PINS			10
-#define ZL3073X_MAX_OUTPUT_PINS			20
-#define ZL3073X_MAX_OUTPUT_PIN_PAIRS	(ZL3073X_MAX_OUTPUT_PINS / 2)
-#define ZL3073X_MAX_DPLLS				2
-#define ZL3073X_MAX_PINS				(ZL3073X_MAX_INPUT_PINS + ZL3073X_MAX_OUTPUT_PINS)
+#define CREATE_TRACE_POINTS
+#include "zl3073x_trace.h"
 
 #define ZL3073X_PTP_CLOCK_DPLL	0
 
-#define READ_SLEEP_US			10
-#define READ_TIMEOUT_US			100000
+#define ZL3073X_MONITOR_PERIOD_MS		500
+/* Bound on how often one sweep steps aside for the PTP servo */
+#define ZL3073X_MONITOR_MAX_YIELDS		20
+#define ZL3073X_MONITOR_YIELD_DELAY		1
+
+#define ZL3073X_DEBUGFS_DIR				"zl3073x"
+#define ZL3073X_BENCH_MAX_ITERATIONS	100000
+#define ZL3073X_REF_MON_STATUS_NO_OVERRIDE	(-1)
+
+/* Transfers of each kind timed by zl3073x_latch_calibrate() */
+#define ZL3073X_LATCH_SAMPLES			32
+
+/* Reference ranking, see zl3073x_rank_update() */
+#define ZL3073X_RANK_MIN_SAMPLES		16
+#define ZL3073X_RANK_EWMA_SHIFT			4
+#define ZL3073X_RANK_MAX_PPT			100000000LL
+#define ZL3073X_RANK_MAX_TAU_MS			(4 * ZL3073X_MONITOR_PERIOD_MS)
+#define ZL3073X_RANK_MARGIN_DEFAULT		50
+#define ZL3073X_RANK_MARGIN_MAX			1000
+#define ZL3073X_RANK_HOLD_MS_DEFAULT		10000
 
 #if IS_ENABLED(CONFIG_ZL3073X_MFG_FILE_AVAILABLE)
 #define ZL3073X_FW_FILENAME				"zl3073x.mfg"
@@ -210,14 +68,18 @@
 #define ZL3073X_P_PIN(pin)		((pin) % 2 == 0)
 #define ZL3073X_N_PIN(pin)		(!ZL3073X_P_PIN(pin))
 
-#define ZL3073X_IS_INPUT_PIN(pin)	(pin >= 20 && pin < 30)
-#define ZL3073X_IS_OUTPUT_PIN(pin)	(!ZL3073X_IS_INPUT_PIN(pin))
+/* Pins are numbered outputs first, then inputs */
+#define ZL3073X_NUM_PINS(zl3073x)	((zl3073x)->info->num_outputs + (zl3073x)->info->num_refs)
+
+#define ZL3073X_IS_INPUT_PIN(zl3073x, pin)	(pin >= (zl3073x)->info->num_outputs && \
+						 pin < ZL3073X_NUM_PINS(zl3073x))
+#define ZL3073X_IS_OUTPUT_PIN(zl3073x, pin)	(!ZL3073X_IS_INPUT_PIN(zl3073x, pin))
 
-#define ZL3073X_REG_MAP_INPUT_PIN_GET(pin)	(pin - 20)
+#define ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x, pin)	(pin - (zl3073x)->info->num_outputs)
 
-#define ZL3073X_CHECK_REF_ID(ref)		((ref >= 0) && (ref < ZL3073X_MAX_INPUT_PINS))
-#define ZL3073X_CHECK_OUTPUT_ID(output)	((output >= 0) && (output < ZL3073X_MAX_OUTPUT_PINS))
-#define ZL3073X_CHECK_SYNTH_ID(synth)	((synth >= 0) && (synth < ZL3073X_MAX_SYNTH))
+#define ZL3073X_CHECK_REF_ID(zl3073x, ref)	((ref >= 0) && (ref < (zl3073x)->info->num_refs))
+#define ZL3073X_CHECK_OUTPUT_ID(zl3073x, output)	((output >= 0) && \
+							 (output < (zl3073x)->info->num_outputs))
 
 static const struct of_device_id zl3073x_match[] = {
 	{ .compatible = "microchip,zl80732" },
@@ -226,73 +88,7 @@ static const struct of_device_id zl3073x_match[] = {
 };
 MODULE_DEVICE_TABLE(of, zl3073x_match);
 
-enum zl3073x_mode_t {
-	ZL3073X_MODE_FREERUN        = 0x0,
-	ZL3073X_MODE_HOLDOVER       = 0x1,
-	ZL3073X_MODE_REFLOCK        = 0x2,
-	ZL3073X_MODE_AUTO_LOCK      = 0x3,
-	ZL3073X_MODE_NCO			= 0x4,
-};
-
-enum zl3073x_dpll_state_t {
-	ZLS3073X_DPLL_STATE_FREERUN		= 0x0,
-	ZLS3073X_DPLL_STATE_HOLDOVER	= 0x1,
-	ZLS3073X_DPLL_STATE_FAST_LOCK	= 0x2,
-	ZLS3073X_DPLL_STATE_ACQUIRING	= 0x3,
-	ZLS3073X_DPLL_STATE_LOCK		= 0x4,
-};
-
-enum zl3073x_tod_ctrl_cmd_t {
-	ZL3073X_TOD_CTRL_CMD_WRITE_NEXT_1HZ	= 0x1,
-	ZL3073X_TOD_CTRL_CMD_READ		= 0x8,
-	ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ	= 0x9,
-};
-
-enum zl3073x_ref_sync_ctrl_mode_t {
-	ZL3073X_REF_SYNC_PAIR_DISABLED	= 0x0,
-	ZL3073X_CLOCK_50_50_ESYNC_25_75	= 0x2,
-};
-enum zl3073x_output_mode_signal_format_t {
-	ZL3073X_BOTH_DISABLED			= 0x0,
-	ZL3073X_BOTH_ENABLED			= 0x4,
-	ZL3073X_P_ENABLE			= 0x5,
-	ZL3073X_N_ENABLE			= 0x6,
-	ZL3073X_N_DIVIDED			= 0xC,
-	ZL3073X_N_DIVIDED_AND_INVERTED	= 0xD,
-};
-
-enum zl3073x_output_mode_clock_type_t {
-	ZL3073X_NORMAL_CLOCK		= 0x0,
-	ZL3073X_ESYNC				= 0x1,
-	ZL3073X_ESYNC_ALTERNATING	= 0x2,
-};
-
-enum zl3073x_pin_type {
-	ZL3073X_SINGLE_ENDED_IN_PHASE, /* CMOS in phase */
-	ZL3073X_SINGLE_ENDED_DIVIDED, /* CMOS N divided */
-	ZL3073X_DIFFERENTIAL, /* programmable diff or LVDS*/
-};
-
-enum zl3073x_output_freq_type_t {
-	ZL3073X_SYNCE,
-	ZL3073X_SYNCE_1Hz_FIXED,
-	ZL3073X_PTP,
-	ZL3073X_25MHz_FIXED,
-	ZL3073X_10MHz_FIXED_EPPS,
-	ZL3073X_1Hz_FIXED,
-};
 
-enum zl3073x_pin_input_frequency {
-	ZL3073X_INPUT_FREQ_1HZ			= 1,
-	ZL3073X_INPUT_FREQ_25HZ			= 25,
-	ZL3073X_INPUT_FREQ_100HZ		= 100,
-	ZL3073X_INPUT_FREQ_1KHZ			= 1000,
-	ZL3073X_INPUT_FREQ_10MHZ		= 10000000,
-	ZL3073X_INPUT_FREQ_25MHZ		= 25000000,
-	ZL3073X_INPUT_FREQ_62p5MHZ		= 62500000,
-	ZL3073X_INPUT_FREQ_78p125MHZ	= 78125000,
-	ZL3073X_INPUT_FREQ_100MHZ		= 100000000,
-};
 
 /* phase adjust is stored in a 32 bit register in units of 2.5 ns
  * so just return the highest allowed by the size of the phase
@@ -305,7 +101,7 @@ struct dpll_pin_phase_adjust_range phase_range = {
 
 /* Shared structures between REV_8 and REV_A */
 #if IS_ENABLED(CONFIG_MD_990_0011_REV_0x00080000) || IS_ENABLED(CONFIG_MD_990_0011_REV_0x000A0000)
-enum dpll_type zl3073x_dpll_type[ZL3073X_MAX_DPLLS] = {
+enum dpll_type zl3073x_dpll_type[] = {
 	DPLL_TYPE_EEC,
 	DPLL_TYPE_PPS
 };
@@ -508,7 +304,7 @@ const char *output_pin_names[] = {
 
 /* Default structures and configs for when no specific board is enabled */
 #if !IS_ENABLED(CONFIG_MD_990_0011_REV_0x00080000) && !IS_ENABLED(CONFIG_MD_990_0011_REV_0x000A0000)
-enum dpll_type zl3073x_dpll_type[ZL3073X_MAX_DPLLS] = {
+enum dpll_type zl3073x_dpll_type[] = {
 	DPLL_TYPE_EEC,
 	DPLL_TYPE_PPS
 };
@@ -644,14 +440,204 @@ const char *output_pin_names[] = {
 };
 #endif
 
+/* Who takes a resource lock; the monitor is recognised by its kthread */
+enum zl3073x_lock_class {
+	ZL3073X_LOCK_PTP,
+	ZL3073X_LOCK_DPLL,
+	ZL3073X_LOCK_MONITOR,
+	ZL3073X_LOCK_FW,
+	ZL3073X_LOCK_CLASS_MAX,
+};
+
+static const char * const zl3073x_lock_class_names[ZL3073X_LOCK_CLASS_MAX] = {
+	[ZL3073X_LOCK_PTP] = "ptp",
+	[ZL3073X_LOCK_DPLL] = "dpll",
+	[ZL3073X_LOCK_MONITOR] = "monitor",
+	[ZL3073X_LOCK_FW] = "fw",
+};
+
+struct zl3073x_lock_class_stats {
+	u64 acquisitions;
+	u64 contended;
+	u64 wait_total_ns;
+	u64 wait_max_ns;
+	u64 hold_total_ns;
+	u64 hold_max_ns;
+};
+
+struct zl3073x_lock_stats {
+	struct zl3073x_lock_class_stats class[ZL3073X_LOCK_CLASS_MAX];
+
+	/* Current holder, only meaningful while the lock is held */
+	u64 acquired_ns;
+	const char *holder;
+	enum zl3073x_lock_class holder_class;
+
+	/* Longest single hold since the last reset */
+	u64 longest_ns;
+	const char *longest_holder;
+	enum zl3073x_lock_class longest_class;
+};
+
+
+/* The TOD locks are named after their DPLL, see zl3073x_res_name() */
+static const char * const zl3073x_res_names[ZL3073X_RES_MAX] = {
+	[ZL3073X_RES_PHASE_STEP] = "phase_step",
+	[ZL3073X_RES_TIE] = "tie",
+	[ZL3073X_RES_OUTPUT_MB] = "output_mb",
+	[ZL3073X_RES_SYNTH_MB] = "synth_mb",
+	[ZL3073X_RES_REF_MB] = "ref_mb",
+	[ZL3073X_RES_DPLL_MB] = "dpll_mb",
+	[ZL3073X_RES_MEAS] = "meas",
+};
+
+static struct lock_class_key zl3073x_res_lock_keys[ZL3073X_RES_MAX];
+
+struct zl3073x_res_lock {
+	struct mutex		mutex;
+	/* Protected by zl3073x->lock_stats_lock */
+	struct zl3073x_lock_stats stats;
+};
+
 struct zl3073x_dpll_record {
 	enum dpll_lock_status lock_status;
+	u8 selected_ref;
+	u8 mode;
+	/* DPLL_MODE_REFSEL and DPLL_LOCK_REFSEL_STATUS at the start of the
+	 * sweep, for the pin states of its steps
+	 */
+	u8 mode_refsel;
+	u8 refsel_status;
+};
+
+/* Published by the monitor for in-kernel consumers, see linux/zl3073x.h */
+struct zl3073x_dpll_status_rcu {
+	struct rcu_head		rcu;
+	struct zl3073x_dpll_status status;
+};
+
+/* Stability of a reference as seen by a DPLL over the monitor samples. The
+ * second difference of the phase and the first difference of the FFO are both
+ * Allan-deviation style estimates of the fractional frequency noise at the
+ * sampling interval; their squares are averaged separately.
+ */
+struct zl3073x_rank_stats {
+	unsigned long	stamp;
+	s64		phase[2];
+	s64		ffo;
+	u8		samples;
+	/* In ppt^2 */
+	u64		phase_var;
+	u64		ffo_var;
 };
 
 struct zl3073x_pin_record {
 	u8 pin_on_dpll_state;
 	s64 phase_offset;
 	s64 freq_offset;
+	u8 priority;
+	/* Protected by the rank lock of the DPLL */
+	struct zl3073x_rank_stats rank;
+};
+
+/* Position of the monitor in its sweep over (ref, DPLL), so that a sweep can
+ * be suspended between steps and resumed on the next run of the work
+ */
+struct zl3073x_monitor {
+	bool			in_sweep;
+	unsigned long		sweep_start;
+	u8			ref;
+	u8			dpll;
+	bool			pin_changed;
+	u8			yields;
+	/* Page register writes of the bus, over the sweeps */
+	u64			selects_start;
+	u64			selects_last;
+	u64			selects_max;
+	u64			selects_total;
+	u64			sweeps;
+};
+
+/* Journal of the state transitions seen by the monitor, kept in a ring of the
+ * last ZL3073X_JOURNAL_ENTRIES entries. The offsets are those of the last
+ * sweep and the TOD is extrapolated from the last TOD read of the PTP paths,
+ * so that journaling costs no bus access.
+ */
+#define ZL3073X_JOURNAL_ENTRIES		256
+
+enum zl3073x_journal_type {
+	ZL3073X_JOURNAL_LOCK,		/* enum dpll_lock_status */
+	ZL3073X_JOURNAL_REF,		/* connected reference */
+	ZL3073X_JOURNAL_MODE,		/* mode field of DPLL_MODE_REFSEL */
+	ZL3073X_JOURNAL_REF_STATUS,	/* DPLL_REF_MON_STATUS */
+};
+
+static const char * const zl3073x_journal_type_names[] = {
+	[ZL3073X_JOURNAL_LOCK] = "lock",
+	[ZL3073X_JOURNAL_REF] = "ref",
+	[ZL3073X_JOURNAL_MODE] = "mode",
+	[ZL3073X_JOURNAL_REF_STATUS] = "ref_status",
+};
+
+struct zl3073x_journal_entry {
+	u64			seq;
+	u64			mono_ns;
+	s64			tod_ns;
+	/* Of @ref against @dpll, in ps and 2^-32 */
+	s64			phase_offset;
+	s64			ffo;
+	u32			old_val;
+	u32			new_val;
+	u8			type;
+	u8			dpll;
+	u8			ref;
+	bool			tod_valid;
+};
+
+struct zl3073x_journal {
+	spinlock_t		lock;
+	struct zl3073x_journal_entry *ring;
+	/* Entries ever added, and the first one shown after a clear */
+	u64			seq;
+	u64			first;
+};
+
+/* Chips on the same bus share one monitor worker, and their sweeps are
+ * staggered over the monitor period so that their bursts do not overlap
+ */
+struct zl3073x_bus_coord {
+	struct list_head	list;
+	struct device		*bus;
+	struct kthread_worker	*kworker;
+	struct list_head	members;
+	unsigned int		nr_members;
+	unsigned long		epoch;
+};
+
+static LIST_HEAD(zl3073x_bus_coords);
+static DEFINE_MUTEX(zl3073x_bus_coords_lock);
+
+/* Probed devices, walked under RCU by zl3073x_dpll_status_get() */
+static LIST_HEAD(zl3073x_devices);
+static DEFINE_MUTEX(zl3073x_devices_lock);
+
+static ATOMIC_NOTIFIER_HEAD(zl3073x_dpll_notifier);
+
+struct zl3073x_bench_result {
+	const char		*op;
+	int			index;
+	u32			iterations;
+	u32			errors;
+	int			last_error;
+	u64			min_ns;
+	u64			median_ns;
+	u64			p99_ns;
+	u64			max_ns;
+	u64			wall_ns;
+	u64			cpu_ns;
+	/* Bus lock acquisitions, and the transactions on the wire they made */
+	u64			accesses;
+	u64			transactions;
 };
 
 struct zl3073x_pin {
@@ -662,173 +648,419 @@ struct zl3073x_pin {
 	struct dpll_pin	*dpll_pin;
 };
 
+/* In-driver PI servo steering the DCO of the PTP DPLL to a 1PPS reference of
+ * the same chip, see zl3073x_servo_work(). Gains are in ppt of frequency per
+ * ns of phase error, the defaults being 0.7 and 0.3 ppb/ns.
+ */
+#define ZL3073X_SERVO_KP_DEFAULT	700
+#define ZL3073X_SERVO_KI_DEFAULT	300
+#define ZL3073X_SERVO_STEP_DEFAULT	20000
+/* Sample this long after the TOD second edge, once the chip has updated the
+ * phase error of the reference
+ */
+#define ZL3073X_SERVO_EDGE_DELAY_MS	100
+
+struct zl3073x_servo {
+	struct mutex		lock;
+	/* Below protected by lock */
+	struct kthread_worker	*kworker;
+	struct kthread_delayed_work work;
+	/* Also set under the DCO lock, so adjfine and slews checking it
+	 * under that lock cannot race with the start
+	 */
+	bool			running;
+	u8			ref;
+	u32			kp;
+	u32			ki;
+	/* Phase errors above this are stepped out through the TIE, 0 never */
+	u32			step_ns;
+	s64			integral_ppt;
+
+	/* Statistics since the last start */
+	u64			samples;
+	u64			steps;
+	u64			unqualified;
+	u64			errors;
+	int			last_error;
+	s64			offset_ns;
+	s64			freq_ppt;
+	s64			offset_max_ns;
+	u64			offset_sq_sum;
+};
+
+/* Frequency of the DCO as requested through adjfine. With a ramp rate set, a
+ * new value is approached at that rate in steps of ZL3073X_DCO_RAMP_PERIOD_MS
+ * instead of being written at once.
+ *
+ * adjtime offsets up to slew_max_ns are slewed rather than stepped: the DCO
+ * runs slew_ppb off the adjfine value until slew_end_ns, when the offset is
+ * absorbed. Both are driven by zl3073x_dco_work().
+ */
+#define ZL3073X_DCO_RAMP_PERIOD_MS	10
+#define ZL3073X_DCO_SLEW_RATE_DEFAULT	10000
+
+struct zl3073x_dco {
+	struct mutex		lock;
+	/* Below protected by lock, frequencies in the scaled ppm of adjfine */
+	s64			target;
+	s64			cur;
+	/* Largest slope of a change in ppb/s, 0 to apply changes at once */
+	u32			ramp_rate;
+	bool			ramping;
+	u64			ramp_last_ns;
+	/* Slew policy, a max of 0 steps all offsets */
+	u32			slew_max_ns;
+	u32			slew_rate;
+	/* Slew in progress, signed rate in ppb or 0 */
+	s32			slew_ppb;
+	u64			slew_end_ns;
+	u64			slews;
+	u64			slewed_ns;
+	struct hrtimer		timer;
+	struct kthread_worker	*kworker;
+	struct kthread_work	work;
+};
+
+/* Reorders the priorities of the references in pool by their stability. The
+ * operator picks the pool and the priorities its members hold; the ranking
+ * only permutes those among them.
+ */
+struct zl3073x_rank {
+	struct mutex		lock;
+	/* Below protected by lock */
+	bool			enabled;
+	u16			pool;
+	/* A reference moves up only if it is this much (in %) more stable */
+	u32			margin;
+	u32			hold_ms;
+	unsigned long		last;
+	u64			reorders;
+	u64			errors;
+};
+
+/* Where in the TOD read command the chip latches the TOD, relative to the
+ * middle of the transfer as the host times it. The chip latches at the last
+ * data bit; the wire time comes from the bus clock and is assumed centred
+ * in the transfer. Protected by the TOD lock of the DPLL.
+ */
+struct zl3073x_latch {
+	bool			valid;
+	s32			offset_ns;
+	u32			cycle_ps;
+	u32			wire_ns;
+	u32			latch_ns;
+	/* Shortest TOD read command seen by the last calibration */
+	u64			write_min_ns;
+	u32			calibrations;
+};
+
 struct zl3073x_dpll {
 	struct zl3073x		*zl3073x;
 	u8			index;
 
 	struct ptp_clock_info	info;
 	struct ptp_clock	*clock;
-	struct ptp_pin_desc	pins[ZL3073X_MAX_PINS];
+	/* One per output, sized by the variant */
+	struct ptp_pin_desc	*pins;
 
 	u16			perout_mask;
 	struct dpll_device	*dpll_device;
+
+	/* Written by the monitor only */
+	struct zl3073x_dpll_status_rcu __rcu *status;
+
+	/* Last values seen by the PTP paths, for the status record */
+	spinlock_t		sample_lock;
+	bool			tod_sample_valid;
+	s64			tod_sample_ns;
+	s64			tod_sample_sys_ns;
+	bool			dco_word_valid;
+	s64			dco_word;
+
+	struct zl3073x_latch	latch;
+	struct zl3073x_servo	servo;
+	struct zl3073x_dco	dco;
+	struct zl3073x_rank	rank;
+};
+
+/* Output state requests of state_on_dpll_set that are applied together, see
+ * zl3073x_output_state_apply()
+ */
+#define ZL3073X_OUTPUT_STATE_WINDOW	msecs_to_jiffies(10)
+/* Windows a failed request is applied in before it is dropped */
+#define ZL3073X_OUTPUT_STATE_RETRIES	3
+
+/* Output mailbox registers, from the mode to the GPO enable */
+#define ZL3073X_OUTPUT_MB_IMAGE_SIZE	(DPLL_OUTPUT_GPO_EN + DPLL_OUTPUT_GPO_EN_SIZE - \
+					 DPLL_OUTPUT_MODE)
+
+struct zl3073x_output_state {
+	spinlock_t		lock;
+	/* Protected by lock: pins with a request, the requested states and
+	 * the worker that applies them, NULL while there is none
+	 */
+	u32			pending;
+	u32			enable;
+	u8			retries;
+	struct kthread_worker	*kworker;
+	struct kthread_delayed_work work;
+	/* Signal format of every output pair, written under the output
+	 * mailbox lock
+	 */
+	u8			format[ZL3073X_MAX_OUTPUT_PIN_PAIRS];
+};
+
+/* Which synth drives each output pair, which DPLL each synth follows and the
+ * synth frequencies. These only change when the configuration is loaded, so
+ * they are read once at probe and the output state, phase adjust, frequency
+ * and esync paths look them up instead of going through the synth mailbox.
+ */
+struct zl3073x_topo {
+	bool			valid;
+	u8			output_synth[ZL3073X_MAX_OUTPUT_PIN_PAIRS];
+	u8			synth_dpll[ZL3073X_MAX_SYNTH];
+	u64			synth_freq[ZL3073X_MAX_SYNTH];
 };
 
 struct zl3073x {
 	struct device		*dev;
-	struct mutex		*lock;
+	struct microchip_dpll_ddata *ddata;
 	struct regmap		*regmap;
 	struct device		*mfd;
 
 	struct kthread_worker *kworker;
 	struct kthread_delayed_work work;
-	struct zl3073x_dpll_record dpll_record[ZL3073X_MAX_DPLLS];
-	struct zl3073x_pin_record input_pin_record[ZL3073X_MAX_DPLLS][ZL3073X_MAX_INPUT_PINS];
-
-	struct zl3073x_dpll	dpll[ZL3073X_MAX_DPLLS];
-	struct zl3073x_pin pin[ZL3073X_MAX_PINS];
+	struct zl3073x_monitor	mon;
+	struct zl3073x_bus_coord *coord;
+	struct list_head	coord_node;
+	/* Start of the monitor slot of this chip within the period */
+	unsigned long		coord_offset;
+	u64			clock_id;
+
+	/* Arrays below are sized by the variant, see zl3073x_alloc() */
+	const struct zl3073x_chip_info *info;
+	u16			chip_id;
+	struct zl3073x_dpll_record *dpll_record;
+	/* Indexed by dpll * info->num_refs + ref */
+	struct zl3073x_pin_record *input_pin_record;
+
+	struct zl3073x_dpll	*dpll;
+	struct zl3073x_pin	*pin;
+
+	struct zl3073x_res_lock	res_lock[ZL3073X_RES_MAX];
+	spinlock_t		lock_stats_lock;
+
+	/* Written at probe and by the configuration loader only, while no
+	 * other path can run, see zl3073x_topo_refresh()
+	 */
+	struct zl3073x_topo	topo;
+	struct zl3073x_output_state out_state;
+
+	/* Entry in zl3073x_devices, for zl3073x_dpll_status_get() */
+	struct list_head	node;
+
+	/* DPLL_REF_MON_STATUS per reference, read once per sweep */
+	u8			*ref_status;
+	/* Read by the status_record sysfs attribute, see linux/zl3073x.h */
+	seqlock_t		status_record_lock;
+	struct zl3073x_status_record *status_record;
+	struct zl3073x_journal	journal;
+
+	struct dentry		*debugfs;
+	/* One benchmark at a time, result kept for reading back */
+	struct mutex		bench_lock;
+	struct zl3073x_bench_result bench;
+	/* Fault injection: value reported instead of DPLL_REF_MON_STATUS */
+	int			*ref_mon_status_override;
 };
 
-/* When accessing the registers of the DPLL, it is always required to access
- * first the lower address and then the higher address. The MSB of the data is
- * always stored at the lowest address and LSB is stored at the highest address.
- * This format is different than most setups therefore make sure to swap the
- * bytes before writting and after reading so it can be easier to follow the
- * datasheet.  This function was added for this purpose and it is used inside
- * the read and write functions.
+/*	The data retrieved from the buffer will be in big-endian format, as the device (zl3073x)
+ *	operates in big-endian format while the host system is considered to be little-endian.
  */
-static u8 *zl3073x_swap(u8 *swap, u16 count)
+static int __zl3073x_read(struct zl3073x *zl3073x, enum microchip_dpll_bus_class class,
+			  u16 regaddr, u8 *buf, u16 count)
 {
-	int i;
-
-	for (i = 0; i < count / 2; ++i) {
-		u8 tmp = swap[i];
+	int ret;
 
-		swap[i] = swap[count - i - 1];
-		swap[count - i - 1] = tmp;
-	}
+	microchip_dpll_bus_lock(zl3073x->ddata, class);
+	ret = regmap_bulk_read(zl3073x->regmap, regaddr, buf, count);
+	microchip_dpll_bus_unlock(zl3073x->ddata, class);
 
-	return swap;
+	return ret;
 }
 
-/*	The data retrieved from the buffer will be in big-endian format, as the device (zl3073x)
- *	operates in big-endian format while the host system is considered to be little-endian.
+/*	The buffer data must be in little-endian format (matching host endianness) before writing.
+ *	The function zl3073x_swap converts the buffer to big-endian format.
  */
+static int __zl3073x_write(struct zl3073x *zl3073x, enum microchip_dpll_bus_class class,
+			   u16 regaddr, u8 *buf, u16 count)
+{
+	int ret;
+
+	microchip_dpll_bus_lock(zl3073x->ddata, class);
+	ret = regmap_bulk_write(zl3073x->regmap, regaddr, zl3073x_swap(buf, count), count);
+	microchip_dpll_bus_unlock(zl3073x->ddata, class);
+
+	return ret;
+}
+
+/* Background accesses: configuration, status and the monitor */
 static int zl3073x_read(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
 {
-	return regmap_bulk_read(zl3073x->regmap, regaddr, buf, count);
+	return __zl3073x_read(zl3073x, MICROCHIP_DPLL_BUS_BACKGROUND, regaddr, buf, count);
 }
 
-/*	The buffer data must be in little-endian format (matching host endianness) before writing.
- *	The function zl3073x_swap converts the buffer to big-endian format.
- */
 static int zl3073x_write(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
 {
-	return regmap_bulk_write(zl3073x->regmap, regaddr, zl3073x_swap(buf, count), count);
+	return __zl3073x_write(zl3073x, MICROCHIP_DPLL_BUS_BACKGROUND, regaddr, buf, count);
 }
 
-static void zl3073x_ptp_timestamp_to_bytearray(const struct timespec64 *ts,
-					       u8 *sec, u8 *nsec)
+/* Latency critical accesses of the PTP servo: TOD, DCO, TIE and phase step */
+static int zl3073x_rt_read(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
 {
-	sec[0] = (ts->tv_sec >> 0) & 0xff;
-	sec[1] = (ts->tv_sec >> 8) & 0xff;
-	sec[2] = (ts->tv_sec >> 16) & 0xff;
-	sec[3] = (ts->tv_sec >> 24) & 0xff;
-	sec[4] = (ts->tv_sec >> 32) & 0xff;
-	sec[5] = (ts->tv_sec >> 40) & 0xff;
-
-	nsec[0] = (ts->tv_nsec >> 0) & 0xff;
-	nsec[1] = (ts->tv_nsec >> 8) & 0xff;
-	nsec[2] = (ts->tv_nsec >> 16) & 0xff;
-	nsec[3] = (ts->tv_nsec >> 24) & 0xff;
-	nsec[4] = 0;
-	nsec[5] = 0;
+	return __zl3073x_read(zl3073x, MICROCHIP_DPLL_BUS_CRITICAL, regaddr, buf, count);
 }
 
-static void zl3073x_ptp_bytearray_to_timestamp(struct timespec64 *ts,
-					       u8 *sec, u8 *nsec)
+static int zl3073x_rt_write(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count)
 {
-	ts->tv_sec = sec[0];
-	for (int i = 1; i < DPLL_TOD_SEC_SIZE; ++i) {
-		ts->tv_sec = ts->tv_sec << 8;
-		ts->tv_sec |= sec[i];
-	}
-
-	ts->tv_nsec = nsec[0];
-	for (int i = 1; i < DPLL_TOD_NSEC_SIZE - 2; ++i) {
-		ts->tv_nsec = ts->tv_nsec << 8;
-		ts->tv_nsec |= nsec[i];
-	}
-
-	set_normalized_timespec64(ts, ts->tv_sec, ts->tv_nsec);
+	return __zl3073x_write(zl3073x, MICROCHIP_DPLL_BUS_CRITICAL, regaddr, buf, count);
 }
 
-/*
- *	Reads the semaphore register associated with the DPLL's TOD control.
- *	Returns the semaphore value on success, or an error code on failure.
- */
-static int zl3073x_ptp_tod_sem(struct zl3073x_dpll *dpll)
+static void zl3073x_res_name(enum zl3073x_res res, char *buf, size_t len)
 {
-	struct zl3073x *zl3073x = dpll->zl3073x;
-	int ret;
-	u8 sem;
+	if (res < ZL3073X_RES_PHASE_STEP)
+		snprintf(buf, len, "tod%d", res - ZL3073X_RES_TOD);
+	else
+		strscpy(buf, zl3073x_res_names[res], len);
+}
 
-	ret = zl3073x_read(zl3073x, DPLL_TOD_CTRL(dpll->index), &sem, sizeof(sem));
+/* There is a TOD lock for every DPLL the register map has room for */
+static bool zl3073x_res_present(struct zl3073x *zl3073x, enum zl3073x_res res)
+{
+	return res >= ZL3073X_RES_PHASE_STEP ||
+	       res < ZL3073X_RES_TOD_OF(zl3073x->info->num_dplls);
+}
 
-	if (ret)
-		return ret;
+#define zl3073x_res_held(zl3073x, res)	\
+	lockdep_assert_held(&(zl3073x)->res_lock[res].mutex)
 
-	return sem;
+/* For zl3073x_core.h, which cannot use the macro */
+static void zl3073x_res_assert_held(struct zl3073x *zl3073x, enum zl3073x_res res)
+{
+	zl3073x_res_held(zl3073x, res);
 }
 
-static int zl3073x_ptp_phase_ctrl_op(struct zl3073x_dpll *dpll)
+static u16 zl3073x_bus_page(struct zl3073x *zl3073x)
 {
-	struct zl3073x *zl3073x = dpll->zl3073x;
-	int ret;
-	u8 ctrl;
+	u16 page = microchip_dpll_bus_page(zl3073x->ddata);
 
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_PHASE_STEP_CTRL, &ctrl, sizeof(ctrl));
+	return page == MICROCHIP_DPLL_PAGE_INVALID ? ZL3073X_PAGE_NONE : page;
+}
 
-	if (ret)
-		return ret;
+/* The resource lock wrappers account for every acquisition so that debugfs
+ * can show, per resource, which user class waits for and which call site
+ * holds the lock.
+ */
+#define zl3073x_lock(zl3073x, res, class)	\
+	__zl3073x_lock(zl3073x, res, class, __func__)
 
-	return ctrl;
+static void __zl3073x_lock(struct zl3073x *zl3073x, enum zl3073x_res res,
+			   enum zl3073x_lock_class class, const char *caller)
+{
+	struct zl3073x_res_lock *rl = &zl3073x->res_lock[res];
+	struct zl3073x_lock_stats *stats = &rl->stats;
+	struct zl3073x_lock_class_stats *cs;
+	bool contended = false;
+	u64 start, now, wait;
+
+	if (zl3073x->kworker && current == zl3073x->kworker->task)
+		class = ZL3073X_LOCK_MONITOR;
+
+	start = ktime_get_ns();
+	if (!mutex_trylock(&rl->mutex)) {
+		contended = true;
+		mutex_lock(&rl->mutex);
+	}
+	now = ktime_get_ns();
+	wait = now - start;
+
+	spin_lock(&zl3073x->lock_stats_lock);
+	cs = &stats->class[class];
+	cs->acquisitions++;
+	cs->contended += contended;
+	cs->wait_total_ns += wait;
+	cs->wait_max_ns = max(cs->wait_max_ns, wait);
+	stats->acquired_ns = now;
+	stats->holder = caller;
+	stats->holder_class = class;
+	spin_unlock(&zl3073x->lock_stats_lock);
 }
 
-static int zl3073x_ptp_tie_ctrl_op(struct zl3073x_dpll *dpll)
+static void zl3073x_unlock(struct zl3073x *zl3073x, enum zl3073x_res res)
 {
-	struct zl3073x *zl3073x = dpll->zl3073x;
-	int ret;
-	u8 ctrl;
+	struct zl3073x_res_lock *rl = &zl3073x->res_lock[res];
+	struct zl3073x_lock_stats *stats = &rl->stats;
+	struct zl3073x_lock_class_stats *cs;
+	u64 hold;
+
+	spin_lock(&zl3073x->lock_stats_lock);
+	hold = ktime_get_ns() - stats->acquired_ns;
+	cs = &stats->class[stats->holder_class];
+	cs->hold_total_ns += hold;
+	cs->hold_max_ns = max(cs->hold_max_ns, hold);
+	if (hold > stats->longest_ns) {
+		stats->longest_ns = hold;
+		stats->longest_holder = stats->holder;
+		stats->longest_class = stats->holder_class;
+	}
+	stats->holder = NULL;
+	spin_unlock(&zl3073x->lock_stats_lock);
 
-	ret = zl3073x_read(zl3073x, DPLL_TIE_CTRL, &ctrl, sizeof(ctrl));
+	mutex_unlock(&rl->mutex);
+}
 
-	if (ret)
-		return ret;
+/* Used by the firmware loader, which owns the whole device */
+static void zl3073x_lock_all(struct zl3073x *zl3073x, enum zl3073x_lock_class class)
+{
+	int res;
 
-	return ctrl;
+	for (res = 0; res < ZL3073X_RES_MAX; res++)
+		zl3073x_lock(zl3073x, res, class);
 }
 
-static int zl3073x_ref_mb_sem(struct zl3073x *zl3073x)
+static void zl3073x_unlock_all(struct zl3073x *zl3073x)
 {
-	int ret;
-	u8 sem;
+	int res;
 
-	ret = zl3073x_read(zl3073x, DPLL_REF_MB_SEM, &sem, sizeof(sem));
+	for (res = ZL3073X_RES_MAX - 1; res >= 0; res--)
+		zl3073x_unlock(zl3073x, res);
+}
 
-	if (ret)
-		return ret;
+static void zl3073x_res_lock_init(struct zl3073x *zl3073x)
+{
+	int res;
 
-	return sem;
+	spin_lock_init(&zl3073x->lock_stats_lock);
+	for (res = 0; res < ZL3073X_RES_MAX; res++) {
+		mutex_init(&zl3073x->res_lock[res].mutex);
+		lockdep_set_class(&zl3073x->res_lock[res].mutex,
+				  &zl3073x_res_lock_keys[res]);
+	}
 }
 
-static int zl3073x_ptp_synth_mb_sem(struct zl3073x_dpll *dpll)
+/*
+ *	Reads the semaphore register associated with the DPLL's TOD control.
+ *	Returns the semaphore value on success, or an error code on failure.
+ */
+static int zl3073x_ptp_tod_sem(struct zl3073x_dpll *dpll)
 {
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	int ret;
 	u8 sem;
 
-	ret = zl3073x_read(zl3073x, DPLL_SYNTH_MB_SEM, &sem, sizeof(sem));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+
+	ret = zl3073x_rt_read(zl3073x, DPLL_TOD_CTRL(dpll->index), &sem, sizeof(sem));
 
 	if (ret)
 		return ret;
@@ -836,39 +1068,53 @@ static int zl3073x_ptp_synth_mb_sem(struct zl3073x_dpll *dpll)
 	return sem;
 }
 
-static int zl3073x_dpll_mb_sem(struct zl3073x *zl3073x)
+static int zl3073x_ptp_phase_ctrl_op(struct zl3073x_dpll *dpll)
 {
+	struct zl3073x *zl3073x = dpll->zl3073x;
 	int ret;
-	u8 sem;
+	u8 ctrl;
 
-	ret = zl3073x_read(zl3073x, DPLL_DPLL_MB_SEM, &sem, sizeof(sem));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_PHASE_STEP);
+
+	ret = zl3073x_rt_read(zl3073x, DPLL_OUTPUT_PHASE_STEP_CTRL, &ctrl, sizeof(ctrl));
 
 	if (ret)
 		return ret;
 
-	return sem;
+	return ctrl;
 }
 
-static int zl3073x_ptp_output_mb_sem(struct zl3073x_dpll *dpll)
+static int zl3073x_ptp_tie_ctrl_op(struct zl3073x_dpll *dpll)
 {
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	int ret;
-	u8 sem;
+	u8 ctrl;
 
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_MB_SEM, &sem, sizeof(sem));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TIE);
+
+	ret = zl3073x_rt_read(zl3073x, DPLL_TIE_CTRL, &ctrl, sizeof(ctrl));
 
 	if (ret)
 		return ret;
 
-	return sem;
+	return ctrl;
 }
 
-static int zl3073x_synth_get(struct zl3073x *zl3073x, int output_index, u8 *synth)
+/* Synth driving output @pair, the pin index / 2 as DPLL_OUTPUT_CTRL counts */
+static int zl3073x_synth_get(struct zl3073x *zl3073x, int pair, u8 *synth)
 {
 	u8 output_ctrl;
 	int ret;
 
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_CTRL(output_index), &output_ctrl,
+	if (pair < 0 || pair >= zl3073x->info->num_outputs / 2)
+		return -EINVAL;
+
+	if (zl3073x->topo.valid) {
+		*synth = zl3073x->topo.output_synth[pair];
+		return 0;
+	}
+
+	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_CTRL(pair), &output_ctrl,
 		     DPLL_OUTPUT_CTRL_SIZE);
 
 	*synth = DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(output_ctrl);
@@ -876,64 +1122,153 @@ static int zl3073x_synth_get(struct zl3073x *zl3073x, int output_index, u8 *synt
 	return ret;
 }
 
+/* Move the system timestamps taken around a TOD read command so that their
+ * middle is at the calibrated latch point
+ */
+static void zl3073x_latch_correct(struct zl3073x_dpll *dpll, struct ptp_system_timestamp *sts)
+{
+	s64 offset = dpll->latch.offset_ns;
+
+	if (!sts || !dpll->latch.valid)
+		return;
+
+	sts->pre_ts = ns_to_timespec64(timespec64_to_ns(&sts->pre_ts) + offset);
+	sts->post_ts = ns_to_timespec64(timespec64_to_ns(&sts->post_ts) + offset);
+}
+
 static int _zl3073x_ptp_gettime64(struct zl3073x_dpll *dpll,
 				  struct timespec64 *ts,
-				  enum zl3073x_tod_ctrl_cmd_t cmd)
+				  enum zl3073x_tod_ctrl_cmd_t cmd,
+				  struct ptp_system_timestamp *sts)
 {
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	u8 nsec[DPLL_TOD_NSEC_SIZE];
 	u8 sec[DPLL_TOD_SEC_SIZE];
+	u64 sys_ns;
 	int ret;
-	u32 val;
+	int val;
 	u8 ctrl;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+
 	/* Check that the semaphore is clear */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_tod_sem, dpll,
-					val, !(DPLL_TOD_CTRL_SEM & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
 	if (ret)
 		goto out;
 
 	/* Issue the read command */
 	ctrl = DPLL_TOD_CTRL_SEM | cmd;
-	ret = zl3073x_write(zl3073x, DPLL_TOD_CTRL(dpll->index), &ctrl, sizeof(ctrl));
+	ptp_read_system_prets(sts);
+	sys_ns = ktime_get_real_ns();
+	ret = zl3073x_rt_write(zl3073x, DPLL_TOD_CTRL(dpll->index), &ctrl, sizeof(ctrl));
 	if (ret)
 		goto out;
+	ptp_read_system_postts(sts);
+	/* The TOD is latched at the last data bit of the write */
+	sys_ns += (ktime_get_real_ns() - sys_ns) / 2;
+	if (dpll->latch.valid)
+		sys_ns += dpll->latch.offset_ns;
+	zl3073x_latch_correct(dpll, sts);
 
 	/* Check that the semaphore is clear */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_tod_sem, dpll,
-					val, !(DPLL_TOD_CTRL_SEM & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
 	if (ret)
 		goto out;
 
 	/* Read the second and nanoseconds */
-	ret = zl3073x_read(zl3073x, DPLL_TOD_SEC(dpll->index),
+	ret = zl3073x_rt_read(zl3073x, DPLL_TOD_SEC(dpll->index),
 		     sec, DPLL_TOD_SEC_SIZE);
 	if (ret)
 		goto out;
-	ret = zl3073x_read(zl3073x, DPLL_TOD_NSEC(dpll->index),
+	ret = zl3073x_rt_read(zl3073x, DPLL_TOD_NSEC(dpll->index),
 		     nsec, DPLL_TOD_NSEC_SIZE);
 	if (ret)
 		goto out;
 
 	zl3073x_ptp_bytearray_to_timestamp(ts, sec, nsec);
 
+	if (cmd == ZL3073X_TOD_CTRL_CMD_READ) {
+		spin_lock(&dpll->sample_lock);
+		dpll->tod_sample_ns = timespec64_to_ns(ts);
+		dpll->tod_sample_sys_ns = sys_ns;
+		dpll->tod_sample_valid = true;
+		spin_unlock(&dpll->sample_lock);
+	}
+
 out:
 	return ret;
 }
 
-static int zl3073x_ptp_gettime64(struct ptp_clock_info *ptp,
-				 struct timespec64 *ts)
+static int zl3073x_ptp_gettimex64(struct ptp_clock_info *ptp,
+				  struct timespec64 *ts,
+				  struct ptp_system_timestamp *sts)
 {
 	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	int ret;
 
-	mutex_lock(zl3073x->lock);
-	ret = _zl3073x_ptp_gettime64(dpll, ts, ZL3073X_TOD_CTRL_CMD_READ);
-	mutex_unlock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+	ret = _zl3073x_ptp_gettime64(dpll, ts, ZL3073X_TOD_CTRL_CMD_READ, sts);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+
+	return ret;
+}
+
+/* The cycle time comes from the bus clock the transport reports. Timing reads
+ * of different lengths does not give it: regmap splits them into one-byte
+ * transactions, each with its own framing and host overhead. The TOD read
+ * command is timed only to check the model; the shortest write is the one
+ * with the least host overhead. The latch point follows from the framing of
+ * the write, see microchip_dpll_bus_write_cycles().
+ */
+static int zl3073x_latch_calibrate(struct zl3073x_dpll *dpll)
+{
+	struct microchip_dpll_ddata *ddata = dpll->zl3073x->ddata;
+	struct zl3073x *zl3073x = dpll->zl3073x;
+	struct zl3073x_latch *latch = &dpll->latch;
+	u64 write = U64_MAX;
+	u32 total, last;
+	u64 cycle_ps;
+	u64 start;
+	int ret;
+	int val;
+	u8 ctrl;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+
+	ctrl = DPLL_TOD_CTRL_SEM | ZL3073X_TOD_CTRL_CMD_READ;
+	for (int i = 0; i < ZL3073X_LATCH_SAMPLES; i++) {
+		ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
+		if (ret)
+			goto out;
+
+		start = ktime_get_ns();
+		ret = zl3073x_rt_write(zl3073x, DPLL_TOD_CTRL(dpll->index), &ctrl, sizeof(ctrl));
+		if (ret)
+			goto out;
+		write = min(write, ktime_get_ns() - start);
+	}
+
+	cycle_ps = ddata->bus_hz ? div_u64(PSEC_PER_SEC, ddata->bus_hz) : 0;
+
+	microchip_dpll_bus_write_cycles(ddata, sizeof(ctrl), &total, &last);
 
+	latch->write_min_ns = write;
+	latch->cycle_ps = cycle_ps;
+	latch->wire_ns = div_u64(total * cycle_ps, 1000);
+	latch->latch_ns = div_u64(last * cycle_ps, 1000);
+	latch->calibrations++;
+
+	/* A wire time longer than the whole write means the model is off */
+	latch->valid = cycle_ps && latch->wire_ns <= write;
+	latch->offset_ns = latch->valid ? (s32)latch->latch_ns - (s32)latch->wire_ns / 2 : 0;
+	if (!latch->valid)
+		dev_warn(zl3073x->dev,
+			 "latch: no estimate (%llu ps/cycle, shortest write %llu ns), using the midpoint\n",
+			 cycle_ps, write);
+
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
 	return ret;
 }
 
@@ -948,10 +1283,10 @@ static int _zl3073x_ptp_settime64(struct zl3073x_dpll *dpll,
 	int val;
 	u8 ctrl;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+
 	/* Check that the semaphore is clear */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_tod_sem, dpll,
-					val, !(DPLL_TOD_CTRL_SEM & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
 	if (ret)
 		goto out;
 
@@ -959,19 +1294,19 @@ static int _zl3073x_ptp_settime64(struct zl3073x_dpll *dpll,
 	zl3073x_ptp_timestamp_to_bytearray(ts, sec, nsec);
 
 	/* Write the value */
-	ret = zl3073x_write(zl3073x, DPLL_TOD_SEC(dpll->index),
+	ret = zl3073x_rt_write(zl3073x, DPLL_TOD_SEC(dpll->index),
 		      sec, DPLL_TOD_SEC_SIZE);
 	if (ret)
 		goto out;
 
-	ret = zl3073x_write(zl3073x, DPLL_TOD_NSEC(dpll->index),
+	ret = zl3073x_rt_write(zl3073x, DPLL_TOD_NSEC(dpll->index),
 				nsec, DPLL_TOD_NSEC_SIZE);
 	if (ret)
 		goto out;
 
 	/* Issue the write command */
 	ctrl = DPLL_TOD_CTRL_SEM | cmd;
-	ret = zl3073x_write(zl3073x, DPLL_TOD_CTRL(dpll->index), &ctrl, sizeof(ctrl));
+	ret = zl3073x_rt_write(zl3073x, DPLL_TOD_CTRL(dpll->index), &ctrl, sizeof(ctrl));
 
 out:
 	return ret;
@@ -984,9 +1319,9 @@ static int zl3073x_ptp_settime64(struct ptp_clock_info *ptp,
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	int ret;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
 	ret = _zl3073x_ptp_settime64(dpll, ts, ZL3073X_TOD_CTRL_CMD_WRITE_NEXT_1HZ);
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
 
 	return ret;
 }
@@ -1001,15 +1336,13 @@ static int zl3073x_ptp_wait_sec_rollover(struct zl3073x_dpll *dpll)
 
 	do {
 		/* Check that the semaphore is clear */
-		ret = readx_poll_timeout_atomic(zl3073x_ptp_tod_sem, dpll,
-						val, !(DPLL_TOD_CTRL_SEM & val),
-						READ_SLEEP_US, READ_TIMEOUT_US);
+		ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
 		if (ret)
 			goto out;
 
 		/* Read the time */
 		ret = _zl3073x_ptp_gettime64(dpll, &ts,
-					     ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ);
+					     ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ, NULL);
 		if (ret)
 			goto out;
 
@@ -1028,93 +1361,128 @@ out:
 	return ret;
 }
 
-static int _zl3073x_ptp_get_synth_freq(struct zl3073x_dpll *dpll, u8 synth, u64 *synthFreq)
+static int zl3073x_synth_freq_read(struct zl3073x *zl3073x, u8 synth, u64 *synthFreq)
 {
-	struct zl3073x *zl3073x = dpll->zl3073x;
-	u16 numerator;
-	u16 denomitor;
-	u8 buf[4];
-	u16 base;
-	u32 mult;
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(synth_freq_base, 0),
+		ZL3073X_FIELD_REQ(synth_freq_mult, 0),
+		ZL3073X_FIELD_REQ(synth_freq_m, 0),
+		ZL3073X_FIELD_REQ(synth_freq_n, 0),
+	};
 	int ret;
-	int val;
-
-	/* Select the synth */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(synth);
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_MB_MASK, buf,
-		      DPLL_SYNTH_MB_MASK_SIZE);
-	if (ret)
-		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_SYNTH_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_MB_SEM, buf,
-		      DPLL_SYNTH_MB_SEM_SIZE);
-	if (ret)
-		goto out;
+	zl3073x_res_held(zl3073x, ZL3073X_RES_SYNTH_MB);
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_synth_mb_sem, dpll,
-					val,
-					!(DPLL_SYNTH_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_synth_mb, BIT(synth), DPLL_SYNTH_MB_SEM_RD);
 	if (ret)
 		goto out;
 
 	/* The output frequency is determined by the following formula:
 	 * base * multiplier * numerator / denomitor
-	 * Therefore get all this number and calculate the output frequency
 	 */
-	ret = zl3073x_read(zl3073x, DPLL_SYNTH_FREQ_BASE, buf,
-		     DPLL_SYNTH_FREQ_BASE_SIZE);
-	if (ret)
-		goto out;
-
-	base = buf[0] << 8;
-	base |= buf[1];
-
-	ret = zl3073x_read(zl3073x, DPLL_SYNTH_FREQ_MULT, buf,
-		     DPLL_SYNTH_FREQ_MULT_SIZE);
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	mult = buf[0] << 24;
-	mult |= buf[1] << 16;
-	mult |= buf[2] << 8;
-	mult |= buf[3];
-
-	ret = zl3073x_read(zl3073x, DPLL_SYNTH_FREQ_M, buf,
-		     DPLL_SYNTH_FREQ_M_SIZE);
-	if (ret)
-		goto out;
+	*synthFreq = zl3073x_freq_calc(req[0].val, req[1].val, req[2].val, req[3].val);
+out:
+	return ret;
+}
 
-	numerator = buf[0] << 8;
-	numerator |= buf[1];
+/* Frequency of @synth from the topology cache, or read through the synth
+ * mailbox under a lock of @class while the cache is not valid
+ */
+static int zl3073x_synth_freq_get(struct zl3073x *zl3073x, u8 synth,
+				  enum zl3073x_lock_class class, u64 *freq)
+{
+	int ret;
 
-	ret = zl3073x_read(zl3073x, DPLL_SYNTH_FREQ_N, buf,
-		     DPLL_SYNTH_FREQ_N_SIZE);
-	if (ret)
-		goto out;
+	if (zl3073x->topo.valid && ZL3073X_CHECK_SYNTH_ID(synth)) {
+		*freq = zl3073x->topo.synth_freq[synth];
+		return 0;
+	}
 
-	denomitor = buf[0] << 8;
-	denomitor |= buf[1];
+	zl3073x_lock(zl3073x, ZL3073X_RES_SYNTH_MB, class);
+	ret = zl3073x_synth_freq_read(zl3073x, synth, freq);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_SYNTH_MB);
 
-	*synthFreq = base * mult * numerator / denomitor;
-out:
 	return ret;
 }
 
-static int zl3073x_ptp_getmaxphase(struct ptp_clock_info *ptp)
+/* Read the output to synth and synth to DPLL selections in one burst each and
+ * the frequency of every synth, and mark the cache valid. Called with the
+ * synth mailbox held, before the PTP clock and the DPLL devices are
+ * registered or with every resource held by the configuration loader, so the
+ * lock free readers of zl3073x->topo never see it change.
+ */
+static int zl3073x_topo_refresh(struct zl3073x *zl3073x)
 {
-	/* Adjphase accepts phase inputs from -1s to 1s */
-	return NSEC_PER_SEC;
-}
+	struct zl3073x_field_req req[ZL3073X_MAX_OUTPUT_PIN_PAIRS];
+	struct zl3073x_topo *topo = &zl3073x->topo;
+	int pairs = zl3073x->info->num_outputs / 2;
+	int ret;
+	int i;
 
-static int zl3073x_ptp_adjphase(struct ptp_clock_info *ptp, s32 delta)
+	zl3073x_res_held(zl3073x, ZL3073X_RES_SYNTH_MB);
+
+	topo->valid = false;
+
+	for (i = 0; i < pairs; i++)
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(output_ctrl, i);
+
+	/* zl3073x_topo_invalidate() only sees the driver's writes */
+	if (WARN_ON(!zl3073x_field_reqs_cacheable(req, pairs)))
+		return -EINVAL;
+
+	ret = zl3073x_field_read_batch(zl3073x, req, pairs);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < pairs; i++)
+		topo->output_synth[i] = DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(req[i].val);
+
+	for (i = 0; i < ZL3073X_MAX_SYNTH; i++)
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(synth_ctrl, i);
+
+	if (WARN_ON(!zl3073x_field_reqs_cacheable(req, ZL3073X_MAX_SYNTH)))
+		return -EINVAL;
+
+	ret = zl3073x_field_read_batch(zl3073x, req, ZL3073X_MAX_SYNTH);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ZL3073X_MAX_SYNTH; i++) {
+		topo->synth_dpll[i] = DPLL_SYNTH_CTRL_DPLL_SEL_GET(req[i].val);
+
+		ret = zl3073x_synth_freq_read(zl3073x, i, &topo->synth_freq[i]);
+		if (ret)
+			return ret;
+	}
+
+	topo->valid = true;
+
+	return 0;
+}
+
+/* Configuration writes that change what zl3073x_topo_refresh() reads */
+static void zl3073x_topo_invalidate(struct zl3073x *zl3073x, u16 addr)
+{
+	if ((addr >= DPLL_SYNTH_CTRL(0) && addr < DPLL_SYNTH_CTRL(ZL3073X_MAX_SYNTH)) ||
+	    (addr >= DPLL_OUTPUT_CTRL(0) &&
+	     addr < DPLL_OUTPUT_CTRL(ZL3073X_MAX_OUTPUT_PIN_PAIRS)) ||
+	    (addr >> 7) == (DPLL_SYNTH_MB_MASK >> 7))
+		zl3073x->topo.valid = false;
+}
+
+static int zl3073x_ptp_getmaxphase(struct ptp_clock_info *ptp)
+{
+	/* Adjphase accepts phase inputs from -1s to 1s */
+	return NSEC_PER_SEC;
+}
+
+/* Shift the phase of the DPLL by the sub-second part of @delta */
+static int zl3073x_ptp_tie_write(struct zl3073x_dpll *dpll, s32 delta)
 {
-	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
 	struct zl3073x *zl3073x = dpll->zl3073x;
 	u8 tieWriteOp = DPLL_TIE_CTRL_OPERATION;
 	s64 delta_sub_sec_in_tie_units;
@@ -1135,46 +1503,50 @@ static int zl3073x_ptp_adjphase(struct ptp_clock_info *ptp, s32 delta)
 	tieData[1] = (delta_sub_sec_in_tie_units & 0xFF00) >> 8;
 	tieData[0] = (delta_sub_sec_in_tie_units & 0xFF) >> 0;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_TIE, ZL3073X_LOCK_PTP);
 
 	/* Set the ctrl to look at the correct dpll */
-	ret = zl3073x_write(zl3073x, DPLL_TIE_CTRL_MASK_REG, &tieDpll, DPLL_TIE_CTRL_SIZE);
+	ret = zl3073x_rt_write(zl3073x, DPLL_TIE_CTRL_MASK_REG, &tieDpll, DPLL_TIE_CTRL_SIZE);
 
 	if (ret)
 		goto out;
 
 	/* Wait for access to the CTRL register */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_tie_ctrl_op, dpll,
-					val,
-					!(DPLL_TIE_CTRL_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_tie_ctrl_op, dpll, val, !(DPLL_TIE_CTRL_MASK & val));
 	if (ret)
 		goto out;
 
 	/* Writes data to the tie register */
-	ret = zl3073x_write(zl3073x, DPLL_TIE_DATA(dpll->index), tieData, sizeof(tieData));
+	ret = zl3073x_rt_write(zl3073x, DPLL_TIE_DATA(dpll->index), tieData, sizeof(tieData));
 
 	if (ret)
 		goto out;
 
 	/* Request to write the TIE */
-	ret = zl3073x_write(zl3073x, DPLL_TIE_CTRL, &tieWriteOp, DPLL_TIE_CTRL_SIZE);
+	ret = zl3073x_rt_write(zl3073x, DPLL_TIE_CTRL, &tieWriteOp, DPLL_TIE_CTRL_SIZE);
 
 	if (ret)
 		goto out;
 
 	/* Wait until the TIE operation is completed*/
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_tie_ctrl_op, dpll,
-					val,
-					!(DPLL_TIE_CTRL_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_tie_ctrl_op, dpll, val, !(DPLL_TIE_CTRL_MASK & val));
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TIE);
 
 	return ret;
 }
 
+static int zl3073x_ptp_adjphase(struct ptp_clock_info *ptp, s32 delta)
+{
+	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
+
+	if (READ_ONCE(dpll->servo.running))
+		return -EBUSY;
+
+	return zl3073x_ptp_tie_write(dpll, delta);
+}
+
 static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 {
 	struct zl3073x *zl3073x = dpll->zl3073x;
@@ -1185,11 +1557,13 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 	int val;
 	int ret;
 
+	/* The TOD lock also covers perout_mask */
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_PHASE_STEP);
+
 	/* Wait for the previous command to finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_phase_ctrl_op, dpll,
-					val,
-					!(DPLL_OUTPUT_PHASE_STEP_CTRL_OP_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_ptp_phase_ctrl_op, dpll, val,
+			   !(DPLL_OUTPUT_PHASE_STEP_CTRL_OP_MASK & val));
 	if (ret)
 		goto out;
 
@@ -1198,7 +1572,7 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 	 */
 	memset(buf, 0, sizeof(buf));
 	buf[0] = 1;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_NUMBER, buf,
+	ret = zl3073x_rt_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_NUMBER, buf,
 		      DPLL_OUTPUT_PHASE_STEP_NUMBER_SIZE);
 
 	if (ret)
@@ -1208,14 +1582,11 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 	 * synth for only 1 output as it is expected that all the outputs that
 	 * are used by 1PPS are connected to same synth.
 	 */
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_CTRL(__ffs(dpll->perout_mask)), buf,
-		     DPLL_OUTPUT_CTRL_SIZE);
-
+	ret = zl3073x_synth_get(zl3073x, __ffs(dpll->perout_mask) / 2, &synth);
 	if (ret)
 		goto out;
 
-	synth = DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(buf[0]);
-	ret =  _zl3073x_ptp_get_synth_freq(dpll, synth, &synthFreq);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_PTP, &synthFreq);
 	if (ret)
 		goto out;
 
@@ -1227,7 +1598,7 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 	buf[1] = (register_units >> 8) & 0xff;
 	buf[2] = (register_units >> 16) & 0xff;
 	buf[3] = (register_units >> 24) & 0xff;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_DATA, buf,
+	ret = zl3073x_rt_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_DATA, buf,
 		      DPLL_OUTPUT_PHASE_STEP_DATA_SIZE);
 
 	if (ret)
@@ -1236,7 +1607,7 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 	/* Select which output should be adjusted */
 	memset(buf, 0, sizeof(buf));
 	buf[0] = dpll->perout_mask;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_MASK, buf,
+	ret = zl3073x_rt_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_MASK, buf,
 		      DPLL_OUTPUT_PHASE_STEP_MASK_SIZE);
 
 	if (ret)
@@ -1248,7 +1619,7 @@ static int _zl3073x_ptp_steptime(struct zl3073x_dpll *dpll, const s64 delta)
 		 DPLL_OUTPUT_PHASE_STEP_CTRL_OP(DPLL_OUTPUT_PAHSE_STEP_CTRL_OP_WRITE) |
 		 DPLL_OUTPUT_PHASE_STEP_CTRL_TOD_STEP;
 
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_CTRL, buf,
+	ret = zl3073x_rt_write(zl3073x, DPLL_OUTPUT_PHASE_STEP_CTRL, buf,
 		      DPLL_OUTPUT_PHASE_STEP_CTRL_SIZE);
 
 out:
@@ -1270,26 +1641,6 @@ out:
 	return ret;
 }
 
-static int zl3073x_dpll_map_raw_to_manager_mode(int raw_mode, enum dpll_mode *mode)
-{
-	switch (raw_mode)	{
-	case ZL3073X_MODE_HOLDOVER:
-	case ZL3073X_MODE_REFLOCK:
-		*mode = DPLL_MODE_MANUAL;
-		break;
-	case ZL3073X_MODE_AUTO_LOCK:
-		*mode = DPLL_MODE_AUTOMATIC;
-		break;
-	case ZL3073X_MODE_FREERUN:
-	case ZL3073X_MODE_NCO:
-	default:
-		*mode = -EINVAL;
-		break;
-	}
-
-	return 0;
-}
-
 static int zl3073x_dpll_raw_lock_status_get(struct zl3073x *zl3073x, int dpll_index, u8 *rawLockStatus)
 {
 	u8 dpll_status;
@@ -1319,25 +1670,7 @@ static int zl3073x_dpll_map_raw_to_manager_lock_status(struct zl3073x *zl3073x,
 
 	ho_ready = DPLL_MON_STATUS_HO_READY_GET(dpll_mon_status);
 
-	switch (dpll_status)	{
-	case ZLS3073X_DPLL_STATE_FREERUN:
-	case ZLS3073X_DPLL_STATE_FAST_LOCK:
-	case ZLS3073X_DPLL_STATE_ACQUIRING:
-		*lock_status = DPLL_LOCK_STATUS_UNLOCKED;
-		break;
-	case ZLS3073X_DPLL_STATE_HOLDOVER:
-		*lock_status = DPLL_LOCK_STATUS_HOLDOVER;
-		break;
-	case ZLS3073X_DPLL_STATE_LOCK:
-		if (ho_ready)
-			*lock_status = DPLL_LOCK_STATUS_LOCKED_HO_ACQ;
-		else
-			*lock_status = DPLL_LOCK_STATUS_LOCKED;
-		break;
-	default:
-		*lock_status = -EINVAL;
-		break;
-	}
+	*lock_status = zl3073x_lock_status_from_raw(dpll_status, ho_ready);
 out:
 	return ret;
 }
@@ -1346,46 +1679,111 @@ static int zl3073x_dpll_get_priority_ref(struct zl3073x *zl3073x, u8 dpll_index,
 				u8 refId, u32 *prio)
 {
 	u8 ref_priority;
-	u8 buf[3];
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_DPLL_MB, ZL3073X_LOCK_DPLL);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(dpll_index);
-	ret = zl3073x_write(zl3073x, DPLL_DPLL_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_dpll_mb, BIT(dpll_index));
 
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_DPLL_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_DPLL_MB_SEM, buf, DPLL_DPLL_MB_SEM_SIZE);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_RD);
+	if (ret)
+		goto out;
+
+	ret = zl3073x_read(zl3073x, DPLL_REF_PRIORITY(refId), &ref_priority, sizeof(ref_priority));
 
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_DPLL_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	*prio = DPLL_REF_PRIORITY_GET(ref_priority, refId);
+
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_DPLL_MB);
+	return ret;
+}
+
+
+/* The priorities of all references of a DPLL, with a single mailbox read */
+static int zl3073x_dpll_ref_priorities_get(struct zl3073x *zl3073x, u8 dpll_index, u8 *prio)
+{
+	u8 count = DIV_ROUND_UP(zl3073x->info->num_refs, 2);
+	u8 data[ZL3073X_MAX_INPUT_PINS / 2];
+	int ret;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_DPLL_MB, ZL3073X_LOCK_DPLL);
+
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_dpll_mb, BIT(dpll_index));
 	if (ret)
 		goto out;
 
-	ret = zl3073x_read(zl3073x, DPLL_REF_PRIORITY(refId), &ref_priority, sizeof(ref_priority));
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_RD);
+	if (ret)
+		goto out;
 
+	ret = zl3073x_read(zl3073x, DPLL_REF_PRIORITY(0), data, count);
 	if (ret)
 		goto out;
 
-	*prio = DPLL_REF_PRIORITY_GET(ref_priority, refId);
+	for (int i = 0; i < zl3073x->info->num_refs; i++)
+		prio[i] = DPLL_REF_PRIORITY_GET(data[i / 2], i);
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_DPLL_MB);
 	return ret;
 }
 
+/* Set the priorities of the references in @mask of a DPLL, with a single
+ * mailbox write. The other references keep what the chip has. Nothing is
+ * written, and -EAGAIN returned, if a reference in @mask no longer has the
+ * priority in @old, as when it was set through netlink meanwhile.
+ */
+static int zl3073x_dpll_ref_priorities_set(struct zl3073x *zl3073x, u8 dpll_index,
+					   const u8 *old, const u8 *prio, u16 mask)
+{
+	u8 count = DIV_ROUND_UP(zl3073x->info->num_refs, 2);
+	u8 data[ZL3073X_MAX_INPUT_PINS / 2];
+	int ret;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_DPLL_MB, ZL3073X_LOCK_DPLL);
+
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_dpll_mb, BIT(dpll_index));
+	if (ret)
+		goto out;
+
+	/* The mailbox writes back the whole DPLL configuration */
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_RD);
+	if (ret)
+		goto out;
+
+	ret = zl3073x_read(zl3073x, DPLL_REF_PRIORITY(0), data, count);
+	if (ret)
+		goto out;
+
+	for (int i = 0; i < zl3073x->info->num_refs; i++) {
+		if (!(mask & BIT(i)))
+			continue;
+
+		if (DPLL_REF_PRIORITY_GET(data[i / 2], i) != old[i]) {
+			ret = -EAGAIN;
+			goto out;
+		}
+
+		data[i / 2] = DPLL_REF_PRIORITY_SET(data[i / 2], i, prio[i]);
+	}
+
+	/* The bytes are in chip order, and zl3073x_write() swaps them */
+	ret = zl3073x_write(zl3073x, DPLL_REF_PRIORITY(0), zl3073x_swap(data, count), count);
+	if (ret)
+		goto out;
+
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_WR);
+
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_DPLL_MB);
+	return ret;
+}
 
 static int zl3073x_dpll_set_priority_ref(struct zl3073x *zl3073x, u8 dpll_index,
 				u8 refId, u32 new_priority)
@@ -1394,31 +1792,17 @@ static int zl3073x_dpll_set_priority_ref(struct zl3073x *zl3073x, u8 dpll_index,
 	u8 updated_priority;
 	u8 buf[3];
 	int ret;
-	int val;
 
 	ret = 0;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_DPLL_MB, ZL3073X_LOCK_DPLL);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(dpll_index);
-	ret = zl3073x_write(zl3073x, DPLL_DPLL_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_DPLL_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_DPLL_MB_SEM, buf, DPLL_DPLL_MB_SEM_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_dpll_mb, BIT(dpll_index));
 
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_DPLL_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_RD);
 	if (ret)
 		goto out;
 
@@ -1438,77 +1822,32 @@ static int zl3073x_dpll_set_priority_ref(struct zl3073x *zl3073x, u8 dpll_index,
 	if (ret)
 		goto out;
 
-    /* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_DPLL_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_DPLL_MB_SEM, buf, DPLL_DPLL_MB_SEM_SIZE);
-
-	if (ret)
-		goto out;
-
-    /* Wait for the write command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-										!(DPLL_DPLL_MB_SEM_WR & val),
-										READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_dpll_mb, DPLL_DPLL_MB_SEM_WR);
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_DPLL_MB);
 	return ret;
 }
 
 
 static int zl3073x_dpll_get_input_phase_adjust(struct zl3073x *zl3073x, u8 refId, s32 *phaseAdj)
 {
-	u8 buf[DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE];
 	s64 currentPhaseOffsetComp = 0;
 	s32 phaseOffsetComp32 = 0;
 	int ret;
-	int val;
-
-	mutex_lock(zl3073x->lock);
-
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(refId);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
 
-	if (ret)
-		goto out;
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_ref_mb, BIT(refId), DPLL_REF_MB_SEM_RD);
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_PHASE_OFFSET_COMPENSATION_REG, buf, DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE);
-
+	ret = zl3073x_field_read_ref_phase_comp(zl3073x, 0, &currentPhaseOffsetComp);
 	if (ret)
 		goto out;
 
-	/* Combine the 6 bytes into a 64-bit signed integer */
-	currentPhaseOffsetComp = ((s64)buf[0] << 40) |
-								((s64)buf[1] << 32) |
-								((s64)buf[2] << 24) |
-								((s64)buf[3] << 16) |
-								((s64)buf[4] << 8) |
-								((s64)buf[5] << 0);
-
-	/* Perform sign extension for a 48-bit signed value */
-	if (currentPhaseOffsetComp & (1LL << 47))
-		currentPhaseOffsetComp |= 0xFFFF000000000000;
-
 	/* Check if the value fits within Sint32 range */
 	if (currentPhaseOffsetComp < phase_range.min || currentPhaseOffsetComp > phase_range.max) {
 		ret = -ERANGE; /* Value too large to fit in Sint32 */
@@ -1521,283 +1860,147 @@ static int zl3073x_dpll_get_input_phase_adjust(struct zl3073x *zl3073x, u8 refId
 	}
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
 	return ret;
 }
 
 static int zl3073x_dpll_set_input_phase_adjust(struct zl3073x *zl3073x, u8 refId, s32 phaseOffsetComp32)
 {
-	u8 buf[DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE];
 	s64 phaseOffsetComp48 = 0;
 	int ret;
-	int val;
 
-	/* Convert the 32-bit signed value to 64-bit format */
+	/* Convert the 32-bit signed value to 64-bit format, the field write
+	 * keeps the lower 48 bits
+	 */
 	phaseOffsetComp48 = (s64)phaseOffsetComp32;
 
-    /* Mask the upper 16 bits to ensure it's within 48 bits */
-	phaseOffsetComp48 &= 0xFFFFFFFFFFFF;
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
-	mutex_lock(zl3073x->lock);
-
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(refId);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_ref_mb, BIT(refId));
 
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
 	/* 2's compliment */
 	phaseOffsetComp48 = ~phaseOffsetComp48 + 1;
 
-	/* Split the 48-bit value into 6 bytes */
-	buf[5] = (u8)(phaseOffsetComp48 >> 40);
-	buf[4] = (u8)(phaseOffsetComp48 >> 32);
-	buf[3] = (u8)(phaseOffsetComp48 >> 24);
-	buf[2] = (u8)(phaseOffsetComp48 >> 16);
-	buf[1] = (u8)(phaseOffsetComp48 >> 8);
-	buf[0] = (u8)(phaseOffsetComp48 >> 0);
-
-	/* Write the 48-bit value to the compensation register */
-	ret = zl3073x_write(zl3073x, DPLL_REF_PHASE_OFFSET_COMPENSATION_REG, buf, DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
-
+	ret = zl3073x_field_write_ref_phase_comp(zl3073x, 0, phaseOffsetComp48);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_WR);
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
 	return ret;
 }
 
 static int zl3073x_dpll_get_output_phase_adjust(struct zl3073x *zl3073x, u8 outputIndex, s32 *phaseAdj)
 {
-	u8 buf[DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE];
 	s32 currentPhaseOffsetComp = 0;
 	int halfSynthCycle;
 	u8 synth;
 	u64 freq;
 	int ret;
-	int val;
-
-	ret = zl3073x_synth_get(zl3073x, outputIndex, &synth);
-
-	if (ret)
-		return ret;
-
-	ret = _zl3073x_ptp_get_synth_freq(zl3073x->dpll, synth, &freq);
-	if (ret)
-		return ret;
-
-	halfSynthCycle = (int)div_u64(PSEC_PER_SEC, (freq*2));
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(outputIndex/2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
+	/* Resolve the synth under the output mailbox lock so that it cannot
+	 * be changed underneath us
+	 */
+	ret = zl3073x_synth_get(zl3073x, outputIndex / 2, &synth);
 
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
-
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &freq);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	halfSynthCycle = (int)div_u64(PSEC_PER_SEC, (freq*2));
+
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(outputIndex/2), DPLL_OUTPUT_MB_SEM_RD);
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_PHASE_COMPENSATION_REG, buf, DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE);
-
+	ret = zl3073x_field_read_output_phase_comp(zl3073x, 0, &currentPhaseOffsetComp);
 	if (ret)
 		goto out;
 
-	/* Combine the 4 bytes into a 32-bit signed integer */
-	currentPhaseOffsetComp = (buf[0] << 24) |
-								(buf[1] << 16) |
-								(buf[2] << 8) |
-								(buf[3] << 0);
-
 	if (currentPhaseOffsetComp != 0) {
 		currentPhaseOffsetComp = (currentPhaseOffsetComp * halfSynthCycle);
 		*phaseAdj = ~currentPhaseOffsetComp + 1; /* Reverse the two's complement negation applied during 'set' */
 	}
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 	return ret;
 }
 
 static int zl3073x_dpll_set_output_phase_adjust(struct zl3073x *zl3073x, u8 outputIndex, s32 phaseOffsetComp32)
 {
-	u8 buf[DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE];
 	int halfSynthCycle;
 	u8 synth;
 	u64 freq;
 	int ret;
-	int val;
 
-	ret = zl3073x_synth_get(zl3073x, outputIndex, &synth);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
+
+	/* Resolve the synth under the output mailbox lock so that it cannot
+	 * be changed underneath us
+	 */
+	ret = zl3073x_synth_get(zl3073x, outputIndex / 2, &synth);
 
 	if (ret)
-		return ret;
+		goto out;
 
-	ret = _zl3073x_ptp_get_synth_freq(zl3073x->dpll, synth, &freq);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &freq);
 	if (ret)
-		return ret;
+		goto out;
 
 	halfSynthCycle = (int)div_u64(PSEC_PER_SEC, (freq*2));
 
 	if ((halfSynthCycle % phaseOffsetComp32) != 0) {
 		/* Not a multiple of halfSynthCycle, return an error */
 		ret = -ERANGE;
-		return ret;
+		goto out;
 	}
 
-	mutex_lock(zl3073x->lock);
-
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(outputIndex/2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, BIT(outputIndex/2));
 
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-
 	phaseOffsetComp32 = phaseOffsetComp32 / halfSynthCycle;
 	/* 2's compliment */
 	phaseOffsetComp32 = ~phaseOffsetComp32 + 1;
 
-	/* Split the 32-bit value into 4 bytes */
-	buf[3] = (u8)(phaseOffsetComp32 >> 24);
-	buf[2] = (u8)(phaseOffsetComp32 >> 16);
-	buf[1] = (u8)(phaseOffsetComp32 >> 8);
-	buf[0] = (u8)(phaseOffsetComp32 >> 0);
-
-	/* Write the 48-bit value to the compensation register */
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_PHASE_COMPENSATION_REG, buf, DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE);
-
+	ret = zl3073x_field_write_output_phase_comp(zl3073x, 0, phaseOffsetComp32);
 	if (ret)
 		goto out;
 
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_OUTPUT_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
-	return 0;
-}
-
-static int zl3073x_ptp_adjtime(struct ptp_clock_info *ptp, s64 delta)
-{
-	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
-	struct zl3073x *zl3073x = dpll->zl3073x;
-	s64 delta_sub_sec_in_ns;
-	struct timespec64 ts;
-	s64 delta_sec_in_ns;
-	s32 delta_sec_rem;
-	s64 delta_sec;
-	int ret;
-	int val;
-
-	/* Split the offset to apply into seconds and nanoseconds */
-	delta_sec = div_s64_rem(delta, NSEC_PER_SEC, &delta_sec_rem);
-	delta_sec_in_ns = delta_sec * NSEC_PER_SEC;
-	delta_sub_sec_in_ns = delta_sec_rem;
-
-	mutex_lock(zl3073x->lock);
-
-	if (delta >= NSEC_PER_SEC || delta <= -NSEC_PER_SEC) {
-		/* wait for rollover */
-		ret = zl3073x_ptp_wait_sec_rollover(dpll);
-		if (ret)
-			goto out;
-
-		/* get the predicted TOD at the next internal 1PPS */
-		ret = _zl3073x_ptp_gettime64(dpll, &ts,
-					     ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ);
-		if (ret)
-			goto out;
-
-		ts = timespec64_add(ts, ns_to_timespec64(delta_sec_in_ns));
-
-		ret = _zl3073x_ptp_settime64(dpll, &ts,
-					     ZL3073X_TOD_CTRL_CMD_WRITE_NEXT_1HZ);
-		if (ret)
-			goto out;
-
-		/* Wait for the semaphore bit to confirm correct settime application */
-		ret = readx_poll_timeout_atomic(zl3073x_ptp_tod_sem, dpll,
-					val, !(DPLL_TOD_CTRL_SEM & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
-		if (ret)
-			goto out;
-	}
-
-	ret = _zl3073x_ptp_steptime(dpll, delta_sub_sec_in_ns);
-
-out:
-	mutex_unlock(zl3073x->lock);
-
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 	return ret;
 }
 
-static int zl3073x_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
+/* Set the DCO of the DPLL to @scaled_ppm, in the units of adjfine */
+static int zl3073x_ptp_dco_write(struct zl3073x_dpll *dpll, s64 scaled_ppm_s64)
 {
-	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
 	struct zl3073x *zl3073x = dpll->zl3073x;
-	s64 scaled_ppm_s64;
 	u8 dco[6];
 	int ret;
 	s64 ref;
 
-	/* Store the scaled_ppm into a s64 variable because on 32bit arch, the
-	 * multiplication with ZL30373X_1PPM_FORMAT with overflow meaning that
-	 * will not be able to adjust to lowest ns
+	/* Taken as s64 because on 32bit arch the multiplication with
+	 * ZL3073X_1PPM_FORMAT would overflow a long and lose the lowest ns
 	 */
-	scaled_ppm_s64 = scaled_ppm;
-	if (!scaled_ppm_s64)
-		return 0;
-
-	mutex_lock(zl3073x->lock);
-
 	ref = ZL3073X_1PPM_FORMAT * (scaled_ppm_s64 >> 16);
 	ref += (ZL3073X_1PPM_FORMAT * (0xffff & scaled_ppm_s64)) >> 16;
 
@@ -1811,24 +2014,313 @@ static int zl3073x_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
 	dco[1] = ref >>  8;
 	dco[0] = ref >>  0;
 
-	ret = zl3073x_write(zl3073x, DPLL_DF_OFFSET(dpll->index), dco, sizeof(dco));
+	/* A single transfer, the bus lock is enough */
+	ret = zl3073x_rt_write(zl3073x, DPLL_DF_OFFSET(dpll->index), dco, sizeof(dco));
+	if (ret)
+		return ret;
 
-	mutex_unlock(zl3073x->lock);
+	spin_lock(&dpll->sample_lock);
+	dpll->dco_word = sign_extend64(ref, 47);
+	dpll->dco_word_valid = true;
+	spin_unlock(&dpll->sample_lock);
 
-	return ret;
+	return 0;
 }
 
-static enum zl3073x_output_mode_signal_format_t
-_zl3073x_ptp_disable_pin(enum zl3073x_output_mode_signal_format_t current_mode,
-			 u8 pin)
+static int zl3073x_dco_apply(struct zl3073x_dpll *dpll)
 {
-	switch (current_mode) {
-	case ZL3073X_P_ENABLE:
-		if (ZL3073X_P_PIN(pin))
-			return ZL3073X_BOTH_DISABLED;
-		break;
-	case ZL3073X_N_ENABLE:
-		if (ZL3073X_N_PIN(pin))
+	struct zl3073x_dco *dco = &dpll->dco;
+
+	lockdep_assert_held(&dco->lock);
+
+	/* ppb of the slew to scaled ppm */
+	return zl3073x_ptp_dco_write(dpll, dco->cur + div_s64((s64)dco->slew_ppb << 16, 1000));
+}
+
+/* Offset the slew in progress has yet to absorb at @now */
+static s64 zl3073x_dco_slew_left(struct zl3073x_dco *dco, u64 now)
+{
+	s64 left;
+
+	if (!dco->slew_ppb || now >= dco->slew_end_ns)
+		return 0;
+
+	left = div_u64((dco->slew_end_ns - now) * abs(dco->slew_ppb), NSEC_PER_SEC);
+
+	return dco->slew_ppb > 0 ? left : -left;
+}
+
+/* Wake up for the next ramp step or the end of the slew, whichever is first */
+static void zl3073x_dco_schedule(struct zl3073x_dco *dco, u64 now)
+{
+	u64 next = U64_MAX;
+
+	if (dco->ramping)
+		next = now + ZL3073X_DCO_RAMP_PERIOD_MS * NSEC_PER_MSEC;
+	if (dco->slew_ppb)
+		next = min(next, dco->slew_end_ns);
+
+	if (next != U64_MAX)
+		hrtimer_start(&dco->timer, ns_to_ktime(next), HRTIMER_MODE_ABS);
+}
+
+static enum hrtimer_restart zl3073x_dco_timer(struct hrtimer *timer)
+{
+	struct zl3073x_dco *dco = container_of(timer, struct zl3073x_dco, timer);
+
+	kthread_queue_work(dco->kworker, &dco->work);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Move the DCO towards the target by as much as the ramp rate allows for the
+ * time since the previous step, so late steps do not slow the ramp down, and
+ * drop the slew offset once its end is reached
+ */
+static void zl3073x_dco_work(struct kthread_work *work)
+{
+	struct zl3073x_dco *dco = container_of(work, struct zl3073x_dco, work);
+	struct zl3073x_dpll *dpll = container_of(dco, struct zl3073x_dpll, dco);
+	u64 now = ktime_get_ns();
+	bool update = false;
+	u64 elapsed_us;
+	s64 step;
+	int ret;
+
+	mutex_lock(&dco->lock);
+
+	if (dco->ramping) {
+		elapsed_us = min_t(u64, div_u64(now - dco->ramp_last_ns, NSEC_PER_USEC),
+				   USEC_PER_SEC);
+		dco->ramp_last_ns = now;
+
+		/* ppb/s to scaled ppm/s, then the share of the elapsed time */
+		step = div_u64(div_u64((u64)dco->ramp_rate << 16, 1000) * elapsed_us,
+			       USEC_PER_SEC);
+
+		if (!dco->ramp_rate || abs(dco->target - dco->cur) <= step)
+			dco->cur = dco->target;
+		else if (dco->target > dco->cur)
+			dco->cur += step;
+		else
+			dco->cur -= step;
+
+		if (dco->cur == dco->target)
+			dco->ramping = false;
+		update = true;
+	}
+
+	if (dco->slew_ppb && now >= dco->slew_end_ns) {
+		dco->slew_ppb = 0;
+		update = true;
+	}
+
+	if (update) {
+		ret = zl3073x_dco_apply(dpll);
+		if (ret)
+			dev_err_ratelimited(dpll->zl3073x->dev, "DCO update failed: %d\n", ret);
+	}
+
+	zl3073x_dco_schedule(dco, now);
+
+	mutex_unlock(&dco->lock);
+}
+
+/* Slew @delta if the policy allows it, on top of what is left of a slew in
+ * progress. Returns 1 if the offset is being slewed, 0 if it is to be stepped
+ * or a negative error, -EBUSY while the servo owns the DCO.
+ */
+static int zl3073x_dco_slew(struct zl3073x_dpll *dpll, s64 delta)
+{
+	struct zl3073x_dco *dco = &dpll->dco;
+	s32 old_ppb;
+	u64 now;
+	s64 left;
+	int ret;
+
+	mutex_lock(&dco->lock);
+
+	if (READ_ONCE(dpll->servo.running)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	now = ktime_get_ns();
+	left = zl3073x_dco_slew_left(dco, now) + delta;
+
+	if (!dco->slew_max_ns || !dco->slew_rate || abs(left) > dco->slew_max_ns) {
+		ret = 0;
+		goto out;
+	}
+
+	old_ppb = dco->slew_ppb;
+	dco->slew_ppb = left < 0 ? -dco->slew_rate : left ? dco->slew_rate : 0;
+	dco->slew_end_ns = now + DIV_ROUND_UP_ULL(abs(left) * NSEC_PER_SEC, dco->slew_rate);
+
+	if (dco->slew_ppb != old_ppb) {
+		ret = zl3073x_dco_apply(dpll);
+		if (ret) {
+			dco->slew_ppb = old_ppb;
+			goto out;
+		}
+	}
+
+	dco->slews++;
+	dco->slewed_ns += abs(delta);
+	zl3073x_dco_schedule(dco, now);
+	ret = 1;
+
+out:
+	mutex_unlock(&dco->lock);
+	return ret;
+}
+
+/* Stop a ramp where it is and drop a slew with what it has not absorbed yet,
+ * e.g. when the servo takes over the DCO
+ */
+static void zl3073x_dco_stop(struct zl3073x_dpll *dpll)
+{
+	struct zl3073x_dco *dco = &dpll->dco;
+
+	mutex_lock(&dco->lock);
+	dco->ramping = false;
+	dco->target = dco->cur;
+	if (dco->slew_ppb) {
+		dco->slew_ppb = 0;
+		if (zl3073x_dco_apply(dpll))
+			dev_warn(dpll->zl3073x->dev, "Failed to drop the DCO slew\n");
+	}
+	mutex_unlock(&dco->lock);
+}
+
+static int zl3073x_dco_init(struct zl3073x_dpll *dpll)
+{
+	struct zl3073x_dco *dco = &dpll->dco;
+
+	mutex_init(&dco->lock);
+	dco->slew_rate = ZL3073X_DCO_SLEW_RATE_DEFAULT;
+	hrtimer_setup(&dco->timer, zl3073x_dco_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	kthread_init_work(&dco->work, zl3073x_dco_work);
+
+	dco->kworker = kthread_run_worker(0, "zl3073x-dco-%s", dev_name(dpll->zl3073x->dev));
+	if (IS_ERR(dco->kworker))
+		return PTR_ERR(dco->kworker);
+
+	sched_set_fifo_low(dco->kworker->task);
+
+	return 0;
+}
+
+static void zl3073x_dco_exit(struct zl3073x_dpll *dpll)
+{
+	zl3073x_dco_stop(dpll);
+	hrtimer_cancel(&dpll->dco.timer);
+	kthread_destroy_worker(dpll->dco.kworker);
+}
+
+static int zl3073x_ptp_adjfine(struct ptp_clock_info *ptp, long scaled_ppm)
+{
+	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
+	struct zl3073x_dco *dco = &dpll->dco;
+	int ret = 0;
+
+	mutex_lock(&dco->lock);
+
+	if (READ_ONCE(dpll->servo.running)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	dco->target = scaled_ppm;
+
+	if (!dco->ramp_rate) {
+		dco->ramping = false;
+		dco->cur = dco->target;
+		ret = zl3073x_dco_apply(dpll);
+	} else if (!dco->ramping) {
+		dco->ramping = true;
+		dco->ramp_last_ns = ktime_get_ns();
+		zl3073x_dco_schedule(dco, dco->ramp_last_ns);
+	}
+
+out:
+	mutex_unlock(&dco->lock);
+
+	return ret;
+}
+
+static int zl3073x_ptp_adjtime(struct ptp_clock_info *ptp, s64 delta)
+{
+	struct zl3073x_dpll *dpll = container_of(ptp, struct zl3073x_dpll, info);
+	struct zl3073x *zl3073x = dpll->zl3073x;
+	s64 delta_sub_sec_in_ns;
+	struct timespec64 ts;
+	s64 delta_sec_in_ns;
+	s32 delta_sec_rem;
+	s64 delta_sec;
+	int ret;
+	int val;
+
+	if (READ_ONCE(dpll->servo.running))
+		return -EBUSY;
+
+	ret = zl3073x_dco_slew(dpll, delta);
+	if (ret)
+		return ret < 0 ? ret : 0;
+
+	/* Split the offset to apply into seconds and nanoseconds */
+	delta_sec = div_s64_rem(delta, NSEC_PER_SEC, &delta_sec_rem);
+	delta_sec_in_ns = delta_sec * NSEC_PER_SEC;
+	delta_sub_sec_in_ns = delta_sec_rem;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+
+	if (delta >= NSEC_PER_SEC || delta <= -NSEC_PER_SEC) {
+		/* wait for rollover */
+		ret = zl3073x_ptp_wait_sec_rollover(dpll);
+		if (ret)
+			goto out;
+
+		/* get the predicted TOD at the next internal 1PPS */
+		ret = _zl3073x_ptp_gettime64(dpll, &ts,
+					     ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ, NULL);
+		if (ret)
+			goto out;
+
+		ts = timespec64_add(ts, ns_to_timespec64(delta_sec_in_ns));
+
+		ret = _zl3073x_ptp_settime64(dpll, &ts,
+					     ZL3073X_TOD_CTRL_CMD_WRITE_NEXT_1HZ);
+		if (ret)
+			goto out;
+
+		/* Wait for the semaphore bit to confirm correct settime application */
+		ret = zl3073x_poll(zl3073x_ptp_tod_sem, dpll, val, !(DPLL_TOD_CTRL_SEM & val));
+		if (ret)
+			goto out;
+	}
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_PHASE_STEP, ZL3073X_LOCK_PTP);
+	ret = _zl3073x_ptp_steptime(dpll, delta_sub_sec_in_ns);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_PHASE_STEP);
+
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+
+	return ret;
+}
+
+static enum zl3073x_output_mode_signal_format_t
+_zl3073x_ptp_disable_pin(enum zl3073x_output_mode_signal_format_t current_mode,
+			 u8 pin)
+{
+	switch (current_mode) {
+	case ZL3073X_P_ENABLE:
+		if (ZL3073X_P_PIN(pin))
+			return ZL3073X_BOTH_DISABLED;
+		break;
+	case ZL3073X_N_ENABLE:
+		if (ZL3073X_N_PIN(pin))
 			return ZL3073X_BOTH_DISABLED;
 		break;
 	case ZL3073X_BOTH_ENABLED:
@@ -1850,37 +2342,22 @@ static int zl3073x_ptp_perout_disable(struct zl3073x_dpll *dpll,
 	u8 buf[2];
 	int pin;
 	int ret;
-	int val;
 	u8 mode;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_OUTPUT_MB);
+
 	pin = ptp_find_pin(dpll->clock, PTP_PF_PEROUT, perout->index);
-	if (pin == -1 || pin >= ZL3073X_MAX_OUTPUT_PINS) {
+	if (pin == -1 || pin >= zl3073x->info->num_outputs) {
 		ret = -EINVAL;
 		goto out;
 	}
 
-	/* Select the output pin */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin / 2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf,
-		      DPLL_OUTPUT_MB_MASK_SIZE);
-
-	if (ret)
-		goto out;
-	/* Select read command  */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf,
-		      DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, BIT(pin / 2));
 
 	if (ret)
 		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, dpll,
-					val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
 	if (ret)
 		goto out;
 
@@ -1891,10 +2368,9 @@ static int zl3073x_ptp_perout_disable(struct zl3073x_dpll *dpll,
 	if (ret)
 		goto out;
 
-	mode = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(buf[0]);
+	mode = _zl3073x_ptp_disable_pin(DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(buf[0]), pin);
 	buf[0] &= ~DPLL_OUTPUT_MODE_SIGNAL_FORMAT_MASK;
-	buf[0] |= DPLL_OUTPUT_MODE_SIGNAL_FORMAT(_zl3073x_ptp_disable_pin(mode,
-									  pin));
+	buf[0] |= DPLL_OUTPUT_MODE_SIGNAL_FORMAT(mode);
 
 	/* Update the configuration */
 	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MODE, buf,
@@ -1903,23 +2379,11 @@ static int zl3073x_ptp_perout_disable(struct zl3073x_dpll *dpll,
 	if (ret)
 		goto out;
 
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf,
-		      DPLL_OUTPUT_MB_SEM_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, dpll,
-					val,
-					!(DPLL_OUTPUT_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
 	if (ret)
 		goto out;
 
+	WRITE_ONCE(zl3073x->out_state.format[pin / 2], mode);
 	dpll->perout_mask &= ~BIT(pin / 2);
 
 out:
@@ -1961,38 +2425,23 @@ static int zl3073x_ptp_perout_enable(struct zl3073x_dpll *dpll,
 	u8 synth;
 	int pin;
 	int ret;
-	int val;
 	u8 mode;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+	zl3073x_res_held(zl3073x, ZL3073X_RES_OUTPUT_MB);
+
 	pin = ptp_find_pin(dpll->clock, PTP_PF_PEROUT, perout->index);
-	if (pin == -1 || pin >= ZL3073X_MAX_OUTPUT_PINS) {
+	if (pin == -1 || pin >= zl3073x->info->num_outputs) {
 		ret = -EINVAL;
 		goto out;
 	}
 
-	/* Select the output pin */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin / 2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf,
-		      DPLL_OUTPUT_MB_MASK_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Select read command  */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf,
-		      DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, BIT(pin / 2));
 
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, dpll,
-					val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
 	if (ret)
 		goto out;
 
@@ -2003,10 +2452,9 @@ static int zl3073x_ptp_perout_enable(struct zl3073x_dpll *dpll,
 	if (ret)
 		goto out;
 
-	mode = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(buf[0]);
+	mode = _zl3073x_ptp_enable_pin(DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(buf[0]), pin);
 	buf[0] &= ~DPLL_OUTPUT_MODE_SIGNAL_FORMAT_MASK;
-	buf[0] |= DPLL_OUTPUT_MODE_SIGNAL_FORMAT(_zl3073x_ptp_enable_pin(mode,
-									 pin));
+	buf[0] |= DPLL_OUTPUT_MODE_SIGNAL_FORMAT(mode);
 
 	/* Update the configuration */
 	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MODE, buf,
@@ -2026,14 +2474,11 @@ static int zl3073x_ptp_perout_enable(struct zl3073x_dpll *dpll,
 	 * in the ouput divider of the pin so it can get an 1PPS as this is the
 	 * only value supported
 	 */
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_CTRL(pin / 2), buf,
-		     DPLL_OUTPUT_CTRL_SIZE);
-
+	ret = zl3073x_synth_get(zl3073x, pin / 2, &synth);
 	if (ret)
 		goto out;
 
-	synth = DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(buf[0]);
-	ret = _zl3073x_ptp_get_synth_freq(dpll, synth, &freq);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_PTP, &freq);
 	if (ret)
 		goto out;
 
@@ -2075,23 +2520,11 @@ static int zl3073x_ptp_perout_enable(struct zl3073x_dpll *dpll,
 			goto out;
 	}
 
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf,
-		      DPLL_OUTPUT_MB_SEM_SIZE);
-
-	if (ret)
-		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, dpll,
-					val,
-					!(DPLL_OUTPUT_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
 	if (ret)
 		goto out;
 
+	WRITE_ONCE(zl3073x->out_state.format[pin / 2], mode);
 	dpll->perout_mask |= BIT(pin / 2);
 
 out:
@@ -2107,7 +2540,8 @@ static int zl3073x_ptp_enable(struct ptp_clock_info *ptp,
 
 	switch (rq->type) {
 	case PTP_CLK_REQ_PEROUT:
-		mutex_lock(zl3073x->lock);
+		zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+		zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_PTP);
 		if (!on)
 			err = zl3073x_ptp_perout_disable(dpll, &rq->perout);
 		/* Only accept a 1-PPS aligned to the second. */
@@ -2116,7 +2550,8 @@ static int zl3073x_ptp_enable(struct ptp_clock_info *ptp,
 			err = -ERANGE;
 		else
 			err = zl3073x_ptp_perout_enable(dpll, &rq->perout);
-		mutex_unlock(zl3073x->lock);
+		zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
+		zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
 		break;
 	default:
 		return -EOPNOTSUPP;
@@ -2143,7 +2578,7 @@ static struct ptp_clock_info zl3073x_ptp_clock_info = {
 	.owner		= THIS_MODULE,
 	.name		= "zl3073x ptp",
 	.max_adj	= 1000000000,
-	.gettime64	= zl3073x_ptp_gettime64,
+	.gettimex64	= zl3073x_ptp_gettimex64,
 	.settime64	= zl3073x_ptp_settime64,
 	.adjtime	= zl3073x_ptp_adjtime,
 	.adjfine	= zl3073x_ptp_adjfine,
@@ -2151,9 +2586,7 @@ static struct ptp_clock_info zl3073x_ptp_clock_info = {
 	.getmaxphase	= zl3073x_ptp_getmaxphase,
 	.enable		= zl3073x_ptp_enable,
 	.verify		= zl3073x_ptp_verify,
-	.n_per_out	= ZL3073X_MAX_OUTPUT_PINS,
-	.n_ext_ts	= ZL3073X_MAX_OUTPUT_PINS,
-	.n_pins		= ZL3073X_MAX_OUTPUT_PINS,
+	/* n_per_out, n_ext_ts and n_pins depend on the variant */
 };
 
 /* DPLL Supporting Funtions */
@@ -2162,6 +2595,8 @@ static int zl3073x_dpll_ref_phase_err_rqst_op(struct zl3073x *zl3073x)
 	u8 read_rqst;
 	int ret;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_MEAS);
+
 	ret = zl3073x_read(zl3073x, DPLL_REF_PHASE_ERR_RQST, &read_rqst, sizeof(read_rqst));
 
 	if (ret)
@@ -2175,6 +2610,8 @@ static int zl3073x_dpll_ref_freq_meas_op(struct zl3073x *zl3073x)
 	int ret;
 	u8 ref_freq_meas_ctrl;
 
+	zl3073x_res_held(zl3073x, ZL3073X_RES_MEAS);
+
 	ret = zl3073x_read(zl3073x, REF_FREQ_MEAS_CTRL, &ref_freq_meas_ctrl, sizeof(ref_freq_meas_ctrl));
 
 	if (ret)
@@ -2183,41 +2620,17 @@ static int zl3073x_dpll_ref_freq_meas_op(struct zl3073x *zl3073x)
 	return ref_freq_meas_ctrl;
 }
 
-static int zl3073x_dpll_forced_ref_get(struct zl3073x *zl3073x, int dpll_index, u8 *dpll_ref)
-{
-	int ret;
-	u8 ref;
-
-	ret = zl3073x_read(zl3073x, DPLL_MODE_REFSEL(dpll_index), &ref, sizeof(ref));
-
-	if (ret)
-		goto out;
-
-	*dpll_ref = DPLL_MODE_REFSEL_REF_GET(ref);
-out:
-	return ret;
-}
-
-static int zl3073x_dpll_ref_selected_get(struct zl3073x *zl3073x, int dpll_index, u8 *ref_selected)
-{
-	u8 selected_ref;
-	int ret;
-
-	ret = zl3073x_read(zl3073x, DPLL_LOCK_REFSEL_STATUS(dpll_index), &selected_ref, sizeof(selected_ref));
-
-	if (ret)
-		goto out;
-
-	*ref_selected = DPLL_LOCK_REFSEL_REF_GET(selected_ref);
-out:
-	return ret;
-}
-
 static int zl3073x_dpll_ref_status_get(struct zl3073x *zl3073x, int ref_index, u8 *ref_status)
 {
+	int override = READ_ONCE(zl3073x->ref_mon_status_override[ref_index]);
 	u8 get_ref_status;
 	int ret;
 
+	if (override != ZL3073X_REF_MON_STATUS_NO_OVERRIDE) {
+		*ref_status = override;
+		return 0;
+	}
+
 	ret = zl3073x_read(zl3073x, DPLL_REF_MON_STATUS(ref_index), &get_ref_status, sizeof(get_ref_status));
 
 	if (ret)
@@ -2233,6 +2646,11 @@ static int zl3073x_dpll_get(struct zl3073x *zl3073x, int synth, u8 *synth_dpll)
 	u8 synth_ctrl;
 	int ret;
 
+	if (zl3073x->topo.valid) {
+		*synth_dpll = zl3073x->topo.synth_dpll[synth];
+		return 0;
+	}
+
 	ret = zl3073x_read(zl3073x, DPLL_SYNTH_CTRL(synth), &synth_ctrl,
 		     sizeof(synth_ctrl));
 
@@ -2244,32 +2662,34 @@ out:
 	return ret;
 }
 
+/* The reference of a DPLL by its DPLL_MODE_REFSEL and
+ * DPLL_LOCK_REFSEL_STATUS registers, before checking that it is qualified
+ */
+static u8 zl3073x_selected_ref_from_raw(u8 mode_refsel, u8 refsel_status)
+{
+	if (DPLL_MODE_REFSEL_MODE_GET(mode_refsel) == ZL3073X_MODE_AUTO_LOCK)
+		return DPLL_LOCK_REFSEL_REF_GET(refsel_status);
+
+	return DPLL_REF_INVALID;
+}
+
 static int zl3073x_connected_ref_get(struct zl3073x *zl3073x, int dpll_index, u8 *connected_ref)
 {
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(dpll_mode_refsel, dpll_index),
+		ZL3073X_FIELD_REQ(dpll_lock_refsel_status, dpll_index),
+	};
 	u8 ref = DPLL_REF_INVALID;
-	u8 selected_ref_index;
-	u8 forced_ref_index;
 	u8 ref_status;
-	u8 mode;
 	int ret;
 
-	ret = zl3073x_dpll_raw_mode_get(zl3073x, dpll_index, &mode);
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	if (mode == ZL3073X_MODE_AUTO_LOCK) {
-		ret = zl3073x_dpll_ref_selected_get(zl3073x, dpll_index, &selected_ref_index);
-		if (ret)
-			goto out;
-
-		ref = selected_ref_index;
-	} else if (mode == ZL3073X_MODE_REFLOCK) {
-		ret = zl3073x_dpll_forced_ref_get(zl3073x, dpll_index, &forced_ref_index);
-		if (ret)
-			goto out;
-	}
+	ref = zl3073x_selected_ref_from_raw(req[0].val, req[1].val);
 
-	if (ZL3073X_CHECK_REF_ID(ref)) {
+	if (ZL3073X_CHECK_REF_ID(zl3073x, ref)) {
 		ret = zl3073x_dpll_ref_status_get(zl3073x, ref, &ref_status);
 		if (ret)
 			goto out;
@@ -2293,9 +2713,7 @@ static int zl3073x_dpll_set_input_frequency(struct zl3073x *zl3073x, u8 refId, u
 	u32 multiplier = 0;
 	u32 numerator = 0;
 	u32 baseFreq = 0;
-	u8 buf[2];
 	int ret;
-	int val;
 
 	/* Reference frequency input configuration lookup table */
 	switch (frequency) {
@@ -2368,120 +2786,74 @@ static int zl3073x_dpll_set_input_frequency(struct zl3073x *zl3073x, u8 refId, u
 	}
 
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(refId);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
-	if (ret)
-		goto out;
-
-	memset(buf, 0, sizeof(buf));
-	buf[0] = (u8)(baseFreq >> 0);
-	buf[1] = (u8)(baseFreq >> 8);
-	ret = zl3073x_write(zl3073x, DPLL_REF_FREQ_BASE_REG, buf, DPLL_REF_FREQ_BASE_REG_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_ref_mb, BIT(refId));
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = (u8)(multiplier >> 0);
-	buf[1] = (u8)(multiplier >> 8);
-	ret = zl3073x_write(zl3073x, DPLL_REF_FREQ_MULT_REG, buf, DPLL_REF_FREQ_MULT_REG_SIZE);
+	ret = zl3073x_field_write_ref_freq_base(zl3073x, 0, baseFreq);
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = (u8)(numerator >> 0);
-	buf[1] = (u8)(numerator >> 8);
-	ret = zl3073x_write(zl3073x, DPLL_REF_FREQ_RATIO_M_REG, buf, DPLL_REF_FREQ_RATIO_M_REG_SIZE);
+	ret = zl3073x_field_write_ref_freq_mult(zl3073x, 0, multiplier);
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = (u8)(denominator >> 0);
-	buf[1] = (u8)(denominator >> 8);
-	ret = zl3073x_write(zl3073x, DPLL_REF_FREQ_RATIO_N_REG, buf, DPLL_REF_FREQ_RATIO_N_REG_SIZE);
+	ret = zl3073x_field_write_ref_freq_m(zl3073x, 0, numerator);
 	if (ret)
 		goto out;
 
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
+	ret = zl3073x_field_write_ref_freq_n(zl3073x, 0, denominator);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_WR);
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
 invalid:
 	return ret;
 }
 
-static int zl3073x_dpll_get_input_frequency(struct zl3073x *zl3073x, u8 refId, u64 *frequency)
+/* The nominal frequency of a reference in Hz, as configured */
+static int zl3073x_ref_freq_nominal_read(struct zl3073x *zl3073x, u8 refId, u64 *freq)
 {
-	u32 denominator = 0;
-	u32 multiplier = 0;
-	u32 inputFreq = 0;
-	u32 numerator = 0;
-	u32 baseFreq = 0;
-	u8 buf[2];
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_freq_base, 0),
+		ZL3073X_FIELD_REQ(ref_freq_mult, 0),
+		ZL3073X_FIELD_REQ(ref_freq_m, 0),
+		ZL3073X_FIELD_REQ(ref_freq_n, 0),
+	};
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(refId);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
-	if (ret)
-		goto out;
-
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_ref_mb, BIT(refId), DPLL_REF_MB_SEM_RD);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_FREQ_BASE_REG, buf, DPLL_REF_FREQ_BASE_REG_SIZE);
-	if (ret)
-		goto out;
-	baseFreq = ((buf[0] << 8) | (buf[1] << 0));
+	*freq = zl3073x_freq_calc(req[0].val, req[1].val, req[2].val, req[3].val);
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_FREQ_MULT_REG, buf, DPLL_REF_FREQ_MULT_REG_SIZE);
-	if (ret)
-		goto out;
-	multiplier = ((buf[0] << 8) | (buf[1] << 0));
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
+	return ret;
+}
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_FREQ_RATIO_M_REG, buf, DPLL_REF_FREQ_RATIO_M_REG_SIZE);
-	if (ret)
-		goto out;
-	numerator = ((buf[0] << 8) | (buf[1] << 0));
+static int zl3073x_dpll_get_input_frequency(struct zl3073x *zl3073x, u8 refId, u64 *frequency)
+{
+	u64 inputFreq;
+	int ret;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_FREQ_RATIO_N_REG, buf, DPLL_REF_FREQ_RATIO_N_REG_SIZE);
+	ret = zl3073x_ref_freq_nominal_read(zl3073x, refId, &inputFreq);
 	if (ret)
-		goto out;
-	denominator = ((buf[0] << 8) | (buf[1] << 0));
-
-	inputFreq = baseFreq * multiplier * numerator / denominator;
+		return ret;
 
 	switch (inputFreq) {
 	case 1: /* 1 HZ */
@@ -2516,10 +2888,7 @@ static int zl3073x_dpll_get_input_frequency(struct zl3073x *zl3073x, u8 refId, u
 		break;
 	}
 
-out:
-	mutex_unlock(zl3073x->lock);
-	return ret;
-
+	return 0;
 }
 
 static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputIndex, u64 frequency)
@@ -2530,19 +2899,12 @@ static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputI
 	u64 synthFreq = 0;
 	u32 outNDiv = 0;
 	u32 outDiv = 0;
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(output_div, 0),
+		ZL3073X_FIELD_REQ(output_esync_div, 0),
+	};
 	u8 synth = 0;
-	u8 buf[6];
 	int ret;
-	int val;
-
-	ret = zl3073x_synth_get(zl3073x, outputIndex, &synth);
-
-	if (ret)
-		return ret;
-
-	ret = _zl3073x_ptp_get_synth_freq(zl3073x->dpll, synth, &synthFreq);
-	if (ret)
-		return ret;
 
 	if (zl3073x->pin[outputIndex].pin_properties.type != DPLL_PIN_TYPE_INT_OSCILLATOR) {
 		for (int i = 0; i < zl3073x->pin[outputIndex].pin_properties.freq_supported_num; i++) {
@@ -2557,48 +2919,37 @@ static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputI
 	if (!isValidFreq)
 		return -EINVAL;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
+
+	/* Resolve the synth under the output mailbox lock so that it cannot
+	 * be changed underneath us
+	 */
+	ret = zl3073x_synth_get(zl3073x, outputIndex / 2, &synth);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(outputIndex/2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &synthFreq);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
-
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(outputIndex/2), DPLL_OUTPUT_MB_SEM_RD);
 	if (ret)
 		goto out;
 
-	/* Get the current outPFreqHz */
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	outDiv = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | (buf[3] << 0);
+	/* Get the current outPFreqHz */
+	outDiv = req[0].val;
 	outPFreqHz = (u32)div_u64(synthFreq, outDiv);
 
 	/* check if output pin is a 2CMOS N DIVIDED */
 	if (zl3073x->pin[outputIndex].pin_type == ZL3073X_SINGLE_ENDED_DIVIDED) {
 
 		/* Get the current outNFreqHz */
-		memset(buf, 0, sizeof(buf));
-		ret = zl3073x_read(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
-		if (ret)
-			goto out;
-
-		outNDiv = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | (buf[3] << 0);
+		outNDiv = req[1].val;
 		outNFreqHz = outPFreqHz / outNDiv;
 
 		if (ZL3073X_P_PIN(outputIndex)) {
@@ -2606,32 +2957,21 @@ static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputI
 				outDiv = (u32)div_u64(synthFreq, (u32)frequency);
 				outNDiv = (u32)div_u64(frequency, outNFreqHz);
 
-				memset(buf, 0, sizeof(buf));
-				buf[0] = (u8)(outDiv >> 0);
-				buf[1] = (u8)(outDiv >> 8);
-				buf[2] = (u8)(outDiv >> 16);
-				buf[3] = (u8)(outDiv >> 24);
-
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
+				ret = zl3073x_field_write_output_div(zl3073x, 0, outDiv);
 				if (ret)
 					goto out;
 
 				/* output_width = output_div */
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_WIDTH, buf, DPLL_OUTPUT_WIDTH_SIZE);
+				ret = zl3073x_field_write_output_width(zl3073x, 0, outDiv);
 				if (ret)
 					goto out;
 
-				memset(buf, 0, sizeof(buf));
-				buf[0] = (u8)(outNDiv >> 0);
-				buf[1] = (u8)(outNDiv >> 8);
-				buf[2] = (u8)(outNDiv >> 16);
-				buf[3] = (u8)(outNDiv >> 24);
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
+				ret = zl3073x_field_write_output_esync_div(zl3073x, 0, outNDiv);
 				if (ret)
 					goto out;
 
 				/* output_esync_width = outN_div */
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG, buf, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE);
+				ret = zl3073x_field_write_output_esync_width(zl3073x, 0, outNDiv);
 				if (ret)
 					goto out;
 			}
@@ -2645,17 +2985,12 @@ static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputI
 		if (ZL3073X_N_PIN(outputIndex)) {
 			if (DPLL_OUTPUTP_GREATER_THAN_OUTPUTN(outPFreqHz, frequency)) {
 				outNDiv = outPFreqHz / (u32)frequency;
-				memset(buf, 0, sizeof(buf));
-				buf[0] = (u8)(outNDiv >> 0);
-				buf[1] = (u8)(outNDiv >> 8);
-				buf[2] = (u8)(outNDiv >> 16);
-				buf[3] = (u8)(outNDiv >> 24);
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
+				ret = zl3073x_field_write_output_esync_div(zl3073x, 0, outNDiv);
 				if (ret)
 					goto out;
 
 				/* output_esync_width = outN_div */
-				ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG, buf, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE);
+				ret = zl3073x_field_write_output_esync_width(zl3073x, 0, outNDiv);
 				if (ret)
 					goto out;
 			}
@@ -2672,37 +3007,21 @@ static int zl3073x_dpll_set_output_frequency(struct zl3073x *zl3073x, u8 outputI
 			zl3073x->pin[outputIndex].pin_type == ZL3073X_DIFFERENTIAL) {
 		outDiv = (u32)div_u64(synthFreq, frequency);
 
-		memset(buf, 0, sizeof(buf));
-		buf[0] = (u8)(outDiv >> 0);
-		buf[1] = (u8)(outDiv >> 8);
-		buf[2] = (u8)(outDiv >> 16);
-		buf[3] = (u8)(outDiv >> 24);
-
-		ret = zl3073x_write(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
+		ret = zl3073x_field_write_output_div(zl3073x, 0, outDiv);
 		if (ret)
 			goto out;
 
 		/* output_width = output_div */
-		ret = zl3073x_write(zl3073x, DPLL_OUTPUT_WIDTH, buf, DPLL_OUTPUT_WIDTH_SIZE);
+		ret = zl3073x_field_write_output_width(zl3073x, 0, outDiv);
 		if (ret)
 			goto out;
 	}
 
-	/* Select write command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
-	if (ret)
-		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_OUTPUT_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
 	if (ret)
 		goto out;
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 	return ret;
 }
 
@@ -2713,48 +3032,36 @@ static int zl3073x_dpll_get_output_frequency(struct zl3073x *zl3073x, u8 outputI
 	u64 synthFreq = 0;
 	u32 outNDiv = 0;
 	u32 outDiv = 0;
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(output_div, 0),
+		ZL3073X_FIELD_REQ(output_esync_div, 0),
+	};
 	u8 synth = 0;
-	u8 buf[6];
 	int ret;
-	int val;
 
-	ret = zl3073x_synth_get(zl3073x, outputIndex, &synth);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
 
-	if (ret)
-		return ret;
-
-	ret = _zl3073x_ptp_get_synth_freq(zl3073x->dpll, synth, &synthFreq);
-	if (ret)
-		return ret;
-
-	mutex_lock(zl3073x->lock);
+	/* Resolve the synth under the output mailbox lock so that it cannot
+	 * be changed underneath us
+	 */
+	ret = zl3073x_synth_get(zl3073x, outputIndex / 2, &synth);
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(outputIndex/2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &synthFreq);
 	if (ret)
 		goto out;
 
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_mb_sem, zl3073x, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(outputIndex/2), DPLL_OUTPUT_MB_SEM_RD);
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	outDiv = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | (buf[3] << 0);
+	outDiv = req[0].val;
 
 	if (zl3073x->pin[outputIndex].pin_type == ZL3073X_SINGLE_ENDED_DIVIDED) {
 		if (ZL3073X_P_PIN(outputIndex)) {
@@ -2763,12 +3070,7 @@ static int zl3073x_dpll_get_output_frequency(struct zl3073x *zl3073x, u8 outputI
 
 		else {
 			outPFreqHz = (u32)div_u64(synthFreq, outDiv);
-			memset(buf, 0, sizeof(buf));
-			ret = zl3073x_read(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
-			if (ret)
-				goto out;
-
-			outNDiv = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | (buf[3] << 0);
+			outNDiv = req[1].val;
 			*frequency = outPFreqHz / outNDiv;
 		}
 	}
@@ -2778,81 +3080,70 @@ static int zl3073x_dpll_get_output_frequency(struct zl3073x *zl3073x, u8 outputI
 		*frequency = div_u64(synthFreq, outDiv);
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 	return ret;
 }
 
-static int zl3073x_dpll_phase_offset_get(struct zl3073x *zl3073x, struct zl3073x_dpll *zl3073x_dpll,
-				u8 ref_index, s64 *phase_offset)
+/* Measure the phase error of @ref_index against @dpll_index, in 0.01 ps */
+static int zl3073x_ref_phase_err_read(struct zl3073x *zl3073x, u8 dpll_index, u8 ref_index,
+				      enum zl3073x_lock_class class, s64 *phase_err)
 {
-	int phase_offset_div_factor;
-	s64 connected_ref_period_ps;
-	s64 phase_offset_reg_units;
-	u64 connected_ref_freq;
-	s64 phase_offset_ps;
 	u8 read_rqst = 0b1;
 	u8 dpll_meas_ctrl;
 	u8 dpll_meas_idx;
-	u8 connected_ref;
-	u8 phase_err[6];
-	u8 ref_status;
-	u64 ref_freq;
 	int ret;
 	int val;
 
-	dpll_meas_idx = (zl3073x_dpll->index) & DPLL_MEAS_IDX_MASK;
+	dpll_meas_idx = dpll_index & DPLL_MEAS_IDX_MASK;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_MEAS, class);
 
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x,
-					val,
-					!(DPLL_REF_PHASE_ERR_RQST_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x, val,
+			   !(DPLL_REF_PHASE_ERR_RQST_MASK & val));
 	if (ret)
-		goto err;
+		goto err_unlock;
 
 	ret = zl3073x_read(zl3073x, DPLL_MEAS_CTRL, &dpll_meas_ctrl, sizeof(dpll_meas_ctrl));
 	if (ret)
-		goto err;
+		goto err_unlock;
 
 	dpll_meas_ctrl |= 0b1;
 	ret = zl3073x_write(zl3073x, DPLL_MEAS_CTRL, &dpll_meas_ctrl, sizeof(dpll_meas_ctrl));
 	if (ret)
-		goto err;
+		goto err_unlock;
 
 	ret = zl3073x_write(zl3073x, DPLL_MEAS_IDX_REG, &dpll_meas_idx, sizeof(dpll_meas_idx));
 	if (ret)
-		goto err;
+		goto err_unlock;
 
 	ret = zl3073x_write(zl3073x, DPLL_REF_PHASE_ERR_RQST, &read_rqst, sizeof(read_rqst));
 	if (ret)
-		goto err;
-
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x,
-					val,
-					!(DPLL_REF_PHASE_ERR_RQST_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
-	if (ret)
-		goto err;
+		goto err_unlock;
 
-	ret = zl3073x_read(zl3073x, DPLL_REF_PHASE_ERR(ref_index), phase_err, sizeof(phase_err));
+	ret = zl3073x_poll(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x, val,
+			   !(DPLL_REF_PHASE_ERR_RQST_MASK & val));
 	if (ret)
-		goto err;
+		goto err_unlock;
 
-	mutex_unlock(zl3073x->lock);
+	ret = zl3073x_field_read_ref_phase_err(zl3073x, ref_index, phase_err);
 
-	phase_offset_reg_units = 0;
-	phase_offset_reg_units |= ((s64)phase_err[5] << 0);
-	phase_offset_reg_units |= ((s64)phase_err[4] << 8);
-	phase_offset_reg_units |= ((s64)phase_err[3] << 16);
-	phase_offset_reg_units |= ((s64)phase_err[2] << 24);
-	phase_offset_reg_units |= ((s64)phase_err[1] << 32);
-	phase_offset_reg_units |= ((s64)phase_err[0] << 40);
+err_unlock:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_MEAS);
 
+	return ret;
+}
 
-	/* Perform sign extension for a 48-bit signed value */
-	if (phase_offset_reg_units & (1LL << 47))
-		phase_offset_reg_units |= 0xFFFF000000000000;
+/* Phase offset in ps of @ref_index from its phase error register, given the
+ * connected reference of the DPLL and the monitor status of @ref_index
+ */
+static int zl3073x_dpll_phase_offset_calc(struct zl3073x *zl3073x, u8 ref_index,
+					  u8 connected_ref, u8 ref_status,
+					  s64 phase_offset_reg_units, s64 *phase_offset)
+{
+	u64 connected_ref_freq;
+	s64 phase_offset_ps;
+	u64 ref_freq;
+	int ret;
 
 	/* The register units are 0.01 ps, and the offset is returned in units of ps. */
 	phase_offset_ps = div_s64(phase_offset_reg_units, 100);
@@ -2860,6 +3151,38 @@ static int zl3073x_dpll_phase_offset_get(struct zl3073x *zl3073x, struct zl3073x
 	/* The dpll being locked to a higher freq than the current ref the phase offset
 	 * is modded to the period of the signal the dpll is locked to.
 	 */
+	if (ZL3073X_CHECK_REF_ID(zl3073x, connected_ref) && ZL3073X_CHECK_REF_ID(zl3073x, ref_index) &&
+			(connected_ref != ref_index) && DPLL_REF_MON_STATUS_QUALIFIED(ref_status)) {
+		ret = zl3073x_dpll_get_input_frequency(zl3073x, connected_ref, &connected_ref_freq);
+		if (ret)
+			return ret;
+
+		ret = zl3073x_dpll_get_input_frequency(zl3073x, ref_index, &ref_freq);
+		if (ret)
+			return ret;
+
+		phase_offset_ps = zl3073x_phase_offset_fold(phase_offset_ps, connected_ref_freq,
+							    ref_freq);
+	}
+
+	*phase_offset = phase_offset_ps;
+
+	return 0;
+}
+
+static int zl3073x_dpll_phase_offset_get(struct zl3073x *zl3073x, struct zl3073x_dpll *zl3073x_dpll,
+				u8 ref_index, s64 *phase_offset)
+{
+	s64 phase_offset_reg_units;
+	u8 connected_ref;
+	u8 ref_status;
+	int ret;
+
+	ret = zl3073x_ref_phase_err_read(zl3073x, zl3073x_dpll->index, ref_index,
+					 ZL3073X_LOCK_DPLL, &phase_offset_reg_units);
+	if (ret)
+		goto err;
+
 	ret = zl3073x_connected_ref_get(zl3073x, zl3073x_dpll->index, &connected_ref);
 	if (ret)
 		goto err;
@@ -2868,83 +3191,230 @@ static int zl3073x_dpll_phase_offset_get(struct zl3073x *zl3073x, struct zl3073x
 	if (ret)
 		goto err;
 
-	if (ZL3073X_CHECK_REF_ID(connected_ref) && ZL3073X_CHECK_REF_ID(ref_index) &&
-			(connected_ref != ref_index) && DPLL_REF_MON_STATUS_QUALIFIED(ref_status)) {
-		ret = zl3073x_dpll_get_input_frequency(zl3073x, connected_ref, &connected_ref_freq);
-		if (ret)
-			goto err;
+	ret = zl3073x_dpll_phase_offset_calc(zl3073x, ref_index, connected_ref, ref_status,
+					     phase_offset_reg_units, phase_offset);
+	if (ret)
+		goto err;
 
-		ret = zl3073x_dpll_get_input_frequency(zl3073x, ref_index, &ref_freq);
-		if (ret)
-			goto err;
+	return 0;
 
-		if (connected_ref_freq > ref_freq) {
-			connected_ref_period_ps = (s64)div64_u64(PSEC_PER_SEC, connected_ref_freq);
+err:
+	*phase_offset = 0;
 
-			phase_offset_div_factor = div64_s64(phase_offset_ps, connected_ref_period_ps);
-			phase_offset_ps = phase_offset_ps - (connected_ref_period_ps * phase_offset_div_factor);
-		}
+	return ret;
+}
+
+/* One servo iteration: measure the phase error of the reference, step it out
+ * if it is above the threshold, otherwise steer the DCO by the PI controller.
+ * A positive phase error means that the reference leads the DPLL, so the DCO
+ * is sped up.
+ */
+static int zl3073x_servo_sample(struct zl3073x_dpll *dpll)
+{
+	struct zl3073x_servo *servo = &dpll->servo;
+	struct zl3073x *zl3073x = dpll->zl3073x;
+	s64 max_ppt = (s64)dpll->info.max_adj * 1000;
+	s64 offset, freq;
+	u8 ref_status;
+	s64 err;
+	int ret;
+
+	lockdep_assert_held(&servo->lock);
+
+	ret = zl3073x_dpll_ref_status_get(zl3073x, servo->ref, &ref_status);
+	if (ret)
+		return ret;
+
+	/* Hold the last frequency while the 1PPS is missing */
+	if (!DPLL_REF_MON_STATUS_QUALIFIED(ref_status)) {
+		servo->unqualified++;
+		return 0;
 	}
 
-	*phase_offset = phase_offset_ps;
+	ret = zl3073x_ref_phase_err_read(zl3073x, dpll->index, servo->ref, ZL3073X_LOCK_PTP,
+					 &err);
+	if (ret)
+		return ret;
+
+	/* 0.01 ps units */
+	offset = div_s64(err, 100000);
+
+	servo->samples++;
+	servo->offset_ns = offset;
+	servo->offset_max_ns = max(servo->offset_max_ns, abs(offset));
+	servo->offset_sq_sum += offset * offset;
+
+	if (servo->step_ns && abs(offset) > servo->step_ns) {
+		servo->steps++;
+		return zl3073x_ptp_tie_write(dpll, offset);
+	}
+
+	servo->integral_ppt = clamp(servo->integral_ppt + servo->ki * offset, -max_ppt, max_ppt);
+	freq = clamp(servo->kp * offset + servo->integral_ppt, -max_ppt, max_ppt);
+
+	ret = zl3073x_ptp_dco_write(dpll, div_s64(freq * 65536, 1000000));
+	if (ret)
+		return ret;
+
+	servo->freq_ppt = freq;
 
 	return 0;
+}
 
-err:
-	mutex_unlock(zl3073x->lock);
-	*phase_offset = 0;
+static void zl3073x_servo_work(struct kthread_work *work)
+{
+	struct zl3073x_servo *servo = container_of(work, struct zl3073x_servo, work.work);
+	struct zl3073x_dpll *dpll = container_of(servo, struct zl3073x_dpll, servo);
+	struct zl3073x *zl3073x = dpll->zl3073x;
+	unsigned long delay = HZ;
+	struct timespec64 ts;
+	int ret;
+
+	mutex_lock(&servo->lock);
+
+	if (!servo->running)
+		goto out;
+
+	ret = zl3073x_servo_sample(dpll);
+	if (ret) {
+		servo->errors++;
+		servo->last_error = ret;
+	}
+
+	/* Run again shortly after the next second edge of the TOD */
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+	ret = _zl3073x_ptp_gettime64(dpll, &ts, ZL3073X_TOD_CTRL_CMD_READ, NULL);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+	if (!ret)
+		delay = nsecs_to_jiffies(NSEC_PER_SEC - ts.tv_nsec) +
+			msecs_to_jiffies(ZL3073X_SERVO_EDGE_DELAY_MS);
+
+	kthread_queue_delayed_work(servo->kworker, &servo->work, delay);
+
+out:
+	mutex_unlock(&servo->lock);
+}
+
+/* Start steering the DPLL to @ref. The servo takes over the frequency and
+ * phase of the clock; adjfine, adjphase and adjtime return -EBUSY until it
+ * is stopped.
+ */
+static int zl3073x_servo_start(struct zl3073x_dpll *dpll, u8 ref)
+{
+	struct zl3073x_servo *servo = &dpll->servo;
+	struct kthread_worker *kworker;
+	int ret = 0;
+
+	mutex_lock(&servo->lock);
+
+	if (servo->running) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	kworker = kthread_run_worker(0, "zl3073x-servo-%s", dev_name(dpll->zl3073x->dev));
+	if (IS_ERR(kworker)) {
+		ret = PTR_ERR(kworker);
+		goto out;
+	}
+	sched_set_fifo_low(kworker->task);
+
+	servo->kworker = kworker;
+	servo->ref = ref;
+	servo->integral_ppt = 0;
+	servo->samples = 0;
+	servo->steps = 0;
+	servo->unqualified = 0;
+	servo->errors = 0;
+	servo->last_error = 0;
+	servo->offset_ns = 0;
+	servo->freq_ppt = 0;
+	servo->offset_max_ns = 0;
+	servo->offset_sq_sum = 0;
+
+	/* An adjfine or slew that got the DCO lock first is stopped below, any
+	 * later one sees the servo running
+	 */
+	mutex_lock(&dpll->dco.lock);
+	WRITE_ONCE(servo->running, true);
+	mutex_unlock(&dpll->dco.lock);
+
+	zl3073x_dco_stop(dpll);
 
+	kthread_queue_delayed_work(kworker, &servo->work, 0);
+
+out:
+	mutex_unlock(&servo->lock);
 	return ret;
 }
 
+/* The DCO keeps the last frequency the servo applied */
+static void zl3073x_servo_stop(struct zl3073x_dpll *dpll)
+{
+	struct zl3073x_servo *servo = &dpll->servo;
+	struct kthread_worker *kworker;
+
+	mutex_lock(&servo->lock);
+	kworker = servo->kworker;
+	servo->kworker = NULL;
+	WRITE_ONCE(servo->running, false);
+
+	/* adjfine ramps from where the servo left the DCO */
+	if (kworker) {
+		mutex_lock(&dpll->dco.lock);
+		dpll->dco.cur = div_s64(servo->freq_ppt * 65536, 1000000);
+		dpll->dco.target = dpll->dco.cur;
+		mutex_unlock(&dpll->dco.lock);
+	}
+	mutex_unlock(&servo->lock);
+
+	if (!kworker)
+		return;
+
+	kthread_cancel_delayed_work_sync(&servo->work);
+	kthread_destroy_worker(kworker);
+}
+
 static int zl3073x_dpll_input_esync_get(struct zl3073x *zl3073x, int dpll_index,
 			int pin_index, struct dpll_pin_esync *esync)
 {
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_sync_ctrl, 0),
+		ZL3073X_FIELD_REQ(ref_esync_div, 0),
+	};
 	struct dpll_pin_esync input_esync;
 	u8 esync_enabled;
-	u8 ref_sync_ctrl;
 	u8 esync_pulse;
 	u64 esync_freq;
 	u8 esync_mode;
 	u32 esync_div;
-	u8 buf[4];
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
 
 	/* Wait for the mailbox semaphore */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_wait(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	/* Setup reference */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin_index);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_ref_mb, BIT(pin_index));
 
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	/* get the esync mode and map it to a pulse width */
-	ret = zl3073x_read(zl3073x, DPLL_REF_SYNC_CTRL, &ref_sync_ctrl, sizeof(ref_sync_ctrl));
-
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
-	esync_mode = DPLL_REF_SYNC_CTRL_MODE_GET(ref_sync_ctrl);
+	/* get the esync mode and map it to a pulse width */
+	esync_mode = DPLL_REF_SYNC_CTRL_MODE_GET(req[0].val);
 	esync_enabled = (esync_mode == ZL3073X_CLOCK_50_50_ESYNC_25_75);
 
 	if (esync_enabled)
@@ -2952,17 +3422,7 @@ static int zl3073x_dpll_input_esync_get(struct zl3073x *zl3073x, int dpll_index,
 	else
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_REF_ESYNC_DIV_REG, buf, DPLL_REF_ESYNC_DIV_SIZE);
-
-	if (ret)
-		goto out;
-
-	esync_div = 0;
-	esync_div |= ((u32)buf[3] << 0);
-	esync_div |= ((u32)buf[2] << 8);
-	esync_div |= ((u32)buf[1] << 16);
-	esync_div |= ((u32)buf[0] << 24);
+	esync_div = req[1].val;
 
 	/* The driver currently only supports embedding a 1 Hz pulse
 	 * An esync div of 0 represents 1 Hz.
@@ -2987,7 +3447,7 @@ out:
 
 	*esync = input_esync;
 
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
 	return ret;
 }
 
@@ -2998,11 +3458,9 @@ static int zl3073x_dpll_input_esync_set(struct zl3073x *zl3073x, int dpll_index,
 	u8 valid_input_freq = 0;
 	u8 ref_sync_ctrl;
 	u32 esync_div;
-	u8 buf[4];
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_REF_MB, ZL3073X_LOCK_DPLL);
 
 	for (int i = 0; i < ARRAY_SIZE(freq_range_esync); i++) {
 		if (freq_range_esync[i].min <= freq && freq_range_esync[i].max >= freq)
@@ -3015,31 +3473,16 @@ static int zl3073x_dpll_input_esync_set(struct zl3073x *zl3073x, int dpll_index,
 	}
 
 	/* Wait for the mailbox semaphore */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_wait(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	/* Setup reference */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin_index);
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_MASK, buf, DPLL_DPLL_MB_MASK_SIZE);
-	if (ret)
-		goto out;
-
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_ref_mb, BIT(pin_index));
 	if (ret)
 		goto out;
 
-	/* Wait for the mailbox semaphore */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_RD);
 
 	if (ret)
 		goto out;
@@ -3064,34 +3507,18 @@ static int zl3073x_dpll_input_esync_set(struct zl3073x *zl3073x, int dpll_index,
 		/* Note that esync_div=0 means esync freq is 1Hz, the only supported freq currently */
 		esync_div = 0;
 
-		memset(buf, 0, sizeof(buf));
-		buf[3] = (esync_div & 0xFF000000) >> 24;
-		buf[2] = (esync_div & 0xFF0000) >> 16;
-		buf[1] = (esync_div & 0xFF00) >> 8;
-		buf[0] = (esync_div & 0xFF) >> 0;
-		ret = zl3073x_write(zl3073x, DPLL_REF_ESYNC_DIV_REG, buf, DPLL_REF_ESYNC_DIV_SIZE);
-
+		ret = zl3073x_field_write_ref_esync_div(zl3073x, 0, esync_div);
 		if (ret)
 			goto out;
 	}
 
-	/* Write the mailbox changes back to memory */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_REF_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_REF_MB_SEM, buf, DPLL_REF_MB_SEM_SIZE);
-	if (ret)
-		goto out;
-
-	/* Confirm the write was successful */
-	ret = readx_poll_timeout_atomic(zl3073x_ref_mb_sem, zl3073x, val,
-					!(DPLL_REF_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_ref_mb, DPLL_REF_MB_SEM_WR);
 
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_REF_MB);
 	return ret;
 }
 
@@ -3099,6 +3526,12 @@ static int zl3073x_dpll_output_esync_get(struct zl3073x *zl3073x, struct zl3073x
 			int pin_index, struct dpll_pin_esync *esync)
 {
 	enum zl3073x_output_freq_type_t freq_type = output_freq_type_per_output[pin_index / 2];
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(output_mode, 0),
+		ZL3073X_FIELD_REQ(output_div, 0),
+		ZL3073X_FIELD_REQ(output_esync_div, 0),
+		ZL3073X_FIELD_REQ(output_esync_width, 0),
+	};
 	struct dpll_pin_esync output_esync;
 	u32 half_pulse_width;
 	u32 esync_pulse_width;
@@ -3112,48 +3545,32 @@ static int zl3073x_dpll_output_esync_get(struct zl3073x *zl3073x, struct zl3073x
 	u8 clock_type;
 	u32 esync_div;
 	u8 synth;
-	u8 buf[4];
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
 
 	/* Mailbox setup */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, zl3073x_dpll, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_wait(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin_index / 2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, BIT(pin_index / 2));
 
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	/* Wait for comfirmation that the mailbox can be read */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, zl3073x_dpll, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
-
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
 	/* Check if esync is enabled */
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_MODE, &output_mode, sizeof(output_mode));
-
-	if (ret)
-		goto out;
+	output_mode = req[0].val;
 
 	clock_type = DPLL_OUTPUT_MODE_CLOCK_TYPE_GET(output_mode);
 	signal_format = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(output_mode);
@@ -3181,52 +3598,22 @@ static int zl3073x_dpll_output_esync_get(struct zl3073x *zl3073x, struct zl3073x
 		goto out;
 
 	/* Get the embedded esync frequency */
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
-
-	if (ret)
-		goto out;
+	output_div = req[1].val;
+	esync_div = req[2].val;
 
-	output_div = 0;
-	output_div |= ((u32)buf[3] << 0);
-	output_div |= ((u32)buf[2] << 8);
-	output_div |= ((u32)buf[1] << 16);
-	output_div |= ((u32)buf[0] << 24);
-
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
-
-	if (ret)
-		goto out;
-
-	esync_div = 0;
-	esync_div |= ((u32)buf[3] << 0);
-	esync_div |= ((u32)buf[2] << 8);
-	esync_div |= ((u32)buf[1] << 16);
-	esync_div |= ((u32)buf[0] << 24);
-
-	ret = zl3073x_synth_get(zl3073x, pin_index, &synth);
+	ret = zl3073x_synth_get(zl3073x, pin_index / 2, &synth);
 
 	if (ret)
 		goto out;
 
-	ret = _zl3073x_ptp_get_synth_freq(zl3073x_dpll, synth, &synth_freq);
+	ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &synth_freq);
 	if (ret)
 		goto out;
 
 	esync_freq = div_u64(div_u64(synth_freq, output_div), esync_div);
 
-	/* Get the esync pulse width in units of half synth cycles */
-	memset(buf, 0, sizeof(buf));
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG, buf, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE);
-	if (ret)
-		goto out;
-
-	esync_pulse_width = 0;
-	esync_pulse_width |= ((u32)buf[3] << 0);
-	esync_pulse_width |= ((u32)buf[2] << 8);
-	esync_pulse_width |= ((u32)buf[1] << 16);
-	esync_pulse_width |= ((u32)buf[0] << 24);
+	/* The esync pulse width is in units of half synth cycles */
+	esync_pulse_width = req[3].val;
 
 	/* By comparing the esync_pulse_width to the half of the pulse width the
 	 * esync pulse percentage can be determined. Note that half pulse
@@ -3237,7 +3624,7 @@ static int zl3073x_dpll_output_esync_get(struct zl3073x *zl3073x, struct zl3073x
 	esync_pulse = (50 * esync_pulse_width) / half_pulse_width;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 
 	if (esync_enabled) {
 		output_esync.freq = esync_freq;
@@ -3278,19 +3665,21 @@ static int zl3073x_dpll_output_esync_set(struct zl3073x *zl3073x, struct zl3073x
 {
 	enum zl3073x_output_freq_type_t freq_type = output_freq_type_per_output[pin_index / 2];
 	enum zl3073x_output_mode_clock_type_t clock_type;
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(output_mode, 0),
+		ZL3073X_FIELD_REQ(output_div, 0),
+	};
 	u8 valid_input_freq = 0;
+	u32 esync_pulse;
 	u8 signal_format;
 	u8 output_mode;
-	u8 esync_pulse;
 	u64 synth_freq;
 	u32 output_div;
 	u32 esync_div;
-	u8 buf[4];
 	u8 synth;
 	int ret;
-	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
 
 	if (freq_type == ZL3073X_PTP) {
 		for (int i = 0; i < ARRAY_SIZE(freq_range_esync); i++) {
@@ -3315,39 +3704,27 @@ static int zl3073x_dpll_output_esync_set(struct zl3073x *zl3073x, struct zl3073x
 	}
 
 	/* Make sure nothing else is using the mailbox */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, zl3073x_dpll, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_wait(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
 
 	if (ret)
 		goto out;
 
-	/* Setup output pin mask */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = BIT(pin_index / 2);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_MASK, buf, DPLL_OUTPUT_MB_MASK_SIZE);
+	ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, BIT(pin_index / 2));
 	if (ret)
 		goto out;
 
-	/* Select read command */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_RD;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_RD);
+
 	if (ret)
 		goto out;
 
-	/* Wait for comfirmation that the mailbox can be read */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, zl3073x_dpll, val,
-					!(DPLL_OUTPUT_MB_SEM_RD & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
-
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
 	/* Check if esync is enabled */
-	ret = zl3073x_read(zl3073x, DPLL_OUTPUT_MODE, &output_mode, sizeof(output_mode));
-	if (ret)
-		goto out;
+	output_mode = req[0].val;
+	output_div = req[1].val;
 
 	signal_format = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(output_mode);
 
@@ -3365,40 +3742,23 @@ static int zl3073x_dpll_output_esync_set(struct zl3073x *zl3073x, struct zl3073x
 	/* overwrite the clock type */
 	output_mode &= GENMASK(7, 3);
 	output_mode |= DPLL_OUTPUT_MODE_CLOCK_TYPE_GET(clock_type);
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MODE, &output_mode, sizeof(output_mode));
+	ret = zl3073x_field_write_output_mode(zl3073x, 0, output_mode);
 	if (ret)
 		goto out;
 
 	if (freq > 0) {
-		/* output_div is useful for several calculations */
-		memset(buf, 0, sizeof(buf));
-		ret = zl3073x_read(zl3073x, DPLL_OUTPUT_DIV, buf, DPLL_OUTPUT_DIV_SIZE);
+		/* esync is now enabled so set the esync_div to get the desired frequency */
+		ret = zl3073x_synth_get(zl3073x, pin_index / 2, &synth);
 		if (ret)
 			goto out;
 
-		output_div = 0;
-		output_div |= ((u32)buf[3] << 0);
-		output_div |= ((u32)buf[2] << 8);
-		output_div |= ((u32)buf[1] << 16);
-		output_div |= ((u32)buf[0] << 24);
-
-		/* esync is now enabled so set the esync_div to get the desired frequency */
-		ret = zl3073x_synth_get(zl3073x, pin_index, &synth);
-		if (ret)
-			goto out;
-
-		ret = _zl3073x_ptp_get_synth_freq(zl3073x_dpll, synth, &synth_freq);
+		ret = zl3073x_synth_freq_get(zl3073x, synth, ZL3073X_LOCK_DPLL, &synth_freq);
 		if (ret)
 			goto out;
 
 		esync_div = (u32)div_u64(synth_freq, (output_div * freq));
 
-		memset(buf, 0, sizeof(buf));
-		buf[3] = (esync_div & 0xFF000000) >> 24;
-		buf[2] = (esync_div & 0xFF0000) >> 16;
-		buf[1] = (esync_div & 0xFF00) >> 8;
-		buf[0] = (esync_div & 0xFF) >> 0;
-		ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_DIV_REG, buf, DPLL_OUTPUT_ESYNC_DIV_SIZE);
+		ret = zl3073x_field_write_output_esync_div(zl3073x, 0, esync_div);
 		if (ret)
 			goto out;
 
@@ -3409,95 +3769,108 @@ static int zl3073x_dpll_output_esync_set(struct zl3073x *zl3073x, struct zl3073x
 		 */
 		esync_pulse = output_div / 2;
 
-		memset(buf, 0, sizeof(buf));
-		buf[3] = (esync_pulse & 0xFF000000) >> 24;
-		buf[2] = (esync_pulse & 0xFF0000) >> 16;
-		buf[1] = (esync_pulse & 0xFF00) >> 8;
-		buf[0] = (esync_pulse & 0xFF) >> 0;
-		ret = zl3073x_write(zl3073x, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG, buf, DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE);
+		ret = zl3073x_field_write_output_esync_width(zl3073x, 0, esync_pulse);
 		if (ret)
 			goto out;
 	}
 
-	/* Write the changes to the mailbox */
-	memset(buf, 0, sizeof(buf));
-	buf[0] = DPLL_OUTPUT_MB_SEM_WR;
-	ret = zl3073x_write(zl3073x, DPLL_OUTPUT_MB_SEM, buf, DPLL_OUTPUT_MB_SEM_SIZE);
-	if (ret)
-		goto out;
-
-	/* Wait for the command to actually finish */
-	ret = readx_poll_timeout_atomic(zl3073x_ptp_output_mb_sem, zl3073x_dpll,
-					val,
-					!(DPLL_OUTPUT_MB_SEM_WR & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
 	if (ret)
 		goto out;
 
 out:
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
 	return ret;
 }
 
+/* The status registers of the reference and the DPLL are read in one batch,
+ * page by page; only automatic mode needs the priority from the mailbox.
+ */
 static int zl3073x_input_pin_state_get(struct zl3073x *zl3073x, int dpll_index,
 					int ref_index, enum dpll_pin_state *state)
 {
-	u8 selected_ref_index;
-	u8 forced_ref_index;
-	int ref_priority;
+	int override = READ_ONCE(zl3073x->ref_mon_status_override[ref_index]);
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_mon_status, ref_index),
+		ZL3073X_FIELD_REQ(dpll_mode_refsel, dpll_index),
+		ZL3073X_FIELD_REQ(dpll_lock_refsel_status, dpll_index),
+	};
+	u32 ref_priority = DPLL_REF_PRIORITY_INVALID;
 	u8 ref_status;
 	int ret = 0;
 	u8 mode;
 
-	ret = zl3073x_dpll_ref_status_get(zl3073x, ref_index, &ref_status);
-
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
 	if (ret)
 		goto out;
 
+	ref_status = override != ZL3073X_REF_MON_STATUS_NO_OVERRIDE ? override : req[0].val;
 	if (!DPLL_REF_MON_STATUS_QUALIFIED(ref_status)) {
 		*state = DPLL_PIN_STATE_DISCONNECTED;
 		goto out;
 	}
 
-	ret = zl3073x_dpll_raw_mode_get(zl3073x, dpll_index, &mode);
-	if (ret)
-		goto out;
-
-	ret = zl3073x_dpll_forced_ref_get(zl3073x, dpll_index, &forced_ref_index);
-	if (ret)
-		goto out;
-
+	mode = DPLL_MODE_REFSEL_MODE_GET(req[1].val);
 	if (mode == ZL3073X_MODE_AUTO_LOCK) {
-		ret = zl3073x_dpll_ref_selected_get(zl3073x, dpll_index, &selected_ref_index);
-
-		if (ret)
-			goto out;
-
 		ret = zl3073x_dpll_get_priority_ref(zl3073x, dpll_index, ref_index, &ref_priority);
 
 		if (ret)
 			goto out;
-
-		if (ref_index == selected_ref_index)
-			*state = DPLL_PIN_STATE_CONNECTED;
-		else if (ref_priority != DPLL_REF_PRIORITY_INVALID)
-			*state = DPLL_PIN_STATE_SELECTABLE;
-		else
-			*state = DPLL_PIN_STATE_DISCONNECTED;
-	} else if (ref_index == forced_ref_index)  {
-
-		*state = DPLL_PIN_STATE_CONNECTED;
-	} else {
-		*state = DPLL_PIN_STATE_DISCONNECTED;
 	}
 
+	*state = zl3073x_input_pin_state_from_raw(mode, ref_index,
+						  DPLL_LOCK_REFSEL_REF_GET(req[2].val),
+						  DPLL_MODE_REFSEL_REF_GET(req[1].val),
+						  ref_priority);
+
 out:
 	return ret;
 }
 
+static bool zl3073x_output_format_pin_enabled(u8 format, int output_index)
+{
+	switch (format) {
+	case ZL3073X_BOTH_DISABLED:
+		return false;
+	case ZL3073X_P_ENABLE:
+		return ZL3073X_P_PIN(output_index);
+	case ZL3073X_N_ENABLE:
+		return ZL3073X_N_PIN(output_index);
+	default:
+		return true;
+	}
+}
+
+/* Signal format of a pair with one of its pins switched on or off. The two
+ * pins of a differential or an N divided pair cannot be switched on their own.
+ */
+static u8 zl3073x_output_format_set(u8 format, int output_index, bool enable)
+{
+	switch (zl3073x_output_pin_type[output_index / 2]) {
+	case ZL3073X_DIFFERENTIAL:
+		return enable ? ZL3073X_BOTH_ENABLED : ZL3073X_BOTH_DISABLED;
+	case ZL3073X_SINGLE_ENDED_DIVIDED:
+		if (!enable)
+			return ZL3073X_BOTH_DISABLED;
+		if (format == ZL3073X_N_DIVIDED || format == ZL3073X_N_DIVIDED_AND_INVERTED)
+			return format;
+		return ZL3073X_N_DIVIDED;
+	default:
+		if (enable)
+			return _zl3073x_ptp_enable_pin(format, output_index);
+		return _zl3073x_ptp_disable_pin(format, output_index);
+	}
+}
+
+/* An output is connected to a DPLL when the synth driving it follows that
+ * DPLL and the output is enabled. A request that is not applied yet counts as
+ * applied.
+ */
 static int zl3073x_output_pin_state_get(struct zl3073x *zl3073x, int dpll_index,
 				int output_index, enum dpll_pin_state *state)
 {
+	struct zl3073x_output_state *out = &zl3073x->out_state;
+	bool enabled;
 	u8 synth_dpll;
 	u8 synth;
 	int ret;
@@ -3505,7 +3878,7 @@ static int zl3073x_output_pin_state_get(struct zl3073x *zl3073x, int dpll_index,
 	*state = DPLL_PIN_STATE_DISCONNECTED;
 
 
-	ret = zl3073x_synth_get(zl3073x, (output_index / 2), &synth);
+	ret = zl3073x_synth_get(zl3073x, output_index / 2, &synth);
 
 	if (ret)
 		goto out;
@@ -3515,31 +3888,245 @@ static int zl3073x_output_pin_state_get(struct zl3073x *zl3073x, int dpll_index,
 		if (ret)
 			goto out;
 
-		if (synth_dpll == dpll_index)
+		if (synth_dpll != dpll_index)
+			goto out;
+
+		spin_lock(&out->lock);
+		if (out->pending & BIT(output_index))
+			enabled = out->enable & BIT(output_index);
+		else
+			enabled = zl3073x_output_format_pin_enabled(READ_ONCE(out->format[output_index / 2]),
+								    output_index);
+		spin_unlock(&out->lock);
+
+		if (enabled)
 			*state = DPLL_PIN_STATE_CONNECTED;
 	}
 out:
 	return ret;
 }
 
+/* Apply the pending output state requests. Every pair with a request is read
+ * through the output mailbox and its new register image computed; pairs whose
+ * images are then identical are committed together by one write command with
+ * all of them selected, since the command copies the whole mailbox to every
+ * selected pair.
+ *
+ * Requests that fail stay pending and are retried in the next window, up to
+ * ZL3073X_OUTPUT_STATE_RETRIES times. Without a worker they are dropped and
+ * the error returned.
+ */
+static int zl3073x_output_state_apply(struct zl3073x *zl3073x)
+{
+	u8 image[ZL3073X_MAX_OUTPUT_PIN_PAIRS][ZL3073X_OUTPUT_MB_IMAGE_SIZE];
+	struct zl3073x_output_state *out = &zl3073x->out_state;
+	int pairs = zl3073x->info->num_outputs / 2;
+	u32 pending, enable, changed, failed;
+	u16 todo = 0, group;
+	bool retry = false;
+	u32 done = 0;
+	int last = -1;
+	int ret = 0;
+	u8 format;
+	int i, j;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
+
+	spin_lock(&out->lock);
+	pending = out->pending;
+	enable = out->enable;
+	spin_unlock(&out->lock);
+
+	for (i = 0; i < pairs; i++) {
+		if (!(pending & (BIT(2 * i) | BIT(2 * i + 1))))
+			continue;
+
+		ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(i), DPLL_OUTPUT_MB_SEM_RD);
+		if (ret)
+			goto out;
+
+		ret = zl3073x_read(zl3073x, DPLL_OUTPUT_MODE, image[i], sizeof(image[i]));
+		if (ret)
+			goto out;
+		last = i;
+
+		format = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(image[i][0]);
+		for (j = 2 * i; j < 2 * i + 2; j++)
+			if (pending & BIT(j))
+				format = zl3073x_output_format_set(format, j, enable & BIT(j));
+
+		if (format == DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(image[i][0])) {
+			WRITE_ONCE(out->format[i], format);
+			done |= pending & (BIT(2 * i) | BIT(2 * i + 1));
+			continue;
+		}
+
+		image[i][0] &= ~DPLL_OUTPUT_MODE_SIGNAL_FORMAT_MASK;
+		image[i][0] |= DPLL_OUTPUT_MODE_SIGNAL_FORMAT(format);
+		todo |= BIT(i);
+	}
+
+	for (i = 0; i < pairs; i++) {
+		if (!(todo & BIT(i)))
+			continue;
+
+		group = BIT(i);
+		for (j = i + 1; j < pairs; j++)
+			if ((todo & BIT(j)) && !memcmp(image[i], image[j], sizeof(image[i])))
+				group |= BIT(j);
+		todo &= ~group;
+
+		/* The mailbox holds the pair read last */
+		if (i != last) {
+			ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(i),
+					      DPLL_OUTPUT_MB_SEM_RD);
+			if (ret)
+				goto out;
+		}
+		last = -1;
+
+		ret = zl3073x_field_write_output_mode(zl3073x, 0, image[i][0]);
+		if (ret)
+			goto out;
+
+		ret = zl3073x_mb_select(zl3073x, &zl3073x_output_mb, group);
+		if (ret)
+			goto out;
+
+		ret = zl3073x_mb_cmd(zl3073x, &zl3073x_output_mb, DPLL_OUTPUT_MB_SEM_WR);
+		if (ret)
+			goto out;
+
+		format = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(image[i][0]);
+		for (j = i; j < pairs; j++) {
+			if (group & BIT(j)) {
+				WRITE_ONCE(out->format[j], format);
+				done |= pending & (BIT(2 * j) | BIT(2 * j + 1));
+			}
+		}
+	}
+
+out:
+	/* Requests that arrived meanwhile stay pending for the next run, as do
+	 * failed ones while they have retries left
+	 */
+	spin_lock(&out->lock);
+	changed = out->enable ^ enable;
+	out->pending &= ~(done & ~changed);
+	failed = out->pending & pending & ~changed;
+	if (!failed) {
+		out->retries = 0;
+	} else if (out->kworker && ++out->retries < ZL3073X_OUTPUT_STATE_RETRIES) {
+		kthread_queue_delayed_work(out->kworker, &out->work, ZL3073X_OUTPUT_STATE_WINDOW);
+		retry = true;
+	} else {
+		out->pending &= ~failed;
+		out->retries = 0;
+	}
+	spin_unlock(&out->lock);
+
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
+
+	if (ret)
+		dev_err_ratelimited(zl3073x->dev, "failed to apply output states: %d%s\n", ret,
+				    retry ? ", retrying" : "");
+
+	return ret;
+}
+
+static void zl3073x_output_state_work(struct kthread_work *work)
+{
+	struct zl3073x_output_state *out = container_of(work, struct zl3073x_output_state,
+							work.work);
+
+	zl3073x_output_state_apply(container_of(out, struct zl3073x, out_state));
+}
+
+/* Queue a state request of an output. The first request of a window starts
+ * it, all requests within it are applied together when it ends. Without a
+ * worker the request is applied at once, and its error returned.
+ */
+static int zl3073x_output_state_request(struct zl3073x *zl3073x, int output_index,
+					bool enable)
+{
+	struct zl3073x_output_state *out = &zl3073x->out_state;
+	bool now;
+
+	spin_lock(&out->lock);
+	out->pending |= BIT(output_index);
+	if (enable)
+		out->enable |= BIT(output_index);
+	else
+		out->enable &= ~BIT(output_index);
+	now = !out->kworker;
+	if (!now)
+		kthread_queue_delayed_work(out->kworker, &out->work, ZL3073X_OUTPUT_STATE_WINDOW);
+	spin_unlock(&out->lock);
+
+	if (now)
+		return zl3073x_output_state_apply(zl3073x);
+
+	return 0;
+}
+
+/* Read the signal format of every output pair */
+static int zl3073x_output_state_init(struct zl3073x *zl3073x)
+{
+	struct zl3073x_output_state *out = &zl3073x->out_state;
+	u8 mode;
+	int ret = 0;
+	int i;
+
+	spin_lock_init(&out->lock);
+	kthread_init_delayed_work(&out->work, zl3073x_output_state_work);
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_OUTPUT_MB, ZL3073X_LOCK_DPLL);
+
+	for (i = 0; i < zl3073x->info->num_outputs / 2; i++) {
+		ret = zl3073x_mb_read(zl3073x, &zl3073x_output_mb, BIT(i), DPLL_OUTPUT_MB_SEM_RD);
+		if (ret)
+			break;
+
+		ret = zl3073x_field_read_output_mode(zl3073x, 0, &mode);
+		if (ret)
+			break;
+
+		out->format[i] = DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(mode);
+	}
+
+	zl3073x_unlock(zl3073x, ZL3073X_RES_OUTPUT_MB);
+
+	return ret;
+}
+
+/* Requests from here on are applied at once; pending ones are applied now */
+static void zl3073x_output_state_stop(struct zl3073x *zl3073x)
+{
+	struct zl3073x_output_state *out = &zl3073x->out_state;
+
+	spin_lock(&out->lock);
+	out->kworker = NULL;
+	spin_unlock(&out->lock);
+
+	if (kthread_cancel_delayed_work_sync(&out->work))
+		zl3073x_output_state_apply(zl3073x);
+}
+
 static int zl3073x_dpll_ffo_get(struct zl3073x *zl3073x, u8 dpll_index, u8 ref_index, s64 *ffo)
 {
 	u8 dpll_select_mask = (dpll_index) << DPLL_MEAS_REF_FREQ_MASK_SHIFT;
 	u8 freq_meas_request = 0b11;
 	u8 dpll_meas_ref_freq_ctrl;
 	u8 freq_meas_enable = 0b1;
-	s64 freq_offset_reg;
+	s32 freq_offset_reg;
 	u8 ref_select_mask;
-	u8 freq_err[4];
 	int ret;
 	int val;
 
-	mutex_lock(zl3073x->lock);
+	zl3073x_lock(zl3073x, ZL3073X_RES_MEAS, ZL3073X_LOCK_DPLL);
 
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_ref_freq_meas_op, zl3073x,
-					val,
-					!(REF_FREQ_MEAS_CTRL_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
 	if (ret)
 		goto err;
 
@@ -3573,39 +4160,167 @@ static int zl3073x_dpll_ffo_get(struct zl3073x *zl3073x, u8 dpll_index, u8 ref_i
 	if (ret)
 		goto err;
 
-	ret = readx_poll_timeout_atomic(zl3073x_dpll_ref_freq_meas_op, zl3073x,
-					val,
-					!(REF_FREQ_MEAS_CTRL_MASK & val),
-					READ_SLEEP_US, READ_TIMEOUT_US);
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
 	if (ret)
 		goto err;
 
-	ret = zl3073x_read(zl3073x, DPLL_REF_FREQ_ERR(ref_index), freq_err, sizeof(freq_err));
+	/* register units for FFO are 2^-32 signed */
+	ret = zl3073x_field_read_ref_freq_err(zl3073x, ref_index, &freq_offset_reg);
 	if (ret)
 		goto err;
 
-	mutex_unlock(zl3073x->lock);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_MEAS);
 
-	/* register units for FFO are 2^-32 signed */
-	freq_offset_reg = 0;
-	freq_offset_reg |= ((s64)freq_err[3] << 0);
-	freq_offset_reg |= ((s64)freq_err[2] << 8);
-	freq_offset_reg |= ((s64)freq_err[1] << 16);
-	freq_offset_reg |= ((s64)freq_err[0] << 24);
+	*ffo = freq_offset_reg;
+
+	return ret;
+
+err:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_MEAS);
+	*ffo = 0;
+
+	return ret;
+}
+
+/* The FFO of every reference against DPLL @dpll_index in 2^-32, from a single
+ * measurement of all of them
+ */
+static int zl3073x_ref_ffo_measure_all(struct zl3073x *zl3073x, u8 dpll_index, s32 *ffo)
+{
+	struct zl3073x_field_req req[ZL3073X_MAX_INPUT_PINS];
+	u8 ctrl = (dpll_index << DPLL_MEAS_REF_FREQ_MASK_SHIFT) | 0b1;
+	u16 refs = GENMASK(zl3073x->info->num_refs - 1, 0);
+	/* zl3073x_write() takes the value LSB first, and MASK_4 is the LSB */
+	u8 mask[2] = { refs >> 8, refs & 0xff };
+	u8 request = 0b11;
+	int ret;
+	int val;
+
+	for (int i = 0; i < zl3073x->info->num_refs; i++)
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(ref_freq_err, i);
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_MEAS, ZL3073X_LOCK_DPLL);
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, DPLL_MEAS_REF_FREQ_CTRL, &ctrl, sizeof(ctrl));
+	if (ret)
+		goto out;
 
+	/* Both mask registers in one transfer */
+	ret = zl3073x_write(zl3073x, REF_FREQ_MEAS_MASK_3_0, mask, sizeof(mask));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, REF_FREQ_MEAS_CTRL, &request, sizeof(request));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
+	if (ret)
+		goto out;
 
-	/* Perform sign extension for a 32-bit signed value */
-	if (freq_err[0] & 0x80)
-		freq_offset_reg |= 0xFFFFFFFF00000000LL;
+	ret = zl3073x_field_read_batch(zl3073x, req, zl3073x->info->num_refs);
+	if (ret)
+		goto out;
 
-	*ffo = (s64)freq_offset_reg;
+	for (int i = 0; i < zl3073x->info->num_refs; i++)
+		ffo[i] = (s32)req[i].val;
 
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_MEAS);
 	return ret;
+}
 
-err:
-	mutex_unlock(zl3073x->lock);
-	*ffo = 0;
+/* Phase error (0.01 ps) and FFO (2^-32) of @ref_index against @dpll_index.
+ * The two measurements are independent, so they run side by side with their
+ * accesses grouped by page: both requests and polls are on 0x200, only the
+ * selection of the measured DPLL is on 0x280, and the FFO result on 0x100 is
+ * read last, after the phase error on 0x200.
+ */
+static int zl3073x_ref_meas_read(struct zl3073x *zl3073x, u8 dpll_index, u8 ref_index,
+				 s64 *phase_err, s32 *ffo)
+{
+	struct zl3073x_field_req req[] = {
+		ZL3073X_FIELD_REQ(ref_phase_err, ref_index),
+		ZL3073X_FIELD_REQ(ref_freq_err, ref_index),
+	};
+	u8 freq_ctrl = (dpll_index << DPLL_MEAS_REF_FREQ_MASK_SHIFT) | 0b1;
+	u16 refs = BIT(ref_index);
+	/* zl3073x_write() takes the value LSB first, and MASK_4 is the LSB */
+	u8 mask[2] = { refs >> 8, refs & 0xff };
+	u8 meas_idx = dpll_index & DPLL_MEAS_IDX_MASK;
+	u8 freq_rqst = 0b11;
+	u8 phase_rqst = 0b1;
+	u8 meas_ctrl;
+	int ret;
+	int val;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_MEAS, ZL3073X_LOCK_DPLL);
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x, val,
+			   !(DPLL_REF_PHASE_ERR_RQST_MASK & val));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, DPLL_MEAS_REF_FREQ_CTRL, &freq_ctrl, sizeof(freq_ctrl));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, REF_FREQ_MEAS_MASK_3_0, mask, sizeof(mask));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, REF_FREQ_MEAS_CTRL, &freq_rqst, sizeof(freq_rqst));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_read(zl3073x, DPLL_MEAS_CTRL, &meas_ctrl, sizeof(meas_ctrl));
+	if (ret)
+		goto out;
+
+	meas_ctrl |= 0b1;
+	ret = zl3073x_write(zl3073x, DPLL_MEAS_CTRL, &meas_ctrl, sizeof(meas_ctrl));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, DPLL_MEAS_IDX_REG, &meas_idx, sizeof(meas_idx));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_write(zl3073x, DPLL_REF_PHASE_ERR_RQST, &phase_rqst, sizeof(phase_rqst));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_phase_err_rqst_op, zl3073x, val,
+			   !(DPLL_REF_PHASE_ERR_RQST_MASK & val));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_poll(zl3073x_dpll_ref_freq_meas_op, zl3073x, val,
+			   !(REF_FREQ_MEAS_CTRL_MASK & val));
+	if (ret)
+		goto out;
+
+	ret = zl3073x_field_read_batch(zl3073x, req, ARRAY_SIZE(req));
+	if (ret)
+		goto out;
+
+	*phase_err = req[0].val;
+	*ffo = (s32)req[1].val;
 
+out:
+	zl3073x_unlock(zl3073x, ZL3073X_RES_MEAS);
 	return ret;
 }
 
@@ -3637,7 +4352,8 @@ static int zl3073x_dpll_input_pin_state_on_dpll_get(const struct dpll_pin *pin,
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_input_pin_state_get(zl3073x_dpll->zl3073x, zl3073x_dpll->index,
 					pin_register_index, state);
 
@@ -3668,7 +4384,8 @@ static int zl3073x_dpll_input_pin_prio_get(const struct dpll_pin *pin,  void *pi
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_get_priority_ref(zl3073x_dpll->zl3073x, zl3073x_dpll->index,
 					pin_register_index, prio);
 
@@ -3684,7 +4401,8 @@ static int zl3073x_dpll_input_pin_prio_set(const struct dpll_pin *pin, void *pin
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_set_priority_ref(zl3073x_dpll->zl3073x, zl3073x_dpll->index,
 					pin_register_index, prio);
 
@@ -3700,7 +4418,8 @@ static int zl3073x_dpll_input_pin_frequency_get(const struct dpll_pin *pin, void
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_get_input_frequency(zl3073x_dpll->zl3073x, pin_register_index, frequency);
 
 	return ret;
@@ -3716,7 +4435,8 @@ static int zl3073x_dpll_input_pin_frequency_set(const struct dpll_pin *pin, void
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_set_input_frequency(zl3073x_dpll->zl3073x, pin_register_index, frequency);
 
 	return ret;
@@ -3759,7 +4479,8 @@ static int zl3073x_dpll_input_pin_phase_offset_get(const struct dpll_pin *pin, v
 	u8 pin_register_index;
 	int ret = 0;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_phase_offset_get(zl3073x_dpll->zl3073x, zl3073x_dpll,
 				pin_register_index, phase_offset);
 
@@ -3776,7 +4497,8 @@ static int zl3073x_dpll_input_pin_phase_adjust_get(const struct dpll_pin *pin, v
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_get_input_phase_adjust(zl3073x_dpll->zl3073x, pin_register_index, phase_adjust);
 
 	return ret;
@@ -3792,7 +4514,8 @@ static int zl3073x_dpll_input_pin_phase_adjust_set(const struct dpll_pin *pin, v
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_set_input_phase_adjust(zl3073x_dpll->zl3073x, pin_register_index, phase_adjust);
 
 	return ret;
@@ -3835,7 +4558,8 @@ static int zl3073x_dpll_input_pin_ffo_get(const struct dpll_pin *pin, void *pin_
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_ffo_get(zl3073x_dpll->zl3073x, zl3073x_dpll->index, pin_register_index, ffo);
 
 	return ret;
@@ -3852,7 +4576,8 @@ static int zl3073x_dpll_input_pin_esync_get(const struct dpll_pin *pin, void *pi
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_input_esync_get(zl3073x_dpll->zl3073x,
 						zl3073x_dpll->index, pin_register_index, esync);
 
@@ -3868,7 +4593,8 @@ static int zl3073x_dpll_input_pin_esync_set(const struct dpll_pin *pin, void *pi
 	int pin_register_index;
 	int ret;
 
-	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->index);
+	pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_pin->zl3073x,
+							   zl3073x_pin->index);
 	ret = zl3073x_dpll_input_esync_set(zl3073x_dpll->zl3073x,
 						zl3073x_dpll->index, pin_register_index, freq);
 
@@ -3953,6 +4679,45 @@ out:
 	return ret;
 }
 
+static int zl3073x_dpll_output_pin_state_on_dpll_set(const struct dpll_pin *pin, void *pin_priv,
+				 const struct dpll_device *dpll,
+				 void *dpll_priv, enum dpll_pin_state state,
+				 struct netlink_ext_ack *extack)
+{
+	struct zl3073x_dpll *zl3073x_dpll = dpll_priv;
+	struct zl3073x_pin *zl3073x_pin = pin_priv;
+	struct zl3073x *zl3073x = zl3073x_dpll->zl3073x;
+	u8 synth_dpll;
+	u8 synth;
+	int ret;
+
+	if (state != DPLL_PIN_STATE_CONNECTED && state != DPLL_PIN_STATE_DISCONNECTED) {
+		NL_SET_ERR_MSG(extack, "output can only be connected or disconnected");
+		return -EINVAL;
+	}
+
+	ret = zl3073x_synth_get(zl3073x, zl3073x_pin->index / 2, &synth);
+	if (ret)
+		return ret;
+
+	if (!ZL3073X_CHECK_SYNTH_ID(synth)) {
+		NL_SET_ERR_MSG(extack, "output is not driven by a synth");
+		return -EINVAL;
+	}
+
+	ret = zl3073x_dpll_get(zl3073x, synth, &synth_dpll);
+	if (ret)
+		return ret;
+
+	if (synth_dpll != zl3073x_dpll->index) {
+		NL_SET_ERR_MSG(extack, "output is driven by another DPLL");
+		return -EINVAL;
+	}
+
+	return zl3073x_output_state_request(zl3073x, zl3073x_pin->index,
+					    state == DPLL_PIN_STATE_CONNECTED);
+}
+
 static const struct dpll_pin_ops zl3073x_dpll_input_pin_ops = {
 	.direction_get      = zl3073x_dpll_input_pin_direction_get,
 	.state_on_dpll_get  = zl3073x_dpll_input_pin_state_on_dpll_get,
@@ -3971,6 +4736,7 @@ static const struct dpll_pin_ops zl3073x_dpll_input_pin_ops = {
 static const struct dpll_pin_ops zl3073x_dpll_output_pin_ops = {
 	.direction_get      = zl3073x_dpll_output_pin_direction_get,
 	.state_on_dpll_get  = zl3073x_dpll_output_pin_state_on_dpll_get,
+	.state_on_dpll_set  = zl3073x_dpll_output_pin_state_on_dpll_set,
 	.frequency_get      = zl3073x_dpll_output_pin_frequency_get,
 	.frequency_set      = zl3073x_dpll_output_pin_frequency_set,
 	.phase_adjust_get   = zl3073x_dpll_output_pin_phase_adjust_get,
@@ -3984,29 +4750,21 @@ static const struct dpll_device_ops zl3073x_dpll_device_ops = {
 	.mode_get           = zl3073x_dpll_mode_get,
 };
 
-static u16 zl3073x_dpll_chip_id_get(struct zl3073x *zl3073x)
-{
-	u16 chip_id;
-	u8 buf[2];
-	int ret;
-
-	ret = zl3073x_read(zl3073x, DPLL_CHIP_ID_REG, buf, sizeof(buf));
-	if (ret)
-		return ret;
-
-	chip_id = buf[0] + (buf[1] << 8);
-	return chip_id;
-}
-
+/* A "clock-id" property in the device tree wins. Otherwise the chip ID is
+ * combined with a hash of the MFD device name, which encodes the bus and the
+ * address on it, so that identical chips get different IDs.
+ */
 static u64 zl3073x_dpll_clock_id_get(struct zl3073x *zl3073x)
 {
+	const char *name = dev_name(zl3073x->mfd);
 	u64 clock_id = 0;
-	u16 chip_id;
 
-	chip_id = zl3073x_dpll_chip_id_get(zl3073x);
+	if (!device_property_read_u64(zl3073x->dev, "clock-id", &clock_id) ||
+	    !device_property_read_u64(zl3073x->mfd, "clock-id", &clock_id))
+		return clock_id;
 
-	/* Leave some bits if clock id for potential systems with multiple chips */
-	clock_id = (chip_id << 16);
+	clock_id = (u64)jhash(name, strlen(name), 0) << 32;
+	clock_id |= (u64)zl3073x->chip_id << 16;
 
 	return clock_id;
 }
@@ -4033,7 +4791,7 @@ static struct dpll_pin_properties zl3073x_dpll_output_pin_properties_get(int pin
 
 	output_pin_prop.board_label = output_pin_names[pin_index];
 	output_pin_prop.type = output_dpll_pin_types[pin_index];
-	output_pin_prop.capabilities = 0;
+	output_pin_prop.capabilities = DPLL_PIN_CAPABILITIES_STATE_CAN_CHANGE;
 
 	if (freq_type == ZL3073X_SYNCE) {
 		output_pin_prop.freq_supported = output_freq_range_synce;
@@ -4056,14 +4814,23 @@ static struct dpll_pin_properties zl3073x_dpll_output_pin_properties_get(int pin
 	return output_pin_prop;
 }
 
-static int zl3073x_dpll_register(struct zl3073x_dpll *zl3073x_dpll,
-				enum dpll_type dpll_type, int dpll_index)
+/* DPLLs beyond the ones described by the board are EEC */
+static enum dpll_type zl3073x_dpll_type_get(int dpll_index)
+{
+	if (dpll_index < ARRAY_SIZE(zl3073x_dpll_type))
+		return zl3073x_dpll_type[dpll_index];
+
+	return DPLL_TYPE_EEC;
+}
+
+static int zl3073x_dpll_register(struct zl3073x_dpll *zl3073x_dpll,
+				enum dpll_type dpll_type, int dpll_index)
 {
 	struct dpll_device *dpll_device;
 	u64 clock_id;
 	int ret = 0;
 
-	clock_id = zl3073x_dpll_clock_id_get(zl3073x_dpll->zl3073x);
+	clock_id = zl3073x_dpll->zl3073x->clock_id;
 	dpll_device = dpll_device_get(clock_id, dpll_index, THIS_MODULE);
 
 	if (IS_ERR((dpll_device))) {
@@ -4089,14 +4856,14 @@ static void zl3073x_dpll_unregister(struct zl3073x_dpll *zl3073x_dpll)
 static int zl3073x_pin_register(struct zl3073x_dpll *zl3073x_dpll,
 				struct zl3073x_pin *zl3073x_pin, int pin_index)
 {
-	u64 clock_id = zl3073x_dpll_clock_id_get(zl3073x_dpll->zl3073x);
+	u64 clock_id = zl3073x_dpll->zl3073x->clock_id;
 	struct dpll_pin_properties pin_properties;
 	enum zl3073x_pin_type pin_type;
 	int pin_register_index;
 	int ret = 0;
 
-	if (ZL3073X_IS_INPUT_PIN(pin_index)) {
-		pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(pin_index);
+	if (ZL3073X_IS_INPUT_PIN(zl3073x_dpll->zl3073x, pin_index)) {
+		pin_register_index = ZL3073X_REG_MAP_INPUT_PIN_GET(zl3073x_dpll->zl3073x, pin_index);
 		pin_properties = zl3073x_dpll_input_pin_properties_get(pin_register_index);
 	} else {
 		pin_properties = zl3073x_dpll_output_pin_properties_get(pin_index);
@@ -4108,12 +4875,13 @@ static int zl3073x_pin_register(struct zl3073x_dpll *zl3073x_dpll,
 	if (IS_ERR((dpll_pin))) {
 		ret = PTR_ERR(dpll_pin);
 	} else {
+		zl3073x_pin->zl3073x = zl3073x_dpll->zl3073x;
 		zl3073x_pin->index = pin_index;
 		zl3073x_pin->dpll_pin = dpll_pin;
 		zl3073x_pin->pin_type = pin_type;
 		zl3073x_pin->pin_properties = pin_properties;
 
-		if (ZL3073X_IS_INPUT_PIN(pin_index)) {
+		if (ZL3073X_IS_INPUT_PIN(zl3073x_dpll->zl3073x, pin_index)) {
 			ret = dpll_pin_register(zl3073x_dpll->dpll_device, dpll_pin,
 							&zl3073x_dpll_input_pin_ops, zl3073x_pin);
 		} else {
@@ -4130,10 +4898,10 @@ static void zl3073x_pin_unregister(struct zl3073x *zl3073x, struct zl3073x_pin *
 	struct zl3073x_dpll *zl3073x_dpll;
 
 	if (zl3073x_pin->dpll_pin != NULL) {
-		for (int i = 0; i < ZL3073X_MAX_DPLLS; i++) {
+		for (int i = 0; i < zl3073x->info->num_dplls; i++) {
 			zl3073x_dpll = &zl3073x->dpll[i];
 
-			if (ZL3073X_IS_INPUT_PIN(zl3073x_pin->index))  {
+			if (ZL3073X_IS_INPUT_PIN(zl3073x, zl3073x_pin->index))  {
 				dpll_pin_unregister(zl3073x_dpll->dpll_device, zl3073x_pin->dpll_pin,
 						&zl3073x_dpll_input_pin_ops, zl3073x_pin);
 			} else {
@@ -4152,8 +4920,8 @@ static int zl3073x_register_all_dplls(struct zl3073x *zl3073x)
 	int ret = 0;
 	int i;
 
-	for (i = 0; i < ZL3073X_MAX_DPLLS; i++) {
-		dpll_type = zl3073x_dpll_type[i];
+	for (i = 0; i < zl3073x->info->num_dplls; i++) {
+		dpll_type = zl3073x_dpll_type_get(i);
 		zl3073x_dpll = &zl3073x->dpll[i];
 		zl3073x_dpll->zl3073x = zl3073x;
 		ret = zl3073x_dpll_register(zl3073x_dpll, dpll_type, i);
@@ -4177,7 +4945,7 @@ static void zl3073x_unregister_all_dplls(struct zl3073x *zl3073x)
 {
 	struct zl3073x_dpll *zl3073x_dpll;
 
-	for (int i = 0; i < ZL3073X_MAX_DPLLS; i++) {
+	for (int i = 0; i < zl3073x->info->num_dplls; i++) {
 		zl3073x_dpll = &zl3073x->dpll[i];
 		zl3073x_dpll_unregister(zl3073x_dpll);
 	}
@@ -4191,12 +4959,12 @@ static int zl3073x_register_all_pins(struct zl3073x *zl3073x)
 	int ret = 0;
 	int i;
 
-	for (i = 0; i < ZL3073X_MAX_PINS; i++) {
+	for (i = 0; i < ZL3073X_NUM_PINS(zl3073x); i++) {
 		zl3073x_pin = &zl3073x->pin[i];
 		pin_index = i;
 
 		/* Register each pin on each dpll */
-		for (int j = 0; j < ZL3073X_MAX_DPLLS; j++) {
+		for (int j = 0; j < zl3073x->info->num_dplls; j++) {
 			zl3073x_dpll = &zl3073x->dpll[j];
 			ret = zl3073x_pin_register(zl3073x_dpll, zl3073x_pin, pin_index);
 
@@ -4220,7 +4988,7 @@ static void zl3073x_unregister_all_pins(struct zl3073x *zl3073x)
 {
 	struct zl3073x_pin *zl3073x_pin;
 
-	for (int i = 0; i < ZL3073X_MAX_PINS; i++) {
+	for (int i = 0; i < ZL3073X_NUM_PINS(zl3073x); i++) {
 		zl3073x_pin = &zl3073x->pin[i];
 		zl3073x_pin_unregister(zl3073x, zl3073x_pin);
 	}
@@ -4230,6 +4998,8 @@ static int zl3073x_dpll_init(struct zl3073x *zl3073x)
 {
 	int ret = 0;
 
+	zl3073x->clock_id = zl3073x_dpll_clock_id_get(zl3073x);
+
 	ret = zl3073x_register_all_dplls(zl3073x);
 
 	if (ret != 0)
@@ -4247,314 +5017,2365 @@ out:
 	return ret;
 }
 
-static void zl3073x_dpll_periodic_work(struct kthread_work *work)
+static void zl3073x_dpll_status_publish(struct zl3073x *zl3073x, int dpll_index,
+				       unsigned long events,
+				       enum dpll_lock_status prev_lock_status)
 {
-	struct zl3073x *zl3073x = container_of(work, struct zl3073x, work.work);
-	struct zl3073x_dpll *zl3073x_dpll;
-	enum dpll_lock_status lock_status;
-	struct zl3073x_pin *zl3073x_pin;
-	enum dpll_pin_state pin_state;
-	u8 raw_lock_status;
-	s64 phase_offset;
-	u8 dpll_changed;
-	u8 pin_changed;
-	s64 ffo;
-	int ret;
-
-	for (int i = 0; i < ZL3073X_MAX_DPLLS; i++) {
-		zl3073x_dpll = &zl3073x->dpll[i];
-
-		ret = zl3073x_dpll_raw_lock_status_get(zl3073x_dpll->zl3073x, zl3073x_dpll->index, &raw_lock_status);
-		if (ret)
-			goto out;
+	struct zl3073x_dpll_record *record = &zl3073x->dpll_record[dpll_index];
+	struct zl3073x_dpll *zl3073x_dpll = &zl3073x->dpll[dpll_index];
+	struct zl3073x_dpll_status_rcu *new, *old;
+	struct zl3073x_pin_record *pin_record;
+	struct zl3073x_dpll_event event;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return;
+
+	new->status.lock_status = record->lock_status;
+	new->status.selected_ref = ZL3073X_REF_NONE;
+	new->status.timestamp_ns = ktime_get_ns();
+	if (ZL3073X_CHECK_REF_ID(zl3073x, record->selected_ref)) {
+		pin_record = &zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs +
+							record->selected_ref];
+		new->status.selected_ref = record->selected_ref;
+		new->status.phase_offset = pin_record->phase_offset;
+		new->status.ffo = pin_record->freq_offset;
+	}
 
-		ret = zl3073x_dpll_map_raw_to_manager_lock_status(zl3073x_dpll->zl3073x, zl3073x_dpll->index, raw_lock_status, &lock_status);
-		if (ret)
-			goto out;
+	old = rcu_dereference_protected(zl3073x_dpll->status, true);
+	rcu_assign_pointer(zl3073x_dpll->status, new);
+	if (old)
+		kfree_rcu(old, rcu);
 
-		dpll_changed = (lock_status != zl3073x->dpll_record[i].lock_status);
-		if (dpll_changed)
-			dpll_device_change_ntf(zl3073x_dpll->dpll_device);
+	if (!events)
+		return;
 
-		zl3073x->dpll_record[i].lock_status = lock_status;
-	}
+	event.dev = zl3073x->dev;
+	event.clock_id = zl3073x->clock_id;
+	event.dpll_index = dpll_index;
+	event.prev_lock_status = prev_lock_status;
+	event.status = &new->status;
 
-	/* output pins change checks are redundant because outputs states are constant */
-	for (int i = 0; i < ZL3073X_MAX_INPUT_PINS; i++) {
-		zl3073x_pin = &zl3073x->pin[ZL3073X_MAX_OUTPUT_PINS + i];
-		pin_changed = 0;
+	atomic_notifier_call_chain(&zl3073x_dpll_notifier, events, &event);
+}
 
-		for (int j = 0; j < ZL3073X_MAX_DPLLS; j++) {
-			zl3073x_dpll = &zl3073x->dpll[j];
+int zl3073x_dpll_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&zl3073x_dpll_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(zl3073x_dpll_register_notifier);
 
-			ret = zl3073x_dpll_phase_offset_get(zl3073x, zl3073x_dpll, i, &phase_offset);
-			if (ret)
-				goto out;
+int zl3073x_dpll_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&zl3073x_dpll_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(zl3073x_dpll_unregister_notifier);
 
-			ret = zl3073x_dpll_ffo_get(zl3073x, j, i, &ffo);
-			if (ret)
-				goto out;
+int zl3073x_dpll_status_get(u64 clock_id, int dpll_index,
+			    struct zl3073x_dpll_status *status)
+{
+	struct zl3073x_dpll_status_rcu *cur;
+	struct zl3073x *zl3073x;
+	int ret = -ENODEV;
 
-			ret = zl3073x_input_pin_state_get(zl3073x, j, i, &pin_state);
-			if (ret)
-				goto out;
+	rcu_read_lock();
+	list_for_each_entry_rcu(zl3073x, &zl3073x_devices, node) {
+		if (zl3073x->clock_id != clock_id)
+			continue;
 
-			/* Or equals ensures any changes are not erased */
-			pin_changed |= (phase_offset != zl3073x->input_pin_record[j][i].phase_offset);
-			pin_changed |= (ffo != zl3073x->input_pin_record[j][i].freq_offset);
-			pin_changed |= (pin_state != zl3073x->input_pin_record[j][i].pin_on_dpll_state);
+		if (dpll_index < 0 || dpll_index >= zl3073x->info->num_dplls)
+			break;
 
-			zl3073x->input_pin_record[j][i].phase_offset = phase_offset;
-			zl3073x->input_pin_record[j][i].freq_offset = ffo;
-			zl3073x->input_pin_record[j][i].pin_on_dpll_state = pin_state;
+		cur = rcu_dereference(zl3073x->dpll[dpll_index].status);
+		if (!cur) {
+			ret = -ENODATA;
+			break;
 		}
 
-		if (pin_changed)
-			dpll_pin_change_ntf(zl3073x_pin->dpll_pin);
+		*status = cur->status;
+		ret = 0;
+		break;
 	}
+	rcu_read_unlock();
 
-out:
-    /* Run twice a second */
-	kthread_queue_delayed_work(zl3073x->kworker, &zl3073x->work, msecs_to_jiffies(500));
+	return ret;
 }
+EXPORT_SYMBOL_GPL(zl3073x_dpll_status_get);
 
-static int zl3073x_dpll_init_worker(struct zl3073x *zl3073x)
+/* Record a transition of @type on @dpll_index, about reference @ref
+ * (DPLL_REF_INVALID for none), in the journal and the zl3073x_journal
+ * tracepoint. Called by the monitor only.
+ */
+static void zl3073x_journal_add(struct zl3073x *zl3073x, enum zl3073x_journal_type type,
+				u8 dpll_index, u8 ref, u32 old_val, u32 new_val)
 {
-	struct kthread_worker *kworker;
+	struct zl3073x_dpll *ptp_dpll = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL];
+	struct zl3073x_journal *journal = &zl3073x->journal;
+	struct zl3073x_journal_entry e = {
+		.type = type,
+		.dpll = dpll_index,
+		.ref = ref,
+		.old_val = old_val,
+		.new_val = new_val,
+	};
+	const struct zl3073x_pin_record *rec;
+
+	e.mono_ns = ktime_get_ns();
+
+	spin_lock(&ptp_dpll->sample_lock);
+	if (ptp_dpll->tod_sample_valid) {
+		e.tod_valid = true;
+		e.tod_ns = ptp_dpll->tod_sample_ns + ktime_get_real_ns() -
+			   ptp_dpll->tod_sample_sys_ns;
+	}
+	spin_unlock(&ptp_dpll->sample_lock);
 
-	kthread_init_delayed_work(&zl3073x->work, zl3073x_dpll_periodic_work);
-	kworker = kthread_create_worker(0, "zl3073x-%s",
-					dev_name(zl3073x->dev));
+	if (ZL3073X_CHECK_REF_ID(zl3073x, ref)) {
+		rec = &zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs + ref];
+		e.phase_offset = rec->phase_offset;
+		e.ffo = rec->freq_offset;
+	}
 
-	zl3073x->kworker = kworker;
-	kthread_queue_delayed_work(zl3073x->kworker, &zl3073x->work, 0);
+	spin_lock(&journal->lock);
+	e.seq = journal->seq++;
+	journal->ring[e.seq % ZL3073X_JOURNAL_ENTRIES] = e;
+	spin_unlock(&journal->lock);
 
-	return 0;
+	trace_zl3073x_journal(zl3073x->dev, e.seq, zl3073x_journal_type_names[type],
+			      e.dpll, e.ref, e.old_val, e.new_val, e.tod_valid, e.tod_ns,
+			      e.phase_offset, e.ffo);
 }
 
-static int zl3073x_dpll_init_fine_phase_adjust(struct zl3073x *zl3073x)
+/* Lock status, connected reference, mode and priorities of a DPLL at the
+ * start of a sweep, from its status registers as read by
+ * zl3073x_monitor_dpll_status() and the reference status of the sweep
+ */
+static void zl3073x_dpll_monitor_lock_status(struct zl3073x *zl3073x, int dpll_index,
+					     u8 mon_status, u8 mode_refsel, u8 refsel_status)
 {
-	u8 phase_shift_data[] = { 0xFF, 0xFF };
-	u8 phase_shift_intvl = 0x01;
-	u8 phase_shift_mask = 0x1F;
-	u8 phase_shift_ctrl = 0x01;
+	struct zl3073x_dpll_record *record = &zl3073x->dpll_record[dpll_index];
+	struct zl3073x_dpll *zl3073x_dpll = &zl3073x->dpll[dpll_index];
+	enum dpll_lock_status prev_lock_status;
+	enum dpll_lock_status lock_status;
+	u8 mode = DPLL_MODE_REFSEL_MODE_GET(mode_refsel);
+	u8 prio[ZL3073X_MAX_INPUT_PINS];
+	unsigned long events = 0;
+	u8 selected_ref;
 	int ret;
 
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_MASK,
-			    &phase_shift_mask, sizeof(phase_shift_mask));
+	lock_status = zl3073x_lock_status_from_raw(DPLL_LOCK_REFSEL_LOCK_GET(refsel_status),
+						   DPLL_MON_STATUS_HO_READY_GET(mon_status));
 
-	if (ret)
-		return ret;
+	selected_ref = zl3073x_selected_ref_from_raw(mode_refsel, refsel_status);
+	if (ZL3073X_CHECK_REF_ID(zl3073x, selected_ref) &&
+	    !DPLL_REF_MON_STATUS_QUALIFIED(zl3073x->ref_status[selected_ref]))
+		selected_ref = DPLL_REF_INVALID;
 
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_INTVL,
-			    &phase_shift_intvl, sizeof(phase_shift_intvl));
+	if (mode != record->mode)
+		zl3073x_journal_add(zl3073x, ZL3073X_JOURNAL_MODE, dpll_index, selected_ref,
+				    record->mode, mode);
 
+	record->mode = mode;
+	record->mode_refsel = mode_refsel;
+	record->refsel_status = refsel_status;
+
+	ret = zl3073x_dpll_ref_priorities_get(zl3073x, dpll_index, prio);
 	if (ret)
-		return ret;
+		goto err;
 
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_DATA,
-			    phase_shift_data, sizeof(phase_shift_data));
+	for (int i = 0; i < zl3073x->info->num_refs; i++)
+		zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs + i].priority = prio[i];
 
-	if (ret)
-		return ret;
+	if (lock_status != record->lock_status) {
+		dpll_device_change_ntf(zl3073x_dpll->dpll_device);
+		events |= ZL3073X_DPLL_EVENT_LOCK_STATUS;
+		zl3073x_journal_add(zl3073x, ZL3073X_JOURNAL_LOCK, dpll_index, selected_ref,
+				    record->lock_status, lock_status);
+	}
+	if (selected_ref != record->selected_ref) {
+		events |= ZL3073X_DPLL_EVENT_REF_CHANGE;
+		zl3073x_journal_add(zl3073x, ZL3073X_JOURNAL_REF, dpll_index, selected_ref,
+				    record->selected_ref, selected_ref);
+	}
 
-	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_CTRL,
-			    &phase_shift_ctrl, sizeof(phase_shift_ctrl));
+	prev_lock_status = record->lock_status;
+	record->lock_status = lock_status;
+	record->selected_ref = selected_ref;
 
-	return ret;
+	/* Consumers hear about lock and reference changes at the start of the
+	 * sweep, with the offsets of the previous one; the offsets are
+	 * refreshed once the sweep is over.
+	 */
+	if (events)
+		zl3073x_dpll_status_publish(zl3073x, dpll_index, events, prev_lock_status);
+
+	return;
+
+err:
+	dev_warn_ratelimited(zl3073x->dev, "monitor: DPLL %d lock status failed: %d\n",
+			     dpll_index, ret);
 }
 
-static int zl3073x_ptp_init(struct zl3073x *zl3073x, u8 index)
+/* The status registers of all DPLLs in one batch: each of the status pages is
+ * selected once per sweep rather than once per register
+ */
+static void zl3073x_monitor_dpll_status(struct zl3073x *zl3073x)
 {
-	struct zl3073x_dpll *dpll = &zl3073x->dpll[index];
-
-	for (int i = 0; i < ZL3073X_MAX_OUTPUT_PINS; i++) {
-		struct ptp_pin_desc *p = &dpll->pins[i];
+	struct zl3073x_field_req req[3 * ZL3073X_MAX_DPLLS];
+	int n = zl3073x->info->num_dplls;
+	int ret;
 
-		snprintf(p->name, sizeof(p->name), "pin%d", i);
-		p->index = i;
-		p->func = PTP_PF_NONE;
-		p->chan = 0;
+	for (int i = 0; i < n; i++) {
+		req[i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(dpll_mon_status, i);
+		req[n + i] = (struct zl3073x_field_req)ZL3073X_FIELD_REQ(dpll_mode_refsel, i);
+		req[2 * n + i] =
+			(struct zl3073x_field_req)ZL3073X_FIELD_REQ(dpll_lock_refsel_status, i);
 	}
 
-	dpll->index = index;
-	dpll->zl3073x = zl3073x;
-	dpll->info = zl3073x_ptp_clock_info;
-	dpll->info.pin_config = dpll->pins;
-	dpll->clock = ptp_clock_register(&dpll->info, zl3073x->dev);
-	if (IS_ERR(dpll->clock))
-		return PTR_ERR(dpll->clock);
+	ret = zl3073x_field_read_batch(zl3073x, req, 3 * n);
+	if (ret) {
+		dev_warn_ratelimited(zl3073x->dev, "monitor: DPLL status failed: %d\n", ret);
+		return;
+	}
 
-	return 0;
+	for (int i = 0; i < n; i++)
+		zl3073x_dpll_monitor_lock_status(zl3073x, i, req[i].val, req[n + i].val,
+						 req[2 * n + i].val);
 }
 
-#if IS_ENABLED(CONFIG_ZL3073X_MFG_FILE_AVAILABLE)
-static const char *_zl3073x_firmware_get_line(const char *data,
-					      size_t line_number)
+/* Delay until the first slot of this chip that starts no earlier than @after */
+static unsigned long zl3073x_monitor_delay(struct zl3073x *zl3073x, unsigned long after)
 {
-	for (int i = 0; i < line_number; ++i) {
-		data = strchr(data, '\n');
-		if (!data)
-			return NULL;
-		data += 1;
-	}
+	unsigned long period = msecs_to_jiffies(ZL3073X_MONITOR_PERIOD_MS);
+	unsigned long next = zl3073x->coord->epoch + READ_ONCE(zl3073x->coord_offset);
+	long behind = (long)(after - next);
+	unsigned long now = jiffies;
 
-	return data;
+	if (behind > 0)
+		next += DIV_ROUND_UP(behind, period) * period;
+
+	return time_after(next, now) ? next - now : 0;
 }
 
-static int _zl3073x_firmware_parse_line(struct zl3073x *zl3073x,
-					const char *line)
+/* All the reference monitors are consecutive registers, read them at once.
+ * Changes are journaled with the offsets against the PTP clock DPLL.
+ */
+static void zl3073x_monitor_ref_status(struct zl3073x *zl3073x)
 {
-	unsigned long parsed_value;
-	const char *tmp = line;
-	int err = 0;
-	u8 val = 0;
-	char *endp;
-	u32 delay;
-	u16 addr;
+	u8 prev[ZL3073X_MAX_INPUT_PINS];
+	int override;
+	int ret;
 
-	mutex_lock(zl3073x->lock);
-	switch (tmp[0]) {
-	case 'X':
-		/* The line looks like this:
-		 * X , ADDR , VAL
-		 * Where:
-		 *  - X means that is a command that needs to be executed
-		 *  - ADDR represents the addr and is always 2 bytes and the
-		 *         value is in hex, for example 0x0232
-		 *  - VAL represents the value that is written and is always 1
-		 *        byte and the value is in hex, for example 0x12
-		 */
-		tmp += ZL3073X_FW_COMMAND_SIZE;
+	memcpy(prev, zl3073x->ref_status, zl3073x->info->num_refs);
 
-		tmp += ZL3073X_FW_WHITESPACES_SIZE;
-		if (kstrtoul(tmp, 16, &parsed_value)) {
-			err = -EINVAL;
-			break;
-		}
-		addr = (u16)parsed_value;
+	ret = zl3073x_read(zl3073x, DPLL_REF_MON_STATUS(0), zl3073x->ref_status,
+			   zl3073x->info->num_refs);
+	if (ret) {
+		dev_warn_ratelimited(zl3073x->dev, "monitor: ref status failed: %d\n", ret);
+		memcpy(zl3073x->ref_status, prev, zl3073x->info->num_refs);
+		return;
+	}
 
-		tmp = endp;
-		tmp += ZL3073X_FW_WHITESPACES_SIZE;
-		if (kstrtoul(tmp, 16, &parsed_value)) {
-			err = -EINVAL;
-			break;
-		}
-		val = (u8)parsed_value;
+	for (int i = 0; i < zl3073x->info->num_refs; i++) {
+		override = READ_ONCE(zl3073x->ref_mon_status_override[i]);
+		if (override != ZL3073X_REF_MON_STATUS_NO_OVERRIDE)
+			zl3073x->ref_status[i] = override;
 
-		err = zl3073x_write(zl3073x, addr, &val, 1);
-		break;
-	case 'W':
-		/* The line looks like this:
-		 * W , DELAY
-		 * Where:
-		 *  - W means that is a wait command
-		 *  - DELAY represents the delay in microseconds and the value
-		 *    is in decimal
-		 */
-		tmp += ZL3073X_FW_COMMAND_SIZE;
+		if (zl3073x->ref_status[i] != prev[i])
+			zl3073x_journal_add(zl3073x, ZL3073X_JOURNAL_REF_STATUS,
+					    ZL3073X_PTP_CLOCK_DPLL, i, prev[i],
+					    zl3073x->ref_status[i]);
+	}
+}
 
-		tmp += ZL3073X_FW_WHITESPACES_SIZE;
-		if (kstrtoul(tmp, 10, &parsed_value)) {
-			err = -EINVAL;
-			break;
+/* Copies what the sweep gathered into the record behind the status_record
+ * attribute. No bus access: the TOD and the DCO word are the last ones seen by
+ * the PTP paths.
+ */
+static void zl3073x_status_record_publish(struct zl3073x *zl3073x)
+{
+	struct zl3073x_dpll *ptp_dpll = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL];
+	struct zl3073x_status_record *rec = zl3073x->status_record;
+	const struct zl3073x_chip_info *info = zl3073x->info;
+	bool tod_valid, dco_valid;
+	s64 tod_ns, tod_sys_ns;
+	s64 dco_word;
+
+	spin_lock(&ptp_dpll->sample_lock);
+	tod_valid = ptp_dpll->tod_sample_valid;
+	tod_ns = ptp_dpll->tod_sample_ns;
+	tod_sys_ns = ptp_dpll->tod_sample_sys_ns;
+	dco_valid = ptp_dpll->dco_word_valid;
+	dco_word = ptp_dpll->dco_word;
+	spin_unlock(&ptp_dpll->sample_lock);
+
+	write_seqlock(&zl3073x->status_record_lock);
+
+	rec->version = ZL3073X_STATUS_VERSION;
+	rec->size = sizeof(*rec);
+	rec->generation++;
+	rec->timestamp_ns = ktime_get_ns();
+	rec->chip_id = zl3073x->chip_id;
+	rec->num_dplls = info->num_dplls;
+	rec->num_refs = info->num_refs;
+	rec->ptp_dpll = ZL3073X_PTP_CLOCK_DPLL;
+	rec->flags = (tod_valid ? ZL3073X_STATUS_F_TOD_VALID : 0) |
+		     (dco_valid ? ZL3073X_STATUS_F_DCO_VALID : 0);
+	memcpy(rec->ref_status, zl3073x->ref_status, info->num_refs);
+	rec->tod_ns = tod_ns;
+	rec->tod_sys_ns = tod_sys_ns;
+	rec->dco_word = dco_word;
+
+	for (int i = 0; i < info->num_dplls; i++) {
+		struct zl3073x_dpll_record *dr = &zl3073x->dpll_record[i];
+		struct zl3073x_status_dpll *d = &rec->dpll[i];
+
+		d->lock_status = dr->lock_status;
+		d->mode = dr->mode;
+		d->selected_ref = ZL3073X_CHECK_REF_ID(zl3073x, dr->selected_ref) ?
+				  dr->selected_ref : ZL3073X_STATUS_REF_NONE;
+
+		for (int j = 0; j < info->num_refs; j++) {
+			struct zl3073x_pin_record *pr = &zl3073x->input_pin_record[i * info->num_refs + j];
+
+			d->ref[j].phase_offset = pr->phase_offset;
+			d->ref[j].ffo = pr->freq_offset;
+			d->ref[j].priority = pr->priority;
+			d->ref[j].state = pr->pin_on_dpll_state;
 		}
-		delay = (u32)parsed_value;
-
-		usleep_range(delay / 2, delay);
-		break;
-	default:
-		break;
 	}
-	mutex_unlock(zl3073x->lock);
 
-	return err;
+	write_sequnlock(&zl3073x->status_record_lock);
 }
 
-static int zl3073x_firmware_load(struct zl3073x *zl3073x)
+static ssize_t status_record_read(struct file *file, struct kobject *kobj,
+				  const struct bin_attribute *attr, char *buf,
+				  loff_t off, size_t count)
 {
-	char fname[128] = ZL3073X_FW_FILENAME;
-	const struct firmware *fw;
-	size_t line_number = 0;
-	const char *line;
-	int err = 0;
+	struct zl3073x *zl3073x = dev_get_drvdata(kobj_to_dev(kobj));
+	unsigned int seq;
 
-	err = request_firmware(&fw, fname, zl3073x->dev);
-	if (err)
-		return err;
+	if (off >= sizeof(*zl3073x->status_record))
+		return 0;
 
-	while (true) {
-		line = _zl3073x_firmware_get_line(fw->data, line_number);
-		if (!line)
-			goto out;
+	count = min_t(size_t, count, sizeof(*zl3073x->status_record) - off);
 
-		line_number += 1;
+	do {
+		seq = read_seqbegin(&zl3073x->status_record_lock);
+		memcpy(buf, (u8 *)zl3073x->status_record + off, count);
+	} while (read_seqretry(&zl3073x->status_record_lock, seq));
 
-		/* Skip comment lines */
-		if (line[0] == ';')
-			continue;
+	return count;
+}
+static BIN_ATTR_RO(status_record, sizeof(struct zl3073x_status_record));
 
-		err = _zl3073x_firmware_parse_line(zl3073x, line);
-		if (err)
-			goto out;
+/* One line per reference: the nominal frequency in Hz and the measured one
+ * in mHz, derived from the FFO against the PTP clock DPLL
+ */
+static ssize_t ref_freq_measured_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	s32 ffo[ZL3073X_MAX_INPUT_PINS];
+	u64 nominal, measured, delta;
+	ssize_t len = 0;
+	int ret;
+
+	ret = zl3073x_ref_ffo_measure_all(zl3073x, ZL3073X_PTP_CLOCK_DPLL, ffo);
+	if (ret)
+		return ret;
+
+	for (int i = 0; i < zl3073x->info->num_refs; i++) {
+		ret = zl3073x_ref_freq_nominal_read(zl3073x, i, &nominal);
+		if (ret)
+			return ret;
+
+		/* FFO is in 2^-32 of the nominal frequency */
+		delta = mul_u64_u32_shr(nominal * 1000, abs(ffo[i]), 32);
+		measured = ffo[i] < 0 ? nominal * 1000 - delta : nominal * 1000 + delta;
+
+		len += sysfs_emit_at(buf, len, "%d %llu %llu %lld%s\n", i, nominal,
+				     measured,
+				     ((s64)ffo[i] * NSEC_PER_SEC) >> 32,
+				     zl3073x->ref_status[i] ? " disqualified" : "");
 	}
 
-out:
-	release_firmware(fw);
-	return err;
+	return len;
 }
-#endif
+static DEVICE_ATTR_RO(ref_freq_measured);
 
-static int zl3073x_probe(struct platform_device *pdev)
+/* Ramp rate of the PTP clock DCO in ppb/s, see struct zl3073x_dco */
+static ssize_t dco_ramp_rate_show(struct device *dev, struct device_attribute *attr,
+				  char *buf)
 {
-	struct microchip_dpll_ddata *ddata = dev_get_drvdata(pdev->dev.parent);
-	struct zl3073x *zl3073x;
-	int err;
-
-	zl3073x = devm_kzalloc(&pdev->dev, sizeof(struct zl3073x), GFP_KERNEL);
-	if (!zl3073x)
-		return -ENOMEM;
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
 
-	zl3073x->dev = &pdev->dev;
-	zl3073x->mfd = pdev->dev.parent;
-	zl3073x->lock = &ddata->lock;
-	zl3073x->regmap = ddata->regmap;
+	return sysfs_emit(buf, "%u\n", READ_ONCE(dco->ramp_rate));
+}
 
-#if IS_ENABLED(CONFIG_ZL3073X_MFG_FILE_AVAILABLE)
-	zl3073x_firmware_load(zl3073x);
-#endif
+static ssize_t dco_ramp_rate_store(struct device *dev, struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
+	unsigned int rate;
+	int ret;
 
-#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
-	err = zl3073x_ptp_init(zl3073x, ZL3073X_PTP_CLOCK_DPLL);
-	if (err)
-		return err;
-#endif
+	ret = kstrtouint(buf, 0, &rate);
+	if (ret)
+		return ret;
 
-#if IS_ENABLED(CONFIG_DPLL)
-	err = zl3073x_dpll_init(zl3073x);
-	if (err)
-		return err;
+	if (rate > zl3073x_ptp_clock_info.max_adj)
+		return -ERANGE;
 
-	err = zl3073x_dpll_init_worker(zl3073x);
-	if (err)
-		return err;
-#endif
+	/* A ramp in progress continues at the new rate, or ends at once */
+	mutex_lock(&dco->lock);
+	WRITE_ONCE(dco->ramp_rate, rate);
+	mutex_unlock(&dco->lock);
 
-	platform_set_drvdata(pdev, zl3073x);
+	return count;
+}
+static DEVICE_ATTR_RW(dco_ramp_rate);
 
-	/* Initial firmware fine phase correction */
-	err = zl3073x_dpll_init_fine_phase_adjust(zl3073x);
+/* Largest adjtime offset of the PTP clock in ns that is slewed, 0 to step all */
+static ssize_t dco_slew_max_ns_show(struct device *dev, struct device_attribute *attr,
+				    char *buf)
+{
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
 
-	return err;
+	return sysfs_emit(buf, "%u\n", READ_ONCE(dco->slew_max_ns));
 }
 
-static void zl3073x_remove(struct platform_device *pdev)
+static ssize_t dco_slew_max_ns_store(struct device *dev, struct device_attribute *attr,
+				     const char *buf, size_t count)
 {
-	struct zl3073x *zl3073x = platform_get_drvdata(pdev);
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
+	unsigned int max_ns;
+	int ret;
 
-#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
-	ptp_clock_unregister(zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].clock);
-#endif
+	ret = kstrtouint(buf, 0, &max_ns);
+	if (ret)
+		return ret;
+
+	/* Whole seconds are stepped through the TOD anyway */
+	if (max_ns >= NSEC_PER_SEC)
+		return -ERANGE;
+
+	/* A slew in progress runs to its end */
+	mutex_lock(&dco->lock);
+	WRITE_ONCE(dco->slew_max_ns, max_ns);
+	mutex_unlock(&dco->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(dco_slew_max_ns);
+
+/* Frequency offset in ppb that slews run at */
+static ssize_t dco_slew_rate_show(struct device *dev, struct device_attribute *attr,
+				  char *buf)
+{
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(dco->slew_rate));
+}
+
+static ssize_t dco_slew_rate_store(struct device *dev, struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct zl3073x *zl3073x = dev_get_drvdata(dev);
+	struct zl3073x_dco *dco = &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].dco;
+	unsigned int rate;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &rate);
+	if (ret)
+		return ret;
+
+	/* The slew is on top of the adjfine value, leave it some room */
+	if (!rate || rate > zl3073x_ptp_clock_info.max_adj / 2)
+		return -ERANGE;
+
+	/* Takes effect with the next offset to slew */
+	mutex_lock(&dco->lock);
+	WRITE_ONCE(dco->slew_rate, rate);
+	mutex_unlock(&dco->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(dco_slew_rate);
+
+static struct attribute *zl3073x_attrs[] = {
+	&dev_attr_ref_freq_measured.attr,
+	&dev_attr_dco_ramp_rate.attr,
+	&dev_attr_dco_slew_max_ns.attr,
+	&dev_attr_dco_slew_rate.attr,
+	NULL,
+};
+
+static const struct bin_attribute *const zl3073x_bin_attrs[] = {
+	&bin_attr_status_record,
+	NULL,
+};
+
+/* The DCO attributes belong to the PTP clock */
+static umode_t zl3073x_attr_is_visible(struct kobject *kobj, struct attribute *attr, int n)
+{
+	if (!IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X) &&
+	    (attr == &dev_attr_dco_ramp_rate.attr || attr == &dev_attr_dco_slew_max_ns.attr ||
+	     attr == &dev_attr_dco_slew_rate.attr))
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct attribute_group zl3073x_attr_group = {
+	.attrs = zl3073x_attrs,
+	.bin_attrs = zl3073x_bin_attrs,
+	.is_visible = zl3073x_attr_is_visible,
+};
+
+/* Created by the driver core once probe succeeds, and removed before remove */
+static const struct attribute_group *zl3073x_attr_groups[] = {
+	&zl3073x_attr_group,
+	NULL,
+};
+
+/* Square of a frequency offset, clamped so that the sums cannot overflow */
+static u64 zl3073x_rank_sq(s64 ppt)
+{
+	ppt = clamp(ppt, -ZL3073X_RANK_MAX_PPT, ZL3073X_RANK_MAX_PPT);
+
+	return ppt * ppt;
+}
+
+static void zl3073x_rank_ewma(u64 *var, u64 sq)
+{
+	*var = *var - (*var >> ZL3073X_RANK_EWMA_SHIFT) + (sq >> ZL3073X_RANK_EWMA_SHIFT);
+}
+
+/* Feed the phase (ps) and FFO (2^-32) the monitor read for a reference */
+static void zl3073x_rank_sample(struct zl3073x *zl3073x, int dpll_index, int ref_index,
+				s64 phase, s64 ffo)
+{
+	struct zl3073x_rank *rank = &zl3073x->dpll[dpll_index].rank;
+	struct zl3073x_rank_stats *st =
+		&zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs + ref_index].rank;
+	unsigned long now = jiffies;
+	unsigned int tau_ms;
+	s64 d;
+
+	mutex_lock(&rank->lock);
+
+	/* A disqualified reference or a gap in the samples starts over */
+	if (zl3073x->ref_status[ref_index]) {
+		st->samples = 0;
+		goto out;
+	}
+
+	tau_ms = jiffies_to_msecs(now - st->stamp);
+	if (!tau_ms || tau_ms > ZL3073X_RANK_MAX_TAU_MS)
+		st->samples = 0;
+
+	if (st->samples >= 1) {
+		/* 2^-32 to ppt is 10^12 / 2^32 = 5^12 / 2^20 */
+		d = div_s64((ffo - st->ffo) * 244140625, 1 << 20);
+		zl3073x_rank_ewma(&st->ffo_var, zl3073x_rank_sq(d));
+	}
+
+	if (st->samples >= 2) {
+		/* ps over ms is ppb */
+		d = div_s64((phase - 2 * st->phase[1] + st->phase[0]) * 1000, tau_ms);
+		zl3073x_rank_ewma(&st->phase_var, zl3073x_rank_sq(d));
+	}
+
+	st->phase[0] = st->phase[1];
+	st->phase[1] = phase;
+	st->ffo = ffo;
+	st->stamp = now;
+	if (st->samples < U8_MAX)
+		st->samples++;
+
+out:
+	mutex_unlock(&rank->lock);
+}
+
+static u64 zl3073x_rank_score(const struct zl3073x_rank_stats *st)
+{
+	return max(st->phase_var, st->ffo_var);
+}
+
+/* Whether @a is to be ranked above @b. A qualified reference beats a
+ * disqualified one, otherwise it has to be more stable by the margin, so that
+ * references of similar stability keep their order.
+ */
+static bool zl3073x_rank_better(struct zl3073x *zl3073x, const struct zl3073x_rank *rank,
+				const struct zl3073x_pin_record *rec, u8 a, u8 b)
+{
+	if (zl3073x->ref_status[a])
+		return false;
+	if (zl3073x->ref_status[b])
+		return true;
+
+	return zl3073x_rank_score(&rec[a].rank) * (100 + rank->margin) <
+	       zl3073x_rank_score(&rec[b].rank) * 100;
+}
+
+/* Called at the end of a sweep, with the priorities read at its start. The
+ * pool members are sorted by their current priority, moved up past the ones
+ * they beat, and then given the priorities of the pool in that order. All
+ * changes go to the chip in one mailbox write.
+ */
+static void zl3073x_rank_update(struct zl3073x *zl3073x, int dpll_index)
+{
+	struct zl3073x_pin_record *rec =
+		&zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs];
+	struct zl3073x_rank *rank = &zl3073x->dpll[dpll_index].rank;
+	u8 order[ZL3073X_MAX_INPUT_PINS];
+	u8 slots[ZL3073X_MAX_INPUT_PINS];
+	u8 prio[ZL3073X_MAX_INPUT_PINS];
+	u8 old[ZL3073X_MAX_INPUT_PINS];
+	u16 changed = 0;
+	int n = 0;
+	int i, j;
+	u8 ref;
+	int ret;
+
+	mutex_lock(&rank->lock);
+
+	if (!rank->enabled ||
+	    time_before(jiffies, rank->last + msecs_to_jiffies(rank->hold_ms)))
+		goto out;
+
+	for (ref = 0; ref < zl3073x->info->num_refs; ref++) {
+		if (!(rank->pool & BIT(ref)) || rec[ref].priority == DPLL_REF_PRIORITY_INVALID)
+			continue;
+
+		/* Wait until every qualified member has enough history */
+		if (!zl3073x->ref_status[ref] && rec[ref].rank.samples < ZL3073X_RANK_MIN_SAMPLES)
+			goto out;
+
+		for (i = n++; i > 0 && rec[order[i - 1]].priority > rec[ref].priority; i--)
+			order[i] = order[i - 1];
+		order[i] = ref;
+	}
+
+	if (n < 2)
+		goto out;
+
+	for (i = 0; i < n; i++)
+		slots[i] = rec[order[i]].priority;
+
+	for (i = 1; i < n; i++) {
+		ref = order[i];
+		for (j = i; j > 0 && zl3073x_rank_better(zl3073x, rank, rec, ref, order[j - 1]); j--)
+			order[j] = order[j - 1];
+		order[j] = ref;
+	}
+
+	for (ref = 0; ref < zl3073x->info->num_refs; ref++) {
+		old[ref] = rec[ref].priority;
+		prio[ref] = old[ref];
+	}
+
+	for (i = 0; i < n; i++) {
+		if (prio[order[i]] != slots[i]) {
+			prio[order[i]] = slots[i];
+			changed |= BIT(order[i]);
+		}
+	}
+
+	if (!changed)
+		goto out;
+
+	/* A priority set during the sweep wins, the next sweep ranks again */
+	ret = zl3073x_dpll_ref_priorities_set(zl3073x, dpll_index, old, prio, changed);
+	if (ret == -EAGAIN) {
+		dev_dbg(zl3073x->dev, "rank: DPLL %d priorities changed during the sweep\n",
+			dpll_index);
+		goto out;
+	}
+	if (ret) {
+		rank->errors++;
+		dev_warn_ratelimited(zl3073x->dev, "rank: DPLL %d reorder failed: %d\n",
+				     dpll_index, ret);
+		goto out;
+	}
+
+	rank->reorders++;
+	rank->last = jiffies;
+
+	for (ref = 0; ref < zl3073x->info->num_refs; ref++) {
+		if (!(changed & BIT(ref)))
+			continue;
+
+		rec[ref].priority = prio[ref];
+		dpll_pin_change_ntf(zl3073x->pin[zl3073x->info->num_outputs + ref].dpll_pin);
+	}
+
+	dev_dbg(zl3073x->dev, "rank: DPLL %d priorities reordered, changed refs 0x%x\n",
+		dpll_index, changed);
+
+out:
+	mutex_unlock(&rank->lock);
+}
+
+/* One step of the sweep measures the phase and frequency offset of the pair.
+ * The pin state and the connected reference come from the registers read at
+ * the start of the sweep, so a step only touches the measurement pages.
+ */
+static int zl3073x_dpll_monitor_ref(struct zl3073x *zl3073x, int ref_index,
+				    int dpll_index, bool *changed)
+{
+	struct zl3073x_pin_record *record =
+		&zl3073x->input_pin_record[dpll_index * zl3073x->info->num_refs + ref_index];
+	struct zl3073x_dpll_record *dpll_record = &zl3073x->dpll_record[dpll_index];
+	u8 ref_status = zl3073x->ref_status[ref_index];
+	u8 prio = DPLL_REF_PRIORITY_INVALID;
+	enum dpll_pin_state pin_state;
+	s64 phase_offset;
+	s64 phase_err;
+	s32 ffo_raw;
+	s64 ffo;
+	int ret;
+
+	ret = zl3073x_ref_meas_read(zl3073x, dpll_index, ref_index, &phase_err, &ffo_raw);
+	if (ret)
+		return ret;
+
+	ret = zl3073x_dpll_phase_offset_calc(zl3073x, ref_index, dpll_record->selected_ref,
+					     ref_status, phase_err, &phase_offset);
+	if (ret)
+		return ret;
+
+	ffo = ffo_raw;
+
+	if (dpll_record->mode == ZL3073X_MODE_AUTO_LOCK)
+		prio = record->priority;
+
+	if (!DPLL_REF_MON_STATUS_QUALIFIED(ref_status))
+		pin_state = DPLL_PIN_STATE_DISCONNECTED;
+	else
+		pin_state = zl3073x_input_pin_state_from_raw(dpll_record->mode, ref_index,
+				DPLL_LOCK_REFSEL_REF_GET(dpll_record->refsel_status),
+				DPLL_MODE_REFSEL_REF_GET(dpll_record->mode_refsel), prio);
+
+	zl3073x_rank_sample(zl3073x, dpll_index, ref_index, phase_offset, ffo);
+
+	/* Or equals ensures any changes are not erased */
+	*changed |= (phase_offset != record->phase_offset);
+	*changed |= (ffo != record->freq_offset);
+	*changed |= (pin_state != record->pin_on_dpll_state);
+
+	record->phase_offset = phase_offset;
+	record->freq_offset = ffo;
+	record->pin_on_dpll_state = pin_state;
+
+	return 0;
+}
+
+/* The sweep goes over every (ref, DPLL) pair. Between steps it gives the bus
+ * to the PTP servo when a servo operation is in progress, by requeueing itself
+ * and resuming from the cursor. A failing step skips the rest of that pin only.
+ */
+static void zl3073x_dpll_periodic_work(struct kthread_work *work)
+{
+	struct zl3073x *zl3073x = container_of(work, struct zl3073x, work.work);
+	struct zl3073x_monitor *mon = &zl3073x->mon;
+	struct zl3073x_pin *zl3073x_pin;
+	unsigned long next;
+	u64 selects;
+	int ret;
+
+	if (!mon->in_sweep) {
+		mon->in_sweep = true;
+		mon->sweep_start = jiffies;
+		mon->ref = 0;
+		mon->dpll = 0;
+		mon->pin_changed = false;
+		mon->yields = 0;
+		mon->selects_start = microchip_dpll_bus_page_selects(zl3073x->ddata);
+
+		zl3073x_monitor_ref_status(zl3073x);
+		zl3073x_monitor_dpll_status(zl3073x);
+	}
+
+	/* output pins change checks are redundant because outputs states are constant */
+	while (mon->ref < zl3073x->info->num_refs) {
+		if (mon->yields < ZL3073X_MONITOR_MAX_YIELDS &&
+		    microchip_dpll_bus_critical_busy(zl3073x->ddata)) {
+			mon->yields++;
+			kthread_queue_delayed_work(zl3073x->kworker, &zl3073x->work,
+						   ZL3073X_MONITOR_YIELD_DELAY);
+			return;
+		}
+
+		ret = zl3073x_dpll_monitor_ref(zl3073x, mon->ref, mon->dpll, &mon->pin_changed);
+		if (ret) {
+			dev_warn_ratelimited(zl3073x->dev,
+					     "monitor: ref %d on DPLL %d failed: %d\n",
+					     mon->ref, mon->dpll, ret);
+			mon->dpll = zl3073x->info->num_dplls;
+		} else {
+			mon->dpll++;
+		}
+
+		if (mon->dpll < zl3073x->info->num_dplls)
+			continue;
+
+		zl3073x_pin = &zl3073x->pin[zl3073x->info->num_outputs + mon->ref];
+		if (mon->pin_changed)
+			dpll_pin_change_ntf(zl3073x_pin->dpll_pin);
+
+		mon->pin_changed = false;
+		mon->dpll = 0;
+		mon->ref++;
+	}
+
+	mon->in_sweep = false;
+
+	for (int i = 0; i < zl3073x->info->num_dplls; i++)
+		zl3073x_rank_update(zl3073x, i);
+
+	/* Counts every page select on the bus while the sweep ran, including
+	 * those of other users in its yields
+	 */
+	selects = microchip_dpll_bus_page_selects(zl3073x->ddata) - mon->selects_start;
+	WRITE_ONCE(mon->selects_last, selects);
+	WRITE_ONCE(mon->selects_max, max(mon->selects_max, selects));
+	WRITE_ONCE(mon->selects_total, mon->selects_total + selects);
+	WRITE_ONCE(mon->sweeps, mon->sweeps + 1);
+
+	for (int i = 0; i < zl3073x->info->num_dplls; i++)
+		zl3073x_dpll_status_publish(zl3073x, i, 0, zl3073x->dpll_record[i].lock_status);
+	zl3073x_status_record_publish(zl3073x);
+
+	/* Run twice a second, in the slot of this chip */
+	next = mon->sweep_start + msecs_to_jiffies(ZL3073X_MONITOR_PERIOD_MS) / 2;
+	kthread_queue_delayed_work(zl3073x->kworker, &zl3073x->work,
+				   zl3073x_monitor_delay(zl3073x, next));
+}
+
+/* Spread the slots of all chips on the bus evenly over the period */
+static void zl3073x_coord_reslot(struct zl3073x_bus_coord *coord)
+{
+	unsigned long period = msecs_to_jiffies(ZL3073X_MONITOR_PERIOD_MS);
+	struct zl3073x *zl3073x;
+	unsigned int slot = 0;
+
+	list_for_each_entry(zl3073x, &coord->members, coord_node)
+		WRITE_ONCE(zl3073x->coord_offset,
+			   period * slot++ / coord->nr_members);
+}
+
+static struct zl3073x_bus_coord *zl3073x_coord_get(struct device *bus)
+{
+	struct zl3073x_bus_coord *coord;
+
+	list_for_each_entry(coord, &zl3073x_bus_coords, list)
+		if (coord->bus == bus)
+			return coord;
+
+	coord = kzalloc(sizeof(*coord), GFP_KERNEL);
+	if (!coord)
+		return ERR_PTR(-ENOMEM);
+
+	coord->kworker = kthread_run_worker(0, "zl3073x-%s", dev_name(bus));
+	if (IS_ERR(coord->kworker)) {
+		struct kthread_worker *kworker = coord->kworker;
+
+		kfree(coord);
+		return ERR_CAST(kworker);
+	}
+
+	coord->bus = bus;
+	coord->epoch = jiffies;
+	INIT_LIST_HEAD(&coord->members);
+	list_add_tail(&coord->list, &zl3073x_bus_coords);
+
+	return coord;
+}
+
+/* The bus is the parent of the MFD: the I2C adapter or the SPI controller */
+static int zl3073x_coord_join(struct zl3073x *zl3073x)
+{
+	struct device *bus = zl3073x->mfd->parent ?: zl3073x->mfd;
+	struct zl3073x_bus_coord *coord;
+
+	kthread_init_delayed_work(&zl3073x->work, zl3073x_dpll_periodic_work);
+
+	mutex_lock(&zl3073x_bus_coords_lock);
+
+	coord = zl3073x_coord_get(bus);
+	if (IS_ERR(coord)) {
+		mutex_unlock(&zl3073x_bus_coords_lock);
+		return PTR_ERR(coord);
+	}
+
+	zl3073x->coord = coord;
+	zl3073x->kworker = coord->kworker;
+
+	spin_lock(&zl3073x->out_state.lock);
+	zl3073x->out_state.kworker = coord->kworker;
+	spin_unlock(&zl3073x->out_state.lock);
+	list_add_tail(&zl3073x->coord_node, &coord->members);
+	coord->nr_members++;
+	zl3073x_coord_reslot(coord);
+
+	kthread_queue_delayed_work(zl3073x->kworker, &zl3073x->work,
+				   zl3073x_monitor_delay(zl3073x, jiffies));
+
+	mutex_unlock(&zl3073x_bus_coords_lock);
+
+	return 0;
+}
+
+static void zl3073x_coord_leave(struct zl3073x *zl3073x)
+{
+	struct zl3073x_bus_coord *coord = zl3073x->coord;
+
+	if (!coord)
+		return;
+
+	kthread_cancel_delayed_work_sync(&zl3073x->work);
+	zl3073x_output_state_stop(zl3073x);
+
+	mutex_lock(&zl3073x_bus_coords_lock);
+
+	list_del(&zl3073x->coord_node);
+	zl3073x->coord = NULL;
+	if (--coord->nr_members) {
+		zl3073x_coord_reslot(coord);
+		coord = NULL;
+	} else {
+		list_del(&coord->list);
+	}
+
+	mutex_unlock(&zl3073x_bus_coords_lock);
+
+	if (coord) {
+		kthread_destroy_worker(coord->kworker);
+		kfree(coord);
+	}
+}
+
+static int zl3073x_dpll_init_fine_phase_adjust(struct zl3073x *zl3073x)
+{
+	u8 phase_shift_data[] = { 0xFF, 0xFF };
+	u8 phase_shift_intvl = 0x01;
+	u8 phase_shift_mask = 0x1F;
+	u8 phase_shift_ctrl = 0x01;
+	int ret;
+
+	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_MASK,
+			    &phase_shift_mask, sizeof(phase_shift_mask));
+
+	if (ret)
+		return ret;
+
+	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_INTVL,
+			    &phase_shift_intvl, sizeof(phase_shift_intvl));
+
+	if (ret)
+		return ret;
+
+	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_DATA,
+			    phase_shift_data, sizeof(phase_shift_data));
+
+	if (ret)
+		return ret;
+
+	ret = zl3073x_write(zl3073x, DPLL_SYNTH_PHASE_SHIFT_CTRL,
+			    &phase_shift_ctrl, sizeof(phase_shift_ctrl));
+
+	return ret;
+}
+
+static int zl3073x_ptp_init(struct zl3073x *zl3073x, u8 index)
+{
+	struct zl3073x_dpll *dpll = &zl3073x->dpll[index];
+	int n_pins = zl3073x->info->num_outputs;
+	s64 word;
+	int ret;
+
+	/* Start the cached DCO word from what the firmware configured */
+	if (!zl3073x_field_read_dpll_df_offset(zl3073x, index, &word)) {
+		dpll->dco_word = word;
+		dpll->dco_word_valid = true;
+		/* The word is the negated offset in 2^-48, adjfine counts
+		 * 2^-16 ppm: 10^6 / 2^32 = 15625 / 2^26
+		 */
+		dpll->dco.cur = div_s64(-word * 15625, 1 << 26);
+		dpll->dco.target = dpll->dco.cur;
+	}
+
+	dpll->pins = devm_kcalloc(zl3073x->dev, n_pins, sizeof(*dpll->pins), GFP_KERNEL);
+	if (!dpll->pins)
+		return -ENOMEM;
+
+	for (int i = 0; i < n_pins; i++) {
+		struct ptp_pin_desc *p = &dpll->pins[i];
+
+		snprintf(p->name, sizeof(p->name), "pin%d", i);
+		p->index = i;
+		p->func = PTP_PF_NONE;
+		p->chan = 0;
+	}
+
+	ret = zl3073x_dco_init(dpll);
+	if (ret)
+		return ret;
+
+	mutex_init(&dpll->servo.lock);
+	kthread_init_delayed_work(&dpll->servo.work, zl3073x_servo_work);
+	dpll->servo.kp = ZL3073X_SERVO_KP_DEFAULT;
+	dpll->servo.ki = ZL3073X_SERVO_KI_DEFAULT;
+	dpll->servo.step_ns = ZL3073X_SERVO_STEP_DEFAULT;
+
+	dpll->index = index;
+	dpll->zl3073x = zl3073x;
+
+	/* Without an estimate the latch is taken to be mid transfer */
+	ret = zl3073x_latch_calibrate(dpll);
+	if (ret)
+		dev_warn(zl3073x->dev, "TOD latch calibration failed: %d\n", ret);
+
+	dpll->info = zl3073x_ptp_clock_info;
+	dpll->info.n_per_out = n_pins;
+	dpll->info.n_ext_ts = n_pins;
+	dpll->info.n_pins = n_pins;
+	dpll->info.pin_config = dpll->pins;
+	dpll->clock = ptp_clock_register(&dpll->info, zl3073x->dev);
+	if (IS_ERR(dpll->clock)) {
+		zl3073x_dco_exit(dpll);
+		return PTR_ERR(dpll->clock);
+	}
+
+	return 0;
+}
+
+#if IS_ENABLED(CONFIG_ZL3073X_MFG_FILE_AVAILABLE)
+static const char *_zl3073x_firmware_get_line(const char *data,
+					      size_t line_number)
+{
+	for (int i = 0; i < line_number; ++i) {
+		data = strchr(data, '\n');
+		if (!data)
+			return NULL;
+		data += 1;
+	}
+
+	return data;
+}
+
+static int _zl3073x_firmware_parse_line(struct zl3073x *zl3073x,
+					const char *line)
+{
+	unsigned long parsed_value;
+	const char *tmp = line;
+	int err = 0;
+	u8 val = 0;
+	char *endp;
+	u32 delay;
+	u16 addr;
+
+	switch (tmp[0]) {
+	case 'X':
+		/* The line looks like this:
+		 * X , ADDR , VAL
+		 * Where:
+		 *  - X means that is a command that needs to be executed
+		 *  - ADDR represents the addr and is always 2 bytes and the
+		 *         value is in hex, for example 0x0232
+		 *  - VAL represents the value that is written and is always 1
+		 *        byte and the value is in hex, for example 0x12
+		 */
+		tmp += ZL3073X_FW_COMMAND_SIZE;
+
+		tmp += ZL3073X_FW_WHITESPACES_SIZE;
+		if (kstrtoul(tmp, 16, &parsed_value)) {
+			err = -EINVAL;
+			break;
+		}
+		addr = (u16)parsed_value;
+
+		tmp = endp;
+		tmp += ZL3073X_FW_WHITESPACES_SIZE;
+		if (kstrtoul(tmp, 16, &parsed_value)) {
+			err = -EINVAL;
+			break;
+		}
+		val = (u8)parsed_value;
+
+		zl3073x_topo_invalidate(zl3073x, addr);
+		err = zl3073x_write(zl3073x, addr, &val, 1);
+		break;
+	case 'W':
+		/* The line looks like this:
+		 * W , DELAY
+		 * Where:
+		 *  - W means that is a wait command
+		 *  - DELAY represents the delay in microseconds and the value
+		 *    is in decimal
+		 */
+		tmp += ZL3073X_FW_COMMAND_SIZE;
+
+		tmp += ZL3073X_FW_WHITESPACES_SIZE;
+		if (kstrtoul(tmp, 10, &parsed_value)) {
+			err = -EINVAL;
+			break;
+		}
+		delay = (u32)parsed_value;
+
+		usleep_range(delay / 2, delay);
+		break;
+	default:
+		break;
+	}
+
+	return err;
+}
+
+static int zl3073x_firmware_load(struct zl3073x *zl3073x)
+{
+	char fname[128] = ZL3073X_FW_FILENAME;
+	const struct firmware *fw;
+	size_t line_number = 0;
+	const char *line;
+	int err = 0;
+
+	err = request_firmware(&fw, fname, zl3073x->dev);
+	if (err)
+		return err;
+
+	/* The configuration touches every block of the device */
+	zl3073x_lock_all(zl3073x, ZL3073X_LOCK_FW);
+
+	while (true) {
+		line = _zl3073x_firmware_get_line(fw->data, line_number);
+		if (!line)
+			goto out;
+
+		line_number += 1;
+
+		/* Skip comment lines */
+		if (line[0] == ';')
+			continue;
+
+		err = _zl3073x_firmware_parse_line(zl3073x, line);
+		if (err)
+			goto out;
+	}
+
+out:
+	zl3073x_unlock_all(zl3073x);
+	release_firmware(fw);
+	return err;
+}
+#endif
+
+static struct dentry *zl3073x_debugfs_root;
+
+static int zl3073x_debugfs_ref_mon_status_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	int override;
+
+	for (int i = 0; i < zl3073x->info->num_refs; i++) {
+		override = READ_ONCE(zl3073x->ref_mon_status_override[i]);
+
+		if (override == ZL3073X_REF_MON_STATUS_NO_OVERRIDE)
+			seq_printf(s, "ref%d: hw\n", i);
+		else
+			seq_printf(s, "ref%d: 0x%02x\n", i, override);
+	}
+
+	return 0;
+}
+
+static int zl3073x_debugfs_ref_mon_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_ref_mon_status_show, inode->i_private);
+}
+
+/* Accepted input:
+ *	"<ref> <status>"	report <status> as DPLL_REF_MON_STATUS of <ref>
+ *	"<ref> hw"		report the value read from the device again
+ *	"hw"			drop all overrides
+ * A non-zero status disqualifies the reference, e.g. "3 0x01" simulates
+ * loss of signal on REF3 until "3 hw" is written.
+ */
+static ssize_t zl3073x_debugfs_ref_mon_status_write(struct file *file,
+						    const char __user *ubuf,
+						    size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+	unsigned int ref, status;
+	char buf[32];
+	char *arg;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	arg = strim(buf);
+
+	if (!strcmp(arg, "hw")) {
+		for (int i = 0; i < zl3073x->info->num_refs; i++)
+			WRITE_ONCE(zl3073x->ref_mon_status_override[i],
+				   ZL3073X_REF_MON_STATUS_NO_OVERRIDE);
+		return count;
+	}
+
+	arg = strchr(buf, ' ');
+	if (!arg)
+		return -EINVAL;
+
+	*arg++ = '\0';
+	arg = skip_spaces(arg);
+
+	ret = kstrtouint(buf, 0, &ref);
+	if (ret)
+		return ret;
+
+	if (!ZL3073X_CHECK_REF_ID(zl3073x, ref))
+		return -EINVAL;
+
+	if (!strcmp(arg, "hw")) {
+		WRITE_ONCE(zl3073x->ref_mon_status_override[ref],
+			   ZL3073X_REF_MON_STATUS_NO_OVERRIDE);
+		return count;
+	}
+
+	ret = kstrtouint(arg, 0, &status);
+	if (ret)
+		return ret;
+
+	if (status > U8_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(zl3073x->ref_mon_status_override[ref], status);
+
+	return count;
+}
+
+static const struct file_operations zl3073x_debugfs_ref_mon_status_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_ref_mon_status_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_ref_mon_status_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void zl3073x_debugfs_lock_stats_show_res(struct seq_file *s,
+						const char *name,
+						struct zl3073x_lock_stats *snap,
+						u64 now)
+{
+	for (int i = 0; i < ZL3073X_LOCK_CLASS_MAX; i++) {
+		struct zl3073x_lock_class_stats *cs = &snap->class[i];
+
+		if (!cs->acquisitions)
+			continue;
+
+		seq_printf(s, "%-10s %-8s %12llu %12llu %14llu %12llu %14llu %12llu\n",
+			   name, zl3073x_lock_class_names[i], cs->acquisitions,
+			   cs->contended, div_u64(cs->wait_total_ns, NSEC_PER_USEC),
+			   div_u64(cs->wait_max_ns, NSEC_PER_USEC),
+			   div_u64(cs->hold_total_ns, NSEC_PER_USEC),
+			   div_u64(cs->hold_max_ns, NSEC_PER_USEC));
+	}
+
+	if (snap->longest_holder)
+		seq_printf(s, "%-10s longest hold: %llu us by %s (%s)\n", name,
+			   div_u64(snap->longest_ns, NSEC_PER_USEC),
+			   snap->longest_holder,
+			   zl3073x_lock_class_names[snap->longest_class]);
+
+	if (snap->holder)
+		seq_printf(s, "%-10s held by: %s (%s) for %llu us\n", name,
+			   snap->holder,
+			   zl3073x_lock_class_names[snap->holder_class],
+			   div_u64(now - snap->acquired_ns, NSEC_PER_USEC));
+}
+
+static int zl3073x_debugfs_lock_stats_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	struct zl3073x_lock_stats snap;
+	u64 now = ktime_get_ns();
+	char name[16];
+	int res;
+
+	seq_printf(s, "%-10s %-8s %12s %12s %14s %12s %14s %12s\n", "lock",
+		   "class", "acquired", "contended", "wait_total_us",
+		   "wait_max_us", "hold_total_us", "hold_max_us");
+
+	for (res = 0; res < ZL3073X_RES_MAX; res++) {
+		if (!zl3073x_res_present(zl3073x, res))
+			continue;
+
+		spin_lock(&zl3073x->lock_stats_lock);
+		snap = zl3073x->res_lock[res].stats;
+		spin_unlock(&zl3073x->lock_stats_lock);
+
+		zl3073x_res_name(res, name, sizeof(name));
+		zl3073x_debugfs_lock_stats_show_res(s, name, &snap, now);
+	}
+
+	return 0;
+}
+
+static int zl3073x_debugfs_lock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_lock_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters; the current holders are kept */
+static ssize_t zl3073x_debugfs_lock_stats_write(struct file *file,
+						const char __user *ubuf,
+						size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+
+	spin_lock(&zl3073x->lock_stats_lock);
+	for (int res = 0; res < ZL3073X_RES_MAX; res++) {
+		struct zl3073x_lock_stats *stats = &zl3073x->res_lock[res].stats;
+
+		memset(stats->class, 0, sizeof(stats->class));
+		stats->longest_ns = 0;
+		stats->longest_holder = NULL;
+	}
+	spin_unlock(&zl3073x->lock_stats_lock);
+
+	return count;
+}
+
+static const struct file_operations zl3073x_debugfs_lock_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_lock_stats_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_lock_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const char * const zl3073x_bus_class_names[MICROCHIP_DPLL_BUS_CLASS_MAX] = {
+	[MICROCHIP_DPLL_BUS_CRITICAL] = "critical",
+	[MICROCHIP_DPLL_BUS_BACKGROUND] = "background",
+};
+
+static int zl3073x_debugfs_bus_stats_show(struct seq_file *s, void *unused)
+{
+	struct microchip_dpll_bus_stats stats[MICROCHIP_DPLL_BUS_CLASS_MAX];
+	struct zl3073x *zl3073x = s->private;
+	struct microchip_dpll_bus_errors errors;
+
+	microchip_dpll_bus_stats_get(zl3073x->ddata, stats);
+
+	seq_printf(s, "%-10s %12s %14s %12s %12s %10s\n", "class", "accesses",
+		   "wait_total_us", "wait_avg_ns", "wait_max_us", "yields");
+
+	for (int i = 0; i < MICROCHIP_DPLL_BUS_CLASS_MAX; i++) {
+		struct microchip_dpll_bus_stats *bs = &stats[i];
+
+		seq_printf(s, "%-10s %12llu %14llu %12llu %12llu %10llu\n",
+			   zl3073x_bus_class_names[i], bs->transfers,
+			   div_u64(bs->wait_total_ns, NSEC_PER_USEC),
+			   bs->transfers ? div64_u64(bs->wait_total_ns, bs->transfers) : 0,
+			   div_u64(bs->wait_max_ns, NSEC_PER_USEC), bs->yields);
+	}
+
+	seq_printf(s, "\ntransactions %llu page_selects %llu\n",
+		   microchip_dpll_bus_xfers(zl3073x->ddata),
+		   microchip_dpll_bus_page_selects(zl3073x->ddata));
+
+	microchip_dpll_bus_errors_get(zl3073x->ddata, &errors);
+	seq_printf(s, "errors %llu retries %llu budget_exhausted %llu failures %llu\n",
+		   errors.errors, errors.retries, errors.budget_exhausted, errors.failures);
+
+	return 0;
+}
+
+static int zl3073x_debugfs_bus_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_bus_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters */
+static ssize_t zl3073x_debugfs_bus_stats_write(struct file *file,
+					       const char __user *ubuf,
+					       size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+
+	microchip_dpll_bus_stats_reset(zl3073x->ddata);
+
+	return count;
+}
+
+static const struct file_operations zl3073x_debugfs_bus_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_bus_stats_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_bus_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const char *zl3073x_lock_status_name(u32 status)
+{
+	switch (status) {
+	case DPLL_LOCK_STATUS_UNLOCKED:
+		return "unlocked";
+	case DPLL_LOCK_STATUS_LOCKED:
+		return "locked";
+	case DPLL_LOCK_STATUS_LOCKED_HO_ACQ:
+		return "locked-ho-acq";
+	case DPLL_LOCK_STATUS_HOLDOVER:
+		return "holdover";
+	default:
+		return "none";
+	}
+}
+
+static void zl3073x_debugfs_journal_val(struct seq_file *s, const struct zl3073x_journal_entry *e,
+					u32 val)
+{
+	if (e->type == ZL3073X_JOURNAL_LOCK)
+		seq_printf(s, "%s", zl3073x_lock_status_name(val));
+	else if (e->type == ZL3073X_JOURNAL_REF && val == DPLL_REF_INVALID)
+		seq_puts(s, "none");
+	else if (e->type == ZL3073X_JOURNAL_REF_STATUS)
+		seq_printf(s, "0x%02x", val);
+	else
+		seq_printf(s, "%u", val);
+}
+
+/* Copied out under the lock, then printed oldest first */
+static int zl3073x_debugfs_journal_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	struct zl3073x_journal *journal = &zl3073x->journal;
+	struct zl3073x_journal_entry *entries;
+	u64 cleared, first, seq;
+	u32 n;
+
+	entries = kmalloc_array(ZL3073X_JOURNAL_ENTRIES, sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	spin_lock(&journal->lock);
+	seq = journal->seq;
+	cleared = journal->first;
+	first = max(cleared, seq > ZL3073X_JOURNAL_ENTRIES ?
+				    seq - ZL3073X_JOURNAL_ENTRIES : 0);
+	n = seq - first;
+	for (u32 i = 0; i < n; i++)
+		entries[i] = journal->ring[(first + i) % ZL3073X_JOURNAL_ENTRIES];
+	spin_unlock(&journal->lock);
+
+	seq_printf(s, "entries: %llu, lost: %llu\n", seq - cleared, first - cleared);
+	seq_printf(s, "%8s %16s %20s %-10s %4s %4s %-28s %14s %12s\n", "seq", "mono_ns",
+		   "tod", "type", "dpll", "ref", "transition", "phase_ps", "ffo_ppb");
+
+	for (u32 i = 0; i < n; i++) {
+		const struct zl3073x_journal_entry *e = &entries[i];
+		struct timespec64 tod = ns_to_timespec64(e->tod_ns);
+
+		seq_printf(s, "%8llu %16llu ", e->seq, e->mono_ns);
+		if (e->tod_valid)
+			seq_printf(s, "%10lld.%09ld ", tod.tv_sec, tod.tv_nsec);
+		else
+			seq_printf(s, "%20s ", "-");
+		seq_printf(s, "%-10s %4u ", zl3073x_journal_type_names[e->type], e->dpll);
+		if (e->ref == DPLL_REF_INVALID)
+			seq_printf(s, "%4s ", "-");
+		else
+			seq_printf(s, "%4u ", e->ref);
+		zl3073x_debugfs_journal_val(s, e, e->old_val);
+		seq_puts(s, " -> ");
+		zl3073x_debugfs_journal_val(s, e, e->new_val);
+		seq_printf(s, " %lld %lld\n", e->phase_offset, (e->ffo * NSEC_PER_SEC) >> 32);
+	}
+
+	kfree(entries);
+	return 0;
+}
+
+static int zl3073x_debugfs_journal_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_journal_show, inode->i_private);
+}
+
+/* Any write hides the entries so far */
+static ssize_t zl3073x_debugfs_journal_write(struct file *file, const char __user *ubuf,
+					     size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+	struct zl3073x_journal *journal = &zl3073x->journal;
+
+	spin_lock(&journal->lock);
+	journal->first = journal->seq;
+	spin_unlock(&journal->lock);
+
+	return count;
+}
+
+static const struct file_operations zl3073x_debugfs_journal_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_journal_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_journal_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Updated by the monitor worker at the end of every sweep */
+static int zl3073x_debugfs_monitor_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	struct zl3073x_monitor *mon = &zl3073x->mon;
+	u64 sweeps = READ_ONCE(mon->sweeps);
+
+	seq_printf(s, "sweeps: %llu\n", sweeps);
+	seq_printf(s, "page_selects_last: %llu\n", READ_ONCE(mon->selects_last));
+	seq_printf(s, "page_selects_max: %llu\n", READ_ONCE(mon->selects_max));
+	seq_printf(s, "page_selects_avg: %llu\n",
+		   sweeps ? div64_u64(READ_ONCE(mon->selects_total), sweeps) : 0);
+
+	return 0;
+}
+
+static int zl3073x_debugfs_monitor_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_monitor_show, inode->i_private);
+}
+
+static const struct file_operations zl3073x_debugfs_monitor_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_monitor_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Benchmarked operations. Each one goes through the same locking as its
+ * regular users, so the figures include lock and bus arbitration waits.
+ */
+enum zl3073x_bench_index {
+	ZL3073X_BENCH_INDEX_PTP,
+	ZL3073X_BENCH_INDEX_REF,
+	ZL3073X_BENCH_INDEX_SYNTH,
+	ZL3073X_BENCH_INDEX_OUTPUT,
+};
+
+struct zl3073x_bench_op {
+	const char		*name;
+	enum zl3073x_bench_index index_type;
+	int			(*run)(struct zl3073x *zl3073x, int index);
+};
+
+static int zl3073x_bench_tod_latch(struct zl3073x *zl3073x, int index)
+{
+	struct zl3073x_dpll *dpll = &zl3073x->dpll[index];
+	struct timespec64 ts;
+	int ret;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(index), ZL3073X_LOCK_PTP);
+	ret = _zl3073x_ptp_gettime64(dpll, &ts, ZL3073X_TOD_CTRL_CMD_READ, NULL);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(index));
+
+	return ret;
+}
+
+static int zl3073x_bench_synth_freq(struct zl3073x *zl3073x, int index)
+{
+	u64 freq;
+	int ret;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_SYNTH_MB, ZL3073X_LOCK_DPLL);
+	ret = zl3073x_synth_freq_read(zl3073x, index, &freq);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_SYNTH_MB);
+
+	return ret;
+}
+
+static int zl3073x_bench_ref_mb(struct zl3073x *zl3073x, int index)
+{
+	u64 freq;
+
+	return zl3073x_dpll_get_input_frequency(zl3073x, index, &freq);
+}
+
+static int zl3073x_bench_dpll_mb(struct zl3073x *zl3073x, int index)
+{
+	u32 prio;
+
+	return zl3073x_dpll_get_priority_ref(zl3073x, ZL3073X_PTP_CLOCK_DPLL, index, &prio);
+}
+
+static int zl3073x_bench_output_freq(struct zl3073x *zl3073x, int index)
+{
+	u64 freq;
+
+	return zl3073x_dpll_get_output_frequency(zl3073x, index, &freq);
+}
+
+static int zl3073x_bench_phase_meas(struct zl3073x *zl3073x, int index)
+{
+	s64 offset;
+
+	return zl3073x_dpll_phase_offset_get(zl3073x, &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL],
+					     index, &offset);
+}
+
+static int zl3073x_bench_ffo_meas(struct zl3073x *zl3073x, int index)
+{
+	s64 ffo;
+
+	return zl3073x_dpll_ffo_get(zl3073x, ZL3073X_PTP_CLOCK_DPLL, index, &ffo);
+}
+
+static const struct zl3073x_bench_op zl3073x_bench_ops[] = {
+	{ "tod_latch",	 ZL3073X_BENCH_INDEX_PTP,    zl3073x_bench_tod_latch },
+	{ "synth_freq",	 ZL3073X_BENCH_INDEX_SYNTH,  zl3073x_bench_synth_freq },
+	{ "ref_mb",	 ZL3073X_BENCH_INDEX_REF,    zl3073x_bench_ref_mb },
+	{ "dpll_mb",	 ZL3073X_BENCH_INDEX_REF,    zl3073x_bench_dpll_mb },
+	{ "output_freq", ZL3073X_BENCH_INDEX_OUTPUT, zl3073x_bench_output_freq },
+	{ "phase_meas",	 ZL3073X_BENCH_INDEX_REF,    zl3073x_bench_phase_meas },
+	{ "ffo_meas",	 ZL3073X_BENCH_INDEX_REF,    zl3073x_bench_ffo_meas },
+};
+
+static bool zl3073x_bench_index_valid(struct zl3073x *zl3073x,
+				      enum zl3073x_bench_index type, int index)
+{
+	switch (type) {
+	case ZL3073X_BENCH_INDEX_PTP:
+		/* Only this DPLL has a PTP clock and a calibrated latch */
+		return IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X) &&
+		       index == ZL3073X_PTP_CLOCK_DPLL;
+	case ZL3073X_BENCH_INDEX_REF:
+		return ZL3073X_CHECK_REF_ID(zl3073x, index);
+	case ZL3073X_BENCH_INDEX_SYNTH:
+		return ZL3073X_CHECK_SYNTH_ID(index);
+	case ZL3073X_BENCH_INDEX_OUTPUT:
+		return ZL3073X_CHECK_OUTPUT_ID(zl3073x, index);
+	}
+
+	return false;
+}
+
+static int zl3073x_bench_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u64 zl3073x_bench_bus_accesses(struct zl3073x *zl3073x)
+{
+	struct microchip_dpll_bus_stats stats[MICROCHIP_DPLL_BUS_CLASS_MAX];
+	u64 transfers = 0;
+
+	microchip_dpll_bus_stats_get(zl3073x->ddata, stats);
+	for (int i = 0; i < MICROCHIP_DPLL_BUS_CLASS_MAX; i++)
+		transfers += stats[i].transfers;
+
+	return transfers;
+}
+
+static int zl3073x_bench_run(struct zl3073x *zl3073x, const struct zl3073x_bench_op *op,
+			     int index, u32 iterations)
+{
+	struct zl3073x_bench_result res = {
+		.op = op->name,
+		.index = index,
+	};
+	u64 start, end, cpu, accesses, transactions;
+	u64 *samples;
+	u32 n = 0;
+	int ret;
+
+	samples = kvmalloc_array(iterations, sizeof(*samples), GFP_KERNEL);
+	if (!samples)
+		return -ENOMEM;
+
+	cpu = current->se.sum_exec_runtime;
+	accesses = zl3073x_bench_bus_accesses(zl3073x);
+	transactions = microchip_dpll_bus_xfers(zl3073x->ddata);
+	start = ktime_get_ns();
+
+	for (u32 i = 0; i < iterations; i++) {
+		u64 t0 = ktime_get_ns();
+
+		ret = op->run(zl3073x, index);
+		if (ret) {
+			res.errors++;
+			res.last_error = ret;
+		} else {
+			samples[n++] = ktime_get_ns() - t0;
+		}
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+
+	end = ktime_get_ns();
+	res.iterations = n + res.errors;
+	res.wall_ns = end - start;
+	res.cpu_ns = current->se.sum_exec_runtime - cpu;
+	res.accesses = zl3073x_bench_bus_accesses(zl3073x) - accesses;
+	res.transactions = microchip_dpll_bus_xfers(zl3073x->ddata) - transactions;
+
+	if (n) {
+		sort(samples, n, sizeof(*samples), zl3073x_bench_cmp, NULL);
+		res.min_ns = samples[0];
+		res.median_ns = samples[n / 2];
+		res.p99_ns = samples[min_t(u32, n - 1, div_u64((u64)n * 99, 100))];
+		res.max_ns = samples[n - 1];
+	}
+
+	kvfree(samples);
+
+	zl3073x->bench = res;
+
+	return 0;
+}
+
+static int zl3073x_debugfs_bench_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	struct zl3073x_bench_result *res = &zl3073x->bench;
+	u32 ok;
+
+	mutex_lock(&zl3073x->bench_lock);
+
+	if (!res->op) {
+		seq_puts(s, "ops:");
+		for (int i = 0; i < ARRAY_SIZE(zl3073x_bench_ops); i++)
+			seq_printf(s, " %s", zl3073x_bench_ops[i].name);
+		seq_puts(s, "\n");
+		goto out;
+	}
+
+	ok = res->iterations - res->errors;
+	seq_printf(s, "op: %s %d\n", res->op, res->index);
+	seq_printf(s, "iterations: %u\n", res->iterations);
+	seq_printf(s, "errors: %u (last %d)\n", res->errors, res->last_error);
+	seq_printf(s, "min_ns: %llu\n", res->min_ns);
+	seq_printf(s, "median_ns: %llu\n", res->median_ns);
+	seq_printf(s, "p99_ns: %llu\n", res->p99_ns);
+	seq_printf(s, "max_ns: %llu\n", res->max_ns);
+	seq_printf(s, "wall_ns: %llu\n", res->wall_ns);
+	seq_printf(s, "cpu_ns: %llu\n", res->cpu_ns);
+	seq_printf(s, "bus_accesses: %llu (%llu per op)\n", res->accesses,
+		   ok ? div_u64(res->accesses, ok) : 0);
+	seq_printf(s, "bus_transactions: %llu (%llu per op)\n", res->transactions,
+		   ok ? div_u64(res->transactions, ok) : 0);
+
+out:
+	mutex_unlock(&zl3073x->bench_lock);
+	return 0;
+}
+
+static int zl3073x_debugfs_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_bench_show, inode->i_private);
+}
+
+/* Accepted input: "<op> <iterations> [<index>]". The run is synchronous, in
+ * the context of the writer; reading the file returns the last result.
+ */
+static ssize_t zl3073x_debugfs_bench_write(struct file *file,
+					   const char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+	const struct zl3073x_bench_op *op = NULL;
+	unsigned int iterations;
+	char name[16];
+	char buf[48];
+	int index = 0;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	ret = sscanf(buf, "%15s %u %d", name, &iterations, &index);
+	if (ret < 2)
+		return -EINVAL;
+
+	if (!iterations || iterations > ZL3073X_BENCH_MAX_ITERATIONS)
+		return -EINVAL;
+
+	for (int i = 0; i < ARRAY_SIZE(zl3073x_bench_ops); i++) {
+		if (!strcmp(name, zl3073x_bench_ops[i].name)) {
+			op = &zl3073x_bench_ops[i];
+			break;
+		}
+	}
+
+	if (!op || !zl3073x_bench_index_valid(zl3073x, op->index_type, index))
+		return -EINVAL;
+
+	mutex_lock(&zl3073x->bench_lock);
+	ret = zl3073x_bench_run(zl3073x, op, index, iterations);
+	mutex_unlock(&zl3073x->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations zl3073x_debugfs_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_bench_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int zl3073x_debugfs_servo_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x_dpll *dpll = s->private;
+	struct zl3073x_servo *servo = &dpll->servo;
+
+	mutex_lock(&servo->lock);
+
+	if (servo->running)
+		seq_printf(s, "state: running, ref %u\n", servo->ref);
+	else
+		seq_puts(s, "state: stopped\n");
+	seq_printf(s, "kp: %u\n", servo->kp);
+	seq_printf(s, "ki: %u\n", servo->ki);
+	seq_printf(s, "step_ns: %u\n", servo->step_ns);
+	seq_printf(s, "samples: %llu\n", servo->samples);
+	seq_printf(s, "steps: %llu\n", servo->steps);
+	seq_printf(s, "unqualified: %llu\n", servo->unqualified);
+	seq_printf(s, "errors: %llu (last %d)\n", servo->errors, servo->last_error);
+	seq_printf(s, "offset_ns: %lld\n", servo->offset_ns);
+	seq_printf(s, "offset_max_ns: %lld\n", servo->offset_max_ns);
+	seq_printf(s, "offset_rms_ns: %llu\n",
+		   servo->samples ? int_sqrt64(div64_u64(servo->offset_sq_sum, servo->samples)) : 0);
+	seq_printf(s, "freq_ppt: %lld\n", servo->freq_ppt);
+	seq_printf(s, "integral_ppt: %lld\n", servo->integral_ppt);
+
+	mutex_unlock(&servo->lock);
+	return 0;
+}
+
+static int zl3073x_debugfs_servo_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_servo_show, inode->i_private);
+}
+
+/* Accepted input:
+ *	"start <ref>"		steer the PTP clock to the 1PPS on <ref>
+ *	"stop"			hand the clock back to adjfine/adjtime
+ *	"kp <ppt/ns>", "ki <ppt/ns>", "step <ns>"
+ * The gains and the step threshold can be changed while the servo runs.
+ */
+static ssize_t zl3073x_debugfs_servo_write(struct file *file, const char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	struct zl3073x_dpll *dpll = file_inode(file)->i_private;
+	struct zl3073x_servo *servo = &dpll->servo;
+	unsigned int val = 0;
+	char name[8];
+	char buf[32];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	ret = sscanf(buf, "%7s %u", name, &val);
+	if (ret < 1)
+		return -EINVAL;
+
+	if (!strcmp(name, "stop")) {
+		zl3073x_servo_stop(dpll);
+		return count;
+	}
+
+	if (ret < 2)
+		return -EINVAL;
+
+	if (!strcmp(name, "start")) {
+		if (!ZL3073X_CHECK_REF_ID(dpll->zl3073x, val))
+			return -EINVAL;
+
+		ret = zl3073x_servo_start(dpll, val);
+		return ret ? ret : count;
+	}
+
+	mutex_lock(&servo->lock);
+	if (!strcmp(name, "kp"))
+		servo->kp = val;
+	else if (!strcmp(name, "ki"))
+		servo->ki = val;
+	else if (!strcmp(name, "step"))
+		servo->step_ns = val;
+	else
+		ret = -EINVAL;
+	mutex_unlock(&servo->lock);
+
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations zl3073x_debugfs_servo_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_servo_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_servo_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int zl3073x_debugfs_rank_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x *zl3073x = s->private;
+	const struct zl3073x_chip_info *info = zl3073x->info;
+
+	for (int i = 0; i < info->num_dplls; i++) {
+		struct zl3073x_pin_record *rec = &zl3073x->input_pin_record[i * info->num_refs];
+		struct zl3073x_rank *rank = &zl3073x->dpll[i].rank;
+
+		mutex_lock(&rank->lock);
+
+		seq_printf(s, "dpll %d: %s, pool 0x%03x, margin %u%%, hold %u ms, reorders %llu, errors %llu\n",
+			   i, rank->enabled ? "enabled" : "disabled", rank->pool, rank->margin,
+			   rank->hold_ms, rank->reorders, rank->errors);
+
+		/* Allan deviation is the root of half the mean squared difference */
+		for (int j = 0; j < info->num_refs; j++)
+			seq_printf(s, "  ref %d: prio %u, %s, samples %u, adev_phase_ppt %llu, adev_ffo_ppt %llu\n",
+				   j, rec[j].priority,
+				   zl3073x->ref_status[j] ? "disqualified" : "qualified",
+				   rec[j].rank.samples, int_sqrt64(rec[j].rank.phase_var / 2),
+				   int_sqrt64(rec[j].rank.ffo_var / 2));
+
+		mutex_unlock(&rank->lock);
+	}
+
+	return 0;
+}
+
+static int zl3073x_debugfs_rank_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_rank_show, inode->i_private);
+}
+
+/* Accepted input:
+ *	"enable <dpll> <pool>"	rank the references in the <pool> mask
+ *	"disable <dpll>"	leave the priorities as they are
+ *	"margin <dpll> <%>", "hold <dpll> <ms>"
+ */
+static ssize_t zl3073x_debugfs_rank_write(struct file *file, const char __user *ubuf,
+					  size_t count, loff_t *ppos)
+{
+	struct zl3073x *zl3073x = file_inode(file)->i_private;
+	struct zl3073x_rank *rank;
+	unsigned int dpll_index;
+	unsigned int val = 0;
+	char name[8];
+	char buf[32];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	ret = sscanf(buf, "%7s %u %i", name, &dpll_index, &val);
+	if (ret < 2 || dpll_index >= zl3073x->info->num_dplls)
+		return -EINVAL;
+
+	rank = &zl3073x->dpll[dpll_index].rank;
+
+	if (!strcmp(name, "disable")) {
+		mutex_lock(&rank->lock);
+		rank->enabled = false;
+		mutex_unlock(&rank->lock);
+		return count;
+	}
+
+	if (ret < 3)
+		return -EINVAL;
+
+	mutex_lock(&rank->lock);
+	if (!strcmp(name, "enable") && val && !(val & ~GENMASK(zl3073x->info->num_refs - 1, 0))) {
+		rank->pool = val;
+		rank->enabled = true;
+		rank->last = jiffies;
+	} else if (!strcmp(name, "margin") && val <= ZL3073X_RANK_MARGIN_MAX) {
+		rank->margin = val;
+	} else if (!strcmp(name, "hold")) {
+		rank->hold_ms = val;
+	} else {
+		ret = -EINVAL;
+	}
+	mutex_unlock(&rank->lock);
+
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations zl3073x_debugfs_rank_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_rank_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_rank_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int zl3073x_debugfs_latch_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x_dpll *dpll = s->private;
+	struct zl3073x *zl3073x = dpll->zl3073x;
+	struct zl3073x_latch *latch = &dpll->latch;
+
+	zl3073x_lock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index), ZL3073X_LOCK_PTP);
+
+	seq_printf(s, "bus: %s, %u Hz\n",
+		   zl3073x->ddata->bus_type == MICROCHIP_DPLL_BUS_I2C ? "i2c" : "spi",
+		   zl3073x->ddata->bus_hz);
+	seq_printf(s, "calibrations: %u\n", latch->calibrations);
+	seq_printf(s, "write_min_ns: %llu\n", latch->write_min_ns);
+	seq_printf(s, "cycle_ps: %u\n", latch->cycle_ps);
+	seq_printf(s, "wire_ns: %u\n", latch->wire_ns);
+	seq_printf(s, "latch_ns: %u\n", latch->latch_ns);
+	if (latch->valid)
+		seq_printf(s, "offset_ns: %d\n", latch->offset_ns);
+	else
+		seq_puts(s, "offset_ns: none, midpoint\n");
+
+	zl3073x_unlock(zl3073x, ZL3073X_RES_TOD_OF(dpll->index));
+	return 0;
+}
+
+static int zl3073x_debugfs_latch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_latch_show, inode->i_private);
+}
+
+/* Writing "calibrate" runs the calibration again */
+static ssize_t zl3073x_debugfs_latch_write(struct file *file, const char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	struct zl3073x_dpll *dpll = file_inode(file)->i_private;
+	char buf[16];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	if (!sysfs_streq(buf, "calibrate"))
+		return -EINVAL;
+
+	ret = zl3073x_latch_calibrate(dpll);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations zl3073x_debugfs_latch_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_latch_open,
+	.read = seq_read,
+	.write = zl3073x_debugfs_latch_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int zl3073x_debugfs_dco_show(struct seq_file *s, void *unused)
+{
+	struct zl3073x_dpll *dpll = s->private;
+	struct zl3073x_dco *dco = &dpll->dco;
+
+	mutex_lock(&dco->lock);
+
+	seq_printf(s, "target_scaled_ppm: %lld\n", dco->target);
+	seq_printf(s, "cur_scaled_ppm: %lld\n", dco->cur);
+	seq_printf(s, "ramp: %s, %u ppb/s\n", dco->ramping ? "running" : "idle",
+		   dco->ramp_rate);
+	if (dco->slew_ppb)
+		seq_printf(s, "slew: running, %d ppb, %lld ns left\n", dco->slew_ppb,
+			   zl3073x_dco_slew_left(dco, ktime_get_ns()));
+	else
+		seq_puts(s, "slew: idle\n");
+	seq_printf(s, "slew_max_ns: %u\n", dco->slew_max_ns);
+	seq_printf(s, "slew_rate: %u\n", dco->slew_rate);
+	seq_printf(s, "slews: %llu\n", dco->slews);
+	seq_printf(s, "slewed_ns: %llu\n", dco->slewed_ns);
+
+	mutex_unlock(&dco->lock);
+	return 0;
+}
+
+static int zl3073x_debugfs_dco_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zl3073x_debugfs_dco_show, inode->i_private);
+}
+
+static const struct file_operations zl3073x_debugfs_dco_fops = {
+	.owner = THIS_MODULE,
+	.open = zl3073x_debugfs_dco_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void zl3073x_debugfs_init(struct zl3073x *zl3073x)
+{
+	zl3073x->debugfs = debugfs_create_dir(dev_name(zl3073x->dev),
+					      zl3073x_debugfs_root);
+
+	debugfs_create_file("ref_mon_status", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_ref_mon_status_fops);
+	debugfs_create_file("lock_stats", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_lock_stats_fops);
+	debugfs_create_file("bus_stats", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_bus_stats_fops);
+	debugfs_create_file("bench", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_bench_fops);
+	debugfs_create_file("rank", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_rank_fops);
+	debugfs_create_file("monitor", 0400, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_monitor_fops);
+	debugfs_create_file("journal", 0600, zl3073x->debugfs, zl3073x,
+			    &zl3073x_debugfs_journal_fops);
+#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
+	debugfs_create_file("servo", 0600, zl3073x->debugfs,
+			    &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL],
+			    &zl3073x_debugfs_servo_fops);
+	debugfs_create_file("dco", 0400, zl3073x->debugfs,
+			    &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL],
+			    &zl3073x_debugfs_dco_fops);
+	debugfs_create_file("latch", 0600, zl3073x->debugfs,
+			    &zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL],
+			    &zl3073x_debugfs_latch_fops);
+#endif
+}
+
+static void zl3073x_debugfs_exit(struct zl3073x *zl3073x)
+{
+	debugfs_remove_recursive(zl3073x->debugfs);
+	zl3073x->debugfs = NULL;
+}
+
+static int zl3073x_chip_detect(struct zl3073x *zl3073x)
+{
+	u8 buf[2];
+	int ret;
+
+	ret = zl3073x_read(zl3073x, DPLL_CHIP_ID_REG, buf, sizeof(buf));
+	if (ret)
+		return ret;
+
+	zl3073x->chip_id = zl3073x_get_be(buf, sizeof(buf));
+
+	zl3073x->info = zl3073x_chip_info_lookup(zl3073x->chip_id);
+	if (zl3073x->info)
+		goto out;
+
+	dev_warn(zl3073x->dev, "unknown chip ID 0x%04x, assuming %u DPLLs\n",
+		 zl3073x->chip_id, zl3073x_chip_info_default.num_dplls);
+	zl3073x->info = &zl3073x_chip_info_default;
+
+out:
+	dev_dbg(zl3073x->dev, "chip ID 0x%04x: %u DPLLs, %u refs, %u outputs\n",
+		zl3073x->chip_id, zl3073x->info->num_dplls, zl3073x->info->num_refs,
+		zl3073x->info->num_outputs);
+	return 0;
+}
+
+static int zl3073x_alloc(struct zl3073x *zl3073x)
+{
+	const struct zl3073x_chip_info *info = zl3073x->info;
+	struct device *dev = zl3073x->dev;
+
+	zl3073x->dpll = devm_kcalloc(dev, info->num_dplls, sizeof(*zl3073x->dpll), GFP_KERNEL);
+	zl3073x->dpll_record = devm_kcalloc(dev, info->num_dplls,
+					    sizeof(*zl3073x->dpll_record), GFP_KERNEL);
+	zl3073x->input_pin_record = devm_kcalloc(dev, info->num_dplls * info->num_refs,
+						 sizeof(*zl3073x->input_pin_record),
+						 GFP_KERNEL);
+	zl3073x->pin = devm_kcalloc(dev, ZL3073X_NUM_PINS(zl3073x), sizeof(*zl3073x->pin),
+				    GFP_KERNEL);
+	zl3073x->ref_mon_status_override =
+		devm_kcalloc(dev, info->num_refs,
+			     sizeof(*zl3073x->ref_mon_status_override), GFP_KERNEL);
+	zl3073x->ref_status = devm_kcalloc(dev, info->num_refs, sizeof(*zl3073x->ref_status),
+					   GFP_KERNEL);
+	zl3073x->status_record = devm_kzalloc(dev, sizeof(*zl3073x->status_record), GFP_KERNEL);
+	zl3073x->journal.ring = devm_kcalloc(dev, ZL3073X_JOURNAL_ENTRIES,
+					     sizeof(*zl3073x->journal.ring), GFP_KERNEL);
+
+	if (!zl3073x->dpll || !zl3073x->dpll_record || !zl3073x->input_pin_record ||
+	    !zl3073x->pin || !zl3073x->ref_mon_status_override || !zl3073x->ref_status ||
+	    !zl3073x->status_record || !zl3073x->journal.ring)
+		return -ENOMEM;
+
+	for (int i = 0; i < info->num_dplls; i++) {
+		zl3073x->dpll_record[i].selected_ref = DPLL_REF_INVALID;
+		spin_lock_init(&zl3073x->dpll[i].sample_lock);
+		mutex_init(&zl3073x->dpll[i].rank.lock);
+		zl3073x->dpll[i].rank.margin = ZL3073X_RANK_MARGIN_DEFAULT;
+		zl3073x->dpll[i].rank.hold_ms = ZL3073X_RANK_HOLD_MS_DEFAULT;
+	}
+	seqlock_init(&zl3073x->status_record_lock);
+	spin_lock_init(&zl3073x->journal.lock);
+
+	return 0;
+}
+
+static int zl3073x_probe(struct platform_device *pdev)
+{
+	struct microchip_dpll_ddata *ddata = dev_get_drvdata(pdev->dev.parent);
+	struct zl3073x *zl3073x;
+	int err;
+
+	zl3073x = devm_kzalloc(&pdev->dev, sizeof(struct zl3073x), GFP_KERNEL);
+	if (!zl3073x)
+		return -ENOMEM;
+
+	zl3073x->dev = &pdev->dev;
+	zl3073x->mfd = pdev->dev.parent;
+	zl3073x->ddata = ddata;
+	zl3073x->regmap = ddata->regmap;
+	zl3073x_res_lock_init(zl3073x);
+	mutex_init(&zl3073x->bench_lock);
+
+	err = zl3073x_chip_detect(zl3073x);
+	if (err)
+		return err;
+
+	err = zl3073x_alloc(zl3073x);
+	if (err)
+		return err;
+
+	for (int i = 0; i < zl3073x->info->num_refs; i++)
+		zl3073x->ref_mon_status_override[i] = ZL3073X_REF_MON_STATUS_NO_OVERRIDE;
+
+#if IS_ENABLED(CONFIG_ZL3073X_MFG_FILE_AVAILABLE)
+	zl3073x_firmware_load(zl3073x);
+#endif
+
+	/* Without the cache every lookup goes to the chip, so a failure here
+	 * is not fatal
+	 */
+	zl3073x_lock(zl3073x, ZL3073X_RES_SYNTH_MB, ZL3073X_LOCK_DPLL);
+	err = zl3073x_topo_refresh(zl3073x);
+	zl3073x_unlock(zl3073x, ZL3073X_RES_SYNTH_MB);
+	if (err)
+		dev_warn(zl3073x->dev, "topology cache disabled: %d\n", err);
+
+	err = zl3073x_output_state_init(zl3073x);
+	if (err)
+		return err;
+
+#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
+	err = zl3073x_ptp_init(zl3073x, ZL3073X_PTP_CLOCK_DPLL);
+	if (err)
+		return err;
+#endif
+
+#if IS_ENABLED(CONFIG_DPLL)
+	err = zl3073x_dpll_init(zl3073x);
+	if (err)
+		goto err_ptp;
+
+	err = zl3073x_coord_join(zl3073x);
+	if (err)
+		goto err_dpll;
+#endif
+
+	platform_set_drvdata(pdev, zl3073x);
+
+	zl3073x_debugfs_init(zl3073x);
+
+	/* Initial firmware fine phase correction */
+	err = zl3073x_dpll_init_fine_phase_adjust(zl3073x);
+	if (err)
+		goto err_debugfs;
+
+	mutex_lock(&zl3073x_devices_lock);
+	list_add_tail_rcu(&zl3073x->node, &zl3073x_devices);
+	mutex_unlock(&zl3073x_devices_lock);
+
+	return 0;
+
+err_debugfs:
+	zl3073x_debugfs_exit(zl3073x);
+#if IS_ENABLED(CONFIG_DPLL)
+	/* The monitor may have published a status already */
+	zl3073x_coord_leave(zl3073x);
+	for (int i = 0; i < zl3073x->info->num_dplls; i++)
+		kfree(rcu_dereference_protected(zl3073x->dpll[i].status, true));
+err_dpll:
+	zl3073x_unregister_all_pins(zl3073x);
+	zl3073x_unregister_all_dplls(zl3073x);
+err_ptp:
+#endif
+#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
+	zl3073x_servo_stop(&zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL]);
+	ptp_clock_unregister(zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].clock);
+	zl3073x_dco_exit(&zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL]);
+#endif
+	return err;
+}
+
+static void zl3073x_remove(struct platform_device *pdev)
+{
+	struct zl3073x *zl3073x = platform_get_drvdata(pdev);
+
+	mutex_lock(&zl3073x_devices_lock);
+	list_del_rcu(&zl3073x->node);
+	mutex_unlock(&zl3073x_devices_lock);
+	synchronize_rcu();
+
+	zl3073x_debugfs_exit(zl3073x);
+
+#if IS_ENABLED(CONFIG_DPLL)
+	zl3073x_coord_leave(zl3073x);
+
+	/* No reader can reach the device and the monitor is stopped */
+	for (int i = 0; i < zl3073x->info->num_dplls; i++)
+		kfree(rcu_dereference_protected(zl3073x->dpll[i].status, true));
+#endif
+
+#if IS_ENABLED(CONFIG_PTP_1588_CLOCK_ZL3073X)
+	zl3073x_servo_stop(&zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL]);
+	ptp_clock_unregister(zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL].clock);
+	zl3073x_dco_exit(&zl3073x->dpll[ZL3073X_PTP_CLOCK_DPLL]);
+#endif
 
 #if IS_ENABLED(CONFIG_DPLL)
 	/* Unregister all pins and dpll */
@@ -4567,12 +7388,33 @@ static struct platform_driver zl3073x_driver = {
 	.driver = {
 		.name = "microchip,zl3073x",
 		.of_match_table = zl3073x_match,
+		.dev_groups = zl3073x_attr_groups,
 	},
 	.probe = zl3073x_probe,
 	.remove	= zl3073x_remove,
 };
 
-module_platform_driver(zl3073x_driver);
+static int __init zl3073x_init(void)
+{
+	int ret;
+
+	zl3073x_debugfs_root = debugfs_create_dir(ZL3073X_DEBUGFS_DIR, NULL);
+
+	ret = platform_driver_register(&zl3073x_driver);
+	if (ret)
+		debugfs_remove_recursive(zl3073x_debugfs_root);
+
+	return ret;
+}
+
+static void __exit zl3073x_exit(void)
+{
+	platform_driver_unregister(&zl3073x_driver);
+	debugfs_remove_recursive(zl3073x_debugfs_root);
+}
+
+module_init(zl3073x_init);
+module_exit(zl3073x_exit);
 
 MODULE_DESCRIPTION("Driver for zl3073x clock devices");
 MODULE_LICENSE("GPL");
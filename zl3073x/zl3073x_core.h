@@ -0,0 +1,919 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* Chip logic of ptp_zl3073x that does not depend on the kernel: the register
+ * map, the mailbox command sequences, the register encoding helpers and the
+ * decisions the monitor takes from raw status values.
+ *
+ * The kernel driver includes it directly. On a development host it builds
+ * against tools/host/zl3073x_host.h, which provides the kernel types and
+ * helpers used here (including read_poll_timeout_atomic()) and a register
+ * model behind regmap, so that the logic can be unit tested, run under the
+ * sanitizers and profiled at native speed.
+ *
+ * The mailbox sequences are written against three primitives of the
+ * including environment, see the declarations below.
+ */
+
+#ifndef __ZL3073X_CORE_H
+#define __ZL3073X_CORE_H
+
+#ifdef __KERNEL__
+#include <linux/bitops.h>
+#include <linux/dpll.h>
+#include <linux/errno.h>
+#include <linux/iopoll.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+#else
+#include "zl3073x_host.h"
+#endif
+
+#define DPLL_CHIP_ID_REG				(0x01)
+
+#define DPLL_REF_MON_STATUS(index)			(0x102 + (index))
+#define DPLL_REF_MON_STATUS_QUALIFIED(val)	(!val)
+
+#define DPLL_MON_STATUS(index)					(0x110 + (index))
+#define DPLL_MON_STATUS_HO_READY_GET(val)		((val & GENMASK(2, 2)) >> 2)
+#define DPLL_LOCK_REFSEL_STATUS(index)			(0x130 + (index))
+#define DPLL_LOCK_REFSEL_LOCK_GET(val)			((val & GENMASK(6, 4)) >> 4)
+#define DPLL_LOCK_REFSEL_REF_GET(val)			((val & GENMASK(3, 0)))
+
+#define DPLL_REF_FREQ_ERR(ref)			(0x144 + (ref) * 0x4)
+
+#define DPLL_REF_PHASE_ERR_RQST			(0x20f)
+#define DPLL_REF_PHASE_ERR_RQST_MASK	GENMASK(0, 0)
+
+#define REF_FREQ_MEAS_CTRL				0x21C
+#define REF_FREQ_MEAS_CTRL_MASK			GENMASK(1, 0)
+
+#define REF_FREQ_MEAS_MASK_3_0			0x21D
+#define REF_FREQ_MEAS_MASK_4			0x21E
+
+#define DPLL_MEAS_REF_FREQ_CTRL			0x21F
+#define DPLL_MEAS_REF_FREQ_MASK_SHIFT	4
+
+#define DPLL_REF_PHASE_ERR(ref)			(0x220 + (ref) * 0x6)
+
+#define DPLL_MODE_REFSEL(index)				(0x284 + (index) * 0x4)
+#define DPLL_MODE_REFSEL_MODE_GET(val)		(val & GENMASK(2, 0))
+#define DPLL_MODE_REFSEL_REF_GET(val)		((val & GENMASK(7, 4)) >> 4)
+
+#define DPLL_TIE_CTRL				0x2b0
+#define DPLL_TIE_CTRL_MASK			GENMASK(2, 0)
+#define DPLL_TIE_CTRL_MASK_REG		0x2b1
+#define DPLL_TIE_CTRL_OPERATION		4
+#define DPLL_TIE_CTRL_SIZE			1
+
+#define DPLL_MEAS_CTRL				(0x2D0)
+#define DPLL_MEAS_CTRL_EN_MASK		GENMASK(0, 0)
+#define DPLL_MEAS_IDX_REG			(0x2D1)
+#define DPLL_MEAS_IDX_MASK			GENMASK(2, 0)
+
+#define DPLL_SYNTH_CTRL(index)				(0x480 + (index))
+#define DPLL_SYNTH_CTRL_DPLL_SEL_GET(val)	((val & GENMASK(6, 4)) >> 4)
+
+#define DPLL_TOD_CTRL(index)		(0x2b8 + (index))
+#define DPLL_TOD_CTRL_SEM			BIT(4)
+
+#define DPLL_DF_OFFSET(index)		(0x300 + (index) * 0x20)
+#define DPLL_TIE_DATA(index)		(0x30c + (index) * 0x20)
+#define DPLL_TOD_SEC(index)			(0x312 + (index) * 0x20)
+#define DPLL_TOD_SEC_SIZE			6
+#define DPLL_TOD_NSEC(index)		(0x318 + (index) * 0x20)
+#define DPLL_TOD_NSEC_SIZE			6
+
+#define DPLL_SYNTH_PHASE_SHIFT_CTRL		0x49e
+#define DPLL_SYNTH_PHASE_SHIFT_MASK		0x49f
+#define DPLL_SYNTH_PHASE_SHIFT_INTVL	0x4a0
+#define DPLL_SYNTH_PHASE_SHIFT_DATA		0x4a1
+
+#define DPLL_OUTPUT_CTRL(index)					(0x4a8 + (index))
+#define DPLL_OUTPUT_CTRL_SIZE					1
+#define DPLL_OUTPUT_CTRL_SYNTH_SEL_GET(val)		((val & GENMASK(6, 4)) >> 4)
+#define DPLL_OUTPUT_CTRL_STOP					BIT(1)
+#define DPLL_OUTPUT_CTRL_STOP_HIGH				BIT(2)
+#define DPLL_OUTPUT_CTRL_STOP_HZ				BIT(3)
+
+#define DPLL_OUTPUT_PHASE_STEP_CTRL					0x4b8
+#define DPLL_OUTPUT_PHASE_STEP_CTRL_SIZE			1
+#define DPLL_OUTPUT_PHASE_STEP_CTRL_OP(cmd)			(cmd & GENMASK(1, 0))
+#define DPLL_OUTPUT_PAHSE_STEP_CTRL_OP_WRITE		3
+#define DPLL_OUTPUT_PHASE_STEP_CTRL_OP_MASK			GENMASK(1, 0)
+#define DPLL_OUTPUT_PHASE_STEP_CTRL_TOD_STEP		BIT(3)
+#define DPLL_OUTPUT_PHASE_STEP_CTRL_DPLL(index)		((index) << 4)
+#define DPLL_OUTPUT_PHASE_STEP_NUMBER				0x4b9
+#define DPLL_OUTPUT_PHASE_STEP_NUMBER_SIZE			1
+#define DPLL_OUTPUT_PHASE_STEP_MASK					0x4ba
+#define DPLL_OUTPUT_PHASE_STEP_MASK_SIZE			2
+#define DPLL_OUTPUT_PHASE_STEP_DATA					0x4bc
+#define DPLL_OUTPUT_PHASE_STEP_DATA_SIZE			4
+
+#define DPLL_REF_MB_MASK								0x502
+#define DPLL_REF_MB_MASK_SIZE							2
+#define DPLL_REF_MB_SEM									0x504
+#define DPLL_REF_MB_SEM_SIZE							1
+#define DPLL_REF_MB_SEM_RD								BIT(1)
+#define DPLL_REF_MB_SEM_WR								BIT(0)
+#define DPLL_REF_FREQ_BASE_REG							0x505
+#define DPLL_REF_FREQ_BASE_REG_SIZE						2
+#define DPLL_REF_FREQ_MULT_REG							0x507
+#define DPLL_REF_FREQ_MULT_REG_SIZE						2
+#define DPLL_REF_FREQ_RATIO_M_REG						0x509
+#define DPLL_REF_FREQ_RATIO_M_REG_SIZE					2
+#define DPLL_REF_FREQ_RATIO_N_REG						0x50B
+#define DPLL_REF_FREQ_RATIO_N_REG_SIZE					2
+#define DPLL_REF_PHASE_OFFSET_COMPENSATION_REG			0x528
+#define DPLL_REF_PHASE_OFFSET_COMPENSATION_REG_SIZE		6
+
+#define DPLL_REF_SYNC_CTRL						0x52E
+#define DPLL_REF_SYNC_CTRL_MODE_GET(val)		(val & GENMASK(3, 0))
+#define DPLL_REF_ESYNC_DIV_REG					0x530
+#define DPLL_REF_ESYNC_DIV_SIZE					4
+
+#define DPLL_DPLL_MB_MASK			0x602
+#define DPLL_DPLL_MB_MASK_SIZE		2
+#define DPLL_DPLL_MB_SEM			0x604
+#define DPLL_DPLL_MB_SEM_SIZE		1
+#define DPLL_DPLL_MB_SEM_RD			BIT(1)
+#define DPLL_DPLL_MB_SEM_WR			BIT(0)
+
+#define DPLL_REF_PRIORITY(refId)				(0x652 + (refId/2))
+#define DPLL_REF_PRIORITY_GET_UPPER(data)		(((data) & GENMASK(7, 4)) >> 4)
+#define DPLL_REF_PRIORITY_GET_LOWER(data)		((data) & GENMASK(3, 0))
+
+#define DPLL_REF_PRIORITY_GET(data, refId) \
+	(((refId) % 2 == 0) ? DPLL_REF_PRIORITY_GET_LOWER(data) : \
+							DPLL_REF_PRIORITY_GET_UPPER(data))
+
+#define DPLL_REF_PRIORITY_SET_LOWER(data, value) \
+	(((data) & GENMASK(7, 4)) | ((value) & GENMASK(3, 0)))
+
+#define DPLL_REF_PRIORITY_SET_UPPER(data, value) \
+	(((data) & GENMASK(3, 0)) | (((value) & GENMASK(3, 0)) << 4))
+
+#define DPLL_REF_PRIORITY_SET(data, refId, value) \
+	(((refId) % 2 == 0) ? DPLL_REF_PRIORITY_SET_LOWER((data), (value)) : \
+							DPLL_REF_PRIORITY_SET_UPPER((data), (value)))
+
+#define DPLL_REF_PRIORITY_INVALID	0xf
+#define DPLL_REF_INVALID			0xff
+
+#define DPLL_SYNTH_MB_MASK			0x682
+#define DPLL_SYNTH_MB_MASK_SIZE		2
+#define DPLL_SYNTH_MB_SEM			0x684
+#define DPLL_SYNTH_MB_SEM_SIZE		1
+#define DPLL_SYNTH_MB_SEM_RD		BIT(1)
+#define DPLL_SYNTH_FREQ_BASE		0x686
+#define DPLL_SYNTH_FREQ_BASE_SIZE	2
+#define DPLL_SYNTH_FREQ_MULT		0x688
+#define DPLL_SYNTH_FREQ_MULT_SIZE	4
+#define DPLL_SYNTH_FREQ_M			0x68c
+#define DPLL_SYNTH_FREQ_M_SIZE		2
+#define DPLL_SYNTH_FREQ_N			0x68e
+#define DPLL_SYNTH_FREQ_N_SIZE		2
+
+#define DPLL_OUTPUT_MB_MASK								0x702
+#define DPLL_OUTPUT_MB_MASK_SIZE						2
+#define DPLL_OUTPUT_MB_SEM								0x704
+#define DPLL_OUTPUT_MB_SEM_SIZE							1
+#define DPLL_OUTPUT_MB_SEM_RD							BIT(1)
+#define DPLL_OUTPUT_MB_SEM_WR							BIT(0)
+#define DPLL_OUTPUT_MODE								0x705
+#define DPLL_OUTPUT_MODE_SIZE							1
+#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT(val)				((val) << 4)
+#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT_GET(val)			((val & GENMASK(7, 4)) >> 4)
+#define DPLL_OUTPUT_MODE_SIGNAL_FORMAT_MASK				GENMASK(7, 4)
+#define DPLL_OUTPUT_MODE_CLOCK_TYPE_GET(val)			(val & GENMASK(2, 0))
+#define DPLL_OUTPUT_DIV									0x70c
+#define DPLL_OUTPUT_DIV_SIZE							4
+#define DPLL_OUTPUT_WIDTH								0x710
+#define DPLL_OUTPUT_WIDTH_SIZE							4
+#define DPLL_OUTPUT_ESYNC_DIV_REG						0x714
+#define DPLL_OUTPUT_ESYNC_DIV_SIZE						4
+#define DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG				0x718
+#define DPLL_OUTPUT_ESYNC_PULSE_WIDTH_SIZE				4
+#define DPLL_OUTPUTP_GREATER_THAN_OUTPUTN(outp, outn)	((outp) > (outn))
+#define DPLL_OUTPUT_PHASE_COMPENSATION_REG				0x720
+#define DPLL_OUTPUT_PHASE_COMPENSATION_REG_SIZE			4
+#define DPLL_OUTPUT_GPO_EN								0x724
+#define DPLL_OUTPUT_GPO_EN_SIZE							1
+
+#define ZL3073X_1PPM_FORMAT		281474976
+
+#define ZL3073X_MAX_SYNTH				5
+#define ZL3073X_MAX_INPUT_PINS			10
+#define ZL3073X_MAX_OUTPUT_PINS			20
+#define ZL3073X_MAX_OUTPUT_PIN_PAIRS	(ZL3073X_MAX_OUTPUT_PINS / 2)
+#define ZL3073X_MAX_DPLLS				5
+
+#define READ_SLEEP_US			10
+#define READ_TIMEOUT_US			100000
+
+/* Poll @op(@arg) into @val until @cond holds. A failed bus read ends the poll
+ * at once with its error, instead of looking like a busy bit for the whole
+ * READ_TIMEOUT_US. @val must be signed to hold that error.
+ */
+#define zl3073x_poll(op, arg, val, cond)					\
+({										\
+	int __ret;								\
+										\
+	BUILD_BUG_ON(!is_signed_type(typeof(val)));				\
+	__ret = readx_poll_timeout_atomic(op, arg, val,				\
+					      (val) < 0 || (cond),		\
+					      READ_SLEEP_US, READ_TIMEOUT_US);	\
+	__ret ?: ((val) < 0 ? (val) : 0);					\
+})
+
+#define ZL3073X_CHECK_SYNTH_ID(synth)	((synth >= 0) && (synth < ZL3073X_MAX_SYNTH))
+
+/* The members of the family differ in the number of DPLL channels. The
+ * register map has room for ZL3073X_MAX_DPLLS channels, ZL3073X_MAX_INPUT_PINS
+ * references and ZL3073X_MAX_OUTPUT_PINS outputs; a variant uses a prefix of
+ * each.
+ */
+struct zl3073x_chip_info {
+	u16		id;
+	u8		num_dplls;
+	u8		num_refs;
+	u8		num_outputs;
+};
+
+#define ZL3073X_CHIP_INFO(_id, _dplls)				\
+	{							\
+		.id = _id,					\
+		.num_dplls = _dplls,				\
+		.num_refs = ZL3073X_MAX_INPUT_PINS,		\
+		.num_outputs = ZL3073X_MAX_OUTPUT_PINS,		\
+	}
+
+static const struct zl3073x_chip_info zl3073x_chip_infos[] = {
+	ZL3073X_CHIP_INFO(0x0E93, 1),	/* ZL30731 */
+	ZL3073X_CHIP_INFO(0x0E94, 2),	/* ZL30732 */
+	ZL3073X_CHIP_INFO(0x0E95, 3),	/* ZL30733 */
+	ZL3073X_CHIP_INFO(0x0E96, 4),	/* ZL30734 */
+	ZL3073X_CHIP_INFO(0x0E97, 5),	/* ZL30735 */
+	ZL3073X_CHIP_INFO(0x1E93, 1),	/* ZL80731 */
+	ZL3073X_CHIP_INFO(0x1E94, 2),	/* ZL80732 */
+	ZL3073X_CHIP_INFO(0x1E95, 3),	/* ZL80733 */
+	ZL3073X_CHIP_INFO(0x1E96, 4),	/* ZL80734 */
+	ZL3073X_CHIP_INFO(0x1E97, 5),	/* ZL80735 */
+};
+
+/* Layout the driver always assumed, kept for chip IDs it does not know */
+static const struct zl3073x_chip_info zl3073x_chip_info_default =
+	ZL3073X_CHIP_INFO(0, 2);
+
+enum zl3073x_mode_t {
+	ZL3073X_MODE_FREERUN        = 0x0,
+	ZL3073X_MODE_HOLDOVER       = 0x1,
+	ZL3073X_MODE_REFLOCK        = 0x2,
+	ZL3073X_MODE_AUTO_LOCK      = 0x3,
+	ZL3073X_MODE_NCO			= 0x4,
+};
+
+enum zl3073x_dpll_state_t {
+	ZLS3073X_DPLL_STATE_FREERUN		= 0x0,
+	ZLS3073X_DPLL_STATE_HOLDOVER	= 0x1,
+	ZLS3073X_DPLL_STATE_FAST_LOCK	= 0x2,
+	ZLS3073X_DPLL_STATE_ACQUIRING	= 0x3,
+	ZLS3073X_DPLL_STATE_LOCK		= 0x4,
+};
+
+enum zl3073x_tod_ctrl_cmd_t {
+	ZL3073X_TOD_CTRL_CMD_WRITE_NEXT_1HZ	= 0x1,
+	ZL3073X_TOD_CTRL_CMD_READ		= 0x8,
+	ZL3073X_TOD_CTRL_CMD_READ_NEXT_1HZ	= 0x9,
+};
+
+enum zl3073x_ref_sync_ctrl_mode_t {
+	ZL3073X_REF_SYNC_PAIR_DISABLED	= 0x0,
+	ZL3073X_CLOCK_50_50_ESYNC_25_75	= 0x2,
+};
+enum zl3073x_output_mode_signal_format_t {
+	ZL3073X_BOTH_DISABLED			= 0x0,
+	ZL3073X_BOTH_ENABLED			= 0x4,
+	ZL3073X_P_ENABLE			= 0x5,
+	ZL3073X_N_ENABLE			= 0x6,
+	ZL3073X_N_DIVIDED			= 0xC,
+	ZL3073X_N_DIVIDED_AND_INVERTED	= 0xD,
+};
+
+enum zl3073x_output_mode_clock_type_t {
+	ZL3073X_NORMAL_CLOCK		= 0x0,
+	ZL3073X_ESYNC				= 0x1,
+	ZL3073X_ESYNC_ALTERNATING	= 0x2,
+};
+
+enum zl3073x_pin_type {
+	ZL3073X_SINGLE_ENDED_IN_PHASE, /* CMOS in phase */
+	ZL3073X_SINGLE_ENDED_DIVIDED, /* CMOS N divided */
+	ZL3073X_DIFFERENTIAL, /* programmable diff or LVDS*/
+};
+
+enum zl3073x_output_freq_type_t {
+	ZL3073X_SYNCE,
+	ZL3073X_SYNCE_1Hz_FIXED,
+	ZL3073X_PTP,
+	ZL3073X_25MHz_FIXED,
+	ZL3073X_10MHz_FIXED_EPPS,
+	ZL3073X_1Hz_FIXED,
+};
+
+enum zl3073x_pin_input_frequency {
+	ZL3073X_INPUT_FREQ_1HZ			= 1,
+	ZL3073X_INPUT_FREQ_25HZ			= 25,
+	ZL3073X_INPUT_FREQ_100HZ		= 100,
+	ZL3073X_INPUT_FREQ_1KHZ			= 1000,
+	ZL3073X_INPUT_FREQ_10MHZ		= 10000000,
+	ZL3073X_INPUT_FREQ_25MHZ		= 25000000,
+	ZL3073X_INPUT_FREQ_62p5MHZ		= 62500000,
+	ZL3073X_INPUT_FREQ_78p125MHZ	= 78125000,
+	ZL3073X_INPUT_FREQ_100MHZ		= 100000000,
+};
+
+/* Every hardware resource that needs more than one bus transfer to be used
+ * (a mailbox, a command/semaphore register pair, a measurement latch) has its
+ * own lock, held across the whole command sequence. The individual transfers
+ * are serialized by the MFD lock, which is only held inside zl3073x_read() and
+ * zl3073x_write(), so a TOD read does not wait behind a mailbox sequence.
+ *
+ * The enum order is the lock order: a resource lock may only be taken while
+ * holding locks of lower value. The bus lock is always innermost.
+ *
+ *   tod[n] -> phase_step -> tie -> output_mb -> synth_mb -> ref_mb ->
+ *   dpll_mb -> meas -> bus
+ *
+ * Each resource gets its own lockdep class so that the order is checked.
+ */
+enum zl3073x_res {
+	ZL3073X_RES_TOD,
+	ZL3073X_RES_PHASE_STEP = ZL3073X_RES_TOD + ZL3073X_MAX_DPLLS,
+	ZL3073X_RES_TIE,
+	ZL3073X_RES_OUTPUT_MB,
+	ZL3073X_RES_SYNTH_MB,
+	ZL3073X_RES_REF_MB,
+	ZL3073X_RES_DPLL_MB,
+	ZL3073X_RES_MEAS,
+	ZL3073X_RES_MAX,
+};
+
+#define ZL3073X_RES_TOD_OF(dpll_index)	(ZL3073X_RES_TOD + (dpll_index))
+
+struct zl3073x;
+
+/* Provided by the including environment. Reads return the register bytes as
+ * they are on the chip, MSB at the lowest address; writes take the buffer LSB
+ * first and swap it in place.
+ */
+static int zl3073x_read(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count);
+static int zl3073x_write(struct zl3073x *zl3073x, u16 regaddr, u8 *buf, u16 count);
+static void zl3073x_res_assert_held(struct zl3073x *zl3073x, enum zl3073x_res res);
+/* Address of the page the bus is on, or ZL3073X_PAGE_NONE if not known. Only a
+ * hint: another user of the bus may move it at any time.
+ */
+static u16 zl3073x_bus_page(struct zl3073x *zl3073x);
+
+#define ZL3073X_PAGE_NONE		0xffff
+#define ZL3073X_PAGE_OF(addr)		((addr) & ~0x7f)
+
+static inline const struct zl3073x_chip_info *zl3073x_chip_info_lookup(u16 chip_id)
+{
+	for (int i = 0; i < ARRAY_SIZE(zl3073x_chip_infos); i++)
+		if (zl3073x_chip_infos[i].id == chip_id)
+			return &zl3073x_chip_infos[i];
+
+	return NULL;
+}
+
+/* When accessing the registers of the DPLL, it is always required to access
+ * first the lower address and then the higher address. The MSB of the data is
+ * always stored at the lowest address and LSB is stored at the highest address.
+ * This format is different than most setups therefore make sure to swap the
+ * bytes before writting and after reading so it can be easier to follow the
+ * datasheet.  This function was added for this purpose and it is used inside
+ * the read and write functions.
+ */
+static inline u8 *zl3073x_swap(u8 *swap, u16 count)
+{
+	int i;
+
+	for (i = 0; i < count / 2; ++i) {
+		u8 tmp = swap[i];
+
+		swap[i] = swap[count - i - 1];
+		swap[count - i - 1] = tmp;
+	}
+
+	return swap;
+}
+
+/* Value of a multi-byte register as returned by zl3073x_read() */
+static inline u64 zl3073x_get_be(const u8 *buf, int count)
+{
+	u64 val = 0;
+
+	for (int i = 0; i < count; i++)
+		val = (val << 8) | buf[i];
+
+	return val;
+}
+
+static inline s64 zl3073x_get_be_signed(const u8 *buf, int count)
+{
+	return sign_extend64(zl3073x_get_be(buf, count), count * 8 - 1);
+}
+
+static inline void zl3073x_ptp_timestamp_to_bytearray(const struct timespec64 *ts,
+						      u8 *sec, u8 *nsec)
+{
+	sec[0] = (ts->tv_sec >> 0) & 0xff;
+	sec[1] = (ts->tv_sec >> 8) & 0xff;
+	sec[2] = (ts->tv_sec >> 16) & 0xff;
+	sec[3] = (ts->tv_sec >> 24) & 0xff;
+	sec[4] = (ts->tv_sec >> 32) & 0xff;
+	sec[5] = (ts->tv_sec >> 40) & 0xff;
+
+	nsec[0] = (ts->tv_nsec >> 0) & 0xff;
+	nsec[1] = (ts->tv_nsec >> 8) & 0xff;
+	nsec[2] = (ts->tv_nsec >> 16) & 0xff;
+	nsec[3] = (ts->tv_nsec >> 24) & 0xff;
+	nsec[4] = 0;
+	nsec[5] = 0;
+}
+
+static inline void zl3073x_ptp_bytearray_to_timestamp(struct timespec64 *ts,
+						      u8 *sec, u8 *nsec)
+{
+	ts->tv_sec = sec[0];
+	for (int i = 1; i < DPLL_TOD_SEC_SIZE; ++i) {
+		ts->tv_sec = ts->tv_sec << 8;
+		ts->tv_sec |= sec[i];
+	}
+
+	ts->tv_nsec = nsec[0];
+	for (int i = 1; i < DPLL_TOD_NSEC_SIZE - 2; ++i) {
+		ts->tv_nsec = ts->tv_nsec << 8;
+		ts->tv_nsec |= nsec[i];
+	}
+
+	set_normalized_timespec64(ts, ts->tv_sec, ts->tv_nsec);
+}
+
+/* Synth and reference frequencies are base * multiplier * numerator / denominator */
+static inline u64 zl3073x_freq_calc(u16 base, u32 mult, u16 numerator, u16 denominator)
+{
+	if (!denominator)
+		return 0;
+
+	return div_u64((u64)base * mult * numerator, denominator);
+}
+
+static inline int zl3073x_dpll_map_raw_to_manager_mode(int raw_mode, enum dpll_mode *mode)
+{
+	switch (raw_mode)	{
+	case ZL3073X_MODE_HOLDOVER:
+	case ZL3073X_MODE_REFLOCK:
+		*mode = DPLL_MODE_MANUAL;
+		break;
+	case ZL3073X_MODE_AUTO_LOCK:
+		*mode = DPLL_MODE_AUTOMATIC;
+		break;
+	case ZL3073X_MODE_FREERUN:
+	case ZL3073X_MODE_NCO:
+	default:
+		*mode = -EINVAL;
+		break;
+	}
+
+	return 0;
+}
+
+/* Lock status from DPLL_LOCK_REFSEL_STATUS and the holdover-ready bit of
+ * DPLL_MON_STATUS
+ */
+static inline enum dpll_lock_status zl3073x_lock_status_from_raw(u8 dpll_state, bool ho_ready)
+{
+	switch (dpll_state)	{
+	case ZLS3073X_DPLL_STATE_FREERUN:
+	case ZLS3073X_DPLL_STATE_FAST_LOCK:
+	case ZLS3073X_DPLL_STATE_ACQUIRING:
+		return DPLL_LOCK_STATUS_UNLOCKED;
+	case ZLS3073X_DPLL_STATE_HOLDOVER:
+		return DPLL_LOCK_STATUS_HOLDOVER;
+	case ZLS3073X_DPLL_STATE_LOCK:
+		if (ho_ready)
+			return DPLL_LOCK_STATUS_LOCKED_HO_ACQ;
+		return DPLL_LOCK_STATUS_LOCKED;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* State of a qualified reference on a DPLL in the given mode. In automatic
+ * mode the selected reference is connected and any other one with a valid
+ * priority is selectable; otherwise only the forced reference is connected.
+ */
+static inline enum dpll_pin_state zl3073x_input_pin_state_from_raw(u8 mode, u8 ref,
+								   u8 selected_ref,
+								   u8 forced_ref,
+								   u8 priority)
+{
+	if (mode == ZL3073X_MODE_AUTO_LOCK) {
+		if (ref == selected_ref)
+			return DPLL_PIN_STATE_CONNECTED;
+		if (priority != DPLL_REF_PRIORITY_INVALID)
+			return DPLL_PIN_STATE_SELECTABLE;
+		return DPLL_PIN_STATE_DISCONNECTED;
+	}
+
+	if (ref == forced_ref)
+		return DPLL_PIN_STATE_CONNECTED;
+
+	return DPLL_PIN_STATE_DISCONNECTED;
+}
+
+/* The phase error of a reference slower than the one the DPLL is locked to
+ * is only meaningful modulo the period of the faster signal
+ */
+static inline s64 zl3073x_phase_offset_fold(s64 phase_offset_ps, u64 connected_ref_freq,
+					    u64 ref_freq)
+{
+	s64 period_ps;
+
+	if (!connected_ref_freq || connected_ref_freq <= ref_freq)
+		return phase_offset_ps;
+
+	period_ps = (s64)div64_u64(PSEC_PER_SEC, connected_ref_freq);
+	if (!period_ps)
+		return phase_offset_ps;
+
+	return phase_offset_ps - period_ps * div64_s64(phase_offset_ps, period_ps);
+}
+
+/* The reference, DPLL, synth and output mailboxes work the same way: select
+ * the channel(s) in the mask register, write a read or write command to the
+ * semaphore register, and wait for the chip to clear it. Between a read
+ * command and a write command the mailbox registers hold the configuration of
+ * the selected channel. The whole sequence runs under the resource lock of
+ * the mailbox.
+ */
+struct zl3073x_mb {
+	u16			mask_reg;
+	u16			sem_reg;
+	enum zl3073x_res	res;
+};
+
+static const struct zl3073x_mb zl3073x_ref_mb = {
+	.mask_reg = DPLL_REF_MB_MASK,
+	.sem_reg = DPLL_REF_MB_SEM,
+	.res = ZL3073X_RES_REF_MB,
+};
+
+static const struct zl3073x_mb zl3073x_dpll_mb = {
+	.mask_reg = DPLL_DPLL_MB_MASK,
+	.sem_reg = DPLL_DPLL_MB_SEM,
+	.res = ZL3073X_RES_DPLL_MB,
+};
+
+static const struct zl3073x_mb zl3073x_synth_mb = {
+	.mask_reg = DPLL_SYNTH_MB_MASK,
+	.sem_reg = DPLL_SYNTH_MB_SEM,
+	.res = ZL3073X_RES_SYNTH_MB,
+};
+
+static const struct zl3073x_mb zl3073x_output_mb = {
+	.mask_reg = DPLL_OUTPUT_MB_MASK,
+	.sem_reg = DPLL_OUTPUT_MB_SEM,
+	.res = ZL3073X_RES_OUTPUT_MB,
+};
+
+static inline int zl3073x_mb_sem(struct zl3073x *zl3073x, const struct zl3073x_mb *mb)
+{
+	int ret;
+	u8 sem;
+
+	ret = zl3073x_read(zl3073x, mb->sem_reg, &sem, sizeof(sem));
+	if (ret)
+		return ret;
+
+	return sem;
+}
+
+static inline int zl3073x_mb_select(struct zl3073x *zl3073x, const struct zl3073x_mb *mb,
+				    u16 mask)
+{
+	u8 buf[2] = { mask & 0xff, mask >> 8 };
+
+	zl3073x_res_assert_held(zl3073x, mb->res);
+
+	return zl3073x_write(zl3073x, mb->mask_reg, buf, sizeof(buf));
+}
+
+/* Wait until the chip has completed the command bits in @cmd */
+static inline int zl3073x_mb_wait(struct zl3073x *zl3073x, const struct zl3073x_mb *mb, u8 cmd)
+{
+	int ret;
+	int val;
+
+	zl3073x_res_assert_held(zl3073x, mb->res);
+
+	ret = read_poll_timeout_atomic(zl3073x_mb_sem, val, val < 0 || !(val & cmd),
+				       READ_SLEEP_US, READ_TIMEOUT_US, false, zl3073x, mb);
+	if (ret)
+		return ret;
+
+	return val < 0 ? val : 0;
+}
+
+/* Issue a read or write command and wait for the chip to complete it */
+static inline int zl3073x_mb_cmd(struct zl3073x *zl3073x, const struct zl3073x_mb *mb, u8 cmd)
+{
+	int ret;
+
+	zl3073x_res_assert_held(zl3073x, mb->res);
+
+	ret = zl3073x_write(zl3073x, mb->sem_reg, &cmd, sizeof(cmd));
+	if (ret)
+		return ret;
+
+	return zl3073x_mb_wait(zl3073x, mb, cmd);
+}
+
+/* Latch the configuration of the channels in @mask into the mailbox registers */
+static inline int zl3073x_mb_read(struct zl3073x *zl3073x, const struct zl3073x_mb *mb,
+				  u16 mask, u8 rd_cmd)
+{
+	int ret;
+
+	ret = zl3073x_mb_select(zl3073x, mb, mask);
+	if (ret)
+		return ret;
+
+	return zl3073x_mb_cmd(zl3073x, mb, rd_cmd);
+}
+
+/* Register fields. Every field is described once in ZL3073X_FIELDS():
+ *
+ *	F(name, reg, size, stride, type, flags, mb)
+ *
+ * reg is the address of instance 0, instance n is at reg + n * stride. type is
+ * the C type of the value; a signed type makes the field sign extended from
+ * its size. Fields with a mailbox are only valid between a read command and
+ * the release of that mailbox.
+ *
+ * The chip stores every field MSB first, which the accessors take care of;
+ * there is no per-field byte order.
+ *
+ * For each field this generates the descriptor zl3073x_field_<name> and the
+ * typed accessors zl3073x_field_read_<name>() and zl3073x_field_write_<name>().
+ */
+#define ZL3073X_FIELD_VOLATILE		BIT(0)	/* changed by the chip */
+#define ZL3073X_FIELD_SIGNED		BIT(1)	/* set from the type */
+
+#define ZL3073X_FIELDS(F)									\
+	F(ref_mon_status,	DPLL_REF_MON_STATUS(0),		1, 1,    u8,  ZL3073X_FIELD_VOLATILE, NULL) \
+	F(dpll_mon_status,	DPLL_MON_STATUS(0),		1, 1,    u8,  ZL3073X_FIELD_VOLATILE, NULL) \
+	F(dpll_lock_refsel_status, DPLL_LOCK_REFSEL_STATUS(0),	1, 1,    u8,  ZL3073X_FIELD_VOLATILE, NULL) \
+	F(ref_freq_err,		DPLL_REF_FREQ_ERR(0),		4, 4,    s32, ZL3073X_FIELD_VOLATILE, NULL) \
+	F(ref_phase_err,	DPLL_REF_PHASE_ERR(0),		6, 6,    s64, ZL3073X_FIELD_VOLATILE, NULL) \
+	F(dpll_mode_refsel,	DPLL_MODE_REFSEL(0),		1, 4,    u8,  0, NULL)			\
+	F(dpll_df_offset,	DPLL_DF_OFFSET(0),		6, 0x20, s64, 0, NULL)			\
+	F(synth_ctrl,		DPLL_SYNTH_CTRL(0),		1, 1,    u8,  0, NULL)			\
+	F(output_ctrl,		DPLL_OUTPUT_CTRL(0),		1, 1,    u8,  0, NULL)			\
+	F(ref_freq_base,	DPLL_REF_FREQ_BASE_REG,		2, 0,    u16, 0, &zl3073x_ref_mb)	\
+	F(ref_freq_mult,	DPLL_REF_FREQ_MULT_REG,		2, 0,    u16, 0, &zl3073x_ref_mb)	\
+	F(ref_freq_m,		DPLL_REF_FREQ_RATIO_M_REG,	2, 0,    u16, 0, &zl3073x_ref_mb)	\
+	F(ref_freq_n,		DPLL_REF_FREQ_RATIO_N_REG,	2, 0,    u16, 0, &zl3073x_ref_mb)	\
+	F(ref_phase_comp,	DPLL_REF_PHASE_OFFSET_COMPENSATION_REG, 6, 0, s64, 0, &zl3073x_ref_mb)	\
+	F(ref_sync_ctrl,	DPLL_REF_SYNC_CTRL,		1, 0,    u8,  0, &zl3073x_ref_mb)	\
+	F(ref_esync_div,	DPLL_REF_ESYNC_DIV_REG,		4, 0,    u32, 0, &zl3073x_ref_mb)	\
+	F(synth_freq_base,	DPLL_SYNTH_FREQ_BASE,		2, 0,    u16, 0, &zl3073x_synth_mb)	\
+	F(synth_freq_mult,	DPLL_SYNTH_FREQ_MULT,		4, 0,    u32, 0, &zl3073x_synth_mb)	\
+	F(synth_freq_m,		DPLL_SYNTH_FREQ_M,		2, 0,    u16, 0, &zl3073x_synth_mb)	\
+	F(synth_freq_n,		DPLL_SYNTH_FREQ_N,		2, 0,    u16, 0, &zl3073x_synth_mb)	\
+	F(output_mode,		DPLL_OUTPUT_MODE,		1, 0,    u8,  0, &zl3073x_output_mb)	\
+	F(output_div,		DPLL_OUTPUT_DIV,		4, 0,    u32, 0, &zl3073x_output_mb)	\
+	F(output_width,		DPLL_OUTPUT_WIDTH,		4, 0,    u32, 0, &zl3073x_output_mb)	\
+	F(output_esync_div,	DPLL_OUTPUT_ESYNC_DIV_REG,	4, 0,    u32, 0, &zl3073x_output_mb)	\
+	F(output_esync_width,	DPLL_OUTPUT_ESYNC_PULSE_WIDTH_REG, 4, 0, u32, 0, &zl3073x_output_mb)	\
+	F(output_phase_comp,	DPLL_OUTPUT_PHASE_COMPENSATION_REG, 4, 0, s32, 0, &zl3073x_output_mb)	\
+	F(output_gpo_en,	DPLL_OUTPUT_GPO_EN,		1, 0,    u8,  0, &zl3073x_output_mb)
+
+struct zl3073x_field {
+	u16			reg;
+	u8			size;
+	u8			stride;
+	u8			flags;
+	const struct zl3073x_mb	*mb;
+};
+
+static inline u16 zl3073x_field_addr(const struct zl3073x_field *field, u8 index)
+{
+	return field->reg + index * field->stride;
+}
+
+/* Value of @field from the register bytes as returned by zl3073x_read() */
+static inline u64 zl3073x_field_decode(const struct zl3073x_field *field, const u8 *buf)
+{
+	u64 val = zl3073x_get_be(buf, field->size);
+
+	if (field->flags & ZL3073X_FIELD_SIGNED)
+		return sign_extend64(val, field->size * 8 - 1);
+
+	return val;
+}
+
+static inline int zl3073x_field_read(struct zl3073x *zl3073x, const struct zl3073x_field *field,
+				     u8 index, u64 *val)
+{
+	u8 buf[8];
+	int ret;
+
+	if (field->mb)
+		zl3073x_res_assert_held(zl3073x, field->mb->res);
+
+	ret = zl3073x_read(zl3073x, zl3073x_field_addr(field, index), buf, field->size);
+	if (ret)
+		return ret;
+
+	*val = zl3073x_field_decode(field, buf);
+
+	return 0;
+}
+
+static inline int zl3073x_field_write(struct zl3073x *zl3073x, const struct zl3073x_field *field,
+				      u8 index, u64 val)
+{
+	u8 buf[8];
+
+	if (field->mb)
+		zl3073x_res_assert_held(zl3073x, field->mb->res);
+
+	/* LSB first, zl3073x_write() swaps */
+	for (int i = 0; i < field->size; i++)
+		buf[i] = val >> (i * 8);
+
+	return zl3073x_write(zl3073x, zl3073x_field_addr(field, index), buf, field->size);
+}
+
+#define ZL3073X_FIELD_DEFINE(_name, _reg, _size, _stride, _type, _flags, _mb)		\
+	_Static_assert(sizeof(_type) >= (_size), #_name " does not fit " #_type);	\
+											\
+	static const struct zl3073x_field zl3073x_field_##_name = {			\
+		.reg = (_reg),								\
+		.size = (_size),							\
+		.stride = (_stride),							\
+		.flags = (_flags) | (is_signed_type(_type) ? ZL3073X_FIELD_SIGNED : 0), \
+		.mb = (_mb),								\
+	};										\
+											\
+	static inline int zl3073x_field_read_##_name(struct zl3073x *zl3073x,		\
+						     u8 index, _type *val)		\
+	{										\
+		u64 raw;								\
+		int ret;								\
+											\
+		ret = zl3073x_field_read(zl3073x, &zl3073x_field_##_name, index, &raw);	\
+		if (!ret)								\
+			*val = (_type)raw;						\
+											\
+		return ret;								\
+	}										\
+											\
+	static inline int zl3073x_field_write_##_name(struct zl3073x *zl3073x,	\
+						      u8 index, _type val)		\
+	{										\
+		return zl3073x_field_write(zl3073x, &zl3073x_field_##_name, index, val);\
+	}
+
+ZL3073X_FIELDS(ZL3073X_FIELD_DEFINE)
+
+/* A field of a zl3073x_field_read_batch() request, val is filled in */
+struct zl3073x_field_req {
+	const struct zl3073x_field *field;
+	u8			index;
+	u64			val;
+};
+
+#define ZL3073X_FIELD_REQ(_name, _index)			\
+	{ .field = &zl3073x_field_##_name, .index = (_index) }
+
+/* Whether none of the @count fields of @req is changed by the chip, so that a
+ * cache of them only goes stale on the driver's own writes
+ */
+static inline bool zl3073x_field_reqs_cacheable(const struct zl3073x_field_req *req, int count)
+{
+	for (int i = 0; i < count; i++)
+		if (req[i].field->flags & ZL3073X_FIELD_VOLATILE)
+			return false;
+
+	return true;
+}
+
+#define ZL3073X_FIELD_BATCH_MAX		32
+#define ZL3073X_FIELD_BURST_MAX		32
+
+/* Whether @next, starting at @addr, touches or overlaps the burst
+ * [@start, @end) and can extend it. Holes are never read through: regmap
+ * moves one byte per bus transaction, so a hole byte costs as much as a
+ * requested one. A burst never crosses a page or the page register. @addr is
+ * below @start where the page rotation wraps around to the lowest pages.
+ */
+static inline bool zl3073x_field_joinable(u16 start, u16 end,
+					  const struct zl3073x_field_req *next, u16 addr)
+{
+	u16 next_end = addr + next->field->size;
+
+	if (next_end < end)
+		next_end = end;
+
+	return addr >= start && addr <= end &&
+	       next_end - start <= ZL3073X_FIELD_BURST_MAX &&
+	       (start >> 7) == ((next_end - 1) >> 7) &&
+	       ((next_end - 1) & 0x7f) != 0x7f;
+}
+
+/* Read the @count fields of @req with as few zl3073x_read() calls as
+ * possible: the requests are sorted by address and grouped into bursts of
+ * adjacent registers, each burst read with one call. The transport still
+ * moves one byte per bus transaction, so a burst saves bus lock acquisitions
+ * and per-call overhead, not transactions. The bursts on the page the bus is
+ * on go first, so that every page of the batch is selected at most once and
+ * the current one not at all, which does save transactions.
+ */
+static inline int zl3073x_field_read_batch(struct zl3073x *zl3073x,
+					   struct zl3073x_field_req *req, int count)
+{
+	u8 buf[ZL3073X_FIELD_BURST_MAX];
+	u8 order[ZL3073X_FIELD_BATCH_MAX];
+	u8 rot[ZL3073X_FIELD_BATCH_MAX];
+	u16 page;
+	int first, i, j;
+	int ret;
+
+	if (count > ZL3073X_FIELD_BATCH_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		u16 addr = zl3073x_field_addr(req[i].field, req[i].index);
+
+		if (req[i].field->mb)
+			zl3073x_res_assert_held(zl3073x, req[i].field->mb->res);
+
+		for (j = i; j > 0; j--) {
+			const struct zl3073x_field_req *prev = &req[order[j - 1]];
+
+			if (zl3073x_field_addr(prev->field, prev->index) <= addr)
+				break;
+			order[j] = order[j - 1];
+		}
+		order[j] = i;
+	}
+
+	page = zl3073x_bus_page(zl3073x);
+	for (first = 0; first < count; first++)
+		if (ZL3073X_PAGE_OF(zl3073x_field_addr(req[order[first]].field,
+						       req[order[first]].index)) == page)
+			break;
+
+	if (first && first < count) {
+		for (i = 0; i < count; i++)
+			rot[i] = order[(first + i) % count];
+		memcpy(order, rot, count);
+	}
+
+	for (first = 0; first < count; first = i) {
+		struct zl3073x_field_req *r = &req[order[first]];
+		u16 start = zl3073x_field_addr(r->field, r->index);
+		u16 end = start + r->field->size;
+
+		for (i = first + 1; i < count; i++) {
+			struct zl3073x_field_req *next = &req[order[i]];
+			u16 addr = zl3073x_field_addr(next->field, next->index);
+
+			if (!zl3073x_field_joinable(start, end, next, addr))
+				break;
+			if (addr + next->field->size > end)
+				end = addr + next->field->size;
+		}
+
+		ret = zl3073x_read(zl3073x, start, buf, end - start);
+		if (ret)
+			return ret;
+
+		for (j = first; j < i; j++) {
+			struct zl3073x_field_req *f = &req[order[j]];
+			u16 addr = zl3073x_field_addr(f->field, f->index);
+
+			f->val = zl3073x_field_decode(f->field, &buf[addr - start]);
+		}
+	}
+
+	return 0;
+}
+
+#endif /* __ZL3073X_CORE_H */
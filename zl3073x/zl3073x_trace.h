@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* Tracepoints of the zl3073x driver. The journal event mirrors every entry of
+ * the per-device transition journal, see zl3073x_journal_add().
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM zl3073x
+
+#if !defined(_ZL3073X_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ZL3073X_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(zl3073x_journal,
+
+	TP_PROTO(const struct device *dev, u64 seq, const char *type, u8 dpll, u8 ref,
+		 u32 old_val, u32 new_val, bool tod_valid, s64 tod_ns,
+		 s64 phase_offset, s64 ffo),
+
+	TP_ARGS(dev, seq, type, dpll, ref, old_val, new_val, tod_valid, tod_ns,
+		phase_offset, ffo),
+
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__string(type, type)
+		__field(u64, seq)
+		__field(u8, dpll)
+		__field(u8, ref)
+		__field(u32, old_val)
+		__field(u32, new_val)
+		__field(bool, tod_valid)
+		__field(s64, tod_ns)
+		__field(s64, phase_offset)
+		__field(s64, ffo)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev);
+		__assign_str(type);
+		__entry->seq = seq;
+		__entry->dpll = dpll;
+		__entry->ref = ref;
+		__entry->old_val = old_val;
+		__entry->new_val = new_val;
+		__entry->tod_valid = tod_valid;
+		__entry->tod_ns = tod_ns;
+		__entry->phase_offset = phase_offset;
+		__entry->ffo = ffo;
+	),
+
+	TP_printk("%s seq=%llu %s dpll=%u ref=%u %u->%u tod_ns=%lld%s phase_ps=%lld ffo=%lld",
+		  __get_str(dev), __entry->seq, __get_str(type), __entry->dpll,
+		  __entry->ref, __entry->old_val, __entry->new_val, __entry->tod_ns,
+		  __entry->tod_valid ? "" : "(invalid)", __entry->phase_offset,
+		  __entry->ffo)
+);
+
+#endif /* _ZL3073X_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE zl3073x_trace
+#include <trace/define_trace.h>